@@ -1,6 +1,6 @@
 #include "fpzip.h"
 
-fpzipError fpzip_errno;
+FPZIP_THREAD_LOCAL fpzipError fpzip_errno;
 
 const char* fpzip_errstr[] = {
   "success",
@@ -35,6 +35,8 @@
 ** The code has been modified in minor ways to support its use within Silo.
 ** Some assert calls were removed. Some error codes were added. The read
 ** interface was ajdusted to return sizing information. - MCM 01Jun14
+** fpzip_errno is thread local so that chunks, and the slab streams of
+** fpzip_memory_write_slabs, can be coded on several threads at once.
 **
 ** fpzip was developed as part of the LOCAL LDRD project at LLNL, and may
 ** be freely used and distributed for noncommercial purposes.  The core
@@ -136,6 +138,44 @@ fpzip_memory_write(
   unsigned    nf      /* number of fields */
 );
 
+/*
+** Slab streams.  The array is split into independent z-slabs that are
+** coded separately and indexed by a table of offsets, so slabs can be
+** encoded and decoded on several threads and a range of z planes can be
+** read without decoding the rest of the array.  fpzip_memory_read also
+** reads slab streams.
+*/
+
+size_t                /* number of compressed bytes written (zero = error) */
+fpzip_memory_write_slabs(
+  void*       buffer, /* pointer to compressed data */
+  size_t      size,   /* size of allocated storage */
+  const void* data,   /* array to write */
+  const int*  prec,   /* per field bits of precision (null = full precision) */
+  int         dp,     /* double precision array if nonzero */
+  unsigned    nx,     /* number of x samples */
+  unsigned    ny,     /* number of y samples */
+  unsigned    nz,     /* number of z samples */
+  unsigned    nf,     /* number of fields */
+  unsigned    nslabs, /* number of z-slabs (at most nz) */
+  int         nthreads /* number of threads to encode with */
+);
+
+size_t                /* size of compressed stream (zero = error) */
+fpzip_memory_read_slabs(
+  const void* buffer, /* pointer to compressed data */
+  void*       data,   /* array to read planes z0 through z1-1 into */
+  int*        prec,   /* returned per field bits of precision (may be null) */
+  int         *dp,    /* returned double precision array if nonzero */
+  unsigned    *nx,    /* returned number of x samples */
+  unsigned    *ny,    /* returned number of y samples */
+  unsigned    *nz,    /* returned number of z samples */
+  unsigned    *nf,    /* returned number of fields */
+  unsigned    z0,     /* first z plane to read */
+  unsigned    z1,     /* one past last z plane to read (clamped to nz) */
+  int         nthreads /* number of threads to decode with */
+);
+
 /*
 ** Fortran bindings.
 */
@@ -208,7 +248,21 @@ typedef enum {
   fpzipErrorTargetRescaleTooLarge = 12
 } fpzipError;
 
-extern fpzipError fpzip_errno;     /* error code */
+/* fpzip_errno is per thread, so concurrent calls do not see each other's
+   errors */
+#if defined(_MSC_VER)
+  #define FPZIP_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__) || defined(__INTEL_COMPILER)
+  #define FPZIP_THREAD_LOCAL __thread
+#elif defined(__cplusplus) && __cplusplus >= 201103L
+  #define FPZIP_THREAD_LOCAL thread_local
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+  #define FPZIP_THREAD_LOCAL _Thread_local
+#else
+  #define FPZIP_THREAD_LOCAL
+#endif
+
+extern FPZIP_THREAD_LOCAL fpzipError fpzip_errno; /* error code */
 extern const char* fpzip_errstr[]; /* error message indexed by fpzip_errno */
 
 #ifdef __cplusplus
@@ -1,11 +1,13 @@
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include "pcdecoder.h"
 #include "rcqsmodel.h"
 #include "front.h"
 #include "fpzip.h"
 #include "codec.h"
 #include "read.h"
+#include "slab.h"
 
 #if FPZIP_FP == FPZIP_FP_FAST || FPZIP_FP == FPZIP_FP_SAFE
 // decompress 3D array at specified precision using floating-point arithmetic
@@ -135,25 +137,19 @@ decompress3d(
     decompress3d<T, subsize(T, p)>(rd, data, nx, ny, nz);\
     break
 
-// decompress 4D array
+// decompress one field of a 3D array at the given precision
 template <typename T>
 static bool
-decompress4d(
+decompress_field(
   RCdecoder* rd,   // entropy decoder
-  T*         data, // flattened 4D array to decompress to
-  int*       prec, // per field precision
+  T*         data, // flattened 3D array to decompress to
+  int        bits, // precision
   unsigned   nx,   // number of x samples
   unsigned   ny,   // number of y samples
-  unsigned   nz,   // number of z samples
-  unsigned   nf    // number of fields
+  unsigned   nz    // number of z samples
 )
 {
-  // decompress one field at a time
-  for (unsigned i = 0; i < nf; i++) {
-    int bits = rd->template decode <unsigned>(32);
-    if (prec)
-      prec[i] = bits;
-    switch (bits) {
+  switch (bits) {
       decompress_case( 2);
       decompress_case( 3);
       decompress_case( 4);
@@ -185,9 +181,33 @@ decompress4d(
       decompress_case(30);
       decompress_case(31);
       decompress_case(32);
-      default:
-        fpzip_errno = fpzipErrorBadPrecision;
-        return false;
+    default:
+      return false;
+  }
+  return true;
+}
+
+// decompress 4D array
+template <typename T>
+static bool
+decompress4d(
+  RCdecoder* rd,   // entropy decoder
+  T*         data, // flattened 4D array to decompress to
+  int*       prec, // per field precision
+  unsigned   nx,   // number of x samples
+  unsigned   ny,   // number of y samples
+  unsigned   nz,   // number of z samples
+  unsigned   nf    // number of fields
+)
+{
+  // decompress one field at a time
+  for (unsigned i = 0; i < nf; i++) {
+    int bits = rd->template decode <unsigned>(32);
+    if (prec)
+      prec[i] = bits;
+    if (!decompress_field(rd, data, bits, nx, ny, nz)) {
+      fpzip_errno = fpzipErrorBadPrecision;
+      return false;
     }
     data += nx * ny * nz;
   }
@@ -248,7 +268,7 @@ fpzip_stream_read(
     return false;
   if (data == 0)
     return true;
-  if (dp)
+  if (*dp)
     return decompress4d(rd, (double*)data, prec, *nx, *ny, *nz, *nf);
   else
     return decompress4d(rd, (float*)data, prec, *nx, *ny, *nz, *nf);
@@ -280,9 +300,9 @@ fpzip_file_read(
   return bytes;
 }
 
-// read and decompress a single or double precision 4D array from file
-size_t
-fpzip_memory_read(
+// read and decompress a classic (single stream) array from memory
+static size_t
+fpzip_memory_read_stream(
   const void* buffer, // pointer to compressed data
   void*       data,   // array to read
   int*        prec,   // per field bits of precision
@@ -305,6 +325,171 @@ fpzip_memory_read(
   return bytes;
 }
 
+// state shared by the slab decoding jobs
+struct SlabReader {
+  const unsigned char* base;  // start of slab stream
+  void*                data;  // array to read z-range into
+  int*                 prec;  // per field bits of precision
+  int                  dp;    // double precision array if nonzero
+  unsigned             nx;    // number of x samples
+  unsigned             ny;    // number of y samples
+  unsigned             nz;    // number of z samples
+  unsigned             nf;    // number of fields
+  unsigned             thick; // slab thickness in z
+  unsigned             z0;    // first z plane to read
+  unsigned             z1;    // one past last z plane to read
+  unsigned             s0;    // first slab overlapping [z0, z1)
+  bool*                ok;    // per job success
+};
+
+// decompress the part of one z-slab that overlaps [z0, z1)
+template <typename T>
+static bool
+decompress_slab(const SlabReader* r, unsigned s)
+{
+  const unsigned char* offsets = r->base + 4 * FPZIP_SLAB_HEADER_WORDS;
+  size_t begin = (size_t)fpzip_get64(offsets + 8 * s);
+  size_t end = (size_t)fpzip_get64(offsets + 8 * (s + 1));
+  unsigned sz0 = s * r->thick;
+  unsigned sz1 = sz0 + r->thick < r->nz ? sz0 + r->thick : r->nz;
+  unsigned a = sz0 > r->z0 ? sz0 : r->z0;
+  unsigned b = sz1 < r->z1 ? sz1 : r->z1;
+  size_t plane = (size_t)r->nx * r->ny;
+  bool whole = a == sz0 && b == sz1;
+  T* out = (T*)r->data + (a - r->z0) * plane;
+  T* tmp = whole ? 0 : new T[plane * (sz1 - sz0)];
+  bool status = true;
+
+  RCslabdecoder rd(r->base + begin, end - begin);
+  rd.init();
+  for (unsigned i = 0; i < r->nf && status; i++) {
+    int bits = rd.decode<unsigned>(32);
+    if (r->prec && s == r->s0)
+      r->prec[i] = bits;
+    if (whole)
+      status = decompress_field(&rd, out, bits, r->nx, r->ny, sz1 - sz0);
+    else if ((status = decompress_field(&rd, tmp, bits, r->nx, r->ny, sz1 - sz0)))
+      memcpy(out, tmp + (a - sz0) * plane, (b - a) * plane * sizeof(T));
+    out += plane * (r->z1 - r->z0);
+  }
+  delete[] tmp;
+  return status && !rd.error;
+}
+
+static void
+read_slab(void* arg, unsigned k)
+{
+  SlabReader* r = (SlabReader*)arg;
+  unsigned s = r->s0 + k;
+  r->ok[k] = r->dp ? decompress_slab<double>(r, s)
+                   : decompress_slab<float>(r, s);
+}
+
+// read and decompress planes [z0, z1) of a single or double precision 4D
+// array from memory, decoding only the slabs that overlap the range
+size_t
+fpzip_memory_read_slabs(
+  const void* buffer,  // pointer to compressed data
+  void*       data,    // array to read z-range into
+  int*        prec,    // per field bits of precision
+  int         *dp,     // double precision array if nonzero
+  unsigned    *nx,     // number of x samples
+  unsigned    *ny,     // number of y samples
+  unsigned    *nz,     // number of z samples
+  unsigned    *nf,     // number of fields
+  unsigned    z0,      // first z plane to read
+  unsigned    z1,      // one past last z plane to read
+  int         nthreads // number of threads to decode slabs with
+)
+{
+  const unsigned char* base = (const unsigned char*)buffer;
+
+  // classic stream; decode all of it and keep the requested planes
+  if (memcmp(base, FPZIP_SLAB_MAGIC, 4)) {
+    size_t bytes = fpzip_memory_read_stream(buffer, 0, prec, dp, nx, ny, nz, nf);
+    if (data == 0 || fpzip_errno)
+      return bytes;
+    if (z1 > *nz)
+      z1 = *nz;
+    if (z0 == 0 && z1 == *nz)
+      return fpzip_memory_read_stream(buffer, data, prec, dp, nx, ny, nz, nf);
+    if (z0 > z1) {
+      fpzip_errno = fpzipErrorBadDimensions;
+      return 0;
+    }
+    size_t size = *dp ? sizeof(double) : sizeof(float);
+    size_t plane = (size_t)*nx * *ny * size;
+    unsigned char* tmp = new unsigned char[plane * *nz * *nf];
+    bytes = fpzip_memory_read_stream(buffer, tmp, prec, dp, nx, ny, nz, nf);
+    if (bytes)
+      for (unsigned i = 0; i < *nf; i++)
+        memcpy((unsigned char*)data + i * plane * (z1 - z0),
+               tmp + (i * (size_t)*nz + z0) * plane, plane * (z1 - z0));
+    delete[] tmp;
+    return bytes;
+  }
+
+  fpzip_errno = fpzipSuccess;
+  if (fpzip_get32(base + 4) != FPZ_MAJ_VERSION ||
+      fpzip_get32(base + 8) != FPZ_MIN_VERSION) {
+    fpzip_errno = fpzipErrorBadVersion;
+    return 0;
+  }
+  *nf = fpzip_get32(base + 12);
+  *nz = fpzip_get32(base + 16);
+  *ny = fpzip_get32(base + 20);
+  *nx = fpzip_get32(base + 24);
+  *dp = (int)fpzip_get32(base + 28);
+  unsigned nslabs = fpzip_get32(base + 32);
+  unsigned thick = fpzip_get32(base + 36);
+  if (nslabs != (thick ? (*nz + thick - 1) / thick : 1)) {
+    fpzip_errno = fpzipErrorBadFormat;
+    return 0;
+  }
+  size_t total = (size_t)fpzip_get64(base + 4 * FPZIP_SLAB_HEADER_WORDS + 8 * nslabs);
+  if (data == 0)
+    return 0;
+
+  if (z1 > *nz)
+    z1 = *nz;
+  if (z0 > z1) {
+    fpzip_errno = fpzipErrorBadDimensions;
+    return 0;
+  }
+  if (z0 == z1)
+    return total;
+
+  // slabs overlapping [z0, z1)
+  unsigned s0 = z0 / thick;
+  unsigned s1 = (z1 + thick - 1) / thick;
+  bool* ok = new bool[s1 - s0];
+  SlabReader r = { base, data, prec, *dp, *nx, *ny, *nz, *nf, thick, z0, z1, s0, ok };
+  fpzip_run_slabs(read_slab, &r, s1 - s0, nthreads);
+  for (unsigned k = 0; k < s1 - s0; k++)
+    if (!ok[k])
+      fpzip_errno = fpzipErrorReadStream;
+  delete[] ok;
+  return fpzip_errno ? 0 : total;
+}
+
+// read and decompress a single or double precision 4D array from memory
+size_t
+fpzip_memory_read(
+  const void* buffer, // pointer to compressed data
+  void*       data,   // array to read
+  int*        prec,   // per field bits of precision
+  int         *dp,    // double precision array if nonzero
+  unsigned    *nx,    // number of x samples
+  unsigned    *ny,    // number of y samples
+  unsigned    *nz,    // number of z samples
+  unsigned    *nf     // number of fields
+)
+{
+  if (!memcmp(buffer, FPZIP_SLAB_MAGIC, 4))
+    return fpzip_memory_read_slabs(buffer, data, prec, dp, nx, ny, nz, nf, 0, -1u, 1);
+  return fpzip_memory_read_stream(buffer, data, prec, dp, nx, ny, nz, nf);
+}
+
 // wrappers for fortran calls
 void
 fpzip_file_read_f(
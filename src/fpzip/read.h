@@ -63,4 +63,22 @@ private:
   const unsigned char* const begin;
 };
 
+// memory reader for one slab; reads past the end of the slab return zero
+class RCslabdecoder : public RCdecoder {
+public:
+  RCslabdecoder(const void* buffer, size_t size) : RCdecoder(), error(false), ptr((const unsigned char*)buffer), end(ptr + size) {}
+  unsigned getbyte()
+  {
+    if (ptr == end) {
+      error = true;
+      return 0;
+    }
+    return *ptr++;
+  }
+  bool error;
+private:
+  const unsigned char* ptr;
+  const unsigned char* const end;
+};
+
 #endif
@@ -0,0 +1,132 @@
+#ifndef FPZIP_SLAB_H
+#define FPZIP_SLAB_H
+
+// Slab container for fpzip streams.  The array is cut into independent
+// z-slabs, each range coded on its own, and a table of byte offsets in
+// the header lets slabs be encoded or decoded in any order, on any
+// number of threads, or skipped entirely.
+//
+//   "fpzs" magic (4 bytes)
+//   u32 major version, minor version
+//   u32 nf, nz, ny, nx, dp
+//   u32 number of slabs, slab thickness in z
+//   u64 offset[nslabs + 1]  (from start of buffer; last is total size)
+//   slab streams: per field, 32-bit precision then the slab planes
+//
+// All header words are little endian.
+
+#include "config.h"
+
+#include <stddef.h>
+
+#if defined(HAVE_PTHREAD_H) && !defined(_WIN32)
+#define FPZIP_SLAB_THREADS
+#include <pthread.h>
+#endif
+
+#define FPZIP_SLAB_MAGIC "fpzs"
+#define FPZIP_SLAB_THREADS_MAX 64
+
+// fixed part of slab header; offset table follows
+#define FPZIP_SLAB_HEADER_WORDS 10
+
+static inline size_t
+fpzip_slab_header_size(unsigned nslabs)
+{
+  return 4 * FPZIP_SLAB_HEADER_WORDS + 8 * ((size_t)nslabs + 1);
+}
+
+static inline void
+fpzip_put32(unsigned char* p, unsigned v)
+{
+  for (int i = 0; i < 4; i++, v >>= 8)
+    p[i] = (unsigned char)v;
+}
+
+static inline unsigned
+fpzip_get32(const unsigned char* p)
+{
+  unsigned v = 0;
+  for (int i = 3; i >= 0; i--)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+static inline void
+fpzip_put64(unsigned char* p, unsigned long long v)
+{
+  for (int i = 0; i < 8; i++, v >>= 8)
+    p[i] = (unsigned char)v;
+}
+
+static inline unsigned long long
+fpzip_get64(const unsigned char* p)
+{
+  unsigned long long v = 0;
+  for (int i = 7; i >= 0; i--)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+// run job(arg, s) for s in [0, n) on up to nthreads threads; the calling
+// thread takes slabs too and finishes the work alone if threads cannot
+// be started
+typedef void (*fpzip_slab_job)(void* arg, unsigned s);
+
+#ifdef FPZIP_SLAB_THREADS
+struct fpzip_slab_queue {
+  pthread_mutex_t lock;
+  unsigned next;
+  unsigned n;
+  fpzip_slab_job job;
+  void* arg;
+};
+
+static inline void*
+fpzip_slab_worker(void* p)
+{
+  fpzip_slab_queue* q = (fpzip_slab_queue*)p;
+  for (;;) {
+    pthread_mutex_lock(&q->lock);
+    unsigned s = q->next < q->n ? q->next++ : q->n;
+    pthread_mutex_unlock(&q->lock);
+    if (s == q->n)
+      break;
+    q->job(q->arg, s);
+  }
+  return 0;
+}
+#endif
+
+static inline void
+fpzip_run_slabs(fpzip_slab_job job, void* arg, unsigned n, int nthreads)
+{
+#ifdef FPZIP_SLAB_THREADS
+  if (nthreads > FPZIP_SLAB_THREADS_MAX)
+    nthreads = FPZIP_SLAB_THREADS_MAX;
+  if (nthreads > (int)n)
+    nthreads = (int)n;
+  if (nthreads > 1) {
+    fpzip_slab_queue q;
+    pthread_t threads[FPZIP_SLAB_THREADS_MAX];
+    int started[FPZIP_SLAB_THREADS_MAX];
+    pthread_mutex_init(&q.lock, 0);
+    q.next = 0;
+    q.n = n;
+    q.job = job;
+    q.arg = arg;
+    for (int i = 1; i < nthreads; i++)
+      started[i] = !pthread_create(&threads[i], 0, fpzip_slab_worker, &q);
+    fpzip_slab_worker(&q);
+    for (int i = 1; i < nthreads; i++)
+      if (started[i])
+        pthread_join(threads[i], 0);
+    pthread_mutex_destroy(&q.lock);
+    return;
+  }
+#endif
+  for (unsigned s = 0; s < n; s++)
+    job(arg, s);
+}
+
+#endif
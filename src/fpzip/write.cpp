@@ -1,11 +1,13 @@
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include "pcencoder.h"
 #include "rcqsmodel.h"
 #include "front.h"
 #include "fpzip.h"
 #include "codec.h"
 #include "write.h"
+#include "slab.h"
 
 #if FPZIP_FP == FPZIP_FP_FAST || FPZIP_FP == FPZIP_FP_SAFE
 // compress 3D array at specified precision using floating-point arithmetic
@@ -135,24 +137,19 @@ compress3d(
     compress3d<T, subsize(T, p)>(re, data, nx, ny, nz);\
     break
 
-// compress 4D array
+// compress one field of a 3D array at the given precision
 template <typename T>
 static bool
-compress4d(
+compress_field(
   RCencoder* re,   // entropy encoder
-  const T*   data, // flattened 4D array to compress
-  const int* prec, // per field desired precision
+  const T*   data, // flattened 3D array to compress
+  int        bits, // desired precision
   unsigned   nx,   // number of x samples
   unsigned   ny,   // number of y samples
-  unsigned   nz,   // number of z samples
-  unsigned   nf    // number of fields
+  unsigned   nz    // number of z samples
 )
 {
-  // compress one field at a time
-  for (unsigned i = 0; i < nf; i++) {
-    int bits = prec ? prec[i] : CHAR_BIT * (int)sizeof(T);
-    re->encode(bits, 32);
-    switch (bits) {
+  switch (bits) {
       compress_case( 2);
       compress_case( 3);
       compress_case( 4);
@@ -184,9 +181,32 @@ compress4d(
       compress_case(30);
       compress_case(31);
       compress_case(32);
-      default:
-        fpzip_errno = fpzipErrorBadPrecision;
-        return false;
+    default:
+      return false;
+  }
+  return true;
+}
+
+// compress 4D array
+template <typename T>
+static bool
+compress4d(
+  RCencoder* re,   // entropy encoder
+  const T*   data, // flattened 4D array to compress
+  const int* prec, // per field desired precision
+  unsigned   nx,   // number of x samples
+  unsigned   ny,   // number of y samples
+  unsigned   nz,   // number of z samples
+  unsigned   nf    // number of fields
+)
+{
+  // compress one field at a time
+  for (unsigned i = 0; i < nf; i++) {
+    int bits = prec ? prec[i] : CHAR_BIT * (int)sizeof(T);
+    re->encode(bits, 32);
+    if (!compress_field(re, data, bits, nx, ny, nz)) {
+      fpzip_errno = fpzipErrorBadPrecision;
+      return false;
     }
     data += nx * ny * nz;
   }
@@ -301,6 +321,168 @@ fpzip_memory_write(
   return bytes;
 }
 
+// true if bits is a supported precision for type T
+template <typename T>
+static bool
+valid_precision(int bits)
+{
+  for (unsigned p = 2; p <= 32; p++)
+    if (bits == (int)subsize(T, p))
+      return true;
+  return false;
+}
+
+// state shared by the slab encoding jobs
+struct SlabWriter {
+  const void*     data;   // array to write
+  const int*      prec;   // per field bits of precision
+  int             dp;     // double precision array if nonzero
+  unsigned        nx;     // number of x samples
+  unsigned        ny;     // number of y samples
+  unsigned        nz;     // number of z samples
+  unsigned        nf;     // number of fields
+  unsigned        thick;  // slab thickness in z
+  unsigned char** out;    // per slab output
+  size_t*         cap;    // per slab output capacity
+  size_t*         bytes;  // per slab compressed size
+  bool*           ok;     // per slab success
+};
+
+// compress all fields of one z-slab into its own range coded stream
+template <typename T>
+static bool
+compress_slab(RCencoder* re, const SlabWriter* w, unsigned s)
+{
+  unsigned z0 = s * w->thick;
+  unsigned z1 = z0 + w->thick < w->nz ? z0 + w->thick : w->nz;
+  size_t plane = (size_t)w->nx * w->ny;
+  const T* data = (const T*)w->data + z0 * plane;
+  for (unsigned i = 0; i < w->nf; i++) {
+    int bits = w->prec ? w->prec[i] : CHAR_BIT * (int)sizeof(T);
+    re->encode(bits, 32);
+    if (!compress_field(re, data, bits, w->nx, w->ny, z1 - z0))
+      return false;
+    data += plane * w->nz;
+  }
+  re->finish();
+  return true;
+}
+
+static void
+write_slab(void* arg, unsigned s)
+{
+  SlabWriter* w = (SlabWriter*)arg;
+  RCslabencoder re(w->out[s], w->cap[s]);
+  bool ok = w->dp ? compress_slab<double>(&re, w, s)
+                  : compress_slab<float>(&re, w, s);
+  w->ok[s] = ok && !re.error;
+  w->bytes[s] = re.bytes();
+}
+
+// compress and write a single or double precision 4D array to memory as
+// independently coded z-slabs, using up to nthreads threads
+size_t
+fpzip_memory_write_slabs(
+  void*       buffer,  // pointer to compressed data
+  size_t      size,    // size of allocated storage
+  const void* data,    // array to write
+  const int*  prec,    // per field bits of precision
+  int         dp,      // double precision array if nonzero
+  unsigned    nx,      // number of x samples
+  unsigned    ny,      // number of y samples
+  unsigned    nz,      // number of z samples
+  unsigned    nf,      // number of fields
+  unsigned    nslabs,  // requested number of slabs
+  int         nthreads // number of threads to encode slabs with
+)
+{
+  fpzip_errno = fpzipSuccess;
+
+  // validate precision up front so slab jobs cannot fail on it
+  for (unsigned i = 0; prec && i < nf; i++)
+    if (dp ? !valid_precision<double>(prec[i]) : !valid_precision<float>(prec[i])) {
+      fpzip_errno = fpzipErrorBadPrecision;
+      return 0;
+    }
+
+  // pick a slab thickness that covers nz with at most nslabs slabs
+  if (nslabs < 1)
+    nslabs = 1;
+  if (nslabs > nz && nz > 0)
+    nslabs = nz;
+  unsigned thick = nz ? (nz + nslabs - 1) / nslabs : 0;
+  nslabs = thick ? (nz + thick - 1) / thick : 1;
+
+  size_t head = fpzip_slab_header_size(nslabs);
+  if (size < head) {
+    fpzip_errno = fpzipErrorBufferOverflow;
+    return 0;
+  }
+
+  unsigned char* base = (unsigned char*)buffer;
+  unsigned char** out = new unsigned char*[nslabs];
+  size_t* cap = new size_t[nslabs];
+  size_t* bytes = new size_t[nslabs];
+  bool* ok = new bool[nslabs];
+  SlabWriter w = { data, prec, dp, nx, ny, nz, nf, thick, out, cap, bytes, ok };
+  size_t offset = head;
+  bool status = true;
+
+  if (nthreads > 1 && nslabs > 1) {
+    // encode slabs concurrently into scratch buffers, then concatenate
+    size_t raw = (size_t)nx * ny * thick * nf * (dp ? sizeof(double) : sizeof(float));
+    for (unsigned s = 0; s < nslabs; s++) {
+      cap[s] = raw + raw / 8 + 1024;
+      out[s] = new unsigned char[cap[s]];
+    }
+    fpzip_run_slabs(write_slab, &w, nslabs, nthreads);
+    for (unsigned s = 0; s < nslabs && status; s++) {
+      if (!ok[s] || bytes[s] > size - offset)
+        status = false;
+      else {
+        fpzip_put64(base + 4 * FPZIP_SLAB_HEADER_WORDS + 8 * s, offset);
+        memcpy(base + offset, out[s], bytes[s]);
+        offset += bytes[s];
+      }
+    }
+    for (unsigned s = 0; s < nslabs; s++)
+      delete[] out[s];
+  }
+  else {
+    // encode slabs in order straight into the output buffer
+    for (unsigned s = 0; s < nslabs && status; s++) {
+      out[s] = base + offset;
+      cap[s] = size - offset;
+      write_slab(&w, s);
+      if (!ok[s])
+        status = false;
+      else {
+        fpzip_put64(base + 4 * FPZIP_SLAB_HEADER_WORDS + 8 * s, offset);
+        offset += bytes[s];
+      }
+    }
+  }
+
+  delete[] out;
+  delete[] cap;
+  delete[] bytes;
+  delete[] ok;
+
+  if (!status) {
+    fpzip_errno = fpzipErrorBufferOverflow;
+    return 0;
+  }
+
+  memcpy(base, FPZIP_SLAB_MAGIC, 4);
+  unsigned words[FPZIP_SLAB_HEADER_WORDS - 1] = {
+    FPZ_MAJ_VERSION, FPZ_MIN_VERSION, nf, nz, ny, nx, (unsigned)!!dp, nslabs, thick
+  };
+  for (unsigned i = 0; i < FPZIP_SLAB_HEADER_WORDS - 1; i++)
+    fpzip_put32(base + 4 * (i + 1), words[i]);
+  fpzip_put64(base + 4 * FPZIP_SLAB_HEADER_WORDS + 8 * nslabs, offset);
+  return offset;
+}
+
 // wrappers for fortran calls
 void
 fpzip_file_write_f(
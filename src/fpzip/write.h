@@ -74,4 +74,24 @@ private:
   const unsigned char* const end;
 };
 
+// memory writer for one slab; overflow is only flagged since slabs may
+// be encoded concurrently
+class RCslabencoder : public RCencoder {
+public:
+  RCslabencoder(void* buffer, size_t size) : RCencoder(), error(false), ptr((unsigned char*)buffer), begin(ptr), end(ptr + size) {}
+  void putbyte(unsigned byte)
+  {
+    if (ptr == end)
+      error = true;
+    else
+      *ptr++ = (unsigned char)byte;
+  }
+  size_t bytes() const { return ptr - begin; }
+  bool error;
+private:
+  unsigned char* ptr;
+  const unsigned char* const begin;
+  const unsigned char* const end;
+};
+
 #endif
@@ -56,6 +56,12 @@ product endorsement purposes.
    is explicitly upgraded to the 1.8 API, this symbol should be removed. */
 #define H5_USE_16_API
 
+/* The _GNU_SOURCE wrapper logic is to enable the O_DIRECT flag. It has
+   to come before any system header is included, hdf5.h among them. */
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
 #include <config.h>
 #if defined(HAVE_HDF5_H) && defined(HAVE_LIBHDF5)
 
@@ -66,14 +72,10 @@ product endorsement purposes.
 
 #if HDF5_VERSION_GE(1,8,4)
 
-/* The _GNU_SOURCE wrapper logic is to enable the O_DIRECT flag */
-#ifdef __linux__
-#define _GNU_SOURCE
-#endif
-
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdio.h> /* for snprintf */
 #include <stdlib.h>
 #include <string.h>
@@ -82,6 +84,13 @@ product endorsement purposes.
 #ifndef _WIN32
 #include <unistd.h>
 #endif
+#if defined(HAVE_PWRITEV) || defined(HAVE_PREADV)
+#include <sys/uio.h>
+#endif
+#if defined(HAVE_PTHREAD_H) && !defined(_WIN32)
+#define SILO_VFD_WRITE_BEHIND
+#include <pthread.h>
+#endif
 
 #ifdef __linux__
 #undef _GNU_SOURCE
@@ -91,9 +100,9 @@ product endorsement purposes.
    TO DO:
 
      *1. Examine file block alignment with HDF5 lib metadata allocations
-      2. On systems that support O_DIRECT, try posix_madvise/posix_memalign
-      3. Support partial last block
-      4. Aggregate multiple blocks
+     *2. On systems that support O_DIRECT, try posix_madvise/posix_memalign
+     *3. Support partial last block
+     *4. Aggregate multiple blocks
      *5. allow an 'auto' block count or 'max-N'
       6. If 5, add DBFreeSomeSiloVFDBlocks
       7. Compare with sec2 VFD, PDB
@@ -103,11 +112,11 @@ product endorsement purposes.
      11. Fix skipping truncate (maybe by 3)
     *12. Sanity check block size on read relative to write.
      13. Get performance studies on other systems
-     14. Study read performance too.
-     15. Move to DICHOTOMY and write all meta blocks at end of file.
+    *14. Study read performance too.
+    *15. Move to DICHOTOMY and write all meta blocks at end of file.
      16. Write blocks from different MPI tasks to same file. On read
          back, need to specify which 'task' but should otherwise work.
-     17. Use direct I/O where possible (and appropriate).
+    *17. Use direct I/O where possible (and appropriate).
      18. Capture I/O statistics here.
      19. Set mdc_config to never preempt (chews up memory in lib),
          all writes for md will come on close.
@@ -138,19 +147,30 @@ product endorsement purposes.
 #undef MAX
 #endif
 #define MAX(X,Y)	((X)>(Y)?(X):(Y))
+#ifdef MIN
+#undef MIN
+#endif
+#define MIN(X,Y)	((X)<(Y)?(X):(Y))
 
 /* File operations */
 #define OP_UNKNOWN      0
 #define OP_READ         1
 #define OP_WRITE        2
 
-#define EXACT		0
-#define CLOSEST		1
-
 #define SILO_BLKSZ_PROPNAME "silo_block_size"
 #define SILO_BLKCNT_PROPNAME "silo_block_count"
 #define SILO_LOGSTS_PROPNAME "silo_log_stats"
 #define SILO_USEDIR_PROPNAME "silo_use_direct"
+#define SILO_WRBEH_PROPNAME "silo_write_behind"
+#define SILO_RDAHD_PROPNAME "silo_read_ahead"
+#define SILO_MDEND_PROPNAME "silo_meta_at_end"
+
+/* Max. number of blocks combined into a single multi-block write */
+#ifdef IOV_MAX
+#define SILO_MAX_IOV    IOV_MAX
+#else
+#define SILO_MAX_IOV    1024
+#endif
 
 /* definitions related to the file stat utilities.
  * For Unix, if off_t is not 64bit big, try use the pseudo-standard
@@ -278,11 +298,27 @@ typedef struct silo_vfd_stats_t_
     hsize_t total_seeks;
 
     hsize_t num_multiblock_writes;
+    hsize_t num_multiblock_write_blocks;
     hsize_t num_multiblock_reads;
+    hsize_t num_multiblock_read_blocks;
+
+    hsize_t num_read_aheads;
+    hsize_t num_read_ahead_blocks;
 
     hsize_t num_blocks_majority_md;
     hsize_t num_blocks_majority_raw;
 
+    hsize_t num_block_hits;
+    hsize_t num_block_misses;
+    hsize_t num_block_evictions;
+
+    hsize_t num_write_behind_blocks;
+    hsize_t num_write_behind_hits;
+    hsize_t num_write_behind_stalls;
+    hsize_t max_write_behind_queued;
+
+    hsize_t num_meta_at_end_blocks;
+
     hsize_t total_write_count;
     hsize_t total_write_bytes;
 
@@ -345,16 +381,32 @@ typedef struct silo_vfd_relevant_blocks_t_
     int     off0, off1;
 } silo_vfd_relevant_blocks_t;
 
+/* Blocks live in a fixed pool of max_blocks slots. In-use slots are
+   chained into a hash table on block id and onto one of two LRU lists
+   (metadata-majority or raw-majority). Unused slots are chained through
+   'next' onto a free list. All links are slot indices, NO_BLOCK ends a list. */
+#define NO_BLOCK        (-1)
+#define LRU_MD          0
+#define LRU_RAW         1
+
 typedef struct silo_vfd_block_t_
 {
     hsize_t id;
-    hsize_t age;
     void *buf;
     unsigned dirty;
     hsize_t minmoff, maxmoff;
     hsize_t minroff, maxroff;
+    int hnext;          /* next slot in same hash bucket */
+    int lru;            /* which LRU list slot is on */
+    int prev, next;     /* neighbors in LRU list, prev toward head */
 } silo_vfd_block_t;
 
+typedef struct silo_vfd_lru_t_
+{
+    int head;           /* most recently used */
+    int tail;           /* least recently used */
+} silo_vfd_lru_t;
+
 typedef struct silo_vfd_pair_t_ 
 {
     int i;
@@ -370,6 +422,59 @@ static int compare_silo_vfd_pairs(const void *a, const void *b)
     return 0;
 }
 
+/* Metadata-at-end layout. When a file is written in this mode, blocks
+   that hold mostly metadata are kept in memory, sorted by block id, until
+   the file is closed. They are then written one after another starting at
+   the first block boundary past the end of the HDF5 address space. A map
+   of their block ids and a trailer follow:
+
+       md block 0 | md block 1 | ... | id 0 | id 1 | ... | trailer
+
+   All integers are 64 bit little endian. Block 0, which holds the HDF5
+   superblock, always stays in place. An entry with a null buf is one whose
+   buffer is currently owned by a slot in the block cache. */
+#define SILO_MDEND_MAGIC        "SILOMDAE"
+#define SILO_MDEND_TRAILER_SIZE 32
+
+typedef struct silo_vfd_md_entry_t_
+{
+    hsize_t id;
+    void *buf;
+} silo_vfd_md_entry_t;
+
+#ifdef SILO_VFD_WRITE_BEHIND
+/* Write-behind queue. Evicted dirty blocks are handed off, buffer and
+   all, to a ring of at most 'size' entries that a background thread
+   writes to the file in FIFO order. An entry stays on the queue until
+   its write has completed so that a miss on a queued block can be
+   satisfied from the queue instead of from stale file contents. Only
+   the writer thread removes entries and only the main thread adds them.
+   Everything here is protected by 'mutex'; 'cond' is broadcast on any
+   change in queue state. */
+typedef struct silo_vfd_wb_entry_t_
+{
+    hsize_t id;
+    void *buf;
+} silo_vfd_wb_entry_t;
+
+typedef struct silo_vfd_wb_t_
+{
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    silo_vfd_wb_entry_t *ring;
+    int size;           /* max entries in ring */
+    int head;           /* oldest entry */
+    int count;          /* entries in ring, including those being written */
+    int shutdown;       /* tells writer to exit once ring is empty */
+    int err_no;         /* errno of first failed write, 0 if none */
+    hsize_t write_count;
+    hsize_t write_bytes;
+    hsize_t multiblock_writes;
+    hsize_t multiblock_write_blocks;
+} silo_vfd_wb_t;
+#endif
+
 /* The driver identification number, initialized at runtime */
 static hid_t H5FD_SILO_g = 0;
 
@@ -395,13 +500,31 @@ typedef struct H5FD_silo_t {
     int         op;			/*last operation		*/
     unsigned    write_access;  		/* Flag to indicate the file was opened with write access */
     hsize_t     block_size;
-    hsize_t     op_counter;
     silo_vfd_block_t *block_list;
     int         max_blocks;
     int         num_blocks;
+    int         free_head;
+    int        *hash_buckets;
+    hsize_t     hash_mask;
+    silo_vfd_lru_t lru[2];
     int         log_stats;
     char       *log_name;
-    int         use_direct;
+    int         use_direct;             /* O_DIRECT is in effect on fd */
+    size_t      mem_align;              /* alignment of block buffers */
+    int         write_behind;           /* write-behind queue depth, 0 if off */
+    int         read_ahead;             /* max blocks to read ahead, 0 if off */
+    int         ra_window;              /* current read-ahead window in blocks */
+    int         ra_streak;              /* successive reads advancing by ra_stride */
+    hsize_t     ra_stride;              /* block id stride between recent reads */
+    hsize_t     ra_last_id;             /* last block id of previous read */
+    int         meta_at_end;            /* metadata-at-end layout in use */
+    silo_vfd_md_entry_t *md_list;       /* metadata blocks held until close */
+    int         num_md;
+    int         max_md;
+    haddr_t     md_region_addr;         /* where md blocks start in the file */
+#ifdef SILO_VFD_WRITE_BEHIND
+    silo_vfd_wb_t *wb;                  /* NULL when write-behind is off */
+#endif
     silo_vfd_block_bitmap_t was_written_map;
     silo_vfd_block_bitmap_t was_in_mem_map;
     silo_vfd_stats_t stats;
@@ -710,80 +833,199 @@ relevant_blocks(hsize_t block_size, haddr_t addr, hsize_t size)
     return(ret_value);
 }
 
-static int find_block_by_id(H5FD_silo_t *file, hsize_t id, unsigned leq)
+/* Block buffers are aligned to the file system block size so that they
+   can go straight to O_DIRECT reads and writes */
+static void *alloc_block_buf(H5FD_silo_t const *file)
+{
+#ifdef HAVE_POSIX_MEMALIGN
+    void *buf;
+    if (posix_memalign(&buf, file->mem_align, file->block_size) != 0)
+        return 0;
+    return buf;
+#else
+    return malloc(file->block_size);
+#endif
+}
+
+/* Turn O_DIRECT on or off for the file. Transfers that are not whole,
+   aligned blocks must be done with it off. Returns whether it is on. */
+static int set_direct_io(H5FD_silo_t *file, int on)
+{
+#if defined(O_DIRECT) && defined(F_SETFL)
+    int flags = fcntl(file->fd, F_GETFL);
+    if (flags != -1 && fcntl(file->fd, F_SETFL, on ? (flags | O_DIRECT) : (flags & ~O_DIRECT)) == 0)
+        file->use_direct = on;
+#endif
+    return file->use_direct;
+}
+
+static int hash_block_id(H5FD_silo_t const *file, hsize_t id)
+{
+    return (int) ((id * (hsize_t) 2654435761U) & file->hash_mask);
+}
+
+static int find_block_by_id(H5FD_silo_t *file, hsize_t id)
+{
+    int blidx = file->hash_buckets[hash_block_id(file, id)];
+    while (blidx != NO_BLOCK && file->block_list[blidx].id != id)
+        blidx = file->block_list[blidx].hnext;
+    return blidx;
+}
+
+static int block_lru_class(silo_vfd_block_t const *b)
+{
+    int msize = b->maxmoff - b->minmoff;
+    int rsize = b->maxroff - b->minroff;
+    return msize > rsize ? LRU_MD : LRU_RAW;
+}
+
+static void lru_unlink(H5FD_silo_t *file, int blidx)
 {
-    int bot = 0, top = file->num_blocks - 1, mid;
     silo_vfd_block_t *bl = file->block_list;
-    while (bot <= top)
-    {
-        mid = (bot + top) >> 1;
+    silo_vfd_lru_t *lru = &(file->lru[bl[blidx].lru]);
 
-        if (id > bl[mid].id)
-	{
-            if (leq)
-            {
-                if (mid == file->num_blocks-1) return mid;
-                if (id < bl[mid+1].id) return mid;
-            }
-            bot = mid + 1;
-	}
-        else if (id < bl[mid].id)
-	{
-            if (leq)
-            {
-                if (mid == 0) return -1;
-                if (id > bl[mid-1].id) return mid-1;
-            }
-            top = mid - 1;
-	}
-        else
-            return mid;
-    }
-    return -1; 
+    if (bl[blidx].prev != NO_BLOCK)
+        bl[bl[blidx].prev].next = bl[blidx].next;
+    else
+        lru->head = bl[blidx].next;
+
+    if (bl[blidx].next != NO_BLOCK)
+        bl[bl[blidx].next].prev = bl[blidx].prev;
+    else
+        lru->tail = bl[blidx].prev;
 }
 
-static int find_block_to_preempt(H5FD_silo_t *file)
+static void lru_push_head(H5FD_silo_t *file, int blidx)
 {
-    int i;
-    int min_midx = -1;
-    int min_ridx = -1;
     silo_vfd_block_t *bl = file->block_list;
-    hsize_t min_mage = file->op_counter;
-    hsize_t min_rage = file->op_counter;
-    for (i = 1; i < file->num_blocks; i++)
-    {
-#if 1
-        int msize = bl[i].maxmoff - bl[i].minmoff;
-        int rsize = bl[i].maxroff - bl[i].minroff;
+    silo_vfd_lru_t *lru;
 
-        if (msize > rsize)
+    bl[blidx].lru = block_lru_class(&bl[blidx]);
+    lru = &(file->lru[bl[blidx].lru]);
+
+    bl[blidx].prev = NO_BLOCK;
+    bl[blidx].next = lru->head;
+    if (lru->head != NO_BLOCK)
+        bl[lru->head].prev = blidx;
+    else
+        lru->tail = blidx;
+    lru->head = blidx;
+}
+
+/* Move block to the most recently used end of the LRU list for its
+   (possibly changed) metadata/raw class */
+static void touch_block_by_index(H5FD_silo_t *file, int blidx)
+{
+    lru_unlink(file, blidx);
+    lru_push_head(file, blidx);
+}
+
+/* Raw data blocks are preempted before metadata blocks. Block 0, which
+   holds the superblock and root group, is preempted only if it is the
+   sole candidate. */
+static int find_block_to_preempt(H5FD_silo_t *file)
+{
+    static const int lru_order[2] = {LRU_RAW, LRU_MD};
+    int i, blidx, blk0idx = NO_BLOCK;
+
+    for (i = 0; i < 2; i++)
+    {
+        blidx = file->lru[lru_order[i]].tail;
+        if (blidx != NO_BLOCK && file->block_list[blidx].id == 0)
         {
-            if (bl[i].age < min_mage)
-            {
-                min_mage = bl[i].age;
-                min_midx = i;
-            }
+            blk0idx = blidx;
+            blidx = file->block_list[blidx].prev;
         }
+        if (blidx != NO_BLOCK)
+            return blidx;
+    }
+
+    return blk0idx;
+}
+
+/* Binary search the metadata-at-end list for id. Returns the index of
+   its entry, or where it would be inserted, and sets *found accordingly. */
+static int md_search(H5FD_silo_t const *file, hsize_t id, int *found)
+{
+    int bot = 0, top = file->num_md - 1;
+
+    while (bot <= top)
+    {
+        int mid = (bot + top) >> 1;
+        if (id > file->md_list[mid].id)
+            bot = mid + 1;
+        else if (id < file->md_list[mid].id)
+            top = mid - 1;
         else
         {
-            if (bl[i].age < min_rage)
-            {
-                min_rage = bl[i].age;
-                min_ridx = i;
-            }
+            *found = 1;
+            return mid;
         }
-#else
-        if (bl[i].age < min_rage)
+    }
+
+    *found = 0;
+    return bot;
+}
+
+/* Whether a cached block belongs in the metadata region rather than at
+   its own address. Once a block goes there, it stays there. */
+static int md_pinned(H5FD_silo_t const *file, silo_vfd_block_t const *b)
+{
+    int found;
+
+    if (!file->meta_at_end || b->id == 0)
+        return 0;
+    if (file->write_access && block_lru_class(b) == LRU_MD)
+        return 1;
+    md_search(file, b->id, &found);
+    return found;
+}
+
+/* If block id is held in the metadata list, hand its buffer over in
+   place of *buf and return 1. Otherwise return 0. */
+static int md_take_block(H5FD_silo_t *file, hsize_t id, void **buf)
+{
+    int found, i;
+
+    if (!file->meta_at_end)
+        return 0;
+
+    i = md_search(file, id, &found);
+    if (!found || !file->md_list[i].buf)
+        return 0;
+
+    free(*buf);
+    *buf = file->md_list[i].buf;
+    file->md_list[i].buf = 0;
+
+    return 1;
+}
+
+/* Move a pinned block's buffer from its cache slot to the metadata list */
+static void md_put_block(H5FD_silo_t *file, int blidx)
+{
+    silo_vfd_block_t *b = &(file->block_list[blidx]);
+    int found, i = md_search(file, b->id, &found);
+
+    if (!found)
+    {
+        if (file->num_md == file->max_md)
         {
-            min_rage = bl[i].age;
-            min_ridx = i;
+            file->max_md = file->max_md * 2 + 1;
+            file->md_list = (silo_vfd_md_entry_t *) realloc(file->md_list,
+                file->max_md * sizeof(silo_vfd_md_entry_t));
+            HDassert(file->md_list);
         }
-#endif
+        memmove(&(file->md_list[i+1]), &(file->md_list[i]),
+            (file->num_md - i) * sizeof(silo_vfd_md_entry_t));
+        file->md_list[i].id = b->id;
+        file->num_md++;
     }
 
-    if (min_ridx == -1)
-        return min_midx;
-    return min_ridx;
+    HDassert(!file->md_list[i].buf);
+    file->md_list[i].buf = b->buf;
+    b->buf = 0;
+    b->dirty = 0;
 }
 
 static herr_t put_data_to_block_by_index(H5FD_silo_t *file, H5FD_mem_t type, const void *srcbuf, hsize_t size,
@@ -792,7 +1034,7 @@ static herr_t put_data_to_block_by_index(H5FD_silo_t *file, H5FD_mem_t type, con
     silo_vfd_block_t *block;
     haddr_t addr;
 
-    HDassert(blidx < file->num_blocks);
+    HDassert(blidx < file->max_blocks);
     block = &(file->block_list[blidx]);
 
     HDassert(block->buf);
@@ -801,7 +1043,6 @@ static herr_t put_data_to_block_by_index(H5FD_silo_t *file, H5FD_mem_t type, con
     memcpy((char*)block->buf+off, srcbuf, size);
 
     block->dirty = 1;
-    block->age = file->op_counter++;
 
     if (type == H5FD_MEM_DRAW)
     {
@@ -814,6 +1055,8 @@ static herr_t put_data_to_block_by_index(H5FD_silo_t *file, H5FD_mem_t type, con
         if (off+size-1 > block->maxmoff) block->maxmoff = off+size-1;
     }
 
+    touch_block_by_index(file, blidx);
+
     addr = block->id * file->block_size + off + size;
     if (addr > file->eof) file->eof = addr;
 
@@ -825,7 +1068,7 @@ static herr_t get_data_from_block_by_index(H5FD_silo_t *file, H5FD_mem_t type, v
 {
     silo_vfd_block_t *block;
 
-    HDassert(blidx < file->num_blocks);
+    HDassert(blidx < file->max_blocks);
     block = &(file->block_list[blidx]);
 
     HDassert(block->buf);
@@ -833,8 +1076,6 @@ static herr_t get_data_from_block_by_index(H5FD_silo_t *file, H5FD_mem_t type, v
     HDassert((hsize_t)off+size<=file->block_size);
     memcpy(dstbuf, (char*)block->buf+off, size);
 
-    block->age = file->op_counter++;
-
     if (type == H5FD_MEM_DRAW)
     {
         if (off < block->minroff) block->minroff = off;
@@ -846,6 +1087,8 @@ static herr_t get_data_from_block_by_index(H5FD_silo_t *file, H5FD_mem_t type, v
         if (off+size-1 > block->maxmoff) block->maxmoff = off+size-1;
     }
 
+    touch_block_by_index(file, blidx);
+
     return 0;
 }
 
@@ -908,6 +1151,127 @@ static herr_t file_write(H5FD_silo_t *file, haddr_t addr, size_t size, const voi
     return(ret_value);
 }
 
+#ifdef HAVE_PWRITEV
+static herr_t file_writev(H5FD_silo_t *file, haddr_t addr, struct iovec *iov, int iovcnt)
+{
+    static const char  *func = "file_writev";
+    ssize_t		nbytes;
+    size_t              size = 0;
+    herr_t              ret_value = 0;
+    int                 i;
+
+    HDassert(file && file->pub.cls);
+    HDassert(iov);
+
+    H5Eclear2(H5E_DEFAULT);
+
+    for (i = 0; i < iovcnt; i++)
+        size += iov[i].iov_len;
+
+    /* Check for overflow conditions */
+    if (HADDR_UNDEF==addr)
+        H5E_PUSH_HELPER (func, H5E_ERR_CLS, H5E_IO, H5E_OVERFLOW, "addr undefined", -1, -1)
+    if (REGION_OVERFLOW(addr, size))
+        H5E_PUSH_HELPER (func, H5E_ERR_CLS, H5E_IO, H5E_OVERFLOW, "addr overflow", -1, -1)
+
+    /* Write data, being careful of interrupted system calls and partial
+       results. pwritev does not move the file position so pos/op are
+       left alone. */
+    while(iovcnt > 0) {
+        do {
+            nbytes = pwritev(file->fd, iov, iovcnt, (file_offset_t)addr);
+            file->stats.total_write_count++;
+        } while(-1 == nbytes && EINTR == errno);
+        if(-1 == nbytes) /* error */
+            H5E_PUSH_HELPER (func, H5E_ERR_CLS, H5E_IO, H5E_WRITEERROR, "pwritev failed", -1, errno)
+        file->stats.total_write_bytes += nbytes;
+        HDassert(nbytes > 0);
+        H5_CHECK_OVERFLOW(nbytes, ssize_t, haddr_t);
+        addr += (haddr_t)nbytes;
+        while (iovcnt > 0 && (size_t)nbytes >= iov->iov_len)
+        {
+            nbytes -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + nbytes;
+            iov->iov_len -= nbytes;
+        }
+    }
+
+    if (addr > file->file_eof)
+        file->file_eof = addr;
+
+    return(ret_value);
+}
+#endif
+
+#ifdef HAVE_PREADV
+static herr_t file_readv(H5FD_silo_t *file, haddr_t addr, struct iovec *iov, int iovcnt)
+{
+    static const char  *func = "file_readv";
+    ssize_t		nbytes;
+    size_t              size = 0;
+    herr_t              ret_value = 0;
+    int                 i;
+
+    HDassert(file && file->pub.cls);
+    HDassert(iov);
+
+    H5Eclear2(H5E_DEFAULT);
+
+    for (i = 0; i < iovcnt; i++)
+        size += iov[i].iov_len;
+
+    /* Check for overflow conditions */
+    if (HADDR_UNDEF==addr)
+        H5E_PUSH_HELPER (func, H5E_ERR_CLS, H5E_IO, H5E_OVERFLOW, "addr undefined", -1, -1)
+    if (REGION_OVERFLOW(addr, size))
+        H5E_PUSH_HELPER (func, H5E_ERR_CLS, H5E_IO, H5E_OVERFLOW, "addr overflow", -1, -1)
+
+    /* Read data, careful of interrupted system calls, partial results
+       and eof. Like pwritev, preadv leaves the file position alone. */
+    while(iovcnt > 0) {
+        do {
+            nbytes = preadv(file->fd, iov, iovcnt, (file_offset_t)addr);
+            file->stats.total_read_count++;
+        } while(-1 == nbytes && EINTR == errno);
+        if(-1 == nbytes) /* error */
+            H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_IO, H5E_READERROR, "preadv failed", -1, errno)
+        file->stats.total_read_bytes += nbytes;
+        if(0 == nbytes) {
+            /* end of file but not end of format address space */
+            for (i = 0; i < iovcnt; i++)
+                HDmemset(iov[i].iov_base, 0, iov[i].iov_len);
+            break;
+        }
+        H5_CHECK_OVERFLOW(nbytes, ssize_t, haddr_t);
+        addr += (haddr_t)nbytes;
+        while (iovcnt > 0 && (size_t)nbytes >= iov->iov_len)
+        {
+            nbytes -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + nbytes;
+            iov->iov_len -= nbytes;
+        }
+        if (iovcnt > 0 && file->use_direct) {
+            /* short direct read, see file_read */
+            for (i = 0; i < iovcnt; i++)
+                HDmemset(iov[i].iov_base, 0, iov[i].iov_len);
+            break;
+        }
+    }
+
+    return(ret_value);
+}
+#endif
+
 static herr_t file_read(H5FD_silo_t *file, haddr_t addr, size_t size, void *buf)
 {
     static const char  *func = "file_read";
@@ -954,6 +1318,12 @@ static herr_t file_read(H5FD_silo_t *file, haddr_t addr, size_t size, void *buf)
         H5_CHECK_OVERFLOW(nbytes, ssize_t, haddr_t);
         addr += (haddr_t)nbytes;
         buf = (char *)buf + nbytes;
+        if (size > 0 && file->use_direct) {
+            /* A short direct read ends in the partial last block of the
+               file. Reading on from an unaligned offset would fail. */
+            HDmemset(buf, 0, size);
+            break;
+        }
     }
 
     if (ret_value < 0)
@@ -970,6 +1340,25 @@ static herr_t file_read(H5FD_silo_t *file, haddr_t addr, size_t size, void *buf)
     return(ret_value);
 }
 
+static void update_block_write_stats(H5FD_silo_t *file, silo_vfd_block_t *b)
+{
+    int msize = 0, rsize = 0;
+    if (b->maxmoff > b->minmoff)
+        msize = b->maxmoff - b->minmoff;
+    if (b->maxroff > b->minroff)
+        rsize = b->maxroff - b->minroff;
+
+    if (rsize >= msize)
+        file->stats.total_block_raw_writes++;
+    else
+        file->stats.total_block_md_writes++;
+
+    if (get_block_bitmap_by_id(&(file->was_written_map), b->id))
+        update_hotblock_stats(file, b->id, OP_WRITE, (rsize+msize)?(float)rsize/(msize+rsize):(float)0);
+
+    set_block_bitmap_by_id(&(file->was_written_map), b->id);
+}
+
 static herr_t file_write_block(H5FD_silo_t *file, int blidx)
 {
     static const char  *func = "file_write_block";
@@ -988,28 +1377,104 @@ static herr_t file_write_block(H5FD_silo_t *file, int blidx)
         H5E_PUSH_HELPER (func, H5E_ERR_CLS, H5E_IO, H5E_WRITEERROR, "file_write_block failed", -1, -1)
 
     if (file->log_stats)
-    {
-        int msize = 0, rsize = 0;
-        if (b->maxmoff > b->minmoff)
-            msize = b->maxmoff - b->minmoff;
-        if (b->maxroff > b->minroff)
-            rsize = b->maxroff - b->minroff;
+        update_block_write_stats(file, b);
 
-        if (rsize >= msize)
-            file->stats.total_block_raw_writes++;
-        else
-            file->stats.total_block_md_writes++;
+    if (ret_value == 0)
+        b->dirty = 0;
+
+    return(ret_value);
+}
+
+/* Write n dirty blocks with consecutive ids, in order, using a single
+   vectored write where available */
+static herr_t file_write_blocks(H5FD_silo_t *file, int const *blidx, int n)
+{
+#ifdef HAVE_PWRITEV
+    static const char  *func = "file_write_blocks";
+    struct iovec iov[SILO_MAX_IOV];
+    herr_t ret_value = 0;
+    int i;
+
+    HDassert(n <= SILO_MAX_IOV);
 
-        if (get_block_bitmap_by_id(&(file->was_written_map), b->id))
-            update_hotblock_stats(file, b->id, OP_WRITE, (rsize+msize)?(float)rsize/(msize+rsize):(float)0);
+    if (n == 1)
+        return file_write_block(file, blidx[0]);
 
-        set_block_bitmap_by_id(&(file->was_written_map), b->id);
+    H5Eclear2(H5E_DEFAULT);
+
+    for (i = 0; i < n; i++)
+    {
+        silo_vfd_block_t *b = &(file->block_list[blidx[i]]);
+        HDassert(b->dirty);
+        HDassert(b->buf);
+        HDassert(i == 0 || b->id == file->block_list[blidx[i-1]].id + 1);
+        iov[i].iov_base = b->buf;
+        iov[i].iov_len = file->block_size;
     }
 
-    if (ret_value == 0)
+    if (file_writev(file, file->block_list[blidx[0]].id * file->block_size, iov, n) < 0)
+        H5E_PUSH_HELPER (func, H5E_ERR_CLS, H5E_IO, H5E_WRITEERROR, "file_write_blocks failed", -1, -1)
+
+    file->stats.num_multiblock_writes++;
+    file->stats.num_multiblock_write_blocks += n;
+
+    for (i = 0; i < n; i++)
+    {
+        silo_vfd_block_t *b = &(file->block_list[blidx[i]]);
+        if (file->log_stats)
+            update_block_write_stats(file, b);
         b->dirty = 0;
+    }
 
     return(ret_value);
+#else
+    int i;
+    herr_t ret_value = 0;
+    for (i = 0; i < n; i++)
+        if (file_write_block(file, blidx[i]) < 0)
+            ret_value = -1;
+    return(ret_value);
+#endif
+}
+
+/* Write a dirty block along with any cached, dirty neighbors that
+   together form a run of consecutive block ids */
+static herr_t file_write_block_run(H5FD_silo_t *file, int blidx)
+{
+    int run[SILO_MAX_IOV];
+    int i, n = 0, nlo;
+    hsize_t id = file->block_list[blidx].id;
+    hsize_t lo, hi;
+
+    HDassert(file->block_list[blidx].dirty);
+
+    /* gather dirty neighbors below, then reverse them into id order */
+    for (lo = id; lo > 0 && n < SILO_MAX_IOV/2; lo--)
+    {
+        int nbidx = find_block_by_id(file, lo-1);
+        if (nbidx == NO_BLOCK || !file->block_list[nbidx].dirty ||
+            md_pinned(file, &(file->block_list[nbidx]))) break;
+        run[n++] = nbidx;
+    }
+    for (i = 0, nlo = n; i < nlo/2; i++)
+    {
+        int tmp = run[i];
+        run[i] = run[nlo-1-i];
+        run[nlo-1-i] = tmp;
+    }
+
+    run[n++] = blidx;
+
+    /* gather dirty neighbors above */
+    for (hi = id+1; n < SILO_MAX_IOV; hi++)
+    {
+        int nbidx = find_block_by_id(file, hi);
+        if (nbidx == NO_BLOCK || !file->block_list[nbidx].dirty ||
+            md_pinned(file, &(file->block_list[nbidx]))) break;
+        run[n++] = nbidx;
+    }
+
+    return file_write_blocks(file, run, n);
 }
 
 static herr_t file_read_block(H5FD_silo_t *file, int blidx)
@@ -1040,11 +1505,315 @@ static herr_t file_read_block(H5FD_silo_t *file, int blidx)
     return(ret_value);
 }
 
+#ifdef SILO_VFD_WRITE_BEHIND
+/* Write n queued blocks with consecutive ids starting at ring index
+   first. Runs on the writer thread without the mutex held so it must
+   not touch the HDF5 error stack or anything in file other than fd.
+   Returns 0 or an errno value. */
+static int wb_write_entries(H5FD_silo_t *file, int first, int n)
+{
+    silo_vfd_wb_t *wb = file->wb;
+    haddr_t addr = wb->ring[first].id * file->block_size;
+    ssize_t nbytes;
+    int i;
+#ifdef HAVE_PWRITEV
+    struct iovec iov[SILO_MAX_IOV], *iovp = iov;
+    int iovcnt = n;
+
+    for (i = 0; i < n; i++)
+    {
+        iov[i].iov_base = wb->ring[(first+i)%wb->size].buf;
+        iov[i].iov_len = file->block_size;
+    }
+
+    while (iovcnt > 0)
+    {
+        do {
+            nbytes = pwritev(file->fd, iovp, iovcnt, (file_offset_t)addr);
+        } while(-1 == nbytes && EINTR == errno);
+        if (-1 == nbytes)
+            return errno;
+        wb->write_count++;
+        wb->write_bytes += nbytes;
+        addr += (haddr_t)nbytes;
+        while (iovcnt > 0 && (size_t)nbytes >= iovp->iov_len)
+        {
+            nbytes -= iovp->iov_len;
+            iovp++;
+            iovcnt--;
+        }
+        if (iovcnt > 0)
+        {
+            iovp->iov_base = (char *)iovp->iov_base + nbytes;
+            iovp->iov_len -= nbytes;
+        }
+    }
+#else
+    for (i = 0; i < n; i++)
+    {
+        const char *buf = (const char *) wb->ring[(first+i)%wb->size].buf;
+        size_t size = file->block_size;
+        while (size > 0)
+        {
+            do {
+                nbytes = pwrite(file->fd, buf, size, (file_offset_t)addr);
+            } while(-1 == nbytes && EINTR == errno);
+            if (-1 == nbytes)
+                return errno;
+            wb->write_count++;
+            wb->write_bytes += nbytes;
+            size -= (size_t)nbytes;
+            addr += (haddr_t)nbytes;
+            buf += nbytes;
+        }
+    }
+#endif
+
+    if (n > 1)
+    {
+        wb->multiblock_writes++;
+        wb->multiblock_write_blocks += n;
+    }
+
+    return 0;
+}
+
+/* Writer thread main loop. Writes the longest run of consecutive block
+   ids at the head of the queue, then retires those entries. */
+static void *wb_writer_main(void *arg)
+{
+    H5FD_silo_t *file = (H5FD_silo_t *) arg;
+    silo_vfd_wb_t *wb = file->wb;
+
+    pthread_mutex_lock(&wb->mutex);
+    while (1)
+    {
+        int i, n, first, err_no;
+
+        while (wb->count == 0 && !wb->shutdown)
+            pthread_cond_wait(&wb->cond, &wb->mutex);
+        if (wb->count == 0)
+            break;
+
+        first = wb->head;
+        for (n = 1; n < wb->count && n < SILO_MAX_IOV; n++)
+        {
+            if (wb->ring[(first+n)%wb->size].id != wb->ring[(first+n-1)%wb->size].id + 1)
+                break;
+        }
+
+        /* The main thread only appends past these entries and only reads
+           their buffers so the write can proceed without the mutex */
+        pthread_mutex_unlock(&wb->mutex);
+        err_no = wb_write_entries(file, first, n);
+        pthread_mutex_lock(&wb->mutex);
+
+        if (err_no && !wb->err_no)
+            wb->err_no = err_no;
+        for (i = 0; i < n; i++)
+            free(wb->ring[(first+i)%wb->size].buf);
+        wb->head = (first + n) % wb->size;
+        wb->count -= n;
+        pthread_cond_broadcast(&wb->cond);
+    }
+    pthread_mutex_unlock(&wb->mutex);
+
+    return 0;
+}
+
+static herr_t wb_start(H5FD_silo_t *file, int queue_depth)
+{
+    silo_vfd_wb_t *wb = (silo_vfd_wb_t *) calloc(1, sizeof(silo_vfd_wb_t));
+
+    if (!wb) return -1;
+    if (NULL == (wb->ring = (silo_vfd_wb_entry_t *) malloc(queue_depth * sizeof(silo_vfd_wb_entry_t))))
+    {
+        free(wb);
+        return -1;
+    }
+    wb->size = queue_depth;
+    pthread_mutex_init(&wb->mutex, 0);
+    pthread_cond_init(&wb->cond, 0);
+
+    file->wb = wb;
+    if (pthread_create(&wb->thread, 0, wb_writer_main, file) != 0)
+    {
+        pthread_cond_destroy(&wb->cond);
+        pthread_mutex_destroy(&wb->mutex);
+        free(wb->ring);
+        free(wb);
+        file->wb = 0;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Hand a dirty block's buffer to the writer thread. The block's slot
+   no longer owns the buffer afterwards. Blocks only while the queue
+   is full. */
+static void wb_enqueue_block(H5FD_silo_t *file, int blidx)
+{
+    silo_vfd_wb_t *wb = file->wb;
+    silo_vfd_block_t *b = &(file->block_list[blidx]);
+    haddr_t addr_end = (b->id + 1) * file->block_size;
+
+    HDassert(b->dirty);
+    HDassert(b->buf);
+
+    if (file->log_stats)
+        update_block_write_stats(file, b);
+
+    pthread_mutex_lock(&wb->mutex);
+    if (wb->count == wb->size)
+        file->stats.num_write_behind_stalls++;
+    while (wb->count == wb->size)
+        pthread_cond_wait(&wb->cond, &wb->mutex);
+    wb->ring[(wb->head + wb->count) % wb->size].id = b->id;
+    wb->ring[(wb->head + wb->count) % wb->size].buf = b->buf;
+    wb->count++;
+    if ((hsize_t) wb->count > file->stats.max_write_behind_queued)
+        file->stats.max_write_behind_queued = wb->count;
+    pthread_cond_broadcast(&wb->cond);
+    pthread_mutex_unlock(&wb->mutex);
+
+    file->stats.num_write_behind_blocks++;
+    if (addr_end > file->file_eof)
+        file->file_eof = addr_end;
+
+    b->buf = 0;
+    b->dirty = 0;
+}
+
+/* If block id is still on the queue, copy its newest contents to buf
+   and return 1. Otherwise return 0 and the file holds current data. */
+static int wb_copy_block(H5FD_silo_t *file, hsize_t id, void *buf)
+{
+    silo_vfd_wb_t *wb = file->wb;
+    int i, found = 0;
+
+    pthread_mutex_lock(&wb->mutex);
+    for (i = wb->count - 1; i >= 0 && !found; i--)
+    {
+        silo_vfd_wb_entry_t *e = &(wb->ring[(wb->head + i) % wb->size]);
+        if (e->id != id) continue;
+        memcpy(buf, e->buf, file->block_size);
+        found = 1;
+    }
+    pthread_mutex_unlock(&wb->mutex);
+
+    if (found)
+        file->stats.num_write_behind_hits++;
+
+    return found;
+}
+
+/* Wait for the writer to empty the queue, fold its counters into the
+   file's stats and report any write error it encountered */
+static herr_t wb_drain(H5FD_silo_t *file)
+{
+    static const char  *func = "wb_drain";
+    silo_vfd_wb_t *wb = file->wb;
+    herr_t ret_value = 0;
+    int err_no;
+
+    pthread_mutex_lock(&wb->mutex);
+    while (wb->count > 0)
+        pthread_cond_wait(&wb->cond, &wb->mutex);
+    file->stats.total_write_count += wb->write_count;
+    file->stats.total_write_bytes += wb->write_bytes;
+    file->stats.num_multiblock_writes += wb->multiblock_writes;
+    file->stats.num_multiblock_write_blocks += wb->multiblock_write_blocks;
+    wb->write_count = wb->write_bytes = 0;
+    wb->multiblock_writes = wb->multiblock_write_blocks = 0;
+    err_no = wb->err_no;
+    wb->err_no = 0;
+    pthread_mutex_unlock(&wb->mutex);
+
+    if (err_no)
+        H5E_PUSH_HELPER (func, H5E_ERR_CLS, H5E_IO, H5E_WRITEERROR, "write-behind failed", -1, err_no)
+
+    return(ret_value);
+}
+
+/* Stop the writer thread. The queue must already be drained. */
+static void wb_stop(H5FD_silo_t *file)
+{
+    silo_vfd_wb_t *wb = file->wb;
+
+    pthread_mutex_lock(&wb->mutex);
+    wb->shutdown = 1;
+    pthread_cond_broadcast(&wb->cond);
+    pthread_mutex_unlock(&wb->mutex);
+    pthread_join(wb->thread, 0);
+
+    pthread_cond_destroy(&wb->cond);
+    pthread_mutex_destroy(&wb->mutex);
+    free(wb->ring);
+    free(wb);
+    file->wb = 0;
+}
+#endif
+
+/* Read n blocks with consecutive ids, in order, using a single
+   vectored read where available */
+static herr_t file_read_blocks(H5FD_silo_t *file, int const *blidx, int n)
+{
+#ifdef HAVE_PREADV
+    static const char  *func = "file_read_blocks";
+    struct iovec iov[SILO_MAX_IOV];
+    herr_t ret_value = 0;
+    int i;
+
+    HDassert(n <= SILO_MAX_IOV);
+
+    if (n == 0)
+        return 0;
+    if (n == 1)
+        return file_read_block(file, blidx[0]);
+
+    H5Eclear2(H5E_DEFAULT);
+
+    for (i = 0; i < n; i++)
+    {
+        silo_vfd_block_t *b = &(file->block_list[blidx[i]]);
+        HDassert(b->buf);
+        HDassert(i == 0 || b->id == file->block_list[blidx[i-1]].id + 1);
+        iov[i].iov_base = b->buf;
+        iov[i].iov_len = file->block_size;
+    }
+
+    if (file_readv(file, file->block_list[blidx[0]].id * file->block_size, iov, n) < 0)
+        H5E_PUSH_HELPER (func, H5E_ERR_CLS, H5E_IO, H5E_READERROR, "file_read_blocks failed", -1, -1)
+
+    file->stats.num_multiblock_reads++;
+    file->stats.num_multiblock_read_blocks += n;
+    file->stats.total_block_reads += n;
+
+    for (i = 0; i < n; i++)
+    {
+        silo_vfd_block_t *b = &(file->block_list[blidx[i]]);
+        if (file->log_stats && get_block_bitmap_by_id(&(file->was_in_mem_map), b->id))
+            update_hotblock_stats(file, b->id, OP_READ, 0);
+        b->dirty = 0;
+    }
+
+    return(ret_value);
+#else
+    int i;
+    herr_t ret_value = 0;
+    for (i = 0; i < n; i++)
+        if (file_read_block(file, blidx[i]) < 0)
+            ret_value = -1;
+    return(ret_value);
+#endif
+}
+
 static herr_t remove_block_by_index(H5FD_silo_t *file, int blidx)
 {
-    int i;
     silo_vfd_block_t *bl = file->block_list;
     silo_vfd_block_t *b = &file->block_list[blidx];
+    int *hp;
 
     HDassert(file->num_blocks>0);
 
@@ -1059,26 +1828,46 @@ static herr_t remove_block_by_index(H5FD_silo_t *file, int blidx)
             file->stats.num_blocks_majority_md++;
     }
 
-    for (i = blidx; i < file->num_blocks-1; i++)
-        bl[i] = bl[i+1];
+    /* unlink from hash bucket chain */
+    hp = &(file->hash_buckets[hash_block_id(file, b->id)]);
+    while (*hp != blidx)
+        hp = &(bl[*hp].hnext);
+    *hp = b->hnext;
+
+    lru_unlink(file, blidx);
+
+    /* return slot to the free list */
+    b->buf = 0;
+    b->next = file->free_head;
+    file->free_head = blidx;
 
     file->num_blocks--;
 
     return 0;
 }
 
-/* blidx refers to the block in the list JUST BEFORE the block we're inserting */ 
-/* a -1 implies it comes JUST BEFORE the 0th block */
-static herr_t insert_block_by_index(H5FD_silo_t *file, int blidx)
+static int insert_block_by_id(H5FD_silo_t *file, hsize_t id)
 {
-    int i;
-    silo_vfd_block_t *bl = file->block_list;
+    silo_vfd_block_t *b;
+    int bucket = hash_block_id(file, id);
+    int blidx = file->free_head;
 
     HDassert(file->num_blocks<file->max_blocks);
+    HDassert(blidx != NO_BLOCK);
+
+    b = &(file->block_list[blidx]);
+    file->free_head = b->next;
+    memset(b, 0, sizeof(silo_vfd_block_t));
+    b->id = id;
+    b->minmoff = file->block_size;
+    b->maxmoff = 0;
+    b->minroff = file->block_size;
+    b->maxroff = 0;
+
+    b->hnext = file->hash_buckets[bucket];
+    file->hash_buckets[bucket] = blidx;
 
-    for (i = file->num_blocks; i > blidx+1; i--)
-        bl[i] = bl[i-1];
-    memset(&bl[blidx+1], 0, sizeof(silo_vfd_block_t));
+    lru_push_head(file, blidx);
 
     file->num_blocks++;
 
@@ -1088,34 +1877,32 @@ static herr_t insert_block_by_index(H5FD_silo_t *file, int blidx)
             file->stats.max_blocks_in_mem = file->num_blocks;
     }
 
-    return 0;
+    return blidx;
 }
 
 static int alloc_block_by_id(H5FD_silo_t *file, hsize_t id)
 {
     haddr_t addr0 = id * file->block_size;
     silo_vfd_block_t *b;
-    int blidx = find_block_by_id(file, id, CLOSEST);
-
-    /* blidx refers to the block in the list JUST BEFORE the block we're inserting */ 
-    insert_block_by_index(file, blidx);
-
-    /* update blidx to point to the block we're inserting */
-    blidx++;
+    int blidx = insert_block_by_id(file, id);
 
     b = &(file->block_list[blidx]);
 
-    b->buf = malloc(file->block_size);
+    b->buf = alloc_block_buf(file);
     HDassert(b->buf);
-    b->id = id;
-    b->age = file->op_counter++;
-    b->minmoff = file->block_size;
-    b->maxmoff = 0;
-    b->minroff = file->block_size;
-    b->maxroff = 0;
 
+    if (md_take_block(file, id, &(b->buf)))
+        ;
+    else
+#ifdef SILO_VFD_WRITE_BEHIND
+    if (file->wb && wb_copy_block(file, id, b->buf))
+        ;
+    else
+#endif
     if (addr0<file->file_eof)
         file_read_block(file, blidx);
+    else
+        memset(b->buf, 0, file->block_size);
 
     if (file->log_stats)
     {
@@ -1130,22 +1917,418 @@ static herr_t free_block_by_index(H5FD_silo_t *file, int blidx)
 {
     silo_vfd_block_t *b;
     
-    HDassert(blidx<file->num_blocks);
+    HDassert(blidx<file->max_blocks);
 
     b = &(file->block_list[blidx]);
 
     HDassert(b->buf);
 
+    if (md_pinned(file, b))
+        md_put_block(file, blidx);
+
+#ifdef SILO_VFD_WRITE_BEHIND
+    if (b->dirty && file->wb)
+        wb_enqueue_block(file, blidx);
+#endif
+
     if (b->dirty)
-        file_write_block(file, blidx);
+        file_write_block_run(file, blidx);
 
-    free(b->buf);
+    if (b->buf)
+        free(b->buf);
 
     remove_block_by_index(file, blidx);
 
     return 0;
 }
 
+/* Return index of cached block with given id, faulting it into
+   the cache (and preempting another block if necessary) on a miss */
+static int get_block_by_id(H5FD_silo_t *file, hsize_t id)
+{
+    int blidx = find_block_by_id(file, id);
+
+    if (blidx != NO_BLOCK)
+    {
+        file->stats.num_block_hits++;
+        return blidx;
+    }
+
+    file->stats.num_block_misses++;
+    if (file->num_blocks == file->max_blocks)
+    {
+        free_block_by_index(file, find_block_to_preempt(file));
+        file->stats.num_block_evictions++;
+    }
+
+    return alloc_block_by_id(file, id);
+}
+
+/* Largest read-ahead allowed. Keeping it to half the cache leaves room
+   for the blocks the application is actually working on. */
+static int read_ahead_cap(H5FD_silo_t const *file)
+{
+    return MIN(file->read_ahead, file->max_blocks / 2);
+}
+
+/* Bring up to n uncached blocks id0, id0+stride, ... lying within the
+   file into the cache, reading runs of consecutive ids together.
+   Returns the number of blocks brought in. */
+static int read_ahead_blocks(H5FD_silo_t *file, hsize_t id0, hsize_t stride, int n)
+{
+    int run[SILO_MAX_IOV];
+    int k, nrun = 0, nnew = 0;
+
+    for (k = 0; k < n; k++)
+    {
+        hsize_t id = id0 + k * stride;
+        silo_vfd_block_t *b;
+        int blidx;
+
+        if (id * file->block_size >= file->file_eof)
+            break;
+        if (find_block_by_id(file, id) != NO_BLOCK)
+            continue;
+
+        /* Finish the pending run before preempting anything so that a
+           block with an unfilled buffer is never chosen */
+        if (nrun > 0 && (file->num_blocks == file->max_blocks || nrun == SILO_MAX_IOV ||
+            file->block_list[run[nrun-1]].id + 1 != id))
+        {
+            file_read_blocks(file, run, nrun);
+            nrun = 0;
+        }
+        if (file->num_blocks == file->max_blocks)
+        {
+            free_block_by_index(file, find_block_to_preempt(file));
+            file->stats.num_block_evictions++;
+        }
+
+        blidx = insert_block_by_id(file, id);
+        b = &(file->block_list[blidx]);
+        b->buf = alloc_block_buf(file);
+        HDassert(b->buf);
+        nnew++;
+
+        if (file->log_stats)
+        {
+            set_block_bitmap_by_id(&(file->was_in_mem_map), id);
+            if (id > file->stats.max_block_id) file->stats.max_block_id = id;
+        }
+
+        if (md_take_block(file, id, &(b->buf)))
+            continue;
+#ifdef SILO_VFD_WRITE_BEHIND
+        if (file->wb && wb_copy_block(file, id, b->buf))
+            continue;
+#endif
+
+        run[nrun++] = blidx;
+    }
+    file_read_blocks(file, run, nrun);
+
+    return nnew;
+}
+
+/* Called after each read of blocks id0...id1. Tracks the stride in block
+   ids between successive reads and, once two reads in a row advance by
+   the same stride, reads ahead along it. The window doubles each time
+   the reader catches up with it, up to read_ahead_cap(). */
+static void read_ahead(H5FD_silo_t *file, hsize_t id0, hsize_t id1)
+{
+    int cap = read_ahead_cap(file);
+    hsize_t next;
+
+    if (cap < 1)
+        return;
+
+    if (id0 == file->ra_last_id)
+        ; /* still in the same block, pattern unchanged */
+    else if (id0 > file->ra_last_id && id0 - file->ra_last_id == file->ra_stride)
+        file->ra_streak++;
+    else
+    {
+        file->ra_stride = id0 > file->ra_last_id ? id0 - file->ra_last_id : 0;
+        file->ra_streak = 0;
+        file->ra_window = 0;
+    }
+    file->ra_last_id = id1;
+
+    if (file->ra_streak < 1 || file->ra_stride == 0)
+        return;
+
+    /* nothing to do until the reader gets past the current window */
+    next = id1 + file->ra_stride;
+    if (find_block_by_id(file, next) != NO_BLOCK)
+        return;
+
+    file->ra_window = file->ra_window ? MIN(2 * file->ra_window, cap) : MIN(2, cap);
+    file->stats.num_read_aheads++;
+    file->stats.num_read_ahead_blocks += read_ahead_blocks(file, next, file->ra_stride, file->ra_window);
+
+#ifdef HAVE_POSIX_FADVISE
+    /* let the OS start on the window after this one in the background */
+    if (file->ra_stride == 1)
+        posix_fadvise(file->fd, (file_offset_t) ((next + file->ra_window) * file->block_size),
+            (file_offset_t) (file->ra_window * file->block_size), POSIX_FADV_WILLNEED);
+#endif
+}
+
+/* Fill pairs with in-use blocks sorted by increasing block id.
+   Returns the number of in-use blocks. */
+static int sort_blocks_by_id(H5FD_silo_t *file, silo_vfd_pair_t *pairs)
+{
+    int i, n;
+
+    for (i = 0, n = 0; i < file->max_blocks; i++)
+    {
+        if (!(file->block_list[i].buf)) continue;
+        pairs[n].i = i;
+        pairs[n].id = file->block_list[i].id; 
+        n++;
+    }
+    qsort(pairs, n, sizeof(silo_vfd_pair_t), compare_silo_vfd_pairs);
+
+    return n;
+}
+
+/* Write all dirty blocks in order of increasing block id, combining
+   runs of consecutive dirty blocks into multi-block writes. The blocks
+   remain in the cache. Blocks bound for the metadata region are left
+   for md_write_region. */
+static herr_t flush_dirty_blocks(H5FD_silo_t *file)
+{
+    silo_vfd_pair_t *sorted_pairs;
+    int run[SILO_MAX_IOV];
+    int i, n, nrun = 0;
+    herr_t ret_value = 0;
+
+    if (file->num_blocks == 0)
+        return 0;
+
+    sorted_pairs = (silo_vfd_pair_t*) malloc(file->num_blocks*sizeof(silo_vfd_pair_t));
+    n = sort_blocks_by_id(file, sorted_pairs);
+
+    for (i = 0; i < n; i++)
+    {
+        int blidx = sorted_pairs[i].i;
+
+        int dirty = file->block_list[blidx].dirty &&
+                    !md_pinned(file, &(file->block_list[blidx]));
+
+        /* end current run if this block doesn't extend it */
+        if (nrun > 0 && (!dirty || nrun == SILO_MAX_IOV ||
+            file->block_list[blidx].id != sorted_pairs[i-1].id + 1))
+        {
+            if (file_write_blocks(file, run, nrun) < 0)
+                ret_value = -1;
+            nrun = 0;
+        }
+
+        if (dirty)
+            run[nrun++] = blidx;
+    }
+    if (nrun > 0 && file_write_blocks(file, run, nrun) < 0)
+        ret_value = -1;
+
+    free(sorted_pairs);
+
+    return ret_value;
+}
+
+static void md_free_list(H5FD_silo_t *file)
+{
+    int i;
+    for (i = 0; i < file->num_md; i++)
+        if (file->md_list[i].buf) free(file->md_list[i].buf);
+    free(file->md_list);
+    file->md_list = 0;
+    file->num_md = file->max_md = 0;
+}
+
+/* Write all metadata blocks contiguously at the first block boundary at
+   or after the eoa, followed by their map and the trailer, and cut the
+   file off there. Called on close after all other blocks are written. */
+static herr_t md_write_region(H5FD_silo_t *file)
+{
+    static const char  *func = "md_write_region";
+    hsize_t *map;
+    haddr_t addr;
+    size_t mapsize;
+    herr_t ret_value = 0;
+    int i, n;
+
+    HDassert(sizeof(hsize_t)==8);
+
+    /* move pinned blocks still in the cache onto the list */
+    for (i = 0; i < file->max_blocks; i++)
+    {
+        silo_vfd_block_t *b = &(file->block_list[i]);
+        if (b->buf && md_pinned(file, b))
+            free_block_by_index(file, i);
+    }
+
+    file->md_region_addr = (file->eoa + file->block_size - 1) / file->block_size * file->block_size;
+    addr = file->md_region_addr;
+    for (i = 0; i < file->num_md; i += n)
+    {
+#ifdef HAVE_PWRITEV
+        struct iovec iov[SILO_MAX_IOV];
+        int k;
+
+        n = MIN(file->num_md - i, SILO_MAX_IOV);
+        for (k = 0; k < n; k++)
+        {
+            HDassert(file->md_list[i+k].buf);
+            iov[k].iov_base = file->md_list[i+k].buf;
+            iov[k].iov_len = file->block_size;
+        }
+        if (file_writev(file, addr, iov, n) < 0)
+            H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_IO, H5E_WRITEERROR, "file_writev failed", -1, -1)
+        if (n > 1)
+        {
+            file->stats.num_multiblock_writes++;
+            file->stats.num_multiblock_write_blocks += n;
+        }
+#else
+        n = 1;
+        HDassert(file->md_list[i].buf);
+        if (file_write(file, addr, file->block_size, file->md_list[i].buf) < 0)
+            H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_IO, H5E_WRITEERROR, "file_write failed", -1, -1)
+#endif
+        addr += (haddr_t) n * file->block_size;
+    }
+    file->stats.num_meta_at_end_blocks = file->num_md;
+
+    /* map of block ids then trailer of block size, region address, count and magic */
+    mapsize = (file->num_md + SILO_MDEND_TRAILER_SIZE / 8) * sizeof(hsize_t);
+    if (NULL == (map = (hsize_t *) malloc(mapsize)))
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_RESOURCE, H5E_NOSPACE, "malloc failed", -1, errno)
+    for (i = 0; i < file->num_md; i++)
+        map[i] = file->md_list[i].id;
+    map[i++] = file->block_size;
+    map[i++] = file->md_region_addr;
+    map[i++] = (hsize_t) file->num_md;
+    if (H5Tconvert(H5T_NATIVE_HSIZE, H5T_STD_U64LE, (size_t) i, map, NULL, H5P_DEFAULT) < 0)
+    {
+        free(map);
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_DATATYPE, H5E_CANTCONVERT, "can't convert metadata map", -1, -1)
+    }
+    memcpy(&map[i], SILO_MDEND_MAGIC, 8);
+
+    /* the map is not a whole number of blocks */
+    if (file->use_direct)
+        set_direct_io(file, 0);
+    ret_value = file_write(file, addr, mapsize, map);
+    free(map);
+    if (ret_value < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_IO, H5E_WRITEERROR, "file_write failed", -1, -1)
+
+    /* drop anything left over from a larger, earlier layout */
+    addr += mapsize;
+    if (-1 == HDftruncate(file->fd, (file_offset_t)addr))
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_IO, H5E_SEEKERROR, "HDftruncate failed", -1, errno)
+
+    return(ret_value);
+}
+
+/* If a file of the given size ends in a metadata-at-end trailer, adopt
+   that layout and its block size and load all the file's metadata blocks
+   with one pass over the region. Does nothing for other files. */
+static herr_t md_read_region(H5FD_silo_t *file, haddr_t size)
+{
+    static const char  *func = "md_read_region";
+    hsize_t trailer[SILO_MDEND_TRAILER_SIZE / 8], *map = 0;
+    hsize_t block_size, count;
+    haddr_t addr;
+    herr_t ret_value = 0;
+    int i, n;
+
+    HDassert(sizeof(hsize_t)==8);
+
+    if (size < SILO_MDEND_TRAILER_SIZE)
+        return 0;
+    if (file_read(file, size - SILO_MDEND_TRAILER_SIZE, SILO_MDEND_TRAILER_SIZE, trailer) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_IO, H5E_READERROR, "file_read failed", -1, -1)
+    if (memcmp(&trailer[3], SILO_MDEND_MAGIC, 8))
+        return 0;
+    if (H5Tconvert(H5T_STD_U64LE, H5T_NATIVE_HSIZE, 3, trailer, NULL, H5P_DEFAULT) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_DATATYPE, H5E_CANTCONVERT, "can't convert metadata trailer", -1, -1)
+    block_size = trailer[0];
+    addr = trailer[1];
+    count = trailer[2];
+    if (block_size == 0 || addr % block_size || count > (hsize_t) INT_MAX ||
+        addr + count * (block_size + 8) + SILO_MDEND_TRAILER_SIZE != size)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_FILE, H5E_BADFILE, "bad metadata-at-end trailer", -1, -1)
+
+    file->block_size = block_size;
+
+    if (count > 0)
+    {
+        if (NULL == (map = (hsize_t *) malloc(count * sizeof(hsize_t))) ||
+            NULL == (file->md_list = (silo_vfd_md_entry_t *) calloc(count, sizeof(silo_vfd_md_entry_t))))
+        {
+            free(map);
+            H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_RESOURCE, H5E_NOSPACE, "malloc failed", -1, errno)
+        }
+        file->max_md = (int) count;
+        if (file_read(file, addr + count * block_size, count * sizeof(hsize_t), map) < 0 ||
+            H5Tconvert(H5T_STD_U64LE, H5T_NATIVE_HSIZE, count, map, NULL, H5P_DEFAULT) < 0)
+        {
+            free(map);
+            md_free_list(file);
+            H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_IO, H5E_READERROR, "can't read metadata map", -1, -1)
+        }
+        for (i = 0; i < (int) count; i++)
+        {
+            if (map[i] == 0 || (i > 0 && map[i] <= map[i-1]) ||
+                NULL == (file->md_list[i].buf = alloc_block_buf(file)))
+            {
+                free(map);
+                md_free_list(file);
+                H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_FILE, H5E_BADFILE, "bad metadata map", -1, -1)
+            }
+            file->md_list[i].id = map[i];
+            file->num_md++;
+        }
+        free(map);
+    }
+
+    for (i = 0; i < file->num_md; i += n)
+    {
+        haddr_t baddr = addr + (haddr_t) i * block_size;
+#ifdef HAVE_PREADV
+        struct iovec iov[SILO_MAX_IOV];
+        int k;
+
+        n = MIN(file->num_md - i, SILO_MAX_IOV);
+        for (k = 0; k < n; k++)
+        {
+            iov[k].iov_base = file->md_list[i+k].buf;
+            iov[k].iov_len = block_size;
+        }
+        if (file_readv(file, baddr, iov, n) < 0)
+#else
+        n = 1;
+        if (file_read(file, baddr, block_size, file->md_list[i].buf) < 0)
+#endif
+        {
+            md_free_list(file);
+            H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_IO, H5E_READERROR, "can't read metadata region", -1, -1)
+        }
+    }
+
+    file->meta_at_end = 1;
+    file->md_region_addr = addr;
+    file->stats.num_meta_at_end_blocks = file->num_md;
+
+    /* blocks past the region's start hold no data of the HDF5 file */
+    file->file_eof = addr;
+    file->eof = addr;
+
+    return 0;
+}
+
 /*-------------------------------------------------------------------------
  * Function:	H5FD_silo_init
  *
@@ -1230,6 +2413,9 @@ H5Pset_fapl_silo(hid_t fapl_id)
     int default_block_count = H5FD_SILO_DEFAULT_BLOCK_COUNT;
     int default_log_stats = H5FD_SILO_DEFAULT_LOG_STATS;
     int default_use_direct = H5FD_SILO_DEFAULT_USE_DIRECT;
+    int default_write_behind = H5FD_SILO_DEFAULT_WRITE_BEHIND;
+    int default_read_ahead = H5FD_SILO_DEFAULT_READ_AHEAD;
+    int default_meta_at_end = H5FD_SILO_DEFAULT_META_AT_END;
 
     H5Eclear2(H5E_DEFAULT);
 
@@ -1244,6 +2430,12 @@ H5Pset_fapl_silo(hid_t fapl_id)
         H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTINSERT, "can't insert " SILO_LOGSTS_PROPNAME, -1, -1)
     if (H5Pinsert(fapl_id, SILO_USEDIR_PROPNAME, sizeof(int), &default_use_direct, 0, 0, 0, 0, 0) < 0)
         H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTINSERT, "can't insert " SILO_USEDIR_PROPNAME, -1, -1)
+    if (H5Pinsert(fapl_id, SILO_WRBEH_PROPNAME, sizeof(int), &default_write_behind, 0, 0, 0, 0, 0) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTINSERT, "can't insert " SILO_WRBEH_PROPNAME, -1, -1)
+    if (H5Pinsert(fapl_id, SILO_RDAHD_PROPNAME, sizeof(int), &default_read_ahead, 0, 0, 0, 0, 0) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTINSERT, "can't insert " SILO_RDAHD_PROPNAME, -1, -1)
+    if (H5Pinsert(fapl_id, SILO_MDEND_PROPNAME, sizeof(int), &default_meta_at_end, 0, 0, 0, 0, 0) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTINSERT, "can't insert " SILO_MDEND_PROPNAME, -1, -1)
 
     if (H5Pset(fapl_id, SILO_BLKSZ_PROPNAME, &default_block_size) < 0)
         H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTSET, "can't set " SILO_BLKSZ_PROPNAME, -1, -1)
@@ -1253,6 +2445,12 @@ H5Pset_fapl_silo(hid_t fapl_id)
         H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTSET, "can't set " SILO_LOGSTS_PROPNAME, -1, -1)
     if (H5Pset(fapl_id, SILO_USEDIR_PROPNAME, &default_use_direct) < 0)
         H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTSET, "can't set " SILO_USEDIR_PROPNAME, -1, -1)
+    if (H5Pset(fapl_id, SILO_WRBEH_PROPNAME, &default_write_behind) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTSET, "can't set " SILO_WRBEH_PROPNAME, -1, -1)
+    if (H5Pset(fapl_id, SILO_RDAHD_PROPNAME, &default_read_ahead) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTSET, "can't set " SILO_RDAHD_PROPNAME, -1, -1)
+    if (H5Pset(fapl_id, SILO_MDEND_PROPNAME, &default_meta_at_end) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTSET, "can't set " SILO_MDEND_PROPNAME, -1, -1)
 
     return H5Pset_driver(fapl_id, H5FD_SILO, NULL);
 }
@@ -1310,6 +2508,61 @@ H5Pset_silo_use_direct(hid_t fapl_id, int used)
     return ret_value;
 }
 
+herr_t
+H5Pset_silo_write_behind(hid_t fapl_id, int queue_depth)
+{
+    static const char *func="H5Pset_silo_write_behind";
+    herr_t ret_value = 0;
+
+    /* Clear the error stack */
+    H5Eclear2(H5E_DEFAULT);
+
+    if(0 == H5Pisa_class(fapl_id, H5P_FILE_ACCESS))
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_BADTYPE, "not a file access property list", -1, -1)
+    if (queue_depth < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_ARGS, H5E_BADVALUE, "queue depth must be non-negative", -1, -1)
+    if (H5Pset(fapl_id, SILO_WRBEH_PROPNAME, &queue_depth) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTSET, "can't set " SILO_WRBEH_PROPNAME, -1, -1)
+
+    return ret_value;
+}
+
+herr_t
+H5Pset_silo_read_ahead(hid_t fapl_id, int max_blocks)
+{
+    static const char *func="H5Pset_silo_read_ahead";
+    herr_t ret_value = 0;
+
+    /* Clear the error stack */
+    H5Eclear2(H5E_DEFAULT);
+
+    if(0 == H5Pisa_class(fapl_id, H5P_FILE_ACCESS))
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_BADTYPE, "not a file access property list", -1, -1)
+    if (max_blocks < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_ARGS, H5E_BADVALUE, "read ahead must be non-negative", -1, -1)
+    if (H5Pset(fapl_id, SILO_RDAHD_PROPNAME, &max_blocks) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTSET, "can't set " SILO_RDAHD_PROPNAME, -1, -1)
+
+    return ret_value;
+}
+
+herr_t
+H5Pset_silo_meta_at_end(hid_t fapl_id, int meta_at_end)
+{
+    static const char *func="H5Pset_silo_meta_at_end";
+    herr_t ret_value = 0;
+
+    /* Clear the error stack */
+    H5Eclear2(H5E_DEFAULT);
+
+    if(0 == H5Pisa_class(fapl_id, H5P_FILE_ACCESS))
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_BADTYPE, "not a file access property list", -1, -1)
+    if (H5Pset(fapl_id, SILO_MDEND_PROPNAME, &meta_at_end) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTSET, "can't set " SILO_MDEND_PROPNAME, -1, -1)
+
+    return ret_value;
+}
+
 /*-------------------------------------------------------------------------
  * Function:	H5FD_silo_sb_size
  *
@@ -1467,8 +2720,12 @@ H5FD_silo_open( const char *name, unsigned flags, hid_t fapl_id,
     hsize_t silo_block_size = H5FD_SILO_DEFAULT_BLOCK_SIZE;
     int     silo_log_stats = H5FD_SILO_DEFAULT_LOG_STATS;
     int     silo_use_direct = H5FD_SILO_DEFAULT_USE_DIRECT;
+    int     silo_write_behind = H5FD_SILO_DEFAULT_WRITE_BEHIND;
+    int     silo_read_ahead = H5FD_SILO_DEFAULT_READ_AHEAD;
+    int     silo_meta_at_end = H5FD_SILO_DEFAULT_META_AT_END;
     H5FD_t *ret_value = 0;
     mode_t mode;
+    int i, nbuckets;
 
     /* Sanity check on file offsets */
     assert(sizeof(file_offset_t)>=sizeof(size_t));
@@ -1497,15 +2754,18 @@ H5FD_silo_open( const char *name, unsigned flags, hid_t fapl_id,
         H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTGET, "can't get " SILO_LOGSTS_PROPNAME, 0, -1)
     if (H5Pget(fapl_id, SILO_USEDIR_PROPNAME, &silo_use_direct) < 0)
         H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTGET, "can't get " SILO_USEDIR_PROPNAME, 0, -1)
+    if (H5Pget(fapl_id, SILO_WRBEH_PROPNAME, &silo_write_behind) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTGET, "can't get " SILO_WRBEH_PROPNAME, 0, -1)
+    if (H5Pget(fapl_id, SILO_RDAHD_PROPNAME, &silo_read_ahead) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTGET, "can't get " SILO_RDAHD_PROPNAME, 0, -1)
+    if (H5Pget(fapl_id, SILO_MDEND_PROPNAME, &silo_meta_at_end) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_PLIST, H5E_CANTGET, "can't get " SILO_MDEND_PROPNAME, 0, -1)
 
     /* Build the open flags */
     o_flags = (H5F_ACC_RDWR & flags) ? O_RDWR : O_RDONLY;
     if (H5F_ACC_TRUNC & flags) o_flags |= O_TRUNC;
     if (H5F_ACC_CREAT & flags) o_flags |= O_CREAT;
     if (H5F_ACC_EXCL & flags) o_flags |= O_EXCL;
-#ifdef O_DIRECT
-    if (silo_use_direct) o_flags |= O_DIRECT;
-#endif
 #ifdef _WIN32
     mode = _S_IWRITE | _S_IREAD;
 #else
@@ -1538,6 +2798,26 @@ H5FD_silo_open( const char *name, unsigned flags, hid_t fapl_id,
         H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_RESOURCE, H5E_NOSPACE, "calloc failed", NULL, errno)
     }
 
+    /* hash table with at least twice as many buckets as blocks */
+    for (nbuckets = 1; nbuckets < 2 * silo_block_count; nbuckets <<= 1);
+    if(NULL == (file->hash_buckets = (int *)malloc((size_t)nbuckets * sizeof(int))))
+    {
+        close(fd);
+        free(file->block_list);
+        free(file);
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_RESOURCE, H5E_NOSPACE, "malloc failed", NULL, errno)
+    }
+    for (i = 0; i < nbuckets; i++)
+        file->hash_buckets[i] = NO_BLOCK;
+    file->hash_mask = (hsize_t) (nbuckets - 1);
+
+    /* all slots start out on the free list */
+    for (i = 0; i < silo_block_count; i++)
+        file->block_list[i].next = i < silo_block_count-1 ? i+1 : NO_BLOCK;
+    file->free_head = 0;
+    file->lru[LRU_MD].head = file->lru[LRU_MD].tail = NO_BLOCK;
+    file->lru[LRU_RAW].head = file->lru[LRU_RAW].tail = NO_BLOCK;
+
     file->fd = fd;
     file->file_eof = (haddr_t)sb.st_size;
     file->eof = (haddr_t)sb.st_size;
@@ -1545,14 +2825,22 @@ H5FD_silo_open( const char *name, unsigned flags, hid_t fapl_id,
     file->op = OP_UNKNOWN;
     file->write_access = write_access;
     file->block_size = silo_block_size;
+    file->mem_align = 4096;
+#ifndef _WIN32
+    if (sb.st_blksize >= (int) sizeof(void*) && (sb.st_blksize & (sb.st_blksize - 1)) == 0)
+        file->mem_align = (size_t) sb.st_blksize;
+#endif
     file->max_blocks = silo_block_count;
     file->log_stats = silo_log_stats;
+    file->read_ahead = silo_read_ahead;
+    file->meta_at_end = silo_meta_at_end && write_access;
     if (silo_log_stats)
     {
         const char *ext = "-h5-vfd-log";
         if (NULL == (file->log_name = (char*) malloc(strlen(name)+strlen(ext)+1)))
         {
             close(file->fd);
+            free(file->hash_buckets);
             free(file->block_list);
             free(file);
             H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_RESOURCE, H5E_NOSPACE, "malloc failed", NULL, errno)
@@ -1560,6 +2848,28 @@ H5FD_silo_open( const char *name, unsigned flags, hid_t fapl_id,
         sprintf(file->log_name, "%s%s", name, ext);
     }
 
+    /* A file written with its metadata at the end keeps that layout */
+    if (md_read_region(file, (haddr_t)sb.st_size) < 0)
+    {
+        close(file->fd);
+        if (file->log_name) free(file->log_name);
+        free(file->hash_buckets);
+        free(file->block_list);
+        free(file);
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_FILE, H5E_BADFILE, "md_read_region failed", NULL, -1)
+    }
+
+    /* Direct I/O needs whole, aligned blocks. Without them, or if the
+       file system refuses O_DIRECT, the file just stays buffered. */
+    if (silo_use_direct && file->block_size % file->mem_align == 0)
+        set_direct_io(file, 1);
+
+#ifdef SILO_VFD_WRITE_BEHIND
+    /* If the writer thread can't be started, just write synchronously */
+    if (silo_write_behind > 0 && write_access && wb_start(file, silo_write_behind) == 0)
+        file->write_behind = silo_write_behind;
+#endif
+
     /* The unique key */
     {
 #ifdef _WIN32
@@ -1611,29 +2921,38 @@ H5FD_silo_close(H5FD_t *_file)
     /* Clear the error stack */
     H5Eclear2(H5E_DEFAULT);
 
-    /* write any dirty blocks to file */
-    if (file->write_access)
+#ifdef SILO_VFD_WRITE_BEHIND
+    /* finish all pending background writes */
+    if (file->wb)
     {
-        int i;
+        if (wb_drain(file) < 0)
+            ret_value = -1;
+        wb_stop(file);
+    }
+#endif
 
-        /* sort blocks by increasing block id */
-        silo_vfd_pair_t *sorted_pairs = (silo_vfd_pair_t*) malloc(file->num_blocks*sizeof(silo_vfd_pair_t));
-        for (i = 0; i < file->num_blocks; i++)
-        {
-            sorted_pairs[i].i = i;
-            sorted_pairs[i].id = file->block_list[i].id; 
-        }
-        qsort(sorted_pairs, file->num_blocks, sizeof(silo_vfd_pair_t), compare_silo_vfd_pairs);
+    /* write any dirty blocks to file */
+    if (file->write_access && flush_dirty_blocks(file) < 0)
+        ret_value = -1;
+    if (file->write_access && file->meta_at_end && md_write_region(file) < 0)
+        ret_value = -1;
+    md_free_list(file);
+
+    /* Blocks are always written whole. Trim what the last one added
+       past the eoa so the file ends with a partial block. */
+    if (file->write_access && !file->meta_at_end && file->file_eof > file->eoa)
+    {
+        if (-1 == HDftruncate(file->fd, (file_offset_t)file->eoa))
+            ret_value = -1;
+        else
+            file->file_eof = file->eoa;
+    }
 
-        /* write the blocks, freeing as we go along */
-        for (i = 0; i < file->num_blocks; i++)
-        {
-            silo_vfd_block_t *b = &(file->block_list[sorted_pairs[i].i]);
-            if (!(b->buf)) continue;
-            if (b->dirty) file_write_block(file, sorted_pairs[i].i);
-            free(b->buf);
-        }
-        free(sorted_pairs);
+    /* free the blocks */
+    {
+        int i;
+        for (i = 0; i < file->max_blocks; i++)
+            if (file->block_list[i].buf) free(file->block_list[i].buf);
     }
 
     errno = 0;
@@ -1649,6 +2968,10 @@ H5FD_silo_close(H5FD_t *_file)
         fprintf(logf, "======== Interactions between the VFD and the filesystem ========\n");
         fprintf(logf, "block size = %llu\n", file->block_size);
         fprintf(logf, "block count = %d\n", file->max_blocks);
+        fprintf(logf, "write-behind queue depth = %d\n", file->write_behind);
+        fprintf(logf, "max read-ahead = %d\n", read_ahead_cap(file));
+        fprintf(logf, "meta at end = %d\n", file->meta_at_end);
+        fprintf(logf, "direct I/O = %d (alignment %llu)\n", file->use_direct, (unsigned long long) file->mem_align);
         fprintf(logf, "\n");
         fprintf(logf, "max block id = %llu\n", file->stats.max_block_id);
         fprintf(logf, "max blocks in mem = %llu\n", file->stats.max_blocks_in_mem);
@@ -1656,11 +2979,32 @@ H5FD_silo_close(H5FD_t *_file)
         fprintf(logf, "total seeks = %llu\n", file->stats.total_seeks);
         fprintf(logf, "\n");
         fprintf(logf, "number of multi-block writes = %llu\n", file->stats.num_multiblock_writes);
+        fprintf(logf, "number of blocks in multi-block writes = %llu\n", file->stats.num_multiblock_write_blocks);
+        fprintf(logf, "number of writes saved by multi-block writes = %llu\n",
+            file->stats.num_multiblock_write_blocks - file->stats.num_multiblock_writes);
         fprintf(logf, "number of multi-block reads = %llu\n", file->stats.num_multiblock_reads);
+        fprintf(logf, "number of blocks in multi-block reads = %llu\n", file->stats.num_multiblock_read_blocks);
+        fprintf(logf, "number of reads saved by multi-block reads = %llu\n",
+            file->stats.num_multiblock_read_blocks - file->stats.num_multiblock_reads);
+        fprintf(logf, "\n");
+        fprintf(logf, "number of read-aheads = %llu\n", file->stats.num_read_aheads);
+        fprintf(logf, "number of blocks read ahead = %llu\n", file->stats.num_read_ahead_blocks);
         fprintf(logf, "\n");
         fprintf(logf, "number of blocks majority md = %llu\n", file->stats.num_blocks_majority_md);
         fprintf(logf, "number of blocks majority raw = %llu\n", file->stats.num_blocks_majority_raw);
         fprintf(logf, "\n");
+        fprintf(logf, "number of block cache hits = %llu\n", file->stats.num_block_hits);
+        fprintf(logf, "number of block cache misses = %llu\n", file->stats.num_block_misses);
+        fprintf(logf, "number of block cache evictions = %llu\n", file->stats.num_block_evictions);
+        fprintf(logf, "\n");
+        fprintf(logf, "number of blocks written behind = %llu\n", file->stats.num_write_behind_blocks);
+        fprintf(logf, "number of misses served from write-behind queue = %llu\n", file->stats.num_write_behind_hits);
+        fprintf(logf, "number of stalls on full write-behind queue = %llu\n", file->stats.num_write_behind_stalls);
+        fprintf(logf, "max blocks in write-behind queue = %llu\n", file->stats.max_write_behind_queued);
+        fprintf(logf, "\n");
+        fprintf(logf, "number of blocks in metadata region = %llu\n", file->stats.num_meta_at_end_blocks);
+        fprintf(logf, "metadata region address = %llu\n", (unsigned long long) file->md_region_addr);
+        fprintf(logf, "\n");
         fprintf(logf, "number of writes = %llu\n", file->stats.total_write_count);
         fprintf(logf, "number of bytes written = %llu\n", file->stats.total_write_bytes);
         fprintf(logf, "\n");
@@ -1795,10 +3139,11 @@ H5FD_silo_close(H5FD_t *_file)
         free(file->log_name);
     }
 
+    free(file->hash_buckets);
     free(file->block_list);
     free(file);
 
-    return(0);
+    return(ret_value);
 }
 
 /*-------------------------------------------------------------------------
@@ -2072,7 +3417,6 @@ H5FD_silo_read(H5FD_t *_file, H5FD_mem_t type, hid_t dxpl_id, haddr_t addr, size
     H5FD_silo_t		*file = (H5FD_silo_t*)_file;
     static const char *func="H5FD_silo_read";  /* Function Name for error reporting */
     herr_t ret_value = 0;
-    silo_vfd_block_t *bl;
     silo_vfd_relevant_blocks_t rb;
     hsize_t id, nbytes;
     int blidx, bufoff;
@@ -2099,28 +3443,14 @@ H5FD_silo_read(H5FD_t *_file, H5FD_mem_t type, hid_t dxpl_id, haddr_t addr, size
         return 0;
 
     rb = relevant_blocks(file->block_size, addr, size);
-    blidx = -1; 
-    bl = file->block_list;
     bufoff = 0;
     for (id = rb.id0; id <= rb.id1; id++)
     {
-        /* look for the block in the list */
-        if (blidx < 0 || blidx >= file->num_blocks-1)
-            blidx = find_block_by_id(file, id, EXACT); 
-        else if (bl[blidx+1].id != id)
-            blidx = find_block_by_id(file, id, EXACT); 
-        else
-            blidx++;
+        /* fault in the rest of a multi-block request in as few reads as possible */
+        if (id < rb.id1 && read_ahead_cap(file) > 1 && find_block_by_id(file, id) == NO_BLOCK)
+            read_ahead_blocks(file, id, 1, (int) MIN(rb.id1 - id + 1, (hsize_t) read_ahead_cap(file)));
 
-        if (blidx < 0)
-        {
-            if (file->num_blocks == file->max_blocks)
-            {
-                int tmpblidx = find_block_to_preempt(file);
-                free_block_by_index(file, tmpblidx);
-            }
-            blidx = alloc_block_by_id(file, id);
-        }
+        blidx = get_block_by_id(file, id);
 
         /* put the data in the block */
 	if (id == rb.id0 && id == rb.id1)
@@ -2147,6 +3477,8 @@ H5FD_silo_read(H5FD_t *_file, H5FD_mem_t type, hid_t dxpl_id, haddr_t addr, size
 	}
     }
 
+    read_ahead(file, rb.id0, rb.id1);
+
     if (file->log_stats)
     {
         int n;
@@ -2166,8 +3498,6 @@ H5FD_silo_read(H5FD_t *_file, H5FD_mem_t type, hid_t dxpl_id, haddr_t addr, size
             file->stats.vfd_md_read_count_hist[n]++;
             file->stats.vfd_md_read_bytes_hist[n] += size;
         }
-        if (rb.id1 > rb.id0+1)
-            file->stats.num_multiblock_reads++;
     }
 
     return(0);
@@ -2203,7 +3533,6 @@ H5FD_silo_write(H5FD_t *_file, H5FD_mem_t type, hid_t dxpl_id, haddr_t addr,
     H5FD_silo_t		*file = (H5FD_silo_t*)_file;
     static const char *func="H5FD_silo_write";  /* Function Name for error reporting */
     herr_t ret_value = 0;
-    silo_vfd_block_t *bl;
     silo_vfd_relevant_blocks_t rb;
     hsize_t id, nbytes;
     int blidx, bufoff;
@@ -2230,28 +3559,10 @@ H5FD_silo_write(H5FD_t *_file, H5FD_mem_t type, hid_t dxpl_id, haddr_t addr,
         return 0;
 
     rb = relevant_blocks(file->block_size, addr, size);
-    blidx = -1; 
-    bl = file->block_list;
     bufoff = 0;
     for (id = rb.id0; id <= rb.id1; id++)
     {
-        /* look for the block in the list */
-        if (blidx < 0 || blidx >= file->num_blocks-1)
-            blidx = find_block_by_id(file, id, EXACT); 
-        else if (bl[blidx+1].id != id)
-            blidx = find_block_by_id(file, id, EXACT); 
-        else
-            blidx++;
-
-        if (blidx < 0)
-        {
-            if (file->num_blocks == file->max_blocks)
-            {
-                int tmpblidx = find_block_to_preempt(file);
-                free_block_by_index(file, tmpblidx);
-            }
-            blidx = alloc_block_by_id(file, id);
-        }
+        blidx = get_block_by_id(file, id);
 
         /* put the data in the block */
 	if (id == rb.id0 && id == rb.id1)
@@ -2297,8 +3608,6 @@ H5FD_silo_write(H5FD_t *_file, H5FD_mem_t type, hid_t dxpl_id, haddr_t addr,
             file->stats.vfd_md_write_count_hist[n]++;
             file->stats.vfd_md_write_bytes_hist[n] += size;
         }
-        if (rb.id1 > rb.id0+1)
-            file->stats.num_multiblock_writes++;
     }
 
     return(0);
@@ -2328,7 +3637,14 @@ H5FD_silo_truncate(H5FD_t *_file, hid_t dxpl_id, hbool_t closing)
     static const char *func = "H5FD_silo_truncate";  /* Function Name for error reporting */
     herr_t ret_value = 0;
 
-    /* Just skip the truncate */
+#ifdef SILO_VFD_WRITE_BEHIND
+    if (file->wb && wb_drain(file) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_IO, H5E_WRITEERROR, "wb_drain failed", -1, -1)
+#endif
+
+    /* Write out dirty blocks but just skip the truncate */
+    if (file->write_access && flush_dirty_blocks(file) < 0)
+        H5E_PUSH_HELPER(func, H5E_ERR_CLS, H5E_IO, H5E_WRITEERROR, "flush_dirty_blocks failed", -1, -1)
     return 0;
 
     /* Shut compiler up */
@@ -94,6 +94,9 @@ be used for advertising or product endorsement purposes.
 #endif
 #define H5FD_SILO_DEFAULT_LOG_STATS 0
 #define H5FD_SILO_DEFAULT_USE_DIRECT 0
+#define H5FD_SILO_DEFAULT_WRITE_BEHIND 0
+#define H5FD_SILO_DEFAULT_READ_AHEAD 0
+#define H5FD_SILO_DEFAULT_META_AT_END 0
 
 #ifdef __cplusplus
 extern "C" {
@@ -105,6 +108,9 @@ herr_t H5Pset_fapl_silo(hid_t fapl_id);
 herr_t H5Pset_silo_block_size_and_count(hid_t fapl_id, hsize_t block_size, int max_blocks_in_mem);
 herr_t H5Pset_silo_log_stats(hid_t fapl_id, int log);
 herr_t H5Pset_silo_use_direct(hid_t fapl_id, int used);
+herr_t H5Pset_silo_write_behind(hid_t fapl_id, int queue_depth);
+herr_t H5Pset_silo_read_ahead(hid_t fapl_id, int max_blocks);
+herr_t H5Pset_silo_meta_at_end(hid_t fapl_id, int meta_at_end);
 
 #ifdef __cplusplus
 }
@@ -76,6 +76,12 @@ do                                                    \
 
 static int h5z_zfp_was_registered = 0;
 
+#ifdef H5Z_ZFP_AS_LIB
+/* Number of OpenMP threads zfp may use to compress one chunk. The host
+   library sets this when it compresses with a thread pool enabled. */
+static int h5z_zfp_omp_threads = 0;
+#endif
+
 static size_t    H5Z_filter_zfp(unsigned int flags, size_t cd_nelmts,
                                 const unsigned int cd_values[],
                                 size_t nbytes, size_t *buf_size, void **buf);
@@ -112,6 +118,20 @@ H5PL_type_t H5PLget_plugin_type(void) {return H5PL_TYPE_FILTER;}
 const void *H5PLget_plugin_info(void) {return H5Z_ZFP;}
 #endif
 
+#ifdef H5Z_ZFP_AS_LIB
+int H5Z_zfp_set_omp_threads(int nthreads)
+{
+    int old = h5z_zfp_omp_threads;
+    h5z_zfp_omp_threads = nthreads;
+    return old;
+}
+
+H5Z_func_t H5Z_zfp_filter_func(void)
+{
+    return H5Z_filter_zfp;
+}
+#endif
+
 #ifndef H5Z_ZFP_AS_LIB
 static
 #endif
@@ -602,6 +622,12 @@ H5Z_filter_zfp(unsigned int flags, size_t cd_nelmts,
 
         Z zfp_stream_set_mode(zstr, zfp_mode);
         msize = Z zfp_stream_maximum_size(zstr, zfld);
+#ifdef H5Z_ZFP_AS_LIB
+        /* Fails harmlessly, leaving serial execution, when zfp was not
+           compiled with OpenMP */
+        if (h5z_zfp_omp_threads > 1)
+            Z zfp_stream_set_omp_threads(zstr, (uint) h5z_zfp_omp_threads);
+#endif
 
         /* Set up the bitstream object */
         if (NULL == (newbuf = malloc(msize)))
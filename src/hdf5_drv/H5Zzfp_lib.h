@@ -9,6 +9,8 @@ extern "C" {
 
 extern int H5Z_zfp_initialize(void);
 extern int H5Z_zfp_finalize(void);
+extern int H5Z_zfp_set_omp_threads(int nthreads);
+extern H5Z_func_t H5Z_zfp_filter_func(void);
 
 #ifdef __cplusplus
 }
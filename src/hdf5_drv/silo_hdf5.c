@@ -65,6 +65,7 @@ be used for advertising or product endorsement purposes.
 
 #include <errno.h>
 #include <assert.h>
+#include <limits.h>
 #if HAVE_STRING_H
 #include <string.h>
 #endif
@@ -231,6 +232,13 @@ extern void zfp_init_zfp();
 /* useful macro for comparing HDF5 versions */
 #include "hdf5_version_ge.h"
 
+/* Compressing chunks on a thread pool needs threads and direct chunk
+   writes (H5Dwrite_chunk) */
+#if defined(HAVE_PTHREAD_H) && !defined(_WIN32) && HDF5_VERSION_GE(1,10,3)
+#define DB_HDF5_PARALLEL_CHUNKS
+#include <pthread.h>
+#endif
+
 /* to encode the version of the hdf5 library in any silo executable */
 char SILO_built_with_H5_lib_vers_info_g[] = "SILO built with "
 #if HDF5_VERSION_GE(1,4,2)
@@ -849,11 +857,11 @@ static hid_t    T_float = -1;
 static hid_t    T_double = -1;
 static hid_t    T_str256 = -1;
 static hid_t    SCALAR = -1;
-static hid_t    P_crprops = -1;
-static hid_t    P_ckcrprops = -1;
-static hid_t    P_rdprops = -1;
 static hid_t    P_ckrdprops = -1;
 
+/* Transfer props for H5Dread. H5P_DEFAULT verifies checksums. */
+#define DB_HDF5_RDPROPS(F) (DBGetEnableChecksumsFile(F) ? H5P_DEFAULT : P_ckrdprops)
+
 #define OPT(V)          ((V)?(V):"")
 #define OFFSET(P,F)     ((char*)&((P).F)-(char*)&(P))
 #define ENDOF(S)        ((S)+strlen(S))
@@ -1026,6 +1034,8 @@ typedef struct db_hdf5_fpzip_params_t {
     int                 totsize1d;
     int                 ndims;
     int                 dims[10];
+    int                 slabs;   /* set by "SLABS=" in DBSetCompression() */
+    int                 threads; /* set around H5Dwrite for slab encoding */
 } db_hdf5_fpzip_params_t;
 static db_hdf5_fpzip_params_t db_hdf5_fpzip_params;
 
@@ -1054,11 +1064,108 @@ db_hdf5_fpzip_set_local(hid_t dcpl_id, hid_t type_id, hid_t space_id)
     db_hdf5_fpzip_params.isfp = H5Tget_class(type_id) == H5T_FLOAT;
     db_hdf5_fpzip_params.ndims = H5Sget_simple_extent_ndims(space_id);
     H5Sget_simple_extent_dims(space_id, dims, maxdims);
+
+    /* The filter sees one chunk at a time, so describe the chunk */
+    if (H5Pget_layout(dcpl_id) == H5D_CHUNKED)
+    {
+        H5Pget_chunk(dcpl_id, 10, dims);
+        db_hdf5_fpzip_params.totsize1d = 1;
+        for (i = 0; i < db_hdf5_fpzip_params.ndims; i++)
+            db_hdf5_fpzip_params.totsize1d *= (int) dims[i];
+    }
     for (i = 0; i < db_hdf5_fpzip_params.ndims; i++)
         db_hdf5_fpzip_params.dims[i] = (int) dims[i];
     return 1;
 }
 
+/* Number of threads for decoding fpzip slab streams, from "THREADS=" in
+   the global compression string. The filter has no file to consult. */
+static int
+db_hdf5_fpzip_read_threads(void)
+{
+    char const *ptr;
+    int n;
+
+    if (!SILO_Globals.compressionParams ||
+        (ptr = strstr(SILO_Globals.compressionParams, "THREADS=")) == NULL)
+        return 1;
+    n = (int) strtol(ptr+8, 0, 10);
+    return n > 1 ? n : 1;
+}
+
+/* Compress the chunk at *buf as PARAMS describe it. The chunk thread
+   pool calls this with its own copy of the parameters. */
+static size_t
+db_hdf5_fpzip_encode(db_hdf5_fpzip_params_t const *params, size_t nbytes,
+    size_t *buf_size, void **buf)
+{
+    unsigned char *cbuf;
+    int max_outbytes, outbytes, prec;
+
+    /* We'll only compress floating point data here, not integer data */
+    if (!params->isfp)
+        return 0;
+
+    /* We can't operate in place like HDF5 wants. But, thats ok.
+     * Next, we can't easily predict compressed size but we need
+     * to allocate a buffer to compress into. Fortunately, fpzip
+     * will try to compress into any sized buffer we pass and
+     * fail if it cannot. So, we decide here what is the minimum
+     * compression we want, allocate a buffer of that size and
+     * try to compress into it. If it fails, we return the right
+     * stuff to HDF5 and do not compress */
+    
+    max_outbytes = nbytes / SILO_Globals.compressionMinratio;
+    cbuf = (unsigned char *) malloc(max_outbytes);        
+
+    /* full precision */
+    prec = 8 * (params->dp ? sizeof(double) : sizeof(float));
+    
+    /* precision with loss factored in */
+    prec = (prec * (4 - params->loss)) / 4;
+
+    if (params->slabs > 0)
+    {
+        /* Slabs are cut along the slowest varying dimension */
+        int i, n = params->ndims;
+        unsigned mid = 1;
+        for (i = 1; i < n - 1; i++)
+            mid *= (unsigned) params->dims[i];
+        outbytes = fpzip_memory_write_slabs(cbuf, max_outbytes, *buf,
+                &prec, params->dp,
+                n > 1 ? params->dims[n-1] : 1, mid,
+                n > 0 ? params->dims[0] : 1, 1,
+                params->slabs, params->threads);
+    }
+    else if (params->ndims == 1 || params->ndims > 3)
+    {
+        outbytes = fpzip_memory_write(cbuf, max_outbytes, *buf,
+                &prec, params->dp, params->totsize1d, 1, 1, 1);
+    }
+    else if (params->ndims == 2)
+        outbytes = fpzip_memory_write(cbuf, max_outbytes, *buf,
+                &prec, params->dp, params->dims[0], params->dims[1], 1, 1);
+    else
+    {
+        outbytes = fpzip_memory_write(cbuf, max_outbytes, *buf,
+                &prec, params->dp, params->dims[0], params->dims[1],
+                params->dims[2], 1);
+    }
+
+    /* If fpzip failed in any way, it returns zero */
+    if (outbytes == 0)
+    {
+        free(cbuf);
+        return 0;
+    }
+
+    /* We had a success. So, free old buffer and return new values */
+    free(*buf);
+    *buf = cbuf;
+    *buf_size = max_outbytes;
+    return outbytes;
+}
+
 static size_t
 db_hdf5_fpzip_filter_op(unsigned int flags, size_t cd_nelmts,
     const unsigned int cd_values[], size_t nbytes,
@@ -1079,9 +1186,11 @@ db_hdf5_fpzip_filter_op(unsigned int flags, size_t cd_nelmts,
         if (new_buf_size <= 0)
            return early_retval;
 
-        /* allocate space and do the decompression */
+        /* allocate space and do the decompression; slab streams are
+           decoded on as many threads as "THREADS=" asks for */
         uncbuf = malloc(new_buf_size);
-        if (!fpzip_memory_read(*buf, uncbuf, &prec, &dp, &nx, &ny, &nz, &nf))
+        if (!fpzip_memory_read_slabs(*buf, uncbuf, &prec, &dp, &nx, &ny, &nz,
+                 &nf, 0, nz, db_hdf5_fpzip_read_threads()))
         {
             free(uncbuf);
             return early_retval;
@@ -1094,63 +1203,8 @@ db_hdf5_fpzip_filter_op(unsigned int flags, size_t cd_nelmts,
     }
     else /* write case */
     {
-        unsigned char *cbuf;
-        int max_outbytes, outbytes, prec;
-
-        /* We'll only compress floating point data here, not integer data */
-        if (!db_hdf5_fpzip_params.isfp)
-            return 0;
-
-        /* We can't operate in place like HDF5 wants. But, thats ok.
-         * Next, we can't easily predict compressed size but we need
-         * to allocate a buffer to compress into. Fortunately, fpzip
-         * will try to compress into any sized buffer we pass and
-         * fail if it cannot. So, we decide here what is the minimum
-         * compression we want, allocate a buffer of that size and
-         * try to compress into it. If it fails, we return the right
-         * stuff to HDF5 and do not compress */
-        
-        max_outbytes = nbytes / SILO_Globals.compressionMinratio;
-        cbuf = (unsigned char *) malloc(max_outbytes);        
-
-        /* full precision */
-        prec = 8 * (db_hdf5_fpzip_params.dp ? sizeof(double) : sizeof(float));
-        
-        /* precision with loss factored in */
-        prec = (prec * (4 - db_hdf5_fpzip_params.loss)) / 4;
-
-        if (db_hdf5_fpzip_params.ndims == 1 || db_hdf5_fpzip_params.ndims > 3)
-        {
-            outbytes = fpzip_memory_write(cbuf, max_outbytes, *buf,
-                    &prec, db_hdf5_fpzip_params.dp,
-                    db_hdf5_fpzip_params.totsize1d, 1, 1, 1);
-        }
-        else if (db_hdf5_fpzip_params.ndims == 2)
-            outbytes = fpzip_memory_write(cbuf, max_outbytes, *buf,
-                    &prec, db_hdf5_fpzip_params.dp,
-                    db_hdf5_fpzip_params.dims[0],
-                    db_hdf5_fpzip_params.dims[1], 1, 1);
-        else
-        {
-            outbytes = fpzip_memory_write(cbuf, max_outbytes, *buf,
-                    &prec, db_hdf5_fpzip_params.dp,
-                    db_hdf5_fpzip_params.dims[0],
-                    db_hdf5_fpzip_params.dims[1],
-                    db_hdf5_fpzip_params.dims[2], 1);
-        }
-
-        /* If fpzip failed in any way, it returns zero */
-        if (outbytes == 0)
-        {
-            free(cbuf);
-            return early_retval;
-        }
-
-        /* We had a success. So, free old buffer and return new values */
-        free(*buf);
-        *buf = cbuf;
-        *buf_size = max_outbytes;
-        return outbytes;
+        return db_hdf5_fpzip_encode(&db_hdf5_fpzip_params, nbytes,
+                   buf_size, buf);
     }
 }
 static H5Z_class_t db_hdf5_fpzip_class;
@@ -2110,10 +2164,6 @@ db_hdf5_init(void)
     T_str256 = H5Tcopy(H5T_C_S1);       /*this is never freed!*/
     H5Tset_size(T_str256, 256);
 
-    P_ckcrprops = H5Pcreate(H5P_DATASET_CREATE); /* never freed */
-    if (DBGetEnableChecksums())
-       H5Pset_fletcher32(P_ckcrprops);
-
     /* for H5Dread calls, H5P_DEFAULT results in *enabled*
        checksums. So, we build the DISabled version here. */
     P_ckrdprops = H5Pcreate(H5P_DATASET_XFER);   /* never freed */
@@ -2121,6 +2171,8 @@ db_hdf5_init(void)
 
 #ifdef HAVE_FPZIP /* { */
     db_hdf5_fpzip_params.loss = 0;
+    db_hdf5_fpzip_params.slabs = 0;
+    db_hdf5_fpzip_params.threads = 0;
 #if HDF5_VERSION_GE(1,8,0) && !defined(H5_USE_16_API)
     db_hdf5_fpzip_class.version = H5Z_CLASS_T_VERS;
     db_hdf5_fpzip_class.encoder_present = 1;
@@ -2793,6 +2845,7 @@ db_hdf5_InitCallbacks(DBfile_hdf5 *dbfile, int target)
     dbfile->pub.close = db_hdf5_Close;
     dbfile->pub.module = db_hdf5_Filters;
     dbfile->pub.flush = db_hdf5_Flush;
+    dbfile->pub.g_image = db_hdf5_GetFileImage;
 
     /* Directory operations */
     dbfile->pub.cd = db_hdf5_SetDir;
@@ -3311,6 +3364,7 @@ PRIVATE int
 db_hdf5_set_compression(DBfile *dbfile, int flags)
 {
     static char *me = "db_hdf5_set_compression";
+    hid_t ckcrprops = ((DBfile_hdf5*)dbfile)->ckcrprops;
     char *ptr;
     char chararray[32];
     char *check;
@@ -3326,16 +3380,16 @@ db_hdf5_set_compression(DBfile *dbfile, int flags)
     have_fpzip = FALSE;
     have_hzip = FALSE;
     have_zfp = FALSE;
-    if ((nfilters = H5Pget_nfilters(P_ckcrprops))<0)
+    if ((nfilters = H5Pget_nfilters(ckcrprops))<0)
     {
        db_perror("H5Pget_nfilters", E_CALLFAIL, me);
        return (-1);
     }
     for (i=0; i<nfilters; i++) {           
 #if defined H5_USE_16_API || (H5_VERS_MAJOR == 1 && H5_VERS_MINOR < 8)
-            filtn = H5Pget_filter(P_ckcrprops,(unsigned)i,0,0,0,0,0);
+            filtn = H5Pget_filter(ckcrprops,(unsigned)i,0,0,0,0,0);
 #else
-            filtn = H5Pget_filter(P_ckcrprops,(unsigned)i,0,0,0,0,0,NULL);
+            filtn = H5Pget_filter(ckcrprops,(unsigned)i,0,0,0,0,0,NULL);
 #endif
         if (H5Z_FILTER_DEFLATE==filtn)     
             have_gzip = TRUE;
@@ -3424,8 +3478,8 @@ db_hdf5_set_compression(DBfile *dbfile, int flags)
              level = (int) strtol(chararray, &check, 10);
              if ((chararray != check) && (level >= 0) && (level <=9))
              {
-                if (H5Pset_shuffle(P_ckcrprops)<0 ||
-                    H5Pset_deflate(P_ckcrprops, level)<0)
+                if (H5Pset_shuffle(ckcrprops)<0 ||
+                    H5Pset_deflate(ckcrprops, level)<0)
                 {
                    db_perror("H5Pset_deflate", E_CALLFAIL, me);
                    return (-1);
@@ -3439,8 +3493,8 @@ db_hdf5_set_compression(DBfile *dbfile, int flags)
           }
           else
           {
-             if (H5Pset_shuffle(P_ckcrprops)<0 ||
-                 H5Pset_deflate(P_ckcrprops, 1)<0)
+             if (H5Pset_shuffle(ckcrprops)<0 ||
+                 H5Pset_deflate(ckcrprops, 1)<0)
              {
                 db_perror("H5Pset_deflate", E_CALLFAIL, me);
                 return (-1);
@@ -3474,8 +3528,8 @@ db_hdf5_set_compression(DBfile *dbfile, int flags)
                    if (strstr(DBGetCompressionFile(dbfile), 
                       "MASK=EC") != NULL)
                    {
-                      if (H5Pset_shuffle(P_ckcrprops)<0 ||
-                          H5Pset_szip(P_ckcrprops, H5_SZIP_EC_OPTION_MASK,block)<0)
+                      if (H5Pset_shuffle(ckcrprops)<0 ||
+                          H5Pset_szip(ckcrprops, H5_SZIP_EC_OPTION_MASK,block)<0)
                       {
                          db_perror("H5Pset_szip", E_CALLFAIL, me);
                          return (-1);
@@ -3484,8 +3538,8 @@ db_hdf5_set_compression(DBfile *dbfile, int flags)
                    else if(strstr(DBGetCompressionFile(dbfile),
                       "MASK=NN")!=NULL)
                    {
-                      if (H5Pset_shuffle(P_ckcrprops)<0 ||
-                          H5Pset_szip(P_ckcrprops, H5_SZIP_NN_OPTION_MASK,block)<0)
+                      if (H5Pset_shuffle(ckcrprops)<0 ||
+                          H5Pset_szip(ckcrprops, H5_SZIP_NN_OPTION_MASK,block)<0)
                       {
                          db_perror("H5Pset_szip", E_CALLFAIL, me);
                          return (-1);
@@ -3493,8 +3547,8 @@ db_hdf5_set_compression(DBfile *dbfile, int flags)
                    }
                    else
                    {
-                      if (H5Pset_shuffle(P_ckcrprops)<0 ||
-                          H5Pset_szip(P_ckcrprops, H5_SZIP_NN_OPTION_MASK, block)<0)
+                      if (H5Pset_shuffle(ckcrprops)<0 ||
+                          H5Pset_szip(ckcrprops, H5_SZIP_NN_OPTION_MASK, block)<0)
                       {
                          db_perror("H5Pset_szip", E_CALLFAIL, me);
                          return (-1);
@@ -3509,8 +3563,8 @@ db_hdf5_set_compression(DBfile *dbfile, int flags)
              }
              else
              {
-                if (H5Pset_shuffle(P_ckcrprops)<0 ||
-                    H5Pset_szip(P_ckcrprops, H5_SZIP_NN_OPTION_MASK, 4)<0)
+                if (H5Pset_shuffle(ckcrprops)<0 ||
+                    H5Pset_szip(ckcrprops, H5_SZIP_NN_OPTION_MASK, 4)<0)
                 {
                    db_perror("H5Pset_szip", E_CALLFAIL, me);
                    return (-1);
@@ -3572,7 +3626,7 @@ db_hdf5_set_compression(DBfile *dbfile, int flags)
               }
            }
 
-           if (H5Pset_filter(P_ckcrprops, DB_HDF5_HZIP_ID, opt_flag, 0, 0)<0)
+           if (H5Pset_filter(ckcrprops, DB_HDF5_HZIP_ID, opt_flag, 0, 0)<0)
            {
                db_perror("hzip filter setup", E_CALLFAIL, me);
                return (-1);
@@ -3586,6 +3640,7 @@ db_hdf5_set_compression(DBfile *dbfile, int flags)
     {
        if (have_fpzip == FALSE)
        {
+          db_hdf5_fpzip_params.loss = 0;
           if ((ptr=(char *)strstr(DBGetCompressionFile(dbfile), 
              "LOSS=")) != (char *)NULL)
           {
@@ -3602,7 +3657,23 @@ db_hdf5_set_compression(DBfile *dbfile, int flags)
              }
           }
 
-          if (H5Pset_filter(P_ckcrprops, DB_HDF5_FPZIP_ID, opt_flag, 0, 0)<0)
+          db_hdf5_fpzip_params.slabs = 0;
+          if ((ptr=(char *)strstr(DBGetCompressionFile(dbfile), 
+             "SLABS=")) != (char *)NULL)
+          {
+             prec = (int) strtol(ptr+6, &check, 10);
+             if ((ptr+6 != check) && (prec > 0))
+             {
+                db_hdf5_fpzip_params.slabs = prec;
+             }
+             else
+             {
+                db_perror(DBGetCompressionFile(dbfile), E_COMPRESSION, me);
+                return (-1);
+             }
+          }
+
+          if (H5Pset_filter(ckcrprops, DB_HDF5_FPZIP_ID, opt_flag, 0, 0)<0)
           {
               db_perror("H5Pset_filter", E_CALLFAIL, me);
               return (-1);
@@ -3665,7 +3736,7 @@ db_hdf5_set_compression(DBfile *dbfile, int flags)
               return -1;
           }
 
-          if (H5Pset_filter(P_ckcrprops, H5Z_FILTER_ZFP, opt_flag, cd_nelmts, cd_values)<0)
+          if (H5Pset_filter(ckcrprops, H5Z_FILTER_ZFP, opt_flag, cd_nelmts, cd_values)<0)
           {
               db_perror("H5Pset_filter", E_CALLFAIL, me);
               return (-1);
@@ -3673,6 +3744,11 @@ db_hdf5_set_compression(DBfile *dbfile, int flags)
        }
     }
 #endif
+    else if (!strstr(DBGetCompressionFile(dbfile), "METHOD=") &&
+             strstr(DBGetCompressionFile(dbfile), "CHUNK="))
+    {
+       /* chunking policy only, no compression filter */
+    }
     else
     {
        db_perror(DBGetCompressionFile(dbfile), E_COMPRESSION, me);
@@ -3681,6 +3757,129 @@ db_hdf5_set_compression(DBfile *dbfile, int flags)
     return 0;
 }
 
+/* Target size, in bytes, of a chunk of a filtered dataset whose rank
+   does not match a "CHUNK=" shape. It matches HDF5's default raw data
+   chunk cache so a chunk being read for a slice stays cached while
+   neighboring hyperslabs are read from it. */
+#define DB_HDF5_CHUNK_TARGET (1<<20)
+
+/* Smallest byte target "CHUNK=" may give. Every chunk costs an index
+   entry and a filter call, which swamp chunks much smaller than this. */
+#define DB_HDF5_CHUNK_MIN (1<<12)
+
+/*-------------------------------------------------------------------------
+ * Function:    db_hdf5_set_chunk
+ *
+ * Purpose:     Choose chunk dimensions for a filtered (compressed and/or
+ *              checksummed) dataset and set them on the file's ckcrprops.
+ *
+ *              The policy comes from the "CHUNK=" keyword of the
+ *              compression string. "CHUNK=<int>" gives a target chunk size
+ *              in bytes and "CHUNK=<int>x<int>..." gives an explicit chunk
+ *              shape, slowest varying dimension first, for datasets of that
+ *              rank; datasets of other ranks target DB_HDF5_CHUNK_TARGET
+ *              bytes rather than failing, since one object often writes
+ *              datasets of several ranks. Byte targets below
+ *              DB_HDF5_CHUNK_MIN are raised to it. "CHUNK=0", like leaving
+ *              out the keyword, keeps the whole dataset in one chunk.
+ *
+ *              A byte target is met by keeping the fastest varying
+ *              dimensions whole and splitting the slowest ones so that
+ *              each chunk is a contiguous run of the dataset. HZIP
+ *              compresses a whole mesh at once and so always gets a
+ *              single chunk.
+ *
+ * Return:      Success:        0
+ *
+ *              Failure:        -1
+ *
+ *-------------------------------------------------------------------------
+ */
+PRIVATE int
+db_hdf5_set_chunk(DBfile *dbfile, int rank, hsize_t const size[], size_t elsize)
+{
+    static char *me = "db_hdf5_set_chunk";
+    char const *cstr = DBGetCompressionFile(dbfile);
+    char const *ptr;
+    char *check;
+    hsize_t chunk[H5S_MAX_RANK];
+    hsize_t target = 0, inner;
+    int i, have_shape = 0;
+
+    for (i = 0; i < rank; i++)
+        chunk[i] = size[i] > 0 ? size[i] : 1;
+
+    if (cstr && (ptr = strstr(cstr, "CHUNK=")) != NULL)
+    {
+        hsize_t shape[H5S_MAX_RANK];
+        int nshape = 0;
+
+        ptr += 6;
+        target = (hsize_t) strtoul(ptr, &check, 10);
+        if (check == ptr)
+        {
+            db_perror(cstr, E_COMPRESSION, me);
+            return -1;
+        }
+        shape[nshape++] = target;
+        while (*check == 'x' && nshape < H5S_MAX_RANK)
+        {
+            ptr = check + 1;
+            shape[nshape++] = (hsize_t) strtoul(ptr, &check, 10);
+            if (check == ptr || shape[nshape-1] == 0)
+            {
+                db_perror(cstr, E_COMPRESSION, me);
+                return -1;
+            }
+        }
+
+        if (nshape > 1)
+        {
+            if (nshape == rank)
+            {
+                for (i = 0; i < rank; i++)
+                    chunk[i] = MIN(shape[i], chunk[i]);
+                have_shape = 1;
+            }
+            target = DB_HDF5_CHUNK_TARGET;
+        }
+        else if (target > 0 && target < DB_HDF5_CHUNK_MIN)
+            target = DB_HDF5_CHUNK_MIN;
+    }
+
+    if (cstr && strstr(cstr, "METHOD=HZIP"))
+        target = 0;
+
+    if (!have_shape && target > 0)
+    {
+        for (i = rank-1, inner = elsize ? elsize : 1; i > 0; i--)
+            inner *= chunk[i];
+        for (i = 0; i < rank; i++)
+        {
+            hsize_t rest = inner;
+            if (i < rank-1)
+                inner /= chunk[i+1];
+            if (rest <= target)
+            {
+                /* even out the chunks so the last one is not mostly
+                   padding */
+                hsize_t n = MAX(target / rest, 1);
+                n = (chunk[i] + n - 1) / n;
+                chunk[i] = (chunk[i] + n - 1) / n;
+                break;
+            }
+            chunk[i] = 1;
+        }
+    }
+
+    if (H5Pset_chunk(((DBfile_hdf5*)dbfile)->ckcrprops, rank, chunk)<0)
+    {
+        db_perror("H5Pset_chunk", E_CALLFAIL, me);
+        return -1;
+    }
+    return 0;
+}
+
 /*-------------------------------------------------------------------------
  * Function:    db_hdf5_set_properties
  *
@@ -3696,41 +3895,461 @@ db_hdf5_set_compression(DBfile *dbfile, int flags)
  *
  * Modifications:
  *
+ *   Chunk dimensions of filtered datasets now come from db_hdf5_set_chunk
+ *   instead of always being the whole dataset. Added ftype argument so
+ *   a byte size can be turned into a chunk shape.
+ *
+ *   The creation properties are now per-file instead of static. The
+ *   file's filtered dataset properties are created on first use.
  *
  *-------------------------------------------------------------------------
  */
 PRIVATE int
-db_hdf5_set_properties(DBfile *dbfile, int rank, hsize_t size[])
+db_hdf5_set_properties(DBfile *dbfile, int rank, hsize_t size[], hid_t ftype)
 {
     static char *me = "db_hdf5_set_properties";
-    P_crprops = H5P_DEFAULT;
+    DBfile_hdf5 *dbfile5 = (DBfile_hdf5*)dbfile;
+    dbfile5->crprops = H5P_DEFAULT;
+    if (!DBGetEnableChecksumsFile(dbfile) && !DBGetCompressionFile(dbfile))
+        return 0;
+    if (dbfile5->ckcrprops <= 0)
+    {
+        if ((dbfile5->ckcrprops = H5Pcreate(H5P_DATASET_CREATE))<0)
+        {
+            db_perror("H5Pcreate", E_CALLFAIL, me);
+            return -1;
+        }
+        if (DBGetEnableChecksumsFile(dbfile))
+            H5Pset_fletcher32(dbfile5->ckcrprops);
+    }
+    if (db_hdf5_set_chunk(dbfile, rank, size, H5Tget_size(ftype))<0)
+        return -1;
     if (DBGetEnableChecksumsFile(dbfile) && 
         !DBGetCompressionFile(dbfile))
     {
-        H5Pset_chunk(P_ckcrprops, rank, size);
-        P_crprops = P_ckcrprops;
+        dbfile5->crprops = dbfile5->ckcrprops;
     }
     else if (DBGetEnableChecksumsFile(dbfile) && 
         DBGetCompressionFile(dbfile))
     {
-        H5Pset_chunk(P_ckcrprops, rank, size);
         if (db_hdf5_set_compression(dbfile, 0)<0) {
             db_perror("db_hdf5_set_compression", E_CALLFAIL, me);
             return(-1);
         }
-        P_crprops = P_ckcrprops;
+        dbfile5->crprops = dbfile5->ckcrprops;
     }
     else if (DBGetCompressionFile(dbfile))
     {
-        H5Pset_chunk(P_ckcrprops, rank, size);
         if (db_hdf5_set_compression(dbfile, 0)<0) {
             db_perror("db_hdf5_set_compression", E_CALLFAIL, me);
             return(-1);
         }
-        P_crprops = P_ckcrprops;
+        dbfile5->crprops = dbfile5->ckcrprops;
+    }
+    return 0;
+}
+/*-------------------------------------------------------------------------
+ * Function:    db_hdf5_compression_threads
+ *
+ * Purpose:     Return the size of the compression thread pool given by
+ *              "THREADS=<int>" in the compression string, or 0 if there
+ *              is none.
+ *
+ *-------------------------------------------------------------------------
+ */
+PRIVATE int
+db_hdf5_compression_threads(DBfile *dbfile)
+{
+    char const *cstr = DBGetCompressionFile(dbfile);
+    char const *ptr;
+    int n;
+
+    if (!cstr || (ptr = strstr(cstr, "THREADS=")) == NULL)
+        return 0;
+    n = (int) strtol(ptr+8, 0, 10);
+    return n > 1 ? n : 0;
+}
+
+#ifdef DB_HDF5_PARALLEL_CHUNKS /* { */
+
+/* The following section compresses the chunks of a dataset on a pool of
+   threads and hands them to HDF5 already compressed with H5Dwrite_chunk.
+   The calling thread writes chunks in order while the pool is still
+   compressing later ones. Only Silo's own filters can be run outside of
+   HDF5's pipeline. A dataset using any other filter (deflate, shuffle,
+   szip, fletcher32) is written with H5Dwrite instead. */
+
+typedef struct db_hdf5_pfilter_t {
+    H5Z_func_t          func;
+    int                 fpzip;  /* call db_hdf5_fpzip_encode instead */
+    unsigned int        flags;
+    size_t              cd_nelmts;
+    unsigned int        cd_values[32];
+} db_hdf5_pfilter_t;
+
+typedef struct db_hdf5_pchunk_t {
+    void               *buf;
+    size_t              nbytes;
+    unsigned int        mask;   /* filters skipped, as for H5Dwrite_chunk */
+    int                 status; /* 0=pending, 1=compressed, -1=failed */
+} db_hdf5_pchunk_t;
+
+typedef struct db_hdf5_cpool_t {
+    pthread_mutex_t     mutex;
+    pthread_cond_t      cond;
+    unsigned char const *data;
+    size_t              elsize;
+    size_t              chunk_bytes;
+    int                 rank;
+    hsize_t             size[H5S_MAX_RANK];
+    hsize_t             chunk[H5S_MAX_RANK];
+    hsize_t             nchunks[H5S_MAX_RANK];
+    int                 nfilters;
+    db_hdf5_pfilter_t   filters[H5Z_MAX_NFILTERS];
+#ifdef HAVE_FPZIP
+    db_hdf5_fpzip_params_t fpzip; /* this dataset's, not the global's */
+#endif
+    db_hdf5_pchunk_t   *chunks;
+    hsize_t             total;
+    hsize_t             next;    /* next chunk to hand to a thread */
+    hsize_t             written; /* chunks handed to HDF5 so far */
+    hsize_t             window;  /* max chunks compressed but not written */
+    int                 abort;
+} db_hdf5_cpool_t;
+
+/* Element offset of chunk k, slowest varying dimension first */
+static void
+db_hdf5_cpool_offset(db_hdf5_cpool_t const *pool, hsize_t k, hsize_t offset[])
+{
+    int i;
+    for (i = pool->rank-1; i >= 0; i--)
+    {
+        offset[i] = (k % pool->nchunks[i]) * pool->chunk[i];
+        k /= pool->nchunks[i];
+    }
+}
+
+/* Gather chunk k out of the caller's buffer and run it through the
+   filters. Edge chunks are zero padded to full size as HDF5 does. */
+static int
+db_hdf5_cpool_compress(db_hdf5_cpool_t *pool, hsize_t k)
+{
+    db_hdf5_pchunk_t *c = &pool->chunks[k];
+    hsize_t offset[H5S_MAX_RANK], ext[H5S_MAX_RANK], idx[H5S_MAX_RANK];
+    size_t buf_size = pool->chunk_bytes, nbytes = pool->chunk_bytes, rowbytes;
+    int i, rank = pool->rank, partial = 0;
+    void *buf;
+
+    db_hdf5_cpool_offset(pool, k, offset);
+    for (i = 0; i < rank; i++)
+    {
+        ext[i] = MIN(pool->chunk[i], pool->size[i] - offset[i]);
+        if (ext[i] < pool->chunk[i])
+            partial = 1;
+        idx[i] = 0;
+    }
+    if ((buf = partial ? calloc(1, buf_size) : malloc(buf_size)) == NULL)
+        return -1;
+
+    rowbytes = (size_t) ext[rank-1] * pool->elsize;
+    while (1)
+    {
+        hsize_t src = 0, dst = 0;
+        for (i = 0; i < rank; i++)
+        {
+            src = src * pool->size[i] + offset[i] + idx[i];
+            dst = dst * pool->chunk[i] + idx[i];
+        }
+        memcpy((unsigned char *) buf + dst * pool->elsize,
+               pool->data + src * pool->elsize, rowbytes);
+        for (i = rank-2; i >= 0; i--)
+        {
+            if (++idx[i] < ext[i])
+                break;
+            idx[i] = 0;
+        }
+        if (i < 0)
+            break;
+    }
+
+    for (i = 0; i < pool->nfilters; i++)
+    {
+        db_hdf5_pfilter_t const *f = &pool->filters[i];
+        size_t n;
+#ifdef HAVE_FPZIP
+        if (f->fpzip)
+            n = db_hdf5_fpzip_encode(&pool->fpzip, nbytes, &buf_size, &buf);
+        else
+#endif
+            n = f->func(0, f->cd_nelmts, f->cd_values, nbytes, &buf_size, &buf);
+        if (n == 0)
+        {
+            if (!(f->flags & H5Z_FLAG_OPTIONAL))
+            {
+                free(buf);
+                return -1;
+            }
+            c->mask |= 1u << i;
+        }
+        else
+        {
+            nbytes = n;
+        }
+    }
+
+    c->buf = buf;
+    c->nbytes = nbytes;
+    return 1;
+}
+
+static void *
+db_hdf5_cpool_worker(void *arg)
+{
+    db_hdf5_cpool_t *pool = (db_hdf5_cpool_t *) arg;
+
+    while (1)
+    {
+        hsize_t k;
+        int status;
+
+        pthread_mutex_lock(&pool->mutex);
+        while (!pool->abort && pool->next < pool->total &&
+               pool->next - pool->written >= pool->window)
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+        if (pool->abort || pool->next >= pool->total)
+        {
+            pthread_mutex_unlock(&pool->mutex);
+            return 0;
+        }
+        k = pool->next++;
+        pthread_mutex_unlock(&pool->mutex);
+
+        status = db_hdf5_cpool_compress(pool, k);
+
+        pthread_mutex_lock(&pool->mutex);
+        pool->chunks[k].status = status;
+        pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->mutex);
     }
     return 0;
 }
+
+/*-------------------------------------------------------------------------
+ * Function:    db_hdf5_write_chunks_parallel
+ *
+ * Purpose:     Write all of dset from buf, compressing its chunks on
+ *              nthreads threads.
+ *
+ * Return:      Success:        1 if the dataset was written, 0 if it
+ *                              cannot be written this way and the caller
+ *                              should use H5Dwrite.
+ *
+ *              Failure:        -1
+ *
+ *-------------------------------------------------------------------------
+ */
+PRIVATE int
+db_hdf5_write_chunks_parallel(hid_t dset, hid_t mtype, void const *buf,
+    int nthreads)
+{
+    static char *me = "db_hdf5_write_chunks_parallel";
+    db_hdf5_cpool_t pool;
+    pthread_t *threads = 0;
+    hid_t dcpl = -1, ftype = -1, fspace = -1;
+    int i, nstarted = 0, retval = 0;
+    hsize_t k;
+
+    memset(&pool, 0, sizeof(pool));
+
+    H5E_BEGIN_TRY {
+        if ((dcpl = H5Dget_create_plist(dset)) < 0 ||
+            H5Pget_layout(dcpl) != H5D_CHUNKED ||
+            (ftype = H5Dget_type(dset)) < 0 ||
+            H5Tequal(ftype, mtype) <= 0 ||
+            (fspace = H5Dget_space(dset)) < 0)
+            goto done;
+    } H5E_END_TRY;
+
+    pool.rank = H5Sget_simple_extent_ndims(fspace);
+    if (pool.rank <= 0 || H5Pget_chunk(dcpl, H5S_MAX_RANK, pool.chunk) != pool.rank)
+        goto done;
+    H5Sget_simple_extent_dims(fspace, pool.size, 0);
+    pool.elsize = H5Tget_size(ftype);
+    pool.chunk_bytes = pool.elsize;
+    pool.total = 1;
+    for (i = 0; i < pool.rank; i++)
+    {
+        pool.nchunks[i] = (pool.size[i] + pool.chunk[i] - 1) / pool.chunk[i];
+        pool.chunk_bytes *= (size_t) pool.chunk[i];
+        pool.total *= pool.nchunks[i];
+    }
+    if (pool.total < 2)
+        goto done;
+
+    /* Every filter in the pipeline has to be one we can call directly */
+    if ((pool.nfilters = H5Pget_nfilters(dcpl)) <= 0)
+        goto done;
+    for (i = 0; i < pool.nfilters; i++)
+    {
+        db_hdf5_pfilter_t *f = &pool.filters[i];
+        H5Z_filter_t id;
+
+        f->cd_nelmts = NELMTS(f->cd_values);
+        id = H5Pget_filter2(dcpl, (unsigned) i, &f->flags, &f->cd_nelmts,
+                 f->cd_values, 0, NULL, NULL);
+        if (f->cd_nelmts > NELMTS(f->cd_values))
+            goto done;
+#ifdef HAVE_FPZIP
+        if (id == DB_HDF5_FPZIP_ID)
+        {
+            f->func = db_hdf5_fpzip_filter_op;
+            f->fpzip = 1;
+        }
+#endif
+#ifdef HAVE_ZFP
+        if (id == H5Z_FILTER_ZFP)
+            f->func = H5Z_zfp_filter_func();
+#endif
+        if (!f->func)
+            goto done;
+    }
+
+    pool.data = (unsigned char const *) buf;
+    pool.window = 4 * (hsize_t) nthreads;
+#ifdef HAVE_FPZIP
+    /* The workers must not read the global the filter's set_local writes */
+    pool.fpzip = db_hdf5_fpzip_params;
+    pool.fpzip.threads = 0;
+#endif
+    if ((pool.chunks = (db_hdf5_pchunk_t *) calloc(pool.total, sizeof(db_hdf5_pchunk_t))) == NULL ||
+        (threads = (pthread_t *) malloc(nthreads * sizeof(pthread_t))) == NULL)
+    {
+        db_perror("pool", E_NOMEM, me);
+        retval = -1;
+        goto done;
+    }
+    pthread_mutex_init(&pool.mutex, 0);
+    pthread_cond_init(&pool.cond, 0);
+    for (nstarted = 0; nstarted < nthreads; nstarted++)
+    {
+        if (pthread_create(&threads[nstarted], 0, db_hdf5_cpool_worker, &pool) != 0)
+            break;
+    }
+    if (nstarted == 0)
+    {
+        db_perror("pthread_create", E_CALLFAIL, me);
+        retval = -1;
+        goto cleanup;
+    }
+
+    for (k = 0, retval = 1; k < pool.total; k++)
+    {
+        db_hdf5_pchunk_t *c = &pool.chunks[k];
+        hsize_t offset[H5S_MAX_RANK];
+
+        pthread_mutex_lock(&pool.mutex);
+        while (c->status == 0)
+            pthread_cond_wait(&pool.cond, &pool.mutex);
+        pthread_mutex_unlock(&pool.mutex);
+
+        if (c->status < 0)
+        {
+            db_perror("chunk compression", E_COMPRESSION, me);
+            retval = -1;
+            break;
+        }
+        db_hdf5_cpool_offset(&pool, k, offset);
+        if (H5Dwrite_chunk(dset, H5P_DEFAULT, c->mask, offset, c->nbytes, c->buf) < 0)
+        {
+            db_perror("H5Dwrite_chunk", E_CALLFAIL, me);
+            retval = -1;
+            break;
+        }
+        free(c->buf);
+        c->buf = 0;
+
+        pthread_mutex_lock(&pool.mutex);
+        pool.written = k+1;
+        pthread_cond_broadcast(&pool.cond);
+        pthread_mutex_unlock(&pool.mutex);
+    }
+
+cleanup:
+    pthread_mutex_lock(&pool.mutex);
+    pool.abort = retval < 0;
+    pthread_cond_broadcast(&pool.cond);
+    pthread_mutex_unlock(&pool.mutex);
+    for (i = 0; i < nstarted; i++)
+        pthread_join(threads[i], 0);
+    for (k = 0; k < pool.total; k++)
+        free(pool.chunks[k].buf);
+    pthread_cond_destroy(&pool.cond);
+    pthread_mutex_destroy(&pool.mutex);
+
+done:
+    free(threads);
+    free(pool.chunks);
+    H5E_BEGIN_TRY {
+        H5Pclose(dcpl);
+        H5Tclose(ftype);
+        H5Sclose(fspace);
+    } H5E_END_TRY;
+    return retval;
+}
+
+#endif /* DB_HDF5_PARALLEL_CHUNKS } */
+
+/*-------------------------------------------------------------------------
+ * Function:    db_hdf5_write_filtered
+ *
+ * Purpose:     Write all of a newly created, possibly filtered, dataset.
+ *              With a compression thread pool enabled, chunks are
+ *              compressed in parallel when the filters allow it.
+ *              Otherwise, the data goes through H5Dwrite and the ZFP
+ *              filter may use the pool's size for OpenMP threads, and
+ *              the FPZIP filter for encoding slabs, within each chunk.
+ *
+ * Return:      Success:        0
+ *
+ *              Failure:        -1
+ *
+ *-------------------------------------------------------------------------
+ */
+PRIVATE int
+db_hdf5_write_filtered(DBfile *dbfile, hid_t dset, hid_t mtype, hid_t space,
+    void const *buf)
+{
+    int nthreads = db_hdf5_compression_threads(dbfile);
+    herr_t status;
+#ifdef HAVE_ZFP
+    int omp_threads;
+#endif
+
+#ifdef DB_HDF5_PARALLEL_CHUNKS
+    if (nthreads > 1)
+    {
+        int ret = db_hdf5_write_chunks_parallel(dset, mtype, buf, nthreads);
+        if (ret != 0)
+            return ret < 0 ? -1 : 0;
+    }
+#endif
+
+#ifdef HAVE_ZFP
+    omp_threads = H5Z_zfp_set_omp_threads(nthreads);
+#endif
+#ifdef HAVE_FPZIP
+    db_hdf5_fpzip_params.threads = nthreads;
+#endif
+    status = H5Dwrite(dset, mtype, space, space, H5P_DEFAULT, buf);
+#ifdef HAVE_FPZIP
+    db_hdf5_fpzip_params.threads = 0;
+#endif
+#ifdef HAVE_ZFP
+    H5Z_zfp_set_omp_threads(omp_threads);
+#endif
+    return status < 0 ? -1 : 0;
+}
+
 /*-------------------------------------------------------------------------
  * Function:    db_hdf5_get_comp_var 
  *
@@ -3883,11 +4502,7 @@ db_hdf5_get_comp_var(DBfile *_dbfile, char const *name, hsize_t *nelmts,
                         *buf = realloc(*buf, numvals*H5Tget_size(mtype));
                     }
 
-                    P_rdprops = H5P_DEFAULT;
-                    if (!DBGetEnableChecksumsFile(_dbfile))
-                        P_rdprops = P_ckrdprops;
-
-                    if (H5Dread(d, mtype, H5S_ALL, H5S_ALL, P_rdprops, *buf)<0) {
+                    if (H5Dread(d, mtype, H5S_ALL, H5S_ALL, DB_HDF5_RDPROPS(_dbfile), *buf)<0) {
                         hdf5_to_silo_error(name, "db_hdf5_get_comp_var");
                         if (buf_was_allocated)
                         {
@@ -3946,10 +4561,30 @@ db_hdf5_get_comp_var(DBfile *_dbfile, char const *name, hsize_t *nelmts,
     return retval;
 }
 
+/* State passed through H5Literate to load_toc */
+typedef struct load_toc_t {
+    DBtoc       *toc;
+    int         namesOnly;      /* skip reading each object's silo_type */
+} load_toc_t;
+
+/* Make room for list[n], growing list geometrically. Capacity is always
+   the smallest power of two that is at least n. */
+PRIVATE void
+toc_grow(char ***list, int n)
+{
+    if ((n & (n-1)) == 0)
+        *list = (char **) realloc(*list, (n ? 2*n : 1) * sizeof(char*));
+}
+
 /*-------------------------------------------------------------------------
- * Function:    load_toc
+ * Function:    db_hdf5_probe_type
  *
- * Purpose:     Add an object to the table of contents
+ * Purpose:     Determine the silo object type of the entry NAME in group
+ *              GRP the way the table of contents classifies it. LB is the
+ *              link info for NAME. Sets *OBJTYPE to the type, which is
+ *              DB_INVALID_OBJECT for entries which do not appear in a table
+ *              of contents, and *ISLINK if the entry is a link the table of
+ *              contents should report as a symlink.
  *
  * Return:      Success:        0
  *
@@ -3960,36 +4595,31 @@ db_hdf5_get_comp_var(DBfile *_dbfile, char const *name, hsize_t *nelmts,
  *
  * Modifications:
  *
- *   Mark C. Miller, Tue Feb  1 13:48:33 PST 2005
- *   Made it deal with case of QUAD_RECT or QUAD_CURV
- *
+ *   Split out of load_toc so the object index can classify entries the
+ *   same way.
  *-------------------------------------------------------------------------
  */
-PRIVATE herr_t
-load_toc(hid_t grp, char const *name, H5L_info_t const *dummy, void *_toc)
+PRIVATE int
+db_hdf5_probe_type(hid_t grp, char const *name, H5L_info_t const *lb,
+                   int *objtype, int *islink)
 {
-    DBtoc               *toc = (DBtoc*)_toc;
     H5G_stat_t          sb;
-    H5L_info_t          lb;
-    DBObjectType        objtype = DB_INVALID_OBJECT;
-    int                 *nvals=NULL, _objtype, islink=0;
-    char                ***names=NULL;
+    int                 _objtype;
     hid_t               obj=-1, attr=-1;
 
-    if (H5Gget_objinfo(grp, name, FALSE, &sb)<0) return -1;
-    if (H5Lget_info(grp, name, &lb, H5P_DEFAULT)<0) return -1;
-    if (sb.type == H5G_LINK)
-    {
-        islink = 1;
-        if (H5Gget_objinfo(grp, name, TRUE, &sb)<0) return -1;
-    }
-    else if (lb.type == H5L_TYPE_EXTERNAL)
+    if (lb->type == H5L_TYPE_EXTERNAL)
     {
         /* external links are presently constrained to work
            only for group tagets */
-        islink = 1;
+        *islink = 1;
         sb.type = H5G_GROUP;
     }
+    else
+    {
+        *islink = lb->type == H5L_TYPE_SOFT;
+        if (H5Gget_objinfo(grp, name, TRUE, &sb)<0) return -1;
+    }
+    *objtype = DB_INVALID_OBJECT;
     switch (sb.type) {
     case H5G_GROUP:
         /*
@@ -3998,23 +4628,23 @@ load_toc(hid_t grp, char const *name, H5L_info_t const *dummy, void *_toc)
          */
         if (!strcmp(name, "..") || (obj=H5Gopen(grp, name, H5P_DEFAULT))<0) break;
         H5E_BEGIN_TRY {
-            if (H5Gget_objinfo(obj, "..", FALSE, NULL)>=0) objtype = DB_DIR;
+            if (H5Gget_objinfo(obj, "..", FALSE, NULL)>=0) *objtype = DB_DIR;
         } H5E_END_TRY;
         H5Gclose(obj);
         break;
 
     case H5G_TYPE:
         if ((obj=H5Topen(grp, name, H5P_DEFAULT))<0) break;
-        if ((attr=H5Aopen_name(obj, "silo_type"))<0) break;
-        if (H5Aread(attr, H5T_NATIVE_INT, &_objtype)<0) break;
-        objtype = (DBObjectType)_objtype;
-        H5Aclose(attr);
+        if ((attr=H5Aopen_name(obj, "silo_type"))>=0 &&
+            H5Aread(attr, H5T_NATIVE_INT, &_objtype)>=0)
+            *objtype = _objtype;
+        if (attr>=0) H5Aclose(attr);
         H5Tclose(obj);
         break;
 
     case H5G_DATASET:
-        objtype = DB_VARIABLE;
-        islink = 0; /* ignore links on raw data */
+        *objtype = DB_VARIABLE;
+        *islink = 0; /* ignore links on raw data */
         break;
 
     default:
@@ -4022,6 +4652,30 @@ load_toc(hid_t grp, char const *name, H5L_info_t const *dummy, void *_toc)
         break;
     }
 
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    toc_add
+ *
+ * Purpose:     Append NAME, an entry of group GRP with silo type OBJTYPE,
+ *              to the matching list of the table of contents TOC.
+ *
+ * Programmer:  Robb Matzke
+ *              Thursday, February 11, 1999
+ *
+ * Modifications:
+ *
+ *   Split out of load_toc so tables of contents can also be built from
+ *   the object index.
+ *-------------------------------------------------------------------------
+ */
+PRIVATE void
+toc_add(DBtoc *toc, hid_t grp, char const *name, int objtype, int islink)
+{
+    int                 *nvals=NULL;
+    char                ***names=NULL;
+
     /* What table of contents field does this object belong to? */
     switch (objtype) {
     case DB_INVALID_OBJECT:
@@ -4131,42 +4785,623 @@ load_toc(hid_t grp, char const *name, H5L_info_t const *dummy, void *_toc)
         break;
     }
 
-    /* Append to table of contents */
-#ifndef _MSC_VER
-#warning REVISIT THIS CODE BLOCK
-#endif
-#if 0
-    if (islink) {
-        int n = toc->nsymlink++;
-        toc->symlink_names = (char **) realloc(toc->symlink_names, (n+1)*sizeof(char*));
-        toc->symlink_names[n] = STRDUP(name);
+    /* Append to table of contents */
+    if (names && nvals) {
+        int n1 = (*nvals)++;
+        toc_grow(names, n1);
+        (*names)[n1] = STRDUP(name);
+        if (islink) {
+            char target[2*256];
+            int n2 = toc->nsymlink++;
+            toc_grow(&toc->symlink_names, n2);
+            toc->symlink_names[n2] = (*names)[n1]; /* note: copy of the pointer */
+            toc_grow(&toc->symlink_target_names, n2);
+            if (db_hdf5_getslink(grp, name, target) == 0)
+                toc->symlink_target_names[n2] = STRDUP(target);
+            else
+                toc->symlink_target_names[n2] = STRDUP("unknown");
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    load_toc
+ *
+ * Purpose:     Add an object to the table of contents
+ *
+ * Return:      Success:        0
+ *
+ *              Failure:        -1
+ *
+ * Programmer:  Robb Matzke
+ *              Thursday, February 11, 1999
+ *
+ * Modifications:
+ *
+ *   Mark C. Miller, Tue Feb  1 13:48:33 PST 2005
+ *   Made it deal with case of QUAD_RECT or QUAD_CURV
+ *
+ *   Uses the link info H5Literate provides instead of querying it
+ *   again and grows the name lists geometrically. In names-only mode,
+ *   entries go to obj_names without querying the objects at all.
+ *-------------------------------------------------------------------------
+ */
+PRIVATE herr_t
+load_toc(hid_t grp, char const *name, H5L_info_t const *lb, void *_ctx)
+{
+    load_toc_t          *ctx = (load_toc_t*)_ctx;
+    DBtoc               *toc = ctx->toc;
+    int                 objtype, islink=0;
+
+    /* In names-only mode every entry goes in obj_names without looking
+       at the object at all, except for the `..' and link group entries
+       which never appear in a table of contents */
+    if (ctx->namesOnly)
+    {
+        if (!strcmp(name, "..") || !strcmp(name, ".silo") /*LINKGRP*/)
+            return 0;
+        toc_grow(&toc->obj_names, toc->nobj);
+        toc->obj_names[toc->nobj++] = STRDUP(name);
+        return 0;
+    }
+
+    if (db_hdf5_probe_type(grp, name, lb, &objtype, &islink)<0) return -1;
+    toc_add(toc, grp, name, objtype, islink);
+
+    return 0;
+}
+
+/*
+ * Object index
+ *
+ * Classifying a directory entry costs an H5Topen and an attribute read,
+ * which dominates opening directories with many objects. So the driver
+ * keeps, for every directory written to, a compact index dataset in the
+ * link group holding the silo type of each entry. The dataset is named
+ * after the object number of the directory's group and holds one record
+ * per entry of the form "<type> <islink> <target> <name>\0" in name order,
+ * where <target> identifies the object a hard link points to (0 for other
+ * links). Its `nlinks' attribute is the number of links the directory had
+ * when the index was written and its `version' attribute is the record
+ * format.
+ *
+ * Object numbers are file addresses, which h5repack and the like change,
+ * and another tool may rename, delete or add entries without touching the
+ * index. So before an index is used its records are matched against the
+ * group's links, by name and target, with an H5Literate that opens no
+ * objects. Any difference and the index is ignored.
+ *
+ * Directories written to during this session are tracked in memory with
+ * the types of the objects written and their indices are rewritten when
+ * the file is flushed or closed.
+ */
+#define DB_HDF5_MAX_DIRTY_INDEX 64     /* dirty directories held open  */
+#define DB_HDF5_INDEX_VERSION   2      /* format of index records      */
+
+typedef struct db_hdf5_index_t {
+    unsigned long       objno[2];       /* object number of the group   */
+    hid_t               grp;            /* open group, dirty only       */
+    int                 dirty;          /* written since last flush     */
+    int                 n;              /* number of entries            */
+    char                **names;        /* entry names                  */
+    int                 *types;         /* silo types or DB_INVALID_OBJECT */
+    int                 *links;         /* entries that are links       */
+    char                *buf;           /* storage of names, if read    */
+} db_hdf5_index_t;
+
+PRIVATE void
+db_hdf5_index_free(db_hdf5_index_t *idx)
+{
+    int i;
+
+    if (!idx) return;
+    if (!idx->buf)
+        for (i = 0; i < idx->n; i++)
+            FREE(idx->names[i]);
+    if (idx->grp >= 0)
+    {
+        H5E_BEGIN_TRY {
+            H5Gclose(idx->grp);
+        } H5E_END_TRY;
+    }
+    FREE(idx->names);
+    FREE(idx->types);
+    FREE(idx->links);
+    FREE(idx->buf);
+    FREE(idx);
+}
+
+PRIVATE void
+db_hdf5_index_append(db_hdf5_index_t *idx, char *name, int objtype, int islink)
+{
+    int n = idx->n++;
+
+    toc_grow(&idx->names, n);
+    if ((n & (n-1)) == 0)
+    {
+        idx->types = (int *) realloc(idx->types, (n ? 2*n : 1) * sizeof(int));
+        idx->links = (int *) realloc(idx->links, (n ? 2*n : 1) * sizeof(int));
+    }
+    idx->names[n] = name;
+    idx->types[n] = objtype;
+    idx->links[n] = islink;
+}
+
+/* Position of NAME in the (sorted) index IDX or -1 */
+PRIVATE int
+db_hdf5_index_find(db_hdf5_index_t const *idx, char const *name)
+{
+    int lo = 0, hi = idx->n - 1;
+
+    while (lo <= hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(name, idx->names[mid]);
+        if (cmp == 0) return mid;
+        if (cmp < 0) hi = mid - 1;
+        else lo = mid + 1;
+    }
+    return -1;
+}
+
+PRIVATE void
+db_hdf5_index_dsname(unsigned long const objno[2], char *dsname)
+{
+    sprintf(dsname, "toc_%lx_%lx", objno[0], objno[1]);
+}
+
+/* What the index records as the target of link LB */
+PRIVATE unsigned long long
+db_hdf5_index_target(H5L_info_t const *lb)
+{
+    unsigned long long target = 0;
+
+    if (lb->type != H5L_TYPE_HARD)
+        return 0;
+#if HDF5_VERSION_GE(1,12,0)
+    memcpy(&target, &lb->u.token, MIN(sizeof target, sizeof lb->u.token));
+#else
+    target = (unsigned long long) lb->u.address;
+#endif
+    return target;
+}
+
+/* State passed through H5Literate to index_check */
+typedef struct index_check_t {
+    db_hdf5_index_t const *idx;
+    unsigned long long const *targets;  /* recorded link targets        */
+    int                 n;              /* links matched so far         */
+} index_check_t;
+
+/* Match the next link of the group against the next index record */
+PRIVATE herr_t
+index_check(hid_t grp, char const *name, H5L_info_t const *lb, void *_ctx)
+{
+    index_check_t       *ctx = (index_check_t*)_ctx;
+    int                 n = ctx->n;
+
+    if (!strcmp(name, "..")) return 0;
+    if (n >= ctx->idx->n ||
+        strcmp(name, ctx->idx->names[n]) ||
+        db_hdf5_index_target(lb) != ctx->targets[n])
+        return 1;
+    ctx->n++;
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    db_hdf5_index_read
+ *
+ * Purpose:     Read the object index of group GRP whose object number is
+ *              OBJNO.
+ *
+ * Return:      Success:        The index
+ *
+ *              Failure:        NULL if the group has no index or the
+ *                              index does not match the group
+ *-------------------------------------------------------------------------
+ */
+PRIVATE db_hdf5_index_t *
+db_hdf5_index_read(DBfile_hdf5 *dbfile, hid_t grp, unsigned long const objno[2])
+{
+    db_hdf5_index_t     *idx = NULL;
+    hid_t               dset=-1, attr=-1, vattr=-1, space=-1;
+    H5G_info_t          ginfo;
+    index_check_t       check;
+    unsigned long long  *targets = NULL;
+    char                dsname[64], *p, *end;
+    hssize_t            size;
+    int                 nlinks = -1, version = -1, ok = FALSE;
+
+    db_hdf5_index_dsname(objno, dsname);
+
+    H5E_BEGIN_TRY {
+        if ((dset=H5Dopen(dbfile->link, dsname, H5P_DEFAULT))<0 ||
+            (vattr=H5Aopen_name(dset, "version"))<0 ||
+            H5Aread(vattr, H5T_NATIVE_INT, &version)<0 ||
+            version != DB_HDF5_INDEX_VERSION ||
+            (attr=H5Aopen_name(dset, "nlinks"))<0 ||
+            H5Aread(attr, H5T_NATIVE_INT, &nlinks)<0 ||
+            H5Gget_info(grp, &ginfo)<0 ||
+            (hsize_t)nlinks != ginfo.nlinks ||
+            (space=H5Dget_space(dset))<0 ||
+            (size=H5Sget_simple_extent_npoints(space))<=0)
+            goto done;
+
+        idx = ALLOC(db_hdf5_index_t);
+        idx->grp = -1;
+        idx->objno[0] = objno[0];
+        idx->objno[1] = objno[1];
+        idx->buf = ALLOC_N(char, size+1);
+        if (H5Dread(dset, H5T_NATIVE_CHAR, H5S_ALL, H5S_ALL, H5P_DEFAULT, idx->buf)<0)
+            goto done;
+
+        /* Parse the records, insisting they are in name order */
+        for (p = idx->buf, end = idx->buf + size; p < end && *p; p += strlen(p) + 1)
+        {
+            int objtype = (int) strtol(p, &p, 10);
+            int islink = (int) strtol(p, &p, 10);
+            unsigned long long target = strtoull(p, &p, 16);
+            if (*p++ != ' ' || p >= end || !*p) goto done;
+            if (idx->n && strcmp(idx->names[idx->n-1], p) >= 0) goto done;
+            if ((idx->n & (idx->n-1)) == 0)
+                targets = (unsigned long long *) realloc(targets,
+                    (idx->n ? 2*idx->n : 1) * sizeof(unsigned long long));
+            targets[idx->n] = target;
+            db_hdf5_index_append(idx, p, objtype, islink);
+        }
+
+        /* The records must still describe the group's links */
+        check.idx = idx;
+        check.targets = targets;
+        check.n = 0;
+        if (H5Literate(grp, H5_INDEX_NAME, H5_ITER_INC, NULL, index_check, &check)!=0 ||
+            check.n != idx->n)
+            goto done;
+        ok = TRUE;
+
+done:
+        H5Sclose(space);
+        H5Aclose(attr);
+        H5Aclose(vattr);
+        H5Dclose(dset);
+    } H5E_END_TRY;
+
+    FREE(targets);
+    if (!ok)
+    {
+        db_hdf5_index_free(idx);
+        return NULL;
+    }
+    return idx;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    db_hdf5_index_cwg
+ *
+ * Purpose:     Return the object index of the current working directory.
+ *
+ * Return:      Success:        The index, owned by DBFILE
+ *
+ *              Failure:        NULL if the directory has no usable index
+ *                              or was written to during this session
+ *-------------------------------------------------------------------------
+ */
+PRIVATE db_hdf5_index_t *
+db_hdf5_index_cwg(DBfile_hdf5 *dbfile)
+{
+    H5G_stat_t          sb;
+    herr_t              status;
+    int                 i;
+
+    if (dbfile->cwg_index || dbfile->cwg_index_none)
+        return dbfile->cwg_index;
+
+    dbfile->cwg_index_none = TRUE;
+    H5E_BEGIN_TRY {
+        status = H5Gget_objinfo(dbfile->cwg, ".", TRUE, &sb);
+    } H5E_END_TRY;
+    if (status<0)
+        return NULL;
+    for (i = 0; i < dbfile->ndirty_index; i++)
+    {
+        if (dbfile->dirty_index[i]->objno[0] == sb.objno[0] &&
+            dbfile->dirty_index[i]->objno[1] == sb.objno[1])
+            return NULL;
+    }
+
+    dbfile->cwg_index = db_hdf5_index_read(dbfile, dbfile->cwg, sb.objno);
+    return dbfile->cwg_index;
+}
+
+/* Forget the index of the current working directory */
+PRIVATE void
+db_hdf5_index_release_cwg(DBfile_hdf5 *dbfile)
+{
+    db_hdf5_index_free(dbfile->cwg_index);
+    dbfile->cwg_index = NULL;
+    dbfile->cwg_index_none = FALSE;
+}
+
+PRIVATE int db_hdf5_index_write(DBfile_hdf5 *dbfile, db_hdf5_index_t *idx);
+
+/*-------------------------------------------------------------------------
+ * Function:    db_hdf5_index_note
+ *
+ * Purpose:     Record that NAME, relative to the current working
+ *              directory, was created or rewritten with silo type OBJTYPE
+ *              so that the index of its directory is rewritten when the
+ *              file is flushed or closed. OBJTYPE may be DB_INVALID_OBJECT
+ *              if the type is not known, in which case it is looked up
+ *              when the index is written.
+ *
+ *              The index is only an accelerator so failures here are
+ *              silently ignored.
+ *-------------------------------------------------------------------------
+ */
+PRIVATE void
+db_hdf5_index_note(DBfile_hdf5 *dbfile, char const *name, int objtype)
+{
+    db_hdf5_index_t     *idx = NULL, *old;
+    H5G_stat_t          sb;
+    herr_t              status;
+    char                *dir = NULL;
+    char const          *base = strrchr(name, '/');
+    int                 i;
+
+    db_hdf5_index_release_cwg(dbfile);
+
+    if (base)
+    {
+        dir = STRDUP(name);
+        dir[base == name ? 1 : base - name] = '\0';
+        base++;
+    }
+    else
+    {
+        base = name;
+    }
+    if (!*base) goto done;
+
+    H5E_BEGIN_TRY {
+        status = H5Gget_objinfo(dbfile->cwg, dir ? dir : ".", TRUE, &sb);
+    } H5E_END_TRY;
+    if (status<0) goto done;
+
+    /* Most recently used directory is kept at the end */
+    for (i = dbfile->ndirty_index - 1; i >= 0; i--)
+    {
+        if (dbfile->dirty_index[i]->objno[0] == sb.objno[0] &&
+            dbfile->dirty_index[i]->objno[1] == sb.objno[1])
+        {
+            idx = dbfile->dirty_index[i];
+            memmove(dbfile->dirty_index + i, dbfile->dirty_index + i + 1,
+                (dbfile->ndirty_index - i - 1) * sizeof(db_hdf5_index_t*));
+            dbfile->dirty_index[dbfile->ndirty_index-1] = idx;
+            break;
+        }
+    }
+
+    if (!idx)
+    {
+        hid_t grp;
+
+        /* Only silo directories get an index */
+        H5E_BEGIN_TRY {
+            if ((grp=H5Gopen(dbfile->cwg, dir ? dir : ".", H5P_DEFAULT))>=0 &&
+                H5Gget_objinfo(grp, "..", FALSE, NULL)<0)
+            {
+                H5Gclose(grp);
+                grp = -1;
+            }
+        } H5E_END_TRY;
+        if (grp<0) goto done;
+
+        /* Start from the index in the file, if it is still good */
+        idx = ALLOC(db_hdf5_index_t);
+        idx->grp = grp;
+        idx->objno[0] = sb.objno[0];
+        idx->objno[1] = sb.objno[1];
+        if ((old = db_hdf5_index_read(dbfile, grp, sb.objno)))
+        {
+            for (i = 0; i < old->n; i++)
+                db_hdf5_index_append(idx, STRDUP(old->names[i]), old->types[i], old->links[i]);
+            db_hdf5_index_free(old);
+        }
+
+        /* Write out the least recently used directory to bound the number
+           of groups held open. Its index is picked up again from the file
+           if it is written to later. */
+        if (dbfile->ndirty_index == DB_HDF5_MAX_DIRTY_INDEX)
+        {
+            old = dbfile->dirty_index[0];
+            if (old->dirty)
+                db_hdf5_index_write(dbfile, old);
+            db_hdf5_index_free(old);
+            memmove(dbfile->dirty_index, dbfile->dirty_index + 1,
+                --dbfile->ndirty_index * sizeof(db_hdf5_index_t*));
+        }
+        if (!dbfile->dirty_index)
+            dbfile->dirty_index = ALLOC_N(db_hdf5_index_t*, DB_HDF5_MAX_DIRTY_INDEX);
+        dbfile->dirty_index[dbfile->ndirty_index++] = idx;
+    }
+
+    idx->dirty = TRUE;
+    db_hdf5_index_append(idx, STRDUP(base), objtype, 0);
+
+done:
+    FREE(dir);
+}
+
+/* A recorded entry of a dirty index, for sorting */
+typedef struct index_rec_t {
+    char const          *name;
+    int                 seq;            /* position in the index        */
+} index_rec_t;
+
+/* State passed through H5Literate to index_entry */
+typedef struct index_entry_t {
+    db_hdf5_index_t     *idx;           /* recorded entries             */
+    index_rec_t         *recs;          /* recorded entries in name order */
+    char                *buf;           /* records                      */
+    size_t              len, size;      /* used and allocated length    */
+} index_entry_t;
+
+/* Name order with later entries for the same name first */
+PRIVATE int
+index_rec_cmp(void const *a, void const *b)
+{
+    index_rec_t const *ra = (index_rec_t const *)a;
+    index_rec_t const *rb = (index_rec_t const *)b;
+    int cmp = strcmp(ra->name, rb->name);
+    return cmp ? cmp : rb->seq - ra->seq;
+}
+
+PRIVATE herr_t
+index_entry(hid_t grp, char const *name, H5L_info_t const *lb, void *_ctx)
+{
+    index_entry_t       *ctx = (index_entry_t*)_ctx;
+    db_hdf5_index_t     *idx = ctx->idx;
+    int                 objtype = DB_INVALID_OBJECT, islink = 0;
+    int                 lo = 0, hi = idx->n - 1;
+    size_t              need;
+
+    if (!strcmp(name, "..")) return 0;
+
+    /* Find the latest recorded type of this entry, if any */
+    while (lo <= hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(name, ctx->recs[mid].name);
+        if (cmp <= 0) hi = mid - 1;
+        else lo = mid + 1;
+    }
+    if (lo < idx->n && !strcmp(name, ctx->recs[lo].name))
+        objtype = idx->types[ctx->recs[lo].seq];
+
+    if (objtype == DB_INVALID_OBJECT)
+    {
+        if (db_hdf5_probe_type(grp, name, lb, &objtype, &islink)<0) return -1;
     }
-    else if (names && nvals) {
-        int n = (*nvals)++;
-        *names = (char **)realloc(*names, *nvals*sizeof(char*));
-        (*names)[n] = STRDUP(name);
+    else
+    {
+        islink = lb->type != H5L_TYPE_HARD && objtype != DB_VARIABLE;
     }
-#endif
-    if (names && nvals) {
-        int n1 = (*nvals)++;
-        *names = (char **)realloc(*names, *nvals*sizeof(char*));
-        (*names)[n1] = STRDUP(name);
-        if (islink) {
-            char target[2*256];
-            int n2 = toc->nsymlink++;
-            toc->symlink_names = (char **) realloc(toc->symlink_names, (n2+1)*sizeof(char*));
-            toc->symlink_names[n2] = (*names)[n1]; /* note: copy of the pointer */
-            toc->symlink_target_names = (char **) realloc(toc->symlink_target_names, (n2+1)*sizeof(char*));
-            if (db_hdf5_getslink(grp, name, target) == 0)
-                toc->symlink_target_names[n2] = STRDUP(target);
-            else
-                toc->symlink_target_names[n2] = STRDUP("unknown");
-        }
+
+    need = strlen(name) + 64;
+    if (ctx->len + need > ctx->size)
+    {
+        ctx->size = 2 * (ctx->len + need);
+        ctx->buf = (char *) realloc(ctx->buf, ctx->size);
     }
+    ctx->len += sprintf(ctx->buf + ctx->len, "%d %d %llx %s", objtype, islink,
+                        db_hdf5_index_target(lb), name) + 1;
 
     return 0;
 }
 
+/*-------------------------------------------------------------------------
+ * Function:    db_hdf5_index_write
+ *
+ * Purpose:     Write the index of the dirty directory IDX.
+ *
+ * Return:      Success:        0
+ *
+ *              Failure:        -1
+ *-------------------------------------------------------------------------
+ */
+PRIVATE int
+db_hdf5_index_write(DBfile_hdf5 *dbfile, db_hdf5_index_t *idx)
+{
+    index_entry_t       ctx;
+    hid_t               dset=-1, attr=-1, vattr=-1, space=-1;
+    H5G_info_t          ginfo;
+    hsize_t             size;
+    char                dsname[64];
+    int                 i, nlinks, version = DB_HDF5_INDEX_VERSION, retval = -1;
+
+    memset(&ctx, 0, sizeof ctx);
+    ctx.idx = idx;
+    ctx.recs = ALLOC_N(index_rec_t, idx->n ? idx->n : 1);
+    for (i = 0; i < idx->n; i++)
+    {
+        ctx.recs[i].name = idx->names[i];
+        ctx.recs[i].seq = i;
+    }
+    qsort(ctx.recs, idx->n, sizeof(index_rec_t), index_rec_cmp);
+
+    db_hdf5_index_dsname(idx->objno, dsname);
+
+    H5E_BEGIN_TRY {
+        if (H5Gget_info(idx->grp, &ginfo)<0 ||
+            H5Literate(idx->grp, H5_INDEX_NAME, H5_ITER_INC, NULL, index_entry, &ctx)<0)
+            goto done;
+
+        /* Terminating empty record, so the dataset is never empty */
+        ctx.buf = (char *) realloc(ctx.buf, ctx.len + 1);
+        ctx.buf[ctx.len++] = '\0';
+
+        H5Ldelete(dbfile->link, dsname, H5P_DEFAULT);
+        size = ctx.len;
+        nlinks = (int) ginfo.nlinks;
+        if ((space=H5Screate_simple(1, &size, NULL))<0 ||
+            (dset=H5Dcreate(dbfile->link, dsname, H5T_NATIVE_CHAR, space,
+                            H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT))<0 ||
+            H5Dwrite(dset, H5T_NATIVE_CHAR, H5S_ALL, H5S_ALL, H5P_DEFAULT, ctx.buf)<0 ||
+            (attr=H5Acreate(dset, "nlinks", dbfile->T_int, SCALAR,
+                            H5P_DEFAULT, H5P_DEFAULT))<0 ||
+            H5Awrite(attr, H5T_NATIVE_INT, &nlinks)<0 ||
+            (vattr=H5Acreate(dset, "version", dbfile->T_int, SCALAR,
+                             H5P_DEFAULT, H5P_DEFAULT))<0 ||
+            H5Awrite(vattr, H5T_NATIVE_INT, &version)<0)
+        {
+            /* Don't leave a partial index behind */
+            H5Ldelete(dbfile->link, dsname, H5P_DEFAULT);
+            goto done;
+        }
+        idx->dirty = FALSE;
+        retval = 0;
+
+done:
+        H5Aclose(vattr);
+        H5Aclose(attr);
+        H5Dclose(dset);
+        H5Sclose(space);
+    } H5E_END_TRY;
+
+    FREE(ctx.recs);
+    FREE(ctx.buf);
+    return retval;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    db_hdf5_index_flush
+ *
+ * Purpose:     Write the indices of all directories written to since they
+ *              were last written. If RELEASE is set, also forget all
+ *              index state; the file is about to be closed.
+ *-------------------------------------------------------------------------
+ */
+PRIVATE void
+db_hdf5_index_flush(DBfile_hdf5 *dbfile, int release)
+{
+    int i;
+
+    for (i = 0; i < dbfile->ndirty_index; i++)
+    {
+        if (dbfile->dirty_index[i]->dirty)
+            db_hdf5_index_write(dbfile, dbfile->dirty_index[i]);
+        if (release)
+            db_hdf5_index_free(dbfile->dirty_index[i]);
+    }
+    if (release)
+    {
+        FREE(dbfile->dirty_index);
+        dbfile->ndirty_index = 0;
+        db_hdf5_index_release_cwg(dbfile);
+    }
+}
+
 /*-------------------------------------------------------------------------
  * Function:    find_objno
  *
@@ -4259,6 +5494,7 @@ db_hdf5_handle_ctdt(DBfile_hdf5 *dbfile, int ts, float t, int dts, double dt, in
             dset = H5Dcreate(dbfile->cwg, names[i], ftype, space, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
             H5Dwrite(dset, mtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, buf[i]);
             H5Dclose(dset);
+            db_hdf5_index_note(dbfile, names[i], DB_VARIABLE);
         }
 
         if (space != -1)
@@ -4272,13 +5508,13 @@ db_hdf5_handle_ctdt(DBfile_hdf5 *dbfile, int ts, float t, int dts, double dt, in
  * Function:    db_hdf5_compname
  *
  * Purpose:     Returns a new name relative to the link directory. The name
- *              is generated by reading the `nlinks' attribute of the link
- *              directory, incrementing it, creating a file name, and saving
- *              it back to the file.
+ *              is generated by incrementing a count of names handed out
+ *              and creating a file name from it. The count is kept in the
+ *              `nlinks' attribute of the link directory.
  *
- * Return:      Success:        0, A new link name not more than 8 characters
- *                              long counting the null terminator is returned
- *                              through the NAME argument.
+ * Return:      Success:        0, A new link name not more than 12
+ *                              characters long counting the null terminator
+ *                              is returned through the NAME argument.
  *
  *              Failure:        -1
  *
@@ -4287,17 +5523,82 @@ db_hdf5_handle_ctdt(DBfile_hdf5 *dbfile, int ts, float t, int dts, double dt, in
  *
  * Modifications:
  *
+ *   The count is read from the file once and kept in the DBfile_hdf5 until
+ *   db_hdf5_nlinks_flush writes it back rather than being read and written
+ *   for every name. Names beyond #999999 get more digits. Names already
+ *   in the link directory are skipped.
  *-------------------------------------------------------------------------
  */
 PRIVATE int
-db_hdf5_compname(DBfile_hdf5 *dbfile, char name[8]/*out*/)
+db_hdf5_compname(DBfile_hdf5 *dbfile, char name[12]/*out*/)
 {
     static char *me = "db_hdf5_compname";
     hid_t       attr=-1;
-    int         nlinks;
 
     PROTECT {
-        /* Open or create the `nlinks' attribute of the link group */
+        /* Read the `nlinks' attribute of the link group, if any, once */
+        if (!dbfile->nlinks_read) {
+            dbfile->nlinks = 0;
+            H5E_BEGIN_TRY {
+                attr = H5Aopen_name(dbfile->link, "nlinks");
+            } H5E_END_TRY;
+            if (attr>=0) {
+                if (H5Aread(attr, H5T_NATIVE_INT, &dbfile->nlinks)<0) {
+                    db_perror("nlinks attribute", E_CALLFAIL, me);
+                    UNWIND();
+                }
+                H5Aclose(attr);
+                attr = -1;
+            }
+            dbfile->nlinks_read = TRUE;
+        }
+
+        /*
+         * Create a name. Another handle open on the same file keeps its own
+         * count and may already have used it, so skip names that exist.
+         */
+        do {
+            if (dbfile->nlinks == INT_MAX) {
+                db_perror("exceeded maximum number of nlinks", E_CALLFAIL, me);
+                UNWIND();
+            }
+            dbfile->nlinks++;
+            dbfile->nlinks_dirty = TRUE;
+            snprintf(name, 12, "#%06u", (unsigned) dbfile->nlinks);
+        } while (H5Lexists(dbfile->link, name, H5P_DEFAULT) > 0);
+        
+    } CLEANUP {
+        H5E_BEGIN_TRY {
+            H5Aclose(attr);
+        } H5E_END_TRY;
+    } END_PROTECT;
+
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    db_hdf5_nlinks_flush
+ *
+ * Purpose:     Writes the count of names handed out by db_hdf5_compname
+ *              back to the `nlinks' attribute of the link directory if it
+ *              has changed since it was last written.
+ *
+ * Return:      Success:        0
+ *
+ *              Failure:        -1
+ *-------------------------------------------------------------------------
+ */
+PRIVATE int
+db_hdf5_nlinks_flush(DBfile_hdf5 *dbfile)
+{
+    static char *me = "db_hdf5_nlinks_flush";
+    hid_t       attr=-1;
+    int         ondisk=0;
+
+    if (!dbfile->nlinks_dirty || dbfile->link < 0)
+        return 0;
+
+    PROTECT {
         H5E_BEGIN_TRY {
             attr = H5Aopen_name(dbfile->link, "nlinks");
         } H5E_END_TRY;
@@ -4307,27 +5608,15 @@ db_hdf5_compname(DBfile_hdf5 *dbfile, char name[8]/*out*/)
             UNWIND();
         }
 
-        /* Increment the nlinks value */
-        if (H5Aread(attr, H5T_NATIVE_INT, &nlinks)<0) {
-            db_perror("nlinks attribute", E_CALLFAIL, me);
-            UNWIND();
-        }
-
-        nlinks++;
-        if (nlinks > 999999) {
-            db_perror("exceeded maximum number of nlinks", E_CALLFAIL, me);
-            UNWIND();
-        }
-
-        if (H5Awrite(attr, H5T_NATIVE_INT, &nlinks)<0) {
+        /* Never lower a count another handle on this file wrote */
+        if (H5Aread(attr, H5T_NATIVE_INT, &ondisk)>=0 && ondisk>dbfile->nlinks)
+            dbfile->nlinks = ondisk;
+        if (H5Awrite(attr, H5T_NATIVE_INT, &dbfile->nlinks)<0) {
             db_perror("nlinks attribute", E_CALLFAIL, me);
             UNWIND();
         }
         H5Aclose(attr);
-
-        /* Create a name */
-        sprintf(name, "#%06d", nlinks);
-        
+        dbfile->nlinks_dirty = FALSE;
     } CLEANUP {
         H5E_BEGIN_TRY {
             H5Aclose(attr);
@@ -4429,7 +5718,7 @@ db_hdf5_compwrz(DBfile_hdf5 *dbfile, int dtype, int rank, int const _size[],
             UNWIND();
         }
  
-        if (db_hdf5_set_properties((DBfile*) dbfile, rank, size) < 0 ) {
+        if (db_hdf5_set_properties((DBfile*) dbfile, rank, size, ftype) < 0 ) {
             db_perror("db_hdf5_set_properties", E_CALLFAIL, me);
             UNWIND();
         }
@@ -4446,15 +5735,16 @@ db_hdf5_compwrz(DBfile_hdf5 *dbfile, int dtype, int rank, int const _size[],
         {
             if (fname)
             {
-                if ((dset=H5Dcreate(dbfile->cwg, fname, ftype, space, H5P_DEFAULT, P_crprops, H5P_DEFAULT))<0) {
+                if ((dset=H5Dcreate(dbfile->cwg, fname, ftype, space, H5P_DEFAULT, dbfile->crprops, H5P_DEFAULT))<0) {
                     db_perror(name, E_CALLFAIL, me);
                     UNWIND();
                 }
+                db_hdf5_index_note(dbfile, fname, DB_VARIABLE);
                 strcpy(name, fname);
             }
             else
             {
-                if ((dset=H5Dcreate(dbfile->link, name, ftype, space, H5P_DEFAULT, P_crprops, H5P_DEFAULT))<0) {
+                if ((dset=H5Dcreate(dbfile->link, name, ftype, space, H5P_DEFAULT, dbfile->crprops, H5P_DEFAULT))<0) {
                     db_perror(name, E_CALLFAIL, me);
                     UNWIND();
                 }
@@ -4462,15 +5752,18 @@ db_hdf5_compwrz(DBfile_hdf5 *dbfile, int dtype, int rank, int const _size[],
         }
         else
         {
-            if ((dset=H5Dcreate(dbfile->link, name, ftype, space, H5P_DEFAULT, P_crprops, H5P_DEFAULT))<0) {
+            if ((dset=H5Dcreate(dbfile->link, name, ftype, space, H5P_DEFAULT, dbfile->crprops, H5P_DEFAULT))<0) {
                 db_perror(name, E_CALLFAIL, me);
                 UNWIND();
             }
             if (fname && DBGetFriendlyHDF5NamesFile((DBfile*)dbfile) == 1)
+            {
                 H5Glink(dbfile->cwg, H5G_LINK_SOFT, name, fname);
+                db_hdf5_index_note(dbfile, fname, DB_VARIABLE);
+            }
         }
 
-        if (buf && H5Dwrite(dset, mtype, space, space, H5P_DEFAULT, buf)<0) {
+        if (buf && db_hdf5_write_filtered((DBfile*)dbfile, dset, mtype, space, buf)<0) {
             hdf5_to_silo_error(name, "db_hdf5_compwrz");
             UNWIND();
         }
@@ -4483,15 +5776,15 @@ db_hdf5_compwrz(DBfile_hdf5 *dbfile, int dtype, int rank, int const _size[],
         if (DBGetCompressionFile((DBfile*)dbfile) && compressionFlags)
         {
             int i;
-            for (i=0; i<H5Pget_nfilters(P_crprops); i++)
+            for (i=0; i<H5Pget_nfilters(dbfile->crprops); i++)
             {
 #if defined H5_USE_16_API || (H5_VERS_MAJOR == 1 && H5_VERS_MINOR < 8)
-                if (H5Pget_filter(P_crprops,(unsigned)i,0,0,0,0,0) == DB_HDF5_HZIP_ID)
+                if (H5Pget_filter(dbfile->crprops,(unsigned)i,0,0,0,0,0) == DB_HDF5_HZIP_ID)
 #else
-                if (H5Pget_filter(P_crprops,(unsigned)i,0,0,0,0,0,NULL) == DB_HDF5_HZIP_ID)
+                if (H5Pget_filter(dbfile->crprops,(unsigned)i,0,0,0,0,0,NULL) == DB_HDF5_HZIP_ID)
 #endif
                 {
-                    H5Premove_filter(P_crprops, DB_HDF5_HZIP_ID);
+                    H5Premove_filter(dbfile->crprops, DB_HDF5_HZIP_ID);
                     break;
                 }
             }
@@ -4582,11 +5875,14 @@ db_hdf5_compckz(DBfile_hdf5 *dbfile, char *name)
 }
 
 /*-------------------------------------------------------------------------
- * Function:    db_hdf5_comprd
+ * Function:    db_hdf5_comprd_into
  *
- * Purpose:     Reads a dataset from the file into memory.
+ * Purpose:     Reads a dataset from the file into memory. If member is
+ *              non-NULL and the DBGet*Into call in progress supplies a
+ *              buffer for it, the data is read into that buffer instead.
  *
- * Return:      Success:        Pointer to dataset values.
+ * Return:      Success:        Pointer to dataset values or NULL if they
+ *                              were read into a caller supplied buffer.
  *
  *              Failure:        NULL
  *
@@ -4597,15 +5893,20 @@ db_hdf5_compckz(DBfile_hdf5 *dbfile, char *name)
  *              Robb Matzke, 1999-10-13
  *              Uses the current working directory instead of the root
  *              directory.
+ *
+ *              Forced single precision conversion of integral types is
+ *              now done by H5Dread so data goes straight from the file
+ *              to its destination buffer.
  *-------------------------------------------------------------------------
  */
 PRIVATE void *
-db_hdf5_comprd(DBfile_hdf5 *dbfile, char *name, int ignore_force_single)
+db_hdf5_comprd_into(DBfile_hdf5 *dbfile, char *name, int ignore_force_single,
+    char const *member, int idx)
 {
-    static char *me = "db_hdf5_comprd";
-    void        *buf = NULL;
+    static char *me = "db_hdf5_comprd_into";
+    void        *buf = NULL, *userbuf = NULL;
     hid_t       d=-1, fspace=-1, ftype=-1, mtype=-1;
-    int         i, nelmts;
+    int         i, nelmts, tofloat;
     void       *retval = NULL;
     
     PROTECT {
@@ -4623,24 +5924,32 @@ db_hdf5_comprd(DBfile_hdf5 *dbfile, char *name, int ignore_force_single)
             /* Choose a memory type based on the file type */
             mtype = hdf2hdf_type(ftype);
 
-            /* if we decided on a memory type of double but
-             * we are forcing single precision, then select
-             * a memory type of float */
-            if (mtype == H5T_NATIVE_DOUBLE &&
-                force_single_g && !ignore_force_single)
+            /* If we are forcing single precision, let HDF5 convert
+             * everything but chars to float as it reads. Chars are
+             * converted below to keep their historical (signed)
+             * interpretation. */
+            tofloat = force_single_g && !ignore_force_single &&
+                      mtype != H5T_NATIVE_FLOAT;
+            if (tofloat && mtype != H5T_NATIVE_UCHAR)
+            {
                 mtype = H5T_NATIVE_FLOAT;
+                tofloat = 0;
+            }
+
+            /* See if the caller wants this one read into its own memory */
+            if (member)
+                userbuf = db_GetReadBuffer((DBfile*)dbfile, member, idx,
+                    tofloat ? DB_FLOAT : hdf2silo_type(mtype), nelmts);
 
             /* Read the data */
-            if (NULL==(buf=malloc(nelmts*H5Tget_size(mtype)))) {
+            if (userbuf && !tofloat)
+                buf = userbuf;
+            else if (NULL==(buf=malloc(nelmts*H5Tget_size(mtype)))) {
                 db_perror(name, E_NOMEM, me);
                 UNWIND();
             }
 
-            P_rdprops = H5P_DEFAULT;
-            if (!DBGetEnableChecksumsFile((DBfile*)dbfile))
-                P_rdprops = P_ckrdprops;
-
-            if (H5Dread(d, mtype, H5S_ALL, H5S_ALL, P_rdprops, buf)<0) {
+            if (H5Dread(d, mtype, H5S_ALL, H5S_ALL, DB_HDF5_RDPROPS((DBfile*)dbfile), buf)<0) {
                 hdf5_to_silo_error(name, me);
                 UNWIND();
             }
@@ -4651,60 +5960,28 @@ db_hdf5_comprd(DBfile_hdf5 *dbfile, char *name, int ignore_force_single)
             H5Sclose(fspace);
 
             /* Setup return value */
-            retval = buf;
+            retval = buf == userbuf ? NULL : buf;
             
-            /* Convert to float if necessary */
-            /* With newer versions of HDF5, this could have been done
-             * automatically in the H5Dread call, above by selecting
-             * the appropriate memory type. However, the current version
-             * of HDF5 does not support conversion from integral types
-             * to float (or double) */
-            if (force_single_g && !ignore_force_single &&
-                mtype != H5T_NATIVE_FLOAT)
+            /* Convert chars to float if necessary */
+            if (tofloat)
             {
-                float *newbuf;
+                float *newbuf = (float *) userbuf;
+                char *cbuf = (char *) buf;
 
                 /* allocate a new buffer */
-                if (NULL==(newbuf=(float*)malloc(nelmts*sizeof(float)))) {
+                if (!newbuf &&
+                    NULL==(newbuf=(float*)malloc(nelmts*sizeof(float)))) {
                     db_perror(name, E_NOMEM, me);
                     UNWIND();
                 }
 
                 /* do the conversion */
-                if      (mtype == H5T_NATIVE_UCHAR)
-                {
-                    char *cbuf = (char *) buf;
-                    for (i = 0; i < nelmts; i++)
-                        newbuf[i] = (float)(cbuf[i]);
-                }
-                else if (mtype == H5T_NATIVE_SHORT)
-                {
-                    short *sbuf = (short *) buf;
-                    for (i = 0; i < nelmts; i++)
-                        newbuf[i] = (float)(sbuf[i]);
-                }
-                else if (mtype == H5T_NATIVE_INT)
-                {
-                    int *ibuf = (int *) buf;
-                    for (i = 0; i < nelmts; i++)
-                        newbuf[i] = (float)(ibuf[i]);
-                }
-                else if (mtype == H5T_NATIVE_LONG)
-                {
-                    long *lbuf = (long *) buf;
-                    for (i = 0; i < nelmts; i++)
-                        newbuf[i] = (float)(lbuf[i]);
-                }
-                else if (mtype == H5T_NATIVE_LLONG)
-                {
-                    long long *lbuf = (long long *) buf;
-                    for (i = 0; i < nelmts; i++)
-                        newbuf[i] = (float)(lbuf[i]);
-                }
+                for (i = 0; i < nelmts; i++)
+                    newbuf[i] = (float)(cbuf[i]);
 
                 /* Free old buffer and setup return value */
                 free(buf);
-                retval = newbuf;
+                retval = userbuf ? NULL : newbuf;
             }
         }
     } CLEANUP {
@@ -4713,12 +5990,29 @@ db_hdf5_comprd(DBfile_hdf5 *dbfile, char *name, int ignore_force_single)
             H5Tclose(ftype);
             H5Sclose(fspace);
         } H5E_END_TRY;
-        FREE(buf);
+        if (buf != userbuf)
+            FREE(buf);
     } END_PROTECT;
 
     return retval;
 }
 
+/*-------------------------------------------------------------------------
+ * Function:    db_hdf5_comprd
+ *
+ * Purpose:     Reads a dataset from the file into newly allocated memory.
+ *
+ * Return:      Success:        Pointer to dataset values.
+ *
+ *              Failure:        NULL
+ *-------------------------------------------------------------------------
+ */
+PRIVATE void *
+db_hdf5_comprd(DBfile_hdf5 *dbfile, char *name, int ignore_force_single)
+{
+    return db_hdf5_comprd_into(dbfile, name, ignore_force_single, NULL, 0);
+}
+
 /*-------------------------------------------------------------------------
  * Function:    db_hdf5_fullname
  *
@@ -4905,6 +6199,7 @@ db_hdf5_hdrwr(DBfile_hdf5 *dbfile, char *name, hid_t mtype, hid_t ftype,
         }
         H5Aclose(attr);
         H5Tclose(obj);
+        db_hdf5_index_note(dbfile, name, _objtype);
 
     } CLEANUP {
         H5E_BEGIN_TRY {
@@ -5201,6 +6496,9 @@ db_hdf5_process_file_options(int opts_set_id, int mode, hid_t *fcpl)
                     int block_count = H5FD_SILO_DEFAULT_BLOCK_COUNT; 
                     int log_stats = H5FD_SILO_DEFAULT_LOG_STATS;
                     int use_direct = H5FD_SILO_DEFAULT_USE_DIRECT;
+                    int write_behind = H5FD_SILO_DEFAULT_WRITE_BEHIND;
+                    int read_ahead = H5FD_SILO_DEFAULT_READ_AHEAD;
+                    int meta_at_end = H5FD_SILO_DEFAULT_META_AT_END;
 
                     if ((p = DBGetOption(opts, DBOPT_H5_SILO_BLOCK_SIZE)))
                         block_size = (hsize_t) (*((int*) p));
@@ -5210,11 +6508,20 @@ db_hdf5_process_file_options(int opts_set_id, int mode, hid_t *fcpl)
                         log_stats = *((int*) p);
                     if ((p = DBGetOption(opts, DBOPT_H5_SILO_USE_DIRECT)))
                         use_direct = *((int*) p);
+                    if ((p = DBGetOption(opts, DBOPT_H5_SILO_WRITE_BEHIND)))
+                        write_behind = *((int*) p);
+                    if ((p = DBGetOption(opts, DBOPT_H5_SILO_READ_AHEAD)))
+                        read_ahead = *((int*) p);
+                    if ((p = DBGetOption(opts, DBOPT_H5_SILO_META_AT_END)))
+                        meta_at_end = *((int*) p);
 
                     h5status |= H5Pset_fapl_silo(retval);
                     h5status |= H5Pset_silo_block_size_and_count(retval, block_size, block_count);
                     h5status |= H5Pset_silo_log_stats(retval, log_stats);
                     h5status |= H5Pset_silo_use_direct(retval, use_direct);
+                    h5status |= H5Pset_silo_write_behind(retval, write_behind);
+                    h5status |= H5Pset_silo_read_ahead(retval, read_ahead);
+                    h5status |= H5Pset_silo_meta_at_end(retval, meta_at_end);
 #else
                     H5Pclose(retval);
                     return db_perror("Silo block VFD >= HDF5 1.8.4", E_NOTENABLEDINBUILD, me);
@@ -5806,6 +7113,10 @@ db_hdf5_initiate_close(DBfile *_dbfile)
         free(dbfile->cwg_name);
     dbfile->cwg_name = NULL;
 
+    if (dbfile->ckcrprops > 0)
+        H5Pclose(dbfile->ckcrprops);
+    dbfile->ckcrprops = -1;
+
     /* Check for any open objects in this file */
 #if HDF5_VERSION_GE(1,6,0)
     if (SILO_Globals._db_err_level_drvr == DB_ALL)
@@ -5919,6 +7230,14 @@ db_hdf5_Open(char const *name, int mode, int opts_set_id)
 #warning QUERY FILE IMAGE STUFF HERE TO GET UDATA PTR
 #endif
 
+#if HDF5_VERSION_GE(1,8,7)
+    /* "file:path" symlinks are external links. Have HDF5 keep the files
+       they lead to open, instead of reopening them on every traversal,
+       until this file is closed. */
+    if (faprops >= 0 && hmode == H5F_ACC_RDONLY && SILO_Globals.maxCachedFiles > 0)
+        H5Pset_elink_file_cache_size(faprops, (unsigned) SILO_Globals.maxCachedFiles);
+#endif
+
     /* Open existing hdf5 file */
     if ((fid=H5Fopen(name, hmode, faprops))<0) {
         H5Pclose(faprops);
@@ -6072,6 +7391,10 @@ db_hdf5_Create(char const *name, int mode, int target, int opts_set_id, char con
  *   Mark C. Miller, Tue Feb  3 09:52:51 PST 2009
  *   Moved code to free pub.GrabId and set Grab related entries to zero to
  *   silo_db_close() function and then added a call to that function here.
+ *
+ *   Writes the object indices of directories written to.
+ *
+ *   Writes back the count of component names handed out.
  *-------------------------------------------------------------------------
  */
 SILO_CALLBACK int
@@ -6086,6 +7409,8 @@ db_hdf5_Close(DBfile *_dbfile)
         PROTECT {
 
             FreeNodelists(dbfile, 0);
+            db_hdf5_index_flush(dbfile, TRUE);
+            db_hdf5_nlinks_flush(dbfile);
 
             /* Free the private parts of the file */
             if (db_hdf5_initiate_close((DBfile*)dbfile)<0 ||
@@ -6128,6 +7453,11 @@ db_hdf5_Close(DBfile *_dbfile)
  *              Failure:        -1
  *
  * Programmer: Mark C. Miller, Fri Aug 14 11:49:05 PDT 2015
+ *
+ * Modifications:
+ *
+ *   Writes the object indices of directories written to and the count of
+ *   component names handed out.
  *-------------------------------------------------------------------------
  */
 SILO_CALLBACK int
@@ -6141,6 +7471,8 @@ db_hdf5_Flush(DBfile *_dbfile)
         return retval;
 
     PROTECT {
+        db_hdf5_index_flush(dbfile, FALSE);
+        db_hdf5_nlinks_flush(dbfile);
         if (H5Fflush(dbfile->fid, H5F_SCOPE_LOCAL)>=0)
             retval = 0;
     } CLEANUP {
@@ -6149,6 +7481,147 @@ db_hdf5_Flush(DBfile *_dbfile)
     return retval;
 }
 
+/*-------------------------------------------------------------------------
+ * Function:    db_hdf5_lookup3
+ *
+ * Purpose:     Bob Jenkins' lookup3 hash (hashlittle, zero initval) which
+ *              is the checksum HDF5 uses for its metadata.
+ *
+ * Return:      The 32 bit checksum of the LEN bytes at KEY.
+ *-------------------------------------------------------------------------
+ */
+#if HDF5_VERSION_GE(1,10,0)
+#define DB_HDF5_ROT(X,K) (((X)<<(K)) | ((X)>>(32-(K))))
+PRIVATE unsigned int
+db_hdf5_lookup3(unsigned char const *k, size_t len)
+{
+    unsigned int a, b, c;
+    unsigned char t[12];
+
+    a = b = c = 0xdeadbeef + (unsigned int) len;
+    while (len > 12)
+    {
+        a += k[0] + ((unsigned int)k[1]<<8) + ((unsigned int)k[2]<<16) + ((unsigned int)k[3]<<24);
+        b += k[4] + ((unsigned int)k[5]<<8) + ((unsigned int)k[6]<<16) + ((unsigned int)k[7]<<24);
+        c += k[8] + ((unsigned int)k[9]<<8) + ((unsigned int)k[10]<<16) + ((unsigned int)k[11]<<24);
+        a -= c;  a ^= DB_HDF5_ROT(c, 4);  c += b;
+        b -= a;  b ^= DB_HDF5_ROT(a, 6);  a += c;
+        c -= b;  c ^= DB_HDF5_ROT(b, 8);  b += a;
+        a -= c;  a ^= DB_HDF5_ROT(c,16);  c += b;
+        b -= a;  b ^= DB_HDF5_ROT(a,19);  a += c;
+        c -= b;  c ^= DB_HDF5_ROT(b, 4);  b += a;
+        len -= 12;
+        k += 12;
+    }
+    if (len == 0)
+        return c;
+
+    /* the last, partial block is zero padded */
+    memset(t, 0, sizeof(t));
+    memcpy(t, k, len);
+    a += t[0] + ((unsigned int)t[1]<<8) + ((unsigned int)t[2]<<16) + ((unsigned int)t[3]<<24);
+    b += t[4] + ((unsigned int)t[5]<<8) + ((unsigned int)t[6]<<16) + ((unsigned int)t[7]<<24);
+    c += t[8] + ((unsigned int)t[9]<<8) + ((unsigned int)t[10]<<16) + ((unsigned int)t[11]<<24);
+    c ^= b; c -= DB_HDF5_ROT(b,14);
+    a ^= c; a -= DB_HDF5_ROT(c,11);
+    b ^= a; b -= DB_HDF5_ROT(a,25);
+    c ^= b; c -= DB_HDF5_ROT(b,16);
+    a ^= c; a -= DB_HDF5_ROT(c, 4);
+    b ^= a; b -= DB_HDF5_ROT(a,14);
+    c ^= b; c -= DB_HDF5_ROT(b,24);
+    return c;
+}
+#undef DB_HDF5_ROT
+#endif
+
+/*-------------------------------------------------------------------------
+ * Function:    db_hdf5_GetFileImage
+ *
+ * Purpose:     Flushes an HDF5 file and returns a copy of its current
+ *              contents as a single malloc'd buffer. This is mostly useful
+ *              for files created in memory with the core or FIC VFDs so
+ *              that they can be shipped elsewhere and reopened with the
+ *              FIC VFD.
+ *
+ * Return:      Success:        0
+ *
+ *              Failure:        -1
+ *-------------------------------------------------------------------------
+ */
+SILO_CALLBACK int
+db_hdf5_GetFileImage(DBfile *_dbfile, void **buf, size_t *size)
+{
+    int retval = -1;
+    DBfile_hdf5    *dbfile = (DBfile_hdf5*)_dbfile;
+    static char *me = "db_hdf5_GetFileImage";
+    void *image = 0;
+
+    if (!dbfile)
+        return retval;
+
+#if HDF5_VERSION_GE(1,8,9)
+    PROTECT {
+        ssize_t nbytes;
+
+        db_hdf5_index_flush(dbfile, FALSE);
+        db_hdf5_nlinks_flush(dbfile);
+        if (H5Fflush(dbfile->fid, H5F_SCOPE_LOCAL)<0)
+            UNWIND();
+        if ((nbytes = H5Fget_file_image(dbfile->fid, NULL, 0))<0)
+        {
+            db_perror("H5Fget_file_image", E_CALLFAIL, me);
+            UNWIND();
+        }
+        if (NULL == (image = malloc(nbytes>0?(size_t)nbytes:1)))
+        {
+            db_perror(NULL, E_NOMEM, me);
+            UNWIND();
+        }
+        if (H5Fget_file_image(dbfile->fid, image, (size_t)nbytes)<0)
+        {
+            db_perror("H5Fget_file_image", E_CALLFAIL, me);
+            UNWIND();
+        }
+
+#if HDF5_VERSION_GE(1,10,0)
+        /* HDF5 1.10 and later clear the status flags of version 2 and 3
+           superblocks in the image. Some releases (1.10.8 among them) do
+           not update the superblock checksum, so the image fails to open.
+           Recompute it if, and only if, the stored one is wrong. The
+           checksum follows four file addresses. */
+        if (nbytes >= 12 && !memcmp(image, "\211HDF\r\n\032\n", 8) &&
+            (((unsigned char*)image)[8] == 2 || ((unsigned char*)image)[8] == 3))
+        {
+            unsigned char *sb = (unsigned char *) image;
+            size_t csoff = 12 + 4 * (size_t) sb[9];
+            if (csoff + 4 <= (size_t) nbytes)
+            {
+                unsigned int cs = db_hdf5_lookup3(sb, csoff);
+                unsigned int old = sb[csoff] | ((unsigned int)sb[csoff+1]<<8) |
+                    ((unsigned int)sb[csoff+2]<<16) | ((unsigned int)sb[csoff+3]<<24);
+                if (cs != old)
+                {
+                    sb[csoff+0] = (unsigned char) (cs & 0xff);
+                    sb[csoff+1] = (unsigned char) ((cs >> 8) & 0xff);
+                    sb[csoff+2] = (unsigned char) ((cs >> 16) & 0xff);
+                    sb[csoff+3] = (unsigned char) ((cs >> 24) & 0xff);
+                }
+            }
+        }
+#endif
+        *buf = image;
+        *size = (size_t) nbytes;
+        retval = 0;
+    } CLEANUP {
+        FREE(image);
+    } END_PROTECT;
+#else
+    db_perror("DBGetFileImage >= HDF5 1.8.9", E_NOTENABLEDINBUILD, me);
+#endif
+
+    return retval;
+}
+
 /*-------------------------------------------------------------------------
  * Function:    db_hdf5_Filters
  *
@@ -6224,6 +7697,7 @@ db_hdf5_MkDir(DBfile *_dbfile, char const *name)
             db_perror(dotdot, E_CALLFAIL, me);
             UNWIND();
         }
+        db_hdf5_index_note(dbfile, name, DB_DIR);
 
         /* Close everything */
         H5Gclose(grp);
@@ -6278,6 +7752,7 @@ db_hdf5_SetDir(DBfile *_dbfile, char const *name)
 
         H5Gclose(dbfile->cwg);
         dbfile->cwg = newdir;
+        db_hdf5_index_release_cwg(dbfile);
 
         if (dbfile->cwg_name) {
             char *new_cwg_name = db_absoluteOf_path(dbfile->cwg_name?dbfile->cwg_name:"/", name);
@@ -6476,12 +7951,14 @@ copy_obj(hid_t hobj, char const *name, void *op_data)
 
     case H5G_TYPE:
     {
-        hid_t       o=-1, attr=-1, atype=-1, s1024=-1;
+        hid_t       o=-1, attr=-1, atype=-1, s1024=-1, ftype=-1;
         char        *file_value=NULL, *mem_value=NULL, *bkg=NULL;
+        char        *new_value=NULL, *new_bkg=NULL;
+        char        (*cnames)[12]=NULL;
         DBObjectType objtype;
         int         _objtype, nmembs, i;
         DBobject    *obj=NULL;
-        size_t      asize, nelmts, msize;
+        size_t      asize, nelmts, msize, fsize, need, offset;
 
         /* Open the object as a named data type */
         if ((o=H5Topen(hobj, name, H5P_DEFAULT))<0) {
@@ -6524,6 +8001,10 @@ copy_obj(hid_t hobj, char const *name, void *op_data)
             UNWIND();
         }
         nmembs = H5Tget_nmembers(atype);
+        if (NULL==(cnames=(char (*)[12])calloc(nmembs?nmembs:1, sizeof(*cnames)))) {
+            db_perror(name, E_NOMEM, me);
+            UNWIND();
+        }
 
         s1024 = H5Tcopy(H5T_C_S1);
         H5Tset_size(s1024, 1024);
@@ -6536,7 +8017,6 @@ copy_obj(hid_t hobj, char const *name, void *op_data)
                 /* build up an in-memory rep that is akin to a struct
                  * with just this one member */
                 char *memname = H5Tget_member_name(atype, i);
-                size_t offset = H5Tget_member_offset(atype, i);
                 hid_t mtype = H5Tcreate(H5T_COMPOUND, msize);
                 for (nelmts=1, j=0; j<ndims; j++) nelmts *= memb_size[j];
                 db_hdf5_put_cmemb(mtype, memname, 0, ndims, memb_size, s1024);
@@ -6551,14 +8031,10 @@ copy_obj(hid_t hobj, char const *name, void *op_data)
                 if (strncmp(mem_value, "/.silo/#", 8) == 0)
                 {
                     /* get unique name for this dataset in dst file */
-                    char cname[8];
-                    db_hdf5_compname(dstfile, cname);
+                    db_hdf5_compname(dstfile, cnames[i]);
 
                     /* copy this dataset to /.silo dir in dst file */
-                    H5Ocopy(hobj, mem_value, dstfile->link, cname, H5P_DEFAULT, H5P_DEFAULT);
-
-                    /* update this attribute's entry with name for this dataset */
-                    sprintf(file_value+offset, "%s%s", LINKGRP, cname);
+                    H5Ocopy(hobj, mem_value, dstfile->link, cnames[i], H5P_DEFAULT, H5P_DEFAULT);
                 }
                 else
                 {
@@ -6587,10 +8063,54 @@ copy_obj(hid_t hobj, char const *name, void *op_data)
             H5Tclose(member_type);
         }
 
+        /*
+         * The names in the dst file can be longer than the ones they
+         * replace, e.g. #1000000 for #000001, so build a type whose string
+         * members fit them and convert the header to it before storing them.
+         */
+        for (i=0, fsize=0; i<nmembs; i++) {
+            hid_t member_type = H5Tget_member_type(atype, i);
+            need = *cnames[i] ? strlen(LINKGRP)+strlen(cnames[i])+1 : 0;
+            fsize += MAX(H5Tget_size(member_type), need);
+            H5Tclose(member_type);
+        }
+        if ((ftype=H5Tcreate(H5T_COMPOUND, fsize))<0) {
+            db_perror(name, E_CALLFAIL, me);
+            UNWIND();
+        }
+        for (i=0, offset=0; i<nmembs; i++) {
+            char *memname = H5Tget_member_name(atype, i);
+            hid_t member_type = H5Tget_member_type(atype, i);
+            hid_t ntype = H5Tcopy(member_type);
+            need = *cnames[i] ? strlen(LINKGRP)+strlen(cnames[i])+1 : 0;
+            if (need > H5Tget_size(ntype)) H5Tset_size(ntype, need);
+            H5Tinsert(ftype, memname, offset, ntype);
+            offset += H5Tget_size(ntype);
+            H5Tclose(ntype);
+            H5Tclose(member_type);
+            free(memname);
+        }
+        if (NULL==(new_value=(char *)calloc(MAX(asize, fsize), 1)) ||
+            NULL==(new_bkg=(char *)calloc(fsize, 1))) {
+            db_perror(name, E_NOMEM, me);
+            UNWIND();
+        }
+        memcpy(new_value, file_value, asize);
+        if (H5Tconvert(atype, ftype, 1, new_value, new_bkg, H5P_DEFAULT)<0) {
+            db_perror(name, E_CALLFAIL, me);
+            UNWIND();
+        }
+        for (i=0; i<nmembs; i++) {
+            if (!*cnames[i]) continue;
+            offset = H5Tget_member_offset(ftype, i);
+            sprintf(new_value+offset, "%s%s", LINKGRP, cnames[i]);
+        }
+
         /* write the header for this silo object */
-        db_hdf5_hdrwr(dstfile, (char *)dstName, atype, atype, file_value, objtype);
+        db_hdf5_hdrwr(dstfile, (char *)dstName, ftype, ftype, new_value, objtype);
 
         /* Cleanup */
+        H5Tclose(ftype);
         H5Tclose(atype);
         H5Tclose(s1024);
         H5Aclose(attr);
@@ -6598,12 +8118,16 @@ copy_obj(hid_t hobj, char const *name, void *op_data)
         free(file_value);
         free(mem_value);
         free(bkg);
+        free(new_value);
+        free(new_bkg);
+        free(cnames);
 
         break;
     }
 
     case H5G_DATASET:
-        H5Ocopy(hobj, name, dstfile->cwg, name, H5P_DEFAULT, H5P_DEFAULT);
+        if (H5Ocopy(hobj, name, dstfile->cwg, name, H5P_DEFAULT, H5P_DEFAULT)>=0)
+            db_hdf5_index_note(dstfile, name, DB_VARIABLE);
         break;
 
     default:
@@ -6798,6 +8322,7 @@ db_hdf5_MkSymlink(DBfile *_dbfile, char const *target, char const *link)
                 UNWIND();
             }
         }
+        db_hdf5_index_note(dbfile, link, DB_INVALID_OBJECT);
     } CLEANUP {
         FREE(tmp);
     } END_PROTECT;
@@ -6881,18 +8406,30 @@ db_hdf5_GetSymlink(DBfile *_dbfile, char const *in_candidate_link, char *out_tar
  *
  * Modifications:
  *
+ *   Builds the table from the directory's object index when it has one.
  *-------------------------------------------------------------------------
  */
 SILO_CALLBACK int
 db_hdf5_NewToc(DBfile *_dbfile)
 {
     DBfile_hdf5 *dbfile = (DBfile_hdf5*)_dbfile;
-    DBtoc       *toc=NULL;
+    load_toc_t  ctx;
+    db_hdf5_index_t *idx;
+    int         i;
     
     db_FreeToc(_dbfile);
-    dbfile->pub.toc = toc = db_AllocToc();
+    dbfile->pub.toc = ctx.toc = db_AllocToc();
+    ctx.namesOnly = db_TocNamesOnly(_dbfile);
+
+    /* Use the object index if the directory has one */
+    if (!ctx.namesOnly && (idx = db_hdf5_index_cwg(dbfile)))
+    {
+        for (i = 0; i < idx->n; i++)
+            toc_add(ctx.toc, dbfile->cwg, idx->names[i], idx->types[i], idx->links[i]);
+        return 0;
+    }
 
-    if (H5Literate(dbfile->cwg, H5_INDEX_NAME, H5_ITER_INC, NULL, load_toc, toc)<0) return -1;
+    if (H5Literate(dbfile->cwg, H5_INDEX_NAME, H5_ITER_INC, NULL, load_toc, &ctx)<0) return -1;
 
     return 0;
 }
@@ -7714,6 +9251,8 @@ db_hdf5_WriteComponent(DBfile *_dbfile, DBobject *obj, char const *compname,
  *   I made it return true or false based on existence of named entity
  *   only and not that the entity also be a dataset.
  *
+ *   Answers from the object index of the current directory when the
+ *   name is in it.
  *-------------------------------------------------------------------------
  */
 SILO_CALLBACK int
@@ -7722,6 +9261,11 @@ db_hdf5_InqVarExists (DBfile *_dbfile, char const *varname)
    DBfile_hdf5  *dbfile = (DBfile_hdf5*)_dbfile;
    herr_t       status;
    H5G_stat_t   sb;
+   db_hdf5_index_t *idx;
+
+   if (!strchr(varname, '/') && (idx = db_hdf5_index_cwg(dbfile)) &&
+       db_hdf5_index_find(idx, varname) >= 0)
+       return TRUE;
 
    /* Check existence */
    H5E_BEGIN_TRY {
@@ -8053,12 +9597,8 @@ db_hdf5_GetVar(DBfile *_dbfile, char const *name)
                     UNWIND();
                 }
 
-                P_rdprops = H5P_DEFAULT;
-                if (!DBGetEnableChecksumsFile(_dbfile))
-                    P_rdprops = P_ckrdprops;
-
                 /* Read entire variable */
-                if (H5Dread(dset, mtype, H5S_ALL, H5S_ALL, P_rdprops, result)<0) {
+                if (H5Dread(dset, mtype, H5S_ALL, H5S_ALL, DB_HDF5_RDPROPS(_dbfile), result)<0) {
                     hdf5_to_silo_error(name, me);
                     UNWIND();
                 }
@@ -8131,12 +9671,8 @@ db_hdf5_ReadVar(DBfile *_dbfile, char const *vname, void *result)
                UNWIND();
            }
 
-           P_rdprops = H5P_DEFAULT;
-           if (!DBGetEnableChecksumsFile(_dbfile))
-               P_rdprops = P_ckrdprops;
-
            /* Read entire variable */
-           if (H5Dread(dset, mtype, H5S_ALL, H5S_ALL, P_rdprops, result)<0) {
+           if (H5Dread(dset, mtype, H5S_ALL, H5S_ALL, DB_HDF5_RDPROPS(_dbfile), result)<0) {
                hdf5_to_silo_error(vname, me);
                UNWIND();
            }
@@ -8221,12 +9757,8 @@ db_hdf5_ReadVarSlice(DBfile *_dbfile, char const *vname, int const *offset, int
            UNWIND();
        }
 
-       P_rdprops = H5P_DEFAULT;
-       if (!DBGetEnableChecksumsFile(_dbfile))
-           P_rdprops = P_ckrdprops;
-
        /* Read the data */
-       if (H5Dread(dset, mtype, mspace, fspace, P_rdprops, result)<0) {
+       if (H5Dread(dset, mtype, mspace, fspace, DB_HDF5_RDPROPS(_dbfile), result)<0) {
            hdf5_to_silo_error(vname, me);
            UNWIND();
        }
@@ -8321,10 +9853,6 @@ db_hdf5_ReadVarVals(DBfile *_dbfile, char const *vname, int mode,
        _nvals = (hsize_t) nvals;
        H5Sselect_hyperslab(mspace, H5S_SELECT_SET, &zero, &_dscount, &_nvals, 0);
 
-       P_rdprops = H5P_DEFAULT;
-       if (!DBGetEnableChecksumsFile(_dbfile))
-           P_rdprops = P_ckrdprops;
-
        /* allocate space for returned array of values */
        if (!*result)
        {
@@ -8347,7 +9875,7 @@ db_hdf5_ReadVarVals(DBfile *_dbfile, char const *vname, int mode,
            }
 
            /* Read the data */
-           if (H5Dread(dset, mtype, mspace, fspace, P_rdprops, p)<0) {
+           if (H5Dread(dset, mtype, mspace, fspace, DB_HDF5_RDPROPS(_dbfile), p)<0) {
                hdf5_to_silo_error(vname, me);
                UNWIND();
            }
@@ -8455,13 +9983,13 @@ db_hdf5_WriteCKZ(DBfile *_dbfile, char const *vname, void const *var,
 
            if (nofilters == 0)
            {
-               if (db_hdf5_set_properties(_dbfile, ndims, ds_size) < 0 ) {
+               if (db_hdf5_set_properties(_dbfile, ndims, ds_size, ftype) < 0 ) {
                    db_perror("db_hdf5_set_properties", E_CALLFAIL, me);
                    UNWIND();
                }
 
                /* Create dataset if it doesn't already exist */
-               if ((dset=H5Dcreate(dbfile->cwg, vname, ftype, space, H5P_DEFAULT, P_crprops, H5P_DEFAULT))<0) {
+               if ((dset=H5Dcreate(dbfile->cwg, vname, ftype, space, H5P_DEFAULT, dbfile->crprops, H5P_DEFAULT))<0) {
                    db_perror(vname, E_CALLFAIL, me);
                    UNWIND();
                }
@@ -8474,6 +10002,7 @@ db_hdf5_WriteCKZ(DBfile *_dbfile, char const *vname, void const *var,
                    UNWIND();
                }
            }
+           db_hdf5_index_note(dbfile, vname, DB_VARIABLE);
        }
        
 #if HDF5_VERSION_GE(1,8,0)
@@ -8498,7 +10027,8 @@ db_hdf5_WriteCKZ(DBfile *_dbfile, char const *vname, void const *var,
 #endif
 
        /* Write data */
-       if (H5Dwrite(dset, mtype, space, space, H5P_DEFAULT, var)<0) {
+       if (nofilters ? H5Dwrite(dset, mtype, space, space, H5P_DEFAULT, var)<0 :
+                       db_hdf5_write_filtered(_dbfile, dset, mtype, space, var)<0) {
            db_perror(vname, E_CALLFAIL, me);
            UNWIND();
        }
@@ -8593,17 +10123,18 @@ db_hdf5_WriteSlice(
                UNWIND();
            }
 
-           if (db_hdf5_set_properties(_dbfile, ndims, ds_size) < 0 ) {
+           if (db_hdf5_set_properties(_dbfile, ndims, ds_size, ftype) < 0 ) {
                db_perror("db_hdf5_set_properties", E_CALLFAIL, me);
                UNWIND();
            }
 
            if ((dset=H5Dcreate(dbfile->cwg, vname, ftype, fspace, H5P_DEFAULT,
-                               P_crprops, H5P_DEFAULT))<0) {
+                               dbfile->crprops, H5P_DEFAULT))<0) {
                db_perror(vname, E_CALLFAIL, me);
                UNWIND();
            }
            H5Sclose(fspace);
+           db_hdf5_index_note(dbfile, vname, DB_VARIABLE);
        }
 
        /*
@@ -10789,9 +12320,11 @@ db_hdf5_GetQuadvar(DBfile *_dbfile, char const *name)
             qv->vals = (void **)calloc(m.nvals, sizeof(void*));
             if (m.mixlen) qv->mixvals = (void **)calloc(m.nvals, sizeof(void*));
             for (i=0; i<m.nvals; i++) {
-                qv->vals[i] = db_hdf5_comprd(dbfile, m.value[i], 0);
+                qv->vals[i] = db_hdf5_comprd_into(dbfile, m.value[i], 0,
+                    "vals", i);
                 if (m.mixlen && m.mixed_value[i][0]) {
-                    qv->mixvals[i] = db_hdf5_comprd(dbfile, m.mixed_value[i], 0);
+                    qv->mixvals[i] = db_hdf5_comprd_into(dbfile,
+                        m.mixed_value[i], 0, "mixvals", i);
                 }
             }
         }
@@ -11765,9 +13298,11 @@ db_hdf5_GetUcdvar(DBfile *_dbfile, char const *name)
             uv->vals = (void **)calloc(m.nvals, sizeof(void*));
             if (m.mixlen) uv->mixvals = (void **)calloc(m.nvals, sizeof(void*));
             for (i=0; i<m.nvals; i++) {
-                uv->vals[i] = db_hdf5_comprd(dbfile, m.value[i], 0);
+                uv->vals[i] = db_hdf5_comprd_into(dbfile, m.value[i], 0,
+                    "vals", i);
                 if (m.mixlen && m.mixed_value[i][0]) {
-                    uv->mixvals[i] = db_hdf5_comprd(dbfile, m.mixed_value[i], 0);
+                    uv->mixvals[i] = db_hdf5_comprd_into(dbfile,
+                        m.mixed_value[i], 0, "mixvals", i);
                 }
             }
         }
@@ -13913,12 +15448,8 @@ db_hdf5_GetMultimeshadj(DBfile *_dbfile, char const *name, int nmesh,
                      UNWIND();
                  }
 
-                 P_rdprops = H5P_DEFAULT;
-                 if (!DBGetEnableChecksumsFile(_dbfile))
-                     P_rdprops = P_ckrdprops;
-
                  /* Read data */
-                 if (H5Dread(nldset, mtype, mspace, fspace, P_rdprops, nlist)<0) {
+                 if (H5Dread(nldset, mtype, mspace, fspace, DB_HDF5_RDPROPS(_dbfile), nlist)<0) {
                      FREE(offsetmap); FREE(offsetmapn); FREE(offsetmapz);
                      DBFreeMultimeshadj(mmadj);
                      hdf5_to_silo_error(name, me);
@@ -13961,12 +15492,8 @@ db_hdf5_GetMultimeshadj(DBfile *_dbfile, char const *name, int nmesh,
                      UNWIND();
                  }
 
-                 P_rdprops = H5P_DEFAULT;
-                 if (!DBGetEnableChecksumsFile(_dbfile))
-                     P_rdprops = P_ckrdprops;
-
                  /* Read data */
-                 if (H5Dread(zldset, mtype, mspace, fspace, P_rdprops, zlist)<0) {
+                 if (H5Dread(zldset, mtype, mspace, fspace, DB_HDF5_RDPROPS(_dbfile), zlist)<0) {
                      FREE(offsetmap); FREE(offsetmapn); FREE(offsetmapz);
                      DBFreeMultimeshadj(mmadj);
                      hdf5_to_silo_error(name, me);
@@ -15637,6 +17164,8 @@ db_hdf5_GetCompoundarray(DBfile *_dbfile, char const *name)
  *   Improved fix, above, for inquries on "/.silo/#000XXXX" datasets
  *   for silex
  *
+ *   Answers from the object index of the current directory when it has
+ *   one and the name is in it.
  *-------------------------------------------------------------------------
  */
 SILO_CALLBACK DBObjectType
@@ -15646,6 +17175,13 @@ db_hdf5_InqVarType(DBfile *_dbfile, char const *name)
     static char         *me = "db_hdf5_InqVarType";
     hid_t               o=-1, attr=-1;
     int                 _objtype = DB_INVALID_OBJECT;
+    db_hdf5_index_t     *idx;
+    int                 i;
+
+    if (!strchr(name, '/') && (idx = db_hdf5_index_cwg(dbfile)) &&
+        (i = db_hdf5_index_find(idx, name)) >= 0 &&
+        idx->types[i] != DB_INVALID_OBJECT)
+        return (DBObjectType)idx->types[i];
 
     PROTECT {
 
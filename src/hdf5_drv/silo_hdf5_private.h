@@ -78,7 +78,16 @@ typedef struct DBfile_hdf5 {
     hid_t       fid;                    /*hdf5 file identifier          */
     hid_t       cwg;                    /*current working group         */
     char        *cwg_name;              /*full name of cwg or NULL      */
+    struct db_hdf5_index_t *cwg_index;  /*on-file object index of cwg   */
+    int         cwg_index_none;         /*cwg has no usable index       */
+    struct db_hdf5_index_t **dirty_index; /*dirs written to this session */
+    int         ndirty_index;           /*number of dirty_index entries */
     hid_t       link;                   /*link group                    */
+    int         nlinks;                 /*last component name handed out*/
+    int         nlinks_read;            /*nlinks read from link group   */
+    int         nlinks_dirty;           /*nlinks not yet written back   */
+    hid_t       crprops;                /*dataset creation props in use */
+    hid_t       ckcrprops;              /*props for filtered datasets   */
     char        *dsettab[NDSETTAB];     /*circular buffer of datasets   */
     char        compname[NDSETTAB][32]; /*component names for datasets  */
     int         dsettab_ins;            /*next insert location          */
@@ -100,6 +109,7 @@ typedef struct DBfile_hdf5 {
 SILO_CALLBACK int db_hdf5_Close (DBfile *);
 SILO_CALLBACK int db_hdf5_Filters(DBfile *_dbfile, FILE *stream);
 SILO_CALLBACK int db_hdf5_Flush (DBfile *);
+SILO_CALLBACK int db_hdf5_GetFileImage (DBfile *, void **, size_t *);
 
 /* Directory operations */
 SILO_CALLBACK int db_hdf5_MkDir(DBfile *_dbfile, char const *name);
@@ -414,24 +414,26 @@ static int     _pj_force_single = FALSE;
 
 /* Definition of global variables (bleah!) */
 
-/* The variable use_PJgroup_cache is used in the PJ_GetObject function call.
- * That function will cache any PJgroup that it retrieves, if possible.
- * Sometimes, however, we've changed the state of the file (like changing
- * directories) and must ignore any cache that we already have.  The
- * "use_PJgroup_cache" variable is a boolean value that allows us to ignore
- * the cached value when we need to.  Note that, even if this variable is set
- * to 0 here, it will be reset to 1 after the first group is read.
+/* PJ_GetObject keeps the PJgroups it reads in a small most-recently-used
+ * cache so that reading a run of objects (a mesh, its variables, then the
+ * mesh again) doesn't go back to the file for each group description.
+ * Entries are keyed by the file and the absolute path of the object in it,
+ * so changing directories doesn't invalidate them. Writing a group drops
+ * its entry and closing a file drops all of that file's entries. At most
+ * SILO_Globals.pdbObjectCacheSize entries are kept (see
+ * DBSetPDBObjectCacheSize) and hits and misses are counted in
+ * SILO_Globals for tuning that size.
  */
-static int use_PJgroup_cache = 1;
+#define PJ_GROUP_CACHE_MAX 256
 
-/* To cache the PJgroup, we need to keep the group, and we need to keep
- * the "definition" of which object it is.  This information can be
- * captured by storing the name of the object, the name of the file it
- * came from, and the directory from which it came.
- */
-static PJgroup *cached_group = NULL;
-static char    *cached_obj_name = NULL;
-static char    *cached_file_name = NULL;
+typedef struct pj_group_cache_entry_t {
+    PDBfile *file;
+    char    *path;
+    PJgroup *group;
+} pj_group_cache_entry_t;
+
+static pj_group_cache_entry_t pj_group_cache[PJ_GROUP_CACHE_MAX];
+static int pj_group_cache_n = 0;
 
 PRIVATE int db_pdb_ParseVDBSpec (char const *mvdbspec, char **varname,
                                  char **filename);
@@ -487,29 +489,148 @@ PJ_InqForceSingle(void)
 }
 
 /*----------------------------------------------------------------------
- *  Routine:                                                PJ_NoCache
+ *  Routine                                             PJ_UncacheEntry
  *
- *  Purpose:
- *      Turn off caching of PJgroups until the next PJ_GetObject call.
+ *  Purpose
  *
- *  Programmer:
- *      Sean Ahern, Mon Jul  1 08:23:41 PDT 1996
+ *      Release the i'th entry of the PJgroup cache and close up the gap.
  *
- *  Notes:
- *     See comment at the top of this file about the use_PJgroup_cache
- *     global variable.
+ *--------------------------------------------------------------------*/
+PRIVATE void
+PJ_UncacheEntry(int i)
+{
+    pj_group_cache_entry_t e = pj_group_cache[i];
+
+    pj_group_cache_n--;
+    memmove(&pj_group_cache[i], &pj_group_cache[i+1],
+        (pj_group_cache_n - i) * sizeof(pj_group_cache_entry_t));
+    PJ_rel_group(e.group);
+    FREE(e.path);
+}
+
+/*----------------------------------------------------------------------
+ *  Routine                                             PJ_UncacheGroup
  *
- *  Modifications:
+ *  Purpose
  *
- *     Jim Reus, 23 Apr 97
- *     Provide void in parameter list (to agree with header file).
+ *      Drop the cached PJgroup, if any, for the object at the absolute
+ *      path in the given file. Called when the group is (re)written.
  *
- *--------------------------------------------------------------------
- */
-INTERNAL void
-PJ_NoCache ( void )
+ *--------------------------------------------------------------------*/
+PRIVATE void
+PJ_UncacheGroup(PDBfile *file, char const *path)
+{
+    int i;
+
+    for (i = 0; i < pj_group_cache_n; i++)
+    {
+        if (pj_group_cache[i].file == file &&
+            strcmp(pj_group_cache[i].path, path) == 0)
+        {
+            PJ_UncacheEntry(i);
+            return;
+        }
+    }
+}
+
+/*----------------------------------------------------------------------
+ *  Routine                                                PJ_FindGroup
+ *
+ *  Purpose
+ *
+ *      Return the PJgroup for the named object, from the cache if it is
+ *      there and read from the file (and cached) otherwise. If the group
+ *      could not be cached, *cached is set to zero and the caller must
+ *      release the group with PJ_rel_group when done with it.
+ *
+ *  Return
+ *
+ *      The group or NULL if the object couldn't be read.
+ *
+ *--------------------------------------------------------------------*/
+PRIVATE PJgroup *
+PJ_FindGroup(PDBfile *file, char const *objname, int *cached)
 {
-    use_PJgroup_cache = 0;
+    int      i, n = MIN(SILO_Globals.pdbObjectCacheSize, PJ_GROUP_CACHE_MAX);
+    char     fullpath[MAXLINE];
+    char    *path = NULL;
+    PJgroup *group = NULL;
+
+    *cached = 0;
+    while (pj_group_cache_n > MAX(n, 0))
+        PJ_UncacheEntry(pj_group_cache_n-1);
+    if (PJ_get_fullpath(lite_PD_pwd(file), objname, fullpath))
+        path = STRDUP(fullpath);
+
+    for (i = 0; path && i < pj_group_cache_n; i++)
+    {
+        if (pj_group_cache[i].file == file &&
+            strcmp(pj_group_cache[i].path, path) == 0)
+        {
+            pj_group_cache_entry_t e = pj_group_cache[i];
+
+            /* Move it to the front */
+            memmove(&pj_group_cache[1], &pj_group_cache[0],
+                i * sizeof(pj_group_cache_entry_t));
+            pj_group_cache[0] = e;
+            SILO_Globals.pdbObjectCacheHits++;
+            *cached = 1;
+            FREE(path);
+            return e.group;
+        }
+    }
+    SILO_Globals.pdbObjectCacheMisses++;
+
+    if (!PJ_get_group(file, objname, &group) || group == NULL)
+    {
+        FREE(path);
+        return NULL;
+    }
+
+    /* Make room at the front, dropping the least recently used group */
+    if (path == NULL || n <= 0)
+    {
+        FREE(path);
+        return group;
+    }
+
+    if (pj_group_cache_n >= n)
+        PJ_UncacheEntry(pj_group_cache_n-1);
+    memmove(&pj_group_cache[1], &pj_group_cache[0],
+        pj_group_cache_n * sizeof(pj_group_cache_entry_t));
+    pj_group_cache[0].file = file;
+    pj_group_cache[0].path = path;
+    pj_group_cache[0].group = group;
+    pj_group_cache_n++;
+    *cached = 1;
+
+    return group;
+}
+
+
+/*----------------------------------------------------------------------
+ *  Routine                                                PJ_ReturnFile
+ *
+ *  Purpose
+ *
+ *      Hand a file PJ_GetObject opened to read an object named with a
+ *      "file:" prefix to the library's cache of open files, which
+ *      closes it when it is no longer wanted. Does nothing for the
+ *      caller's own file (filename is NULL).
+ *
+ *--------------------------------------------------------------------*/
+PRIVATE void
+PJ_CloseFile(void *file)
+{
+    PJ_ClearCache((PDBfile *) file);
+    lite_PD_close((PDBfile *) file);
+}
+
+PRIVATE void
+PJ_ReturnFile(char const *filename, PDBfile *file)
+{
+    if (filename != NULL)
+        db_ReturnCachedFile(filename, DB_PDB, file, PJ_CloseFile);
 }
 
 
@@ -565,14 +686,24 @@ PJ_NoCache ( void )
  *      Replaced returned 'ret_type' argument with input expected_dbtype
  *      argument and cause it to fail if type that is read doesn't
  *      match the expected_dbtype.
+ *
+ *      Files named in the object name are now taken from and returned
+ *      to the library's cache of open files instead of being opened
+ *      and closed for every object. They are no longer leaked when
+ *      the object can't be read.
+ *
+ *      The single cached PJgroup is now a bounded cache of them keyed
+ *      by file and absolute object path (see PJ_FindGroup).
  *--------------------------------------------------------------------*/
 INTERNAL int
 PJ_GetObject(PDBfile *file_in, char const *objname_in, PJcomplist *tobj, int expected_dbtype)
 {
-    int             i, j, error;
+    int             i, j;
+    int             cached = 0;
     char           *varname=NULL, *filename=NULL;
     char const     *objname=NULL;
     PDBfile        *file=NULL;
+    PJgroup        *group=NULL;
     char           *me = "PJ_GetObject";
 
     if (!file_in)
@@ -592,7 +723,8 @@ PJ_GetObject(PDBfile *file_in, char const *objname_in, PJcomplist *tobj, int exp
     if (filename != NULL)
     {
         objname = varname;
-        if ((file = lite_PD_open((char*)filename, "r")) == NULL)
+        if ((file = (PDBfile *) db_TakeCachedFile(filename, DB_PDB)) == NULL &&
+            (file = lite_PD_open((char*)filename, "r")) == NULL)
         {
             FREE (varname);
             FREE (filename);
@@ -608,64 +740,17 @@ PJ_GetObject(PDBfile *file_in, char const *objname_in, PJcomplist *tobj, int exp
         file = file_in;
     }
 
-    /* Read object description if we don't have it cached.
-     *
-     * There are three things that we have to check:
-     *     use_PJgroup_cache is true
-     *     cache_obj_name is the same as the passed-in name
-     *     cache_file_name is the same as the passed-in file's name
-     *
-     * If any of these are false, we can't use the cached PJgroup and must
-     * instead read a new one from the PDBfile.
-     */
-    if ((use_PJgroup_cache == 0) ||
-        (cached_obj_name == NULL) || (strcmp(cached_obj_name, objname) != 0) ||
-        (cached_file_name == NULL) || (strcmp(cached_file_name, file->name)))
+    /* Read object description if we don't have it cached. */
+    group = PJ_FindGroup(file, objname, &cached);
+    if (group == NULL)
     {
-        PJ_ClearCache();
-        error = !PJ_get_group(file, objname, &cached_group);
-        if (error || cached_group == NULL)
-        {
-            char err_str[256];
-            sprintf(err_str,"PJ_get_group: Probably no such object \"%s\".",objname);
-            FREE(varname);
-            FREE(filename);
-            db_perror(err_str, E_CALLFAIL, me);
-            return -1;
-        }
-
-        /* Check object type before we do any allocations */
-        if (expected_dbtype > 0)
-        {
-            int matched = 1;
-            if (expected_dbtype == DB_QUADMESH)
-            {
-                if ((strcmp(cached_group->type, DBGetObjtypeName(DB_QUAD_RECT)) != 0) &&
-                    (strcmp(cached_group->type, DBGetObjtypeName(DB_QUAD_CURV)) != 0))
-                    matched = 0;
-            }  
-            else if (strcmp(cached_group->type, DBGetObjtypeName(expected_dbtype)) != 0)
-            {
-                matched = 0;
-            }
-            if (!matched)
-            {
-                char error[256];
-                sprintf(error,"Requested %s object \"%s\" is not a %s.",
-                    cached_group->type, objname_in, DBGetObjtypeName(expected_dbtype));
-                FREE(varname);
-                FREE(filename);
-                db_perror(error, E_NOTFOUND, me);
-                return -1;
-            }
-        }
-
-        /* We've gotten a new group, remember which one it is. */
-        cached_obj_name = STRDUP(objname);
-        cached_file_name = STRDUP(file->name);
-
-        /* Now that we've cached a group, turn caching back on. */
-        use_PJgroup_cache = 1;
+        char err_str[256];
+        sprintf(err_str,"PJ_get_group: Probably no such object \"%s\".",objname);
+        PJ_ReturnFile(filename, file);
+        FREE(varname);
+        FREE(filename);
+        db_perror(err_str, E_CALLFAIL, me);
+        return -1;
     }
 
     /* Check object type */
@@ -674,21 +759,23 @@ PJ_GetObject(PDBfile *file_in, char const *objname_in, PJcomplist *tobj, int exp
         int matched = 1;
         if (expected_dbtype == DB_QUADMESH)
         {
-            if ((strcmp(cached_group->type, DBGetObjtypeName(DB_QUAD_RECT)) != 0) &&
-                (strcmp(cached_group->type, DBGetObjtypeName(DB_QUAD_CURV)) != 0))
+            if ((strcmp(group->type, DBGetObjtypeName(DB_QUAD_RECT)) != 0) &&
+                (strcmp(group->type, DBGetObjtypeName(DB_QUAD_CURV)) != 0))
                 matched = 0;
         }  
-        else if (strcmp(cached_group->type, DBGetObjtypeName(expected_dbtype)) != 0)
+        else if (strcmp(group->type, DBGetObjtypeName(expected_dbtype)) != 0)
         {
             matched = 0;
         }
         if (!matched)
         {
             char error[256];
+            sprintf(error,"Requested %s object \"%s\" is not a %s.",
+                group->type, objname_in, DBGetObjtypeName(expected_dbtype));
+            if (!cached) PJ_rel_group(group);
+            PJ_ReturnFile(filename, file);
             FREE(varname);
             FREE(filename);
-            sprintf(error,"Requested %s object \"%s\" is not a %s.",
-                cached_group->type, objname_in, DBGetObjtypeName(expected_dbtype));
             db_perror(error, E_NOTFOUND, me);
             return -1;
         }
@@ -698,10 +785,10 @@ PJ_GetObject(PDBfile *file_in, char const *objname_in, PJcomplist *tobj, int exp
      * locations.  */
     for (i = 0; i < tobj->num; i++)
     {
-        for (j = 0; j < cached_group->ncomponents; j++)
+        for (j = 0; j < group->ncomponents; j++)
         {
             if (tobj->ptr[i] != NULL &&
-                STR_EQUAL(cached_group->comp_names[j], tobj->name[i]))
+                STR_EQUAL(group->comp_names[j], tobj->name[i]))
             {
 
                 /*
@@ -709,7 +796,7 @@ PJ_GetObject(PDBfile *file_in, char const *objname_in, PJcomplist *tobj, int exp
                  *  pointer (i.e., ptr[i]). If not alloced, address
                  *  is already in the ptr[i] element.
                  */
-                PJ_ReadVariable(file, cached_group->pdb_names[j],
+                PJ_ReadVariable(file, group->pdb_names[j],
                                 tobj->type[i], (int)tobj->alloced[i],
                                 (tobj->alloced[i]) ?
                                 (char **)&tobj->ptr[i] :
@@ -719,14 +806,15 @@ PJ_GetObject(PDBfile *file_in, char const *objname_in, PJcomplist *tobj, int exp
         }
     }
 
+    if (!cached)
+        PJ_rel_group(group);
+
     /*
-     * If the variable was from another file the file.
+     * If the variable was from another file, keep the file open for the
+     * next object read from it.
      */
-    if (filename != NULL)
-    {
-        FREE (filename);
-        lite_PD_close (file);
-    }
+    PJ_ReturnFile(filename, file);
+    FREE (filename);
 
     FREE (varname);
 
@@ -748,26 +836,20 @@ PJ_GetObject(PDBfile *file_in, char const *objname_in, PJcomplist *tobj, int exp
  *    Brad Whitlock, Thu Jan 20 15:32:27 PST 2000
  *    Added the void to the argument list to preserve the prototype.
  *
+ *    Drop only the groups cached for the given file, or all of them
+ *    if it is NULL.
  *--------------------------------------------------------------------*/
 INTERNAL int
-PJ_ClearCache(void)
+PJ_ClearCache(PDBfile *file)
 {
-    int error;
-    static char *me = "PJ_ClearCache";
+    int i;
 
-    /* Free up the old group. */
-    if (cached_group)
+    /* Free up the groups cached for the file, or all of them. */
+    for (i = pj_group_cache_n-1; i >= 0; i--)
     {
-        error = !PJ_rel_group(cached_group);
-        if (error)
-        {
-            db_perror("PJ_rel_group", E_CALLFAIL, me);
-            return -1;
-        }
-        cached_group = NULL;
+        if (file == NULL || pj_group_cache[i].file == file)
+            PJ_UncacheEntry(i);
     }
-    FREE(cached_obj_name);
-    FREE(cached_file_name);
 
     return 0;
 }
@@ -832,45 +914,54 @@ PJ_GetComponent (PDBfile *file, char const *objname, char const *compname) {
  *    Mark C. Miller, Thu Aug 24 22:41:23 PDT 2023
  *    Add use_PJcache_group==0 to conditions controlling whether a new
  *    call to PJ_GetObject is made.
+ *
+ *    Look the group up with PJ_FindGroup instead of reading a component
+ *    to get it into the single-slot cache.
  *--------------------------------------------------------------------
  */
 INTERNAL int
 PJ_GetComponentType (PDBfile *file, char const *objname, char const *compname)
 {
    int  retval = DB_NOTYPE;
+   int  cached = 0;
+   char *varname = NULL, *filename = NULL;
+   PJgroup *group = NULL;
    char *me = "PJ_GetComponentType";
-   PJcomplist    *_tcl;
 
-   /* If there is no cached group, or we are interested in a
-    * different object, get the one we want.  */
-   if(use_PJgroup_cache == 0 || cached_group == NULL || cached_obj_name == NULL ||
-      (!STR_EQUAL(cached_obj_name, objname)))
+   /* If the object name has a filename in it then get that file */
+   if (db_pdb_ParseVDBSpec(objname, &varname, &filename) < 0)
    {
-       char       *result = NULL;
-       PJcomplist tmp_obj;
-
-       /* Read just the requested component of the given object */
-       INIT_OBJ(&tmp_obj);
-       DEFALL_OBJ(compname, &result, DB_NOTYPE);
-
-       if (PJ_GetObject(file, objname, &tmp_obj, 0) < 0) {
-          db_perror("PJ_GetObject", E_CALLFAIL, me);
-          return DB_NOTYPE;
+       FREE(varname);
+       db_perror("objname", E_BADARGS, me);
+       return DB_NOTYPE;
+   }
+   if (filename != NULL)
+   {
+       objname = varname;
+       if ((file = (PDBfile *) db_TakeCachedFile(filename, DB_PDB)) == NULL &&
+           (file = lite_PD_open((char*)filename, "r")) == NULL)
+       {
+           FREE(varname);
+           FREE(filename);
+           db_perror("objname", E_BADARGS, me);
+           return DB_NOTYPE;
        }
-       FREE(result);
    }
 
-   /* If there is now cached group information (and there should be)
-    * then look for the component in the group and determine its type.  */
-   if(use_PJgroup_cache && cached_group)
+   /* Get the object's group, from the cache if it's there */
+   if ((group = PJ_FindGroup(file, objname, &cached)) == NULL)
+   {
+       db_perror("PJ_get_group", E_CALLFAIL, me);
+   }
+   else
    {
        int i, index, found = 0;
 
-       /* Look through the cached group's component list to find
+       /* Look through the group's component list to find
         * the appropriate index.  */
-        for(i = 0; i < cached_group->ncomponents; i++)
+        for(i = 0; i < group->ncomponents; i++)
         {
-            if(strcmp(compname, cached_group->comp_names[i]) == 0)
+            if(strcmp(compname, group->comp_names[i]) == 0)
             {
                 found = 1;
                 index = i;
@@ -884,19 +975,26 @@ PJ_GetComponentType (PDBfile *file, char const *objname, char const *compname)
          * string, or variable.  */
         if(found)
         {
-            if(strncmp(cached_group->pdb_names[index], "'<i>", 4) == 0)
+            if(strncmp(group->pdb_names[index], "'<i>", 4) == 0)
                 retval = DB_INT;
-            else if(strncmp(cached_group->pdb_names[index], "'<f>", 4) == 0)
+            else if(strncmp(group->pdb_names[index], "'<f>", 4) == 0)
                 retval = DB_FLOAT;
-            else if(strncmp(cached_group->pdb_names[index], "'<d>", 4) == 0)
+            else if(strncmp(group->pdb_names[index], "'<d>", 4) == 0)
                 retval = DB_DOUBLE;
-            else if(strncmp(cached_group->pdb_names[index], "'<s>", 4) == 0)
+            else if(strncmp(group->pdb_names[index], "'<s>", 4) == 0)
                 retval = DB_CHAR;
             else
                 retval = DB_VARIABLE;
         }
+
+        if (!cached)
+            PJ_rel_group(group);
    }
 
+   PJ_ReturnFile(filename, file);
+   FREE(filename);
+   FREE(varname);
+
    return retval;
 }
 
@@ -1722,8 +1820,10 @@ PJ_put_group (
    }
 
    /*----------------------------------------
-    *  Write the group description variable.
+    *  Write the group description variable,
+    *  dropping any cached copy of the old one.
     *----------------------------------------*/
+   PJ_UncacheGroup(file, name);
    return ((int)PJ_write(file, name, "Group *", &group));
 }
 #endif /* PDB_WRITE */
@@ -2005,6 +2105,8 @@ db_pdb_InitCallbacks ( DBfile *dbfile )
  *
  *    Sean Ahern, Mon Nov 23 17:29:17 PST 1998
  *    Added clearing of the object cache when the file is closed.
+ *
+ *    Drop only this file's entries from the object cache.
  *-------------------------------------------------------------------------*/
 SILO_CALLBACK int
 db_pdb_close(DBfile *_dbfile)
@@ -2016,19 +2118,14 @@ db_pdb_close(DBfile *_dbfile)
       /*
        * Free the private parts of the file.
        */
+      PJ_ClearCache(dbfile->pdb);
       lite_PD_close(dbfile->pdb);
       dbfile->pdb = NULL;
 
-      /* We've closed a file, so we can't cache PJgroups any more */
-      PJ_NoCache();
-
       /*
        * Free the public parts of the file.
        */
       silo_db_close(_dbfile);
-
-      /* Clear the current object cache. */
-      PJ_ClearCache();
    }
    return 0;
 }
@@ -2675,7 +2772,7 @@ db_pdb_NewToc (DBfile *_dbfile)
 #define PJDIR  -10
 #define PJVAR  -11
 
-   int            i, lstr, num;
+   int            i, lstr, num, namesOnly;
    int           *types=NULL;
    int            ivar, iqmesh, iqvar, iumesh, iuvar, icurve, idir, iarray,
       imat, imatspecies, imultimesh, imultivar, imultimat, imultimatspecies,
@@ -2692,6 +2789,7 @@ db_pdb_NewToc (DBfile *_dbfile)
 
    db_FreeToc(_dbfile);
    dbfile->pub.toc = toc = db_AllocToc();
+   namesOnly = db_TocNamesOnly(_dbfile);
 
    file = dbfile->pdb;
 
@@ -2735,6 +2833,16 @@ db_pdb_NewToc (DBfile *_dbfile)
       }
       else if (STR_BEGINSWITH(ep->type, "Group")) {
 
+         /*
+          * In names-only mode, don't read the object's type; it goes
+          * in the obj_names list.
+          */
+         if (namesOnly) {
+            types[i] = DB_USERDEF;
+            toc->nobj++;
+            continue;
+         }
+
          /*
           * Read the type field of each object and increment
           * the appropriate count.
@@ -6911,6 +7019,9 @@ db_pdb_ReadVarVals(DBfile *_dbfile, char const *vname, int mode,
  *
  *    Sean Ahern, Mon Jul  1 14:06:08 PDT 1996
  *    Turned off the PJgroup cache when we change directories.
+ *
+ *    The PJgroup cache is keyed by absolute path now and survives a
+ *    change of directory.
  *-------------------------------------------------------------------------*/
 SILO_CALLBACK int
 db_pdb_SetDir (DBfile *_dbfile, char const *path)
@@ -6922,9 +7033,6 @@ db_pdb_SetDir (DBfile *_dbfile, char const *path)
    if (1 == lite_PD_cd(dbfile->pdb, (char*) path)) {
       dbfile->pub.dirid = 0;
 
-      /* We've changed directories, so we can't cache PJgroups any more */
-      PJ_NoCache();
-
       /* Must make new table-of-contents since dir has changed */
       db_FreeToc(_dbfile);
    }
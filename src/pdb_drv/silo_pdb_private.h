@@ -352,9 +352,8 @@ PRIVATE int pdb_getvarinfo (PDBfile *, char *, char *, int *, int *, int);
 
 PRIVATE int PJ_ForceSingle (int);
 PRIVATE int PJ_GetObject (PDBfile *, char const *, PJcomplist *, int expected_dbtype);
-PRIVATE int PJ_ClearCache(void);
+PRIVATE int PJ_ClearCache(PDBfile *);
 PRIVATE int PJ_InqForceSingle (void);
-PRIVATE void PJ_NoCache ( void );
 PRIVATE void *PJ_GetComponent (PDBfile *, char const *, char const *);
 PRIVATE int PJ_GetComponentType (PDBfile *, char const *, char const *);
 PRIVATE int PJ_ReadVariable (PDBfile *, char *, int, int, char **);
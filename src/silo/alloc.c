@@ -2176,6 +2176,7 @@ DBFreeNamescheme(DBnamescheme *ns)
         if (ns->embedns[i])
             DBFreeNamescheme(ns->embedns[i]);
     }
+    db_FreeNameschemeExprs(ns);
     for (i = 0; i < ns->ncspecs; i++)
         FREE(ns->exprstrs[i]);
     FREE(ns->exprstrs);
@@ -52,29 +52,71 @@ Government or Lawrence Livermore National Security, LLC, and shall not
 be used for advertising or product endorsement purposes.
 */
 
+
 #include "silo_private.h"
 
+#if defined(HAVE_PTHREAD_H) && !defined(_WIN32)
+#define DB_EXTFACE_THREADS
+#include <pthread.h>
+#endif
+
 /*
- * Maximum size of the hash table.  This should be a prime number.  This
- * was pulled off the web from
+ * Number of buckets of the chained hash table this code used to use.
+ * The faces are still output in the order that table produced so that
+ * the resulting facelists are unchanged.  This should be a prime number.
+ * This was pulled off the web from
  *    http://www.utm.edu/research/primes/notes/10000.txti 
  */
 #define HASH_MAX 100003
 
+/*
+ * Bounds on the initial size of each open addressed face table.  The
+ * size is chosen from the number of zones and the table doubles if it
+ * gets more than half full.
+ */
+#define FACE_TABLE_MIN      (1<<10)
+#define FACE_TABLE_MAX_INIT (1<<24)
+
+/*
+ * Maximum number of threads used to hash faces.
+ */
+#define FACE_THREADS_MAX 64
+
+/*
+ * Faces with at most this many nodes keep them in the face itself.
+ * This covers the faces of all the standard zone shapes.
+ */
+#define FACE_NODES_INLINE 4
+
 #define MALLOC_N(T,N)            ((T*)malloc((size_t)((N)*sizeof(T))))
 
 typedef struct Face
 {
     int       nNodes;           /* The number of nodes in the face. */
-    int       *nodes;           /* The nodes making up the face. */
-    int       zoneNo;           /* The zone number associated with the face. */
-    struct Face *next;          /* Pointer to another face. */
+    int       zoneNo;           /* The zone number associated with the face,
+                                   or the next free face when it is free. */
+    int       seq;              /* The order in which the face was inserted. */
+    unsigned  key;              /* The hash key of the face. */
+    int       inodes[FACE_NODES_INLINE]; /* The nodes, if there are few. */
+    int       *xnodes;          /* The nodes, if there are many. */
 } Face;
 
+#define FACE_NODES(F) \
+    ((F)->nNodes <= FACE_NODES_INLINE ? (F)->inodes : (F)->xnodes)
+
 typedef struct FaceHash
 {
-    Face      **table;          /* The hash table. */
-    int       size;             /* The size of the hash table. */
+    int       *table;           /* Open addressed table of pool index+1. */
+    int       size;             /* The size of the table (a power of 2). */
+    int       nUsed;            /* The number of faces in the table. */
+    Face      *pool;            /* The pool the faces are allocated from. */
+    int       poolSize;         /* The number of faces in the pool. */
+    int       nPool;            /* The number of pool faces ever used. */
+    int       freeFace;         /* The first free face in the pool or -1. */
+    int       part;             /* The partition of faces in this table. */
+    int       nParts;           /* The number of partitions. */
+    int       seq;              /* The number of faces seen so far. */
+    int       failed;           /* Flag indicating an allocation failed. */
 } FaceHash;
 
 typedef struct CalcExternalFacesState
@@ -90,17 +132,31 @@ typedef struct CalcExternalFacesState
     int       nShapes;
     int       *matList;
     int       bndMethod;
-    FaceHash  faceHash;
+    int       nParts;
+    FaceHash  *faceHash;        /* One face table for each partition. */
 } CalcExternalFacesState;
 
-PRIVATE Face *AllocFace(void);
+typedef struct HashFacesJob
+{
+    CalcExternalFacesState *st;
+    FaceHash  *fh;
+} HashFacesJob;
+
+PRIVATE int AllocFace(FaceHash *fh);
 PRIVATE DBfacelist *CalcExternalFaces(int *zoneList, int nNodes,
     int lowOffset, int highOffset, int origin, int *shapeType, int *shapeSize,
     int *shapeCnt, int nShapes, int *matList, int bndMethod);
+PRIVATE int CompareFaces(const void *a, const void *b);
+PRIVATE void DeleteFace(FaceHash *fh, int slot);
 PRIVATE DBfacelist *FormFaceList(CalcExternalFacesState *st);
-PRIVATE void FreeFace(Face *face);
-PRIVATE void InsertFace(CalcExternalFacesState *st, int *nodes, int nNodes,
-    int zoneNo);
+PRIVATE void FreeFace(FaceHash *fh, int iFace);
+PRIVATE void FreeFaceHash(FaceHash *fh);
+PRIVATE int GrowFaceHash(FaceHash *fh);
+PRIVATE void *HashFaces(void *arg);
+PRIVATE int InitFaceHash(FaceHash *fh, int nZones, int part, int nParts);
+PRIVATE void InsertFace(CalcExternalFacesState *st, FaceHash *fh,
+    int *nodes, int nNodes, int zoneNo);
+PRIVATE void WalkFaces(CalcExternalFacesState *st, FaceHash *fh);
 
 /***********************************************************************
  *
@@ -217,6 +273,40 @@ DBCalcExternalFacelist2(int *nodeList, int nNodes, int lowOffset,
     return fl;
 }
 
+
+/***********************************************************************
+ *
+ * Purpose:  Set the number of threads DBCalcExternalFacelist and
+ *           DBCalcExternalFacelist2 use to hash faces.
+ *
+ * Input arguments:
+ *    nthreads : The number of threads.  Values less than 2 hash the
+ *               faces serially, which is the default.
+ *
+ * Output arguments:
+ *    oldval   : The previous number of threads.
+ *
+ * Notes
+ *    The faces are partitioned among the threads by their smallest
+ *    node number, so each thread builds its own table and the
+ *    resulting facelist does not depend on the number of threads.
+ *
+ **********************************************************************/
+
+PUBLIC int
+DBSetFacelistThreads(int nthreads)
+{
+    int oldval = SILO_Globals.facelistThreads;
+    SILO_Globals.facelistThreads = nthreads;
+    return oldval;
+}
+
+PUBLIC int
+DBGetFacelistThreads(void)
+{
+    return SILO_Globals.facelistThreads;
+}
+
 /***********************************************************************
  *
  * Purpose:  Given a zonelist, calculate a facelist describing all of
@@ -264,18 +354,23 @@ DBCalcExternalFacelist2(int *nodeList, int nNodes, int lowOffset,
  *
  **********************************************************************/
 
+
 PRIVATE DBfacelist *
 CalcExternalFaces(int *zoneList, int nNodes, int lowOffset, int highOffset,
                   int origin, int *shapeType, int *shapeSize, int *shapeCnt,
                   int nShapes, int *matList, int bndMethod)
 {
-    int       i, j, k;
+    int       i;
+    int       nZones;
+    int       nParts;
+    int       failed;
     CalcExternalFacesState st;
-    int       nFaces;
-    int       nEdges;
-    int       iZone, iZoneList;
-    int       nodes[4];
     DBfacelist *faceList=NULL;
+#ifdef DB_EXTFACE_THREADS
+    HashFacesJob jobs[FACE_THREADS_MAX];
+    pthread_t threads[FACE_THREADS_MAX];
+    int       started[FACE_THREADS_MAX];
+#endif
 
     /*
      * Copy relevant global information to a structure for easy
@@ -293,9 +388,103 @@ CalcExternalFaces(int *zoneList, int nNodes, int lowOffset, int highOffset,
     st.matList    = matList;
     st.bndMethod  = bndMethod;
 
-    st.faceHash.size  = MIN(nNodes, HASH_MAX);
-    st.faceHash.table = MALLOC_N(Face *, st.faceHash.size);
-    memset(st.faceHash.table, 0, st.faceHash.size * sizeof(Face *));
+    /*
+     * Decide how many partitions to hash the faces in and set up a
+     * face table for each, sized from the number of zones.
+     */
+    nParts = 1;
+#ifdef DB_EXTFACE_THREADS
+    nParts = MIN(DBGetFacelistThreads(), FACE_THREADS_MAX);
+    if (nParts < 1)
+        nParts = 1;
+#endif
+    nZones = 0;
+    for (i = 0; i < nShapes; i++) nZones += shapeCnt[i];
+
+    st.nParts   = nParts;
+    st.faceHash = (FaceHash *) calloc(nParts, sizeof(FaceHash));
+    if (st.faceHash == NULL)
+        return NULL;
+    failed = 0;
+    for (i = 0; i < nParts; i++)
+        failed |= InitFaceHash(&st.faceHash[i], nZones, i, nParts);
+
+    /*
+     * Hash the faces of each partition, removing duplicates as they
+     * are encountered.  Partitions that don't get a thread of their
+     * own are hashed by this thread.
+     */
+    if (!failed)
+    {
+#ifdef DB_EXTFACE_THREADS
+        for (i = 1; i < nParts; i++)
+        {
+            jobs[i].st = &st;
+            jobs[i].fh = &st.faceHash[i];
+            started[i] = pthread_create(&threads[i], NULL, HashFaces,
+                                        &jobs[i]) == 0;
+        }
+        WalkFaces(&st, &st.faceHash[0]);
+        for (i = 1; i < nParts; i++)
+        {
+            if (started[i])
+                pthread_join(threads[i], NULL);
+            else
+                WalkFaces(&st, &st.faceHash[i]);
+        }
+#else
+        WalkFaces(&st, &st.faceHash[0]);
+#endif
+        for (i = 0; i < nParts; i++)
+            failed |= st.faceHash[i].failed;
+    }
+
+    /*
+     * Form a DBfacelist structure from the remaining faces.
+     */
+    if (!failed)
+        faceList = FormFaceList(&st);
+
+    for (i = 0; i < nParts; i++)
+        FreeFaceHash(&st.faceHash[i]);
+    FREE(st.faceHash);
+
+    return faceList;
+}
+
+/***********************************************************************
+ *
+ * Purpose:  Loop over all the shapes, inserting the faces of each
+ *           zone into a face table.
+ *
+ * Input arguments:
+ *    st       : The external facelist state.
+ *
+ * Output arguments:
+ *
+ * Input/Output arguments:
+ *    fh       : The face table.  Only faces in its partition are
+ *               inserted but all of them are counted.
+ *
+ * Notes
+ *
+ * Modifications:
+ *
+ **********************************************************************/
+
+PRIVATE void
+WalkFaces(CalcExternalFacesState *st, FaceHash *fh)
+{
+    int       i, j, k;
+    int       nFaces;
+    int       nEdges;
+    int       iZone, iZoneList;
+    int       nodes[4];
+    int       *zoneList  = st->zoneList;
+    int       *shapeType = st->shapeType;
+    int       *shapeSize = st->shapeSize;
+    int       *shapeCnt  = st->shapeCnt;
+    int       nShapes    = st->nShapes;
 
     /*
      * Loop over all the shapes, adding the faces for each shape,
@@ -313,19 +502,19 @@ CalcExternalFaces(int *zoneList, int nNodes, int lowOffset, int highOffset,
                     nodes[0] = zoneList[iZoneList+0];
                     nodes[1] = zoneList[iZoneList+1];
                     nodes[2] = zoneList[iZoneList+2];
-                    InsertFace(&st, nodes, 3, iZone);
+                    InsertFace(st, fh, nodes, 3, iZone);
                     nodes[0] = zoneList[iZoneList+0];
                     nodes[1] = zoneList[iZoneList+2];
                     nodes[2] = zoneList[iZoneList+3];
-                    InsertFace(&st, nodes, 3, iZone);
+                    InsertFace(st, fh, nodes, 3, iZone);
                     nodes[0] = zoneList[iZoneList+0];
                     nodes[1] = zoneList[iZoneList+3];
                     nodes[2] = zoneList[iZoneList+1];
-                    InsertFace(&st, nodes, 3, iZone);
+                    InsertFace(st, fh, nodes, 3, iZone);
                     nodes[0] = zoneList[iZoneList+1];
                     nodes[1] = zoneList[iZoneList+3];
                     nodes[2] = zoneList[iZoneList+2];
-                    InsertFace(&st, nodes, 3, iZone);
+                    InsertFace(st, fh, nodes, 3, iZone);
                     iZone++;
                     iZoneList += 4;
                 }
@@ -337,23 +526,23 @@ CalcExternalFaces(int *zoneList, int nNodes, int lowOffset, int highOffset,
                     nodes[1] = zoneList[iZoneList+1];
                     nodes[2] = zoneList[iZoneList+2];
                     nodes[3] = zoneList[iZoneList+3];
-                    InsertFace(&st, nodes, 4, iZone);
+                    InsertFace(st, fh, nodes, 4, iZone);
                     nodes[0] = zoneList[iZoneList+0];
                     nodes[1] = zoneList[iZoneList+4];
                     nodes[2] = zoneList[iZoneList+1];
-                    InsertFace(&st, nodes, 3, iZone);
+                    InsertFace(st, fh, nodes, 3, iZone);
                     nodes[0] = zoneList[iZoneList+1];
                     nodes[1] = zoneList[iZoneList+4];
                     nodes[2] = zoneList[iZoneList+2];
-                    InsertFace(&st, nodes, 3, iZone);
+                    InsertFace(st, fh, nodes, 3, iZone);
                     nodes[0] = zoneList[iZoneList+2];
                     nodes[1] = zoneList[iZoneList+4];
                     nodes[2] = zoneList[iZoneList+3];
-                    InsertFace(&st, nodes, 3, iZone);
+                    InsertFace(st, fh, nodes, 3, iZone);
                     nodes[0] = zoneList[iZoneList+3];
                     nodes[1] = zoneList[iZoneList+4];
                     nodes[2] = zoneList[iZoneList+0];
-                    InsertFace(&st, nodes, 3, iZone);
+                    InsertFace(st, fh, nodes, 3, iZone);
                     iZone++;
                     iZoneList += 5;
                 }
@@ -365,25 +554,25 @@ CalcExternalFaces(int *zoneList, int nNodes, int lowOffset, int highOffset,
                     nodes[1] = zoneList[iZoneList+1];
                     nodes[2] = zoneList[iZoneList+2];
                     nodes[3] = zoneList[iZoneList+3];
-                    InsertFace(&st, nodes, 4, iZone);
+                    InsertFace(st, fh, nodes, 4, iZone);
                     nodes[0] = zoneList[iZoneList+3];
                     nodes[1] = zoneList[iZoneList+2];
                     nodes[2] = zoneList[iZoneList+5];
                     nodes[3] = zoneList[iZoneList+4];
-                    InsertFace(&st, nodes, 4, iZone);
+                    InsertFace(st, fh, nodes, 4, iZone);
                     nodes[0] = zoneList[iZoneList+4];
                     nodes[1] = zoneList[iZoneList+5];
                     nodes[2] = zoneList[iZoneList+1];
                     nodes[3] = zoneList[iZoneList+0];
-                    InsertFace(&st, nodes, 4, iZone);
+                    InsertFace(st, fh, nodes, 4, iZone);
                     nodes[0] = zoneList[iZoneList+3];
                     nodes[1] = zoneList[iZoneList+4];
                     nodes[2] = zoneList[iZoneList+0];
-                    InsertFace(&st, nodes, 3, iZone);
+                    InsertFace(st, fh, nodes, 3, iZone);
                     nodes[0] = zoneList[iZoneList+1];
                     nodes[1] = zoneList[iZoneList+5];
                     nodes[2] = zoneList[iZoneList+2];
-                    InsertFace(&st, nodes, 3, iZone);
+                    InsertFace(st, fh, nodes, 3, iZone);
                     iZone++;
                     iZoneList += 6;
                 }
@@ -395,32 +584,32 @@ CalcExternalFaces(int *zoneList, int nNodes, int lowOffset, int highOffset,
                     nodes[1] = zoneList[iZoneList+3];
                     nodes[2] = zoneList[iZoneList+2];
                     nodes[3] = zoneList[iZoneList+1];
-                    InsertFace(&st, nodes, 4, iZone);
+                    InsertFace(st, fh, nodes, 4, iZone);
                     nodes[0] = zoneList[iZoneList+1];
                     nodes[1] = zoneList[iZoneList+2];
                     nodes[2] = zoneList[iZoneList+6];
                     nodes[3] = zoneList[iZoneList+5];
-                    InsertFace(&st, nodes, 4, iZone);
+                    InsertFace(st, fh, nodes, 4, iZone);
                     nodes[0] = zoneList[iZoneList+5];
                     nodes[1] = zoneList[iZoneList+6];
                     nodes[2] = zoneList[iZoneList+7];
                     nodes[3] = zoneList[iZoneList+4];
-                    InsertFace(&st, nodes, 4, iZone);
+                    InsertFace(st, fh, nodes, 4, iZone);
                     nodes[0] = zoneList[iZoneList+4];
                     nodes[1] = zoneList[iZoneList+7];
                     nodes[2] = zoneList[iZoneList+3];
                     nodes[3] = zoneList[iZoneList+0];
-                    InsertFace(&st, nodes, 4, iZone);
+                    InsertFace(st, fh, nodes, 4, iZone);
                     nodes[0] = zoneList[iZoneList+0];
                     nodes[1] = zoneList[iZoneList+1];
                     nodes[2] = zoneList[iZoneList+5];
                     nodes[3] = zoneList[iZoneList+4];
-                    InsertFace(&st, nodes, 4, iZone);
+                    InsertFace(st, fh, nodes, 4, iZone);
                     nodes[0] = zoneList[iZoneList+3];
                     nodes[1] = zoneList[iZoneList+7];
                     nodes[2] = zoneList[iZoneList+6];
                     nodes[3] = zoneList[iZoneList+2];
-                    InsertFace(&st, nodes, 4, iZone);
+                    InsertFace(st, fh, nodes, 4, iZone);
                     iZone++;
                     iZoneList += 8;
                 }
@@ -432,7 +621,7 @@ CalcExternalFaces(int *zoneList, int nNodes, int lowOffset, int highOffset,
                     for (k = 0; k < nFaces; k++)
                     {
                         nEdges = zoneList[iZoneList++];
-                        InsertFace(&st, &zoneList[iZoneList], nEdges, iZone);
+                        InsertFace(st, fh, &zoneList[iZoneList], nEdges, iZone);
                         iZoneList += nEdges;
                     }
                     iZone++;
@@ -444,7 +633,7 @@ CalcExternalFaces(int *zoneList, int nNodes, int lowOffset, int highOffset,
             case DB_ZONETYPE_POLYGON:
                 for (j = 0; j < shapeCnt[i]; j++)
                 {
-                    InsertFace(&st, &zoneList[iZoneList], shapeSize[i], iZone);
+                    InsertFace(st, fh, &zoneList[iZoneList], shapeSize[i], iZone);
                     iZoneList += shapeSize[i];
                     iZone++;
                 }
@@ -455,15 +644,36 @@ CalcExternalFaces(int *zoneList, int nNodes, int lowOffset, int highOffset,
                 break;
         }
     }
+}
 
-    /*
-     * Form a DBfacelist structure from the remaining faces.
-     */
-    faceList = FormFaceList(&st);
+/***********************************************************************
+ *
+ * Purpose:  Thread entry point hashing the faces of one partition.
+ *
+ * Input arguments:
+ *    arg      : The HashFacesJob to do.
+ *
+ * Output arguments:
+ *
+ * Input/Output arguments:
+ *
+ * Notes
+ *
+ * Modifications:
+ *
+ **********************************************************************/
 
-    return faceList;
+PRIVATE void *
+HashFaces(void *arg)
+{
+    HashFacesJob *job = (HashFacesJob *) arg;
+
+    WalkFaces(job->st, job->fh);
+
+    return NULL;
 }
 
+
 /***********************************************************************
  *
  * Purpose:  Form a DBfacelist structure from the remaining faces in
@@ -500,26 +710,23 @@ CalcExternalFaces(int *zoneList, int nNodes, int lowOffset, int highOffset,
 PRIVATE DBfacelist *
 FormFaceList(CalcExternalFacesState *st)
 {
-    int       i, j;
-    FaceHash  *faceHash=NULL;
+    int       i, j, k;
     int       origin;
     int       minIndex, maxIndex;
     int       nZones;
+    int       nBuckets;
     int       iFaceList;
     int       lFaceList;
     int       iFace;
     int       nFaces;
-    Face      firstFace;
-    Face      *prevFace=NULL, *curFace=NULL, *tmpFace=NULL;
-    int       zoneNoNext;
+    int       nAlloc;
+    Face      **faces=NULL;
     int       *faceList=NULL, *zoneNo=NULL;
-    int       curSize;
     int       nShapes;
     int       lShapeList;
     int       *shapeCnt=NULL, *shapeSize=NULL;
     DBfacelist *fl=NULL;
 
-    faceHash = &(st->faceHash);
     origin = st->origin;
 
     /*
@@ -532,56 +739,48 @@ FormFaceList(CalcExternalFacesState *st)
     maxIndex = nZones - st->highOffset - 1;
 
     /*
-     * Link all the faces into a list and determine the total number
+     * Gather the faces from all the tables, eliminating faces that are
+     * associated with ghost elements, and determine the total number of
      * faces and the total number of nodes in the resulting facelist.
-     * Faces that are associated with ghost elements are eliminated
-     * during the chaining process.  The first element in the list is
-     * an extra face that is allocated from the stack.  This eliminates
-     * special cases in the coding.  Once the faces have been linked
-     * together the hash table is no longer needed so it is freed.
      */
-    firstFace.nNodes = 0;
-    firstFace.nodes  = NULL;
-    firstFace.zoneNo = 0;
-    firstFace.next   = NULL;
-    curFace = &firstFace;
+    nAlloc = 0;
+    for (i = 0; i < st->nParts; i++)
+        nAlloc += st->faceHash[i].nUsed;
+    if (nAlloc > 0 && (faces = MALLOC_N(Face *, nAlloc)) == NULL)
+        return NULL;
+
+    nBuckets = MAX(1, MIN(st->nNodes, HASH_MAX));
     nFaces = 0;
     lFaceList = 0;
-    for (i = 0; i < faceHash->size; i++)
+    for (i = 0; i < st->nParts; i++)
     {
-        if (faceHash->table[i] != NULL)
+        FaceHash *fh = &st->faceHash[i];
+        for (j = 0; j < fh->size; j++)
         {
-            curFace->next = faceHash->table[i];
-            while (curFace->next != NULL)
-            {
-                /*
-                 * If the face came from a real zone, add it to
-                 * the list, otherwise delete it.
-                 */
-                zoneNoNext = curFace->next->zoneNo;
-                if (zoneNoNext >= minIndex && zoneNoNext <= maxIndex)
-                {
-                    nFaces++;
-                    lFaceList += curFace->nNodes;
-                    curFace = curFace->next;
-                }
-                else
-                {
-                    tmpFace = curFace->next;
-                    curFace->next = tmpFace->next;
-                    FreeFace(tmpFace);
-                }
-            }
+            Face *face;
+
+            if (fh->table[j] == 0)
+                continue;
+            face = &fh->pool[fh->table[j]-1];
+            if (face->zoneNo < minIndex || face->zoneNo > maxIndex)
+                continue;
+
+            /*
+             * The hash key isn't needed any more.  Reuse it to hold the
+             * bucket the face would have had in the chained table.
+             */
+            face->key = (unsigned) (FACE_NODES(face)[0] % nBuckets);
+            faces[nFaces++] = face;
+            lFaceList += face->nNodes;
         }
     }
-    lFaceList += curFace->nNodes;
-    FREE(faceHash->table);
-    faceHash->size = 0;
+    if (nFaces > 1)
+        qsort(faces, nFaces, sizeof(Face *), CompareFaces);
 
     /*
      * Build the arrays necessary for the DBfacelist structure.  Loop
-     * over all the faces, extracting all the faces of a particular type
-     * each time until all the faces have been extracted.
+     * over the faces once for each face size in the order the sizes
+     * first appear, extracting all the faces of that size.
      */
     nShapes    = 0;
     lShapeList = 10;
@@ -592,11 +791,14 @@ FormFaceList(CalcExternalFacesState *st)
         faceList   = MALLOC_N(int, lFaceList);
         zoneNo     = MALLOC_N(int, nFaces);
     }
-    iFace      = 0;
-    iFaceList  = 0;
 
-    while (firstFace.next != NULL)
+    for (i = 0; i < nFaces; i++)
     {
+        for (j = 0; j < nShapes; j++)
+            if (shapeSize[j] == faces[i]->nNodes) break;
+        if (j < nShapes)
+            continue;
+
         /*
          * Allocate more space for the shape structures if necessary.
          */
@@ -606,44 +808,34 @@ FormFaceList(CalcExternalFacesState *st)
             shapeSize = REALLOC_N(shapeSize, int, lShapeList);
             shapeCnt  = REALLOC_N(shapeCnt, int, lShapeList);
         }
-
-        /*
-         * Add an entry in the shape structure for the current shape
-         * type.
-         */
-        prevFace = &firstFace;
-        curFace  = firstFace.next;
-        curSize  = curFace->nNodes;
-        shapeSize[nShapes] = curSize;
+        shapeSize[nShapes] = faces[i]->nNodes;
         shapeCnt[nShapes]  = 0;
+        nShapes++;
+    }
 
-        /*
-         * Loop over all the faces, adding all the faces with the current
-         * size to the output face list and removing them from the input
-         * list of faces.
-         */
-        while (curFace != NULL)
+    iFace      = 0;
+    iFaceList  = 0;
+    for (j = 0; j < nShapes; j++)
+    {
+        for (i = 0; i < nFaces; i++)
         {
-            if (curFace->nNodes == curSize)
+            Face *face = faces[i];
+            int  *nodes;
+
+            if (face->nNodes != shapeSize[j])
+                continue;
+            nodes = FACE_NODES(face);
+            shapeCnt[j] += 1;
+            zoneNo[iFace] = face->zoneNo + origin;
+            iFace++;
+            for (k = 0; k < face->nNodes; k++)
             {
-                shapeCnt[nShapes] += 1;
-                zoneNo[iFace] = curFace->zoneNo + origin;
-                iFace++;
-                for (j = 0; j < curSize; j++)
-                {
-                    faceList[iFaceList+j] = curFace->nodes[j];
-                }
-                iFaceList += curSize;
-                prevFace->next = curFace->next;
-                FreeFace(curFace);
-                curFace = prevFace;
+                faceList[iFaceList+k] = nodes[k];
             }
-            prevFace = curFace;
-            curFace = curFace->next;
+            iFaceList += face->nNodes;
         }
-
-        nShapes++;
     }
+    FREE(faces);
 
     /*
      * Put all the pieces together into the DBfacelist structure.
@@ -663,6 +855,40 @@ FormFaceList(CalcExternalFacesState *st)
     return fl;
 }
 
+/***********************************************************************
+ *
+ * Purpose:  Order faces by the bucket they would have had in the
+ *           chained hash table and, within a bucket, from the most to
+ *           the least recently inserted.
+ *
+ * Input arguments:
+ *    a        : Pointer to the first face pointer.
+ *    b        : Pointer to the second face pointer.
+ *
+ * Output arguments:
+ *
+ * Input/Output arguments:
+ *
+ * Notes
+ *
+ * Modifications:
+ *
+ **********************************************************************/
+
+PRIVATE int
+CompareFaces(const void *a, const void *b)
+{
+    Face const *fa = *(Face * const *) a;
+    Face const *fb = *(Face * const *) b;
+
+    if (fa->key != fb->key)
+        return fa->key < fb->key ? -1 : 1;
+    if (fa->seq != fb->seq)
+        return fa->seq > fb->seq ? -1 : 1;
+    return 0;
+}
+
+
 /***********************************************************************
  *
  * Purpose:  Insert a face into the face hash table.  If the face is
@@ -674,6 +900,7 @@ FormFaceList(CalcExternalFacesState *st)
  *
  * Input arguments:
  *    st       : The external facelist state.
+ *    fh       : The face table.
  *    nodes    : The nodes making up the face.
  *    nNodes   : The number of nodes in the face.
  *    zoneNo   : The zone number associated with the face.
@@ -689,131 +916,287 @@ FormFaceList(CalcExternalFacesState *st)
  **********************************************************************/
 
 PRIVATE void
-InsertFace(CalcExternalFacesState *st, int *nodes, int nNodes, int zoneNo)
+InsertFace(CalcExternalFacesState *st, FaceHash *fh, int *nodes, int nNodes,
+           int zoneNo)
 {
     int       i, j;
-    FaceHash  *faceHash=NULL;
-    int       bndMethod;
-    int       *matList;
     int       iMin;
-    int       match;
-    int       deleteIt;
-    Face      *prevFace=NULL, *curFace=NULL;
+    int       seq;
+    int       slot, mask;
+    int       iMatch, matchSeq;
+    int       iFace;
+    int       *faceNodes;
+    unsigned  key, sum;
+    Face      *face=NULL;
 
-    faceHash  = &(st->faceHash);
-    bndMethod = st->bndMethod;
-    matList   = st->matList;
+    seq = fh->seq++;
+    if (fh->failed)
+        return;
 
     /*
      * Find index of the minimum node number in the node list
-     * for the face.  Since it is used to index into the hash
-     * table and as the starting point for performing a match.
+     * for the face.  It selects the partition and is the starting
+     * point for performing a match.
      */
     iMin = 0;
+    sum = (unsigned) nodes[0];
     for (i = 1; i < nNodes; i++)
     {
         if (nodes[i] < nodes[iMin]) iMin = i;
+        sum += (unsigned) nodes[i];
     }
+    if (fh->nParts > 1 && nodes[iMin] % fh->nParts != fh->part)
+        return;
+
+    /*
+     * The key depends on the face's nodes but not on their order so
+     * that a face and its reverse hash together.
+     */
+    key = (unsigned) nodes[iMin] * 0x9E3779B1u ^
+          (sum + (unsigned) nNodes) * 0x85EBCA77u;
+    key ^= key >> 16;
+    key *= 0x7FEB352Du;
+    key ^= key >> 15;
 
     /*
-     * Search the list of faces in the linked list of possible
-     * matches for a match.
+     * Search the probe sequence for a match, which is a face with the
+     * same nodes in the reverse order.  If there are several, use the
+     * most recently inserted one.
      */
-    curFace = faceHash->table[nodes[iMin] % faceHash->size];
-    match = 0;
-    while (match == 0 && curFace != NULL)
+    mask = fh->size - 1;
+    iMatch = -1;
+    matchSeq = -1;
+    for (slot = key & mask; fh->table[slot] != 0; slot = (slot + 1) & mask)
     {
-        if (curFace->nNodes == nNodes)
+        face = &fh->pool[fh->table[slot]-1];
+        if (face->key != key || face->nNodes != nNodes || face->seq < matchSeq)
+            continue;
+        faceNodes = FACE_NODES(face);
+        if (faceNodes[0] != nodes[iMin])
+            continue;
+        j = (iMin + nNodes - 1) % nNodes;
+        for (i = 1; i < nNodes; i++)
         {
-            match = 1;
-            j = (iMin + nNodes - 1) % nNodes;
-            for (i = 1; i < nNodes && match == 1; i++)
-            {
-                match = (curFace->nodes[i] == nodes[j]);
-                j = (j + nNodes - 1) % nNodes;
-            }
+            if (faceNodes[i] != nodes[j]) break;
+            j = (j + nNodes - 1) % nNodes;
         }
-
-        if (match == 0)
+        if (i == nNodes)
         {
-            prevFace = curFace;
-            curFace = curFace->next;
+            iMatch = slot;
+            matchSeq = face->seq;
         }
     }
 
     /*
-     * Determine if the face should be deleted based on getting
-     * a match and the bndMethod.
+     * Delete the matching face if there is one and the bndMethod
+     * agrees.  Otherwise add the new face.
      */
-    deleteIt = 0;
-    if (match == 1)
+    if (iMatch >= 0)
     {
-        if (bndMethod == 0)
-        {
-            deleteIt = 1;
-        }
-        else if (matList[curFace->zoneNo] == matList[zoneNo])
+        face = &fh->pool[fh->table[iMatch]-1];
+        if (st->bndMethod == 0 ||
+            st->matList[face->zoneNo] == st->matList[zoneNo])
         {
-            deleteIt = 1;
+            DeleteFace(fh, iMatch);
+            return;
         }
     }
-        
-    /*
-     * Either delete the matching face or add the new one based on
-     * the deleteIt flag.
-     */
-    if (deleteIt == 1)
+
+    if (2 * (fh->nUsed + 1) > fh->size)
     {
-        /*
-         * Delete the face.
-         */
-        if (prevFace == NULL)
+        if (GrowFaceHash(fh) != 0)
+            return;
+        mask = fh->size - 1;
+        for (slot = key & mask; fh->table[slot] != 0; slot = (slot + 1) & mask)
+            ;
+    }
+
+    if ((iFace = AllocFace(fh)) < 0)
+        return;
+    face = &fh->pool[iFace];
+    face->nNodes = nNodes;
+    face->zoneNo = zoneNo;
+    face->seq    = seq;
+    face->key    = key;
+    face->xnodes = NULL;
+    if (nNodes > FACE_NODES_INLINE &&
+        (face->xnodes = MALLOC_N(int, nNodes)) == NULL)
+    {
+        face->nNodes = 0;
+        FreeFace(fh, iFace);
+        fh->failed = 1;
+        return;
+    }
+    faceNodes = FACE_NODES(face);
+    for (i = 0, j = iMin; i < nNodes; i++, j = (j + 1) % nNodes)
+    {
+        faceNodes[i] = nodes[j];
+    }
+    fh->table[slot] = iFace + 1;
+    fh->nUsed++;
+}
+
+/***********************************************************************
+ *
+ * Purpose:  Delete the face in a slot of a face table, shifting back
+ *           any faces later in its probe sequence to fill the hole.
+ *
+ * Input arguments:
+ *    slot     : The slot of the face to delete.
+ *
+ * Output arguments:
+ *
+ * Input/Output arguments:
+ *    fh       : The face table.
+ *
+ * Notes
+ *
+ * Modifications:
+ *
+ **********************************************************************/
+
+PRIVATE void
+DeleteFace(FaceHash *fh, int slot)
+{
+    int       mask = fh->size - 1;
+    int       hole, next, home;
+
+    FreeFace(fh, fh->table[slot]-1);
+    fh->nUsed--;
+
+    hole = slot;
+    next = slot;
+    for (;;)
+    {
+        fh->table[hole] = 0;
+        for (;;)
         {
+            next = (next + 1) & mask;
+            if (fh->table[next] == 0)
+                return;
+            home = fh->pool[fh->table[next]-1].key & mask;
+
             /*
-             * The previous element is the beginning of the list.
+             * The face can fill the hole unless its home slot lies
+             * cyclically after the hole and at or before its slot.
              */
-            faceHash->table[nodes[iMin] % faceHash->size] = curFace->next;
+            if (hole <= next ? (hole < home && home <= next)
+                             : (hole < home || home <= next))
+                continue;
+            break;
         }
-        else
-        {
-            /*
-             * The previous element is in the middle of the list.
-             */
-            prevFace->next = curFace->next;
-        } 
-        FreeFace(curFace);
+        fh->table[hole] = fh->table[next];
+        hole = next;
     }
-    else
+}
+
+/***********************************************************************
+ *
+ * Purpose:  Initialize an empty face table for one partition of the
+ *           faces, sized from the number of zones.
+ *
+ * Input arguments:
+ *    nZones   : The number of zones in the mesh.
+ *    part     : The partition of faces the table holds.
+ *    nParts   : The number of partitions.
+ *
+ * Output arguments:
+ *    fh       : The face table.
+ *
+ * Input/Output arguments:
+ *
+ * Notes
+ *    Returns 0 on success and -1 if allocation fails.
+ *
+ * Modifications:
+ *
+ **********************************************************************/
+
+PRIVATE int
+InitFaceHash(FaceHash *fh, int nZones, int part, int nParts)
+{
+    int       size;
+
+    size = FACE_TABLE_MIN;
+    while (size < FACE_TABLE_MAX_INIT && size / 2 < nZones / nParts + 1)
+        size *= 2;
+
+    memset(fh, 0, sizeof(FaceHash));
+    fh->part     = part;
+    fh->nParts   = nParts;
+    fh->freeFace = -1;
+    fh->size     = size;
+    fh->table    = (int *) calloc(size, sizeof(int));
+    fh->poolSize = size / 2;
+    fh->pool     = MALLOC_N(Face, fh->poolSize);
+    if (fh->table == NULL || fh->pool == NULL)
     {
-        /*
-         * Add the face.
-         */
-        curFace = AllocFace();
-        curFace->nNodes = nNodes;
-        curFace->nodes = MALLOC_N(int, nNodes);
-        for (i = 0, j = iMin; i < nNodes; i++, j = (j + 1) % nNodes)
-        {
-            curFace->nodes[i] = nodes[j];
-        }
-        curFace->zoneNo = zoneNo;
-        curFace->next = faceHash->table[nodes[iMin] % faceHash->size];
-        faceHash->table[nodes[iMin] % faceHash->size] = curFace;
+        fh->failed = 1;
+        return -1;
     }
+
+    return 0;
 }
 
 /***********************************************************************
  *
- * Purpose:  Free a Face structure.
+ * Purpose:  Double the size of a face table and rehash its faces.
  *
- * Programmer: Eric Brugger
- * Date:       March 12, 1999
+ * Input arguments:
+ *
+ * Output arguments:
+ *
+ * Input/Output arguments:
+ *    fh       : The face table.
+ *
+ * Notes
+ *    Returns 0 on success and -1 if allocation fails.
+ *
+ * Modifications:
+ *
+ **********************************************************************/
+
+PRIVATE int
+GrowFaceHash(FaceHash *fh)
+{
+    int       i, slot;
+    int       size = fh->size * 2;
+    int       mask = size - 1;
+    int       *table;
+
+    if (size <= 0 || (table = (int *) calloc(size, sizeof(int))) == NULL)
+    {
+        fh->failed = 1;
+        return -1;
+    }
+
+    for (i = 0; i < fh->size; i++)
+    {
+        if (fh->table[i] == 0)
+            continue;
+        slot = fh->pool[fh->table[i]-1].key & mask;
+        while (table[slot] != 0)
+            slot = (slot + 1) & mask;
+        table[slot] = fh->table[i];
+    }
+
+    FREE(fh->table);
+    fh->table = table;
+    fh->size  = size;
+
+    return 0;
+}
+
+/***********************************************************************
+ *
+ * Purpose:  Free a face table along with all the faces in it.
  *
  * Input arguments:
- *    face     : The face to free.
  *
  * Output arguments:
  *
  * Input/Output arguments:
+ *    fh       : The face table.
  *
  * Notes
  *
@@ -822,26 +1205,61 @@ InsertFace(CalcExternalFacesState *st, int *nodes, int nNodes, int zoneNo)
  **********************************************************************/
 
 PRIVATE void
-FreeFace(Face *face)
+FreeFaceHash(FaceHash *fh)
 {
+    int       i;
 
-    FREE(face->nodes);
-    FREE(face);
+    for (i = 0; fh->table != NULL && i < fh->size; i++)
+    {
+        if (fh->table[i] != 0)
+            FREE(fh->pool[fh->table[i]-1].xnodes);
+    }
+    FREE(fh->table);
+    FREE(fh->pool);
+    fh->size = 0;
+    fh->nUsed = 0;
 }
 
 /***********************************************************************
  *
- * Purpose:  Allocate a Face structure.
+ * Purpose:  Return a face to the pool of a face table.
  *
- * Programmer: Eric Brugger
- * Date:       March 12, 1999
+ * Input arguments:
+ *    iFace    : The index of the face in the pool.
+ *
+ * Output arguments:
+ *
+ * Input/Output arguments:
+ *    fh       : The face table.
+ *
+ * Notes
+ *
+ * Modifications:
+ *
+ **********************************************************************/
+
+PRIVATE void
+FreeFace(FaceHash *fh, int iFace)
+{
+    Face      *face = &fh->pool[iFace];
+
+    FREE(face->xnodes);
+    face->zoneNo = fh->freeFace;
+    fh->freeFace = iFace;
+}
+
+/***********************************************************************
+ *
+ * Purpose:  Allocate a face from the pool of a face table.
  *
  * Input arguments:
  *
  * Output arguments:
- *    face     : The newly allocated face.
+ *    iFace    : The index of the newly allocated face in the pool, or
+ *               -1 if allocation fails.
  *
  * Input/Output arguments:
+ *    fh       : The face table.
  *
  * Notes
  *
@@ -849,12 +1267,30 @@ FreeFace(Face *face)
  *
  **********************************************************************/
 
-PRIVATE Face *
-AllocFace(void)
+PRIVATE int
+AllocFace(FaceHash *fh)
 {
-    Face      *face=NULL;
+    int       iFace;
+    Face      *pool;
+
+    if (fh->freeFace >= 0)
+    {
+        iFace = fh->freeFace;
+        fh->freeFace = fh->pool[iFace].zoneNo;
+        return iFace;
+    }
 
-    face = MALLOC_N(Face, 1);
+    if (fh->nPool == fh->poolSize)
+    {
+        pool = REALLOC_N(fh->pool, Face, 2 * fh->poolSize);
+        if (pool == NULL)
+        {
+            fh->failed = 1;
+            return -1;
+        }
+        fh->pool = pool;
+        fh->poolSize *= 2;
+    }
 
-    return face;
+    return fh->nPool++;
 }
@@ -121,10 +121,27 @@ product endorsement purposes.
  * processor then returns from the PMPIO_WaitForBaton() call it is waiting.
  * This process continues with each processor in a group handing off a baton
  * to the next processor.
+ *
+ * A baton obtained from PMPIO_InitAggregate() instead runs the group in
+ * /aggregating/ mode. There, no processor waits on its predecessor. The
+ * first processor in each group creates the file and all others build their
+ * piece in a private, in-memory file, simultaneously. When they hand off
+ * the baton, the others ship their in-memory file /images/ to the first
+ * processor which splices each one into the shared file. Only one
+ * processor per group ever touches the filesystem.
  *-----------------------------------------------------------------------------
  */
 
+#include <limits.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+/* Images are shipped in messages of at most this many bytes, so that no
+   message count overflows an int. A shorter message ends the image. */
+#ifndef PMPIO_IMAGE_PIECE
+#define PMPIO_IMAGE_PIECE (1<<30)
+#endif
 
 /*-----------------------------------------------------------------------------
  * Audience:    Public
@@ -199,6 +216,63 @@ typedef void * (*PMPIO_OpenFileCallBack)(const char *fname, const char *nsname,
  */
 typedef void  (*PMPIO_CloseFileCallBack)(void *file, void *udata);
 
+/*-----------------------------------------------------------------------------
+ * Audience:    Public
+ * Chapter:     Create Image Callback
+ * Description:
+ * Defines the create image callback interface used only in aggregating
+ * mode. It should 1) create a file in memory, 2) create the namespace in
+ * it for the current processor to write to and 3) set the file to that
+ * namespace. It is called on every processor of a group except the first.
+ *
+ *     typedef void * (*PMPIO_CreateImageCallBack)(
+ *         const char *nsname, name of the namespace in the file to create
+ *         void *udata         optional, user data passed by PMPIO
+ *     );
+ *-----------------------------------------------------------------------------
+ */
+typedef void * (*PMPIO_CreateImageCallBack)(const char *nsname, void *udata);
+
+/*-----------------------------------------------------------------------------
+ * Audience:    Public
+ * Chapter:     Close Image Callback
+ * Description:
+ * Defines the close image callback interface used only in aggregating mode.
+ * It should close the in-memory file and return its contents as a buffer
+ * allocated with malloc(), which PMPIO will free. It returns 0 on failure.
+ *
+ *     typedef void * (*PMPIO_CloseImageCallBack)(
+ *         void *file,   pointer to the in-memory file object to close
+ *         size_t *size, returned size, in bytes, of the image
+ *         void *udata   optional user data passed by PMPIO
+ *     );
+ *-----------------------------------------------------------------------------
+ */
+typedef void * (*PMPIO_CloseImageCallBack)(void *file, size_t *size, void *udata);
+
+/*-----------------------------------------------------------------------------
+ * Audience:    Public
+ * Chapter:     Splice Image Callback
+ * Description:
+ * Defines the splice image callback interface used only in aggregating
+ * mode. It is called on the first processor of a group, once for each
+ * image another processor of the group shipped to it, and should copy the
+ * namespace named nsname from the image into the shared file. The callback
+ * takes ownership of the image, a buffer allocated with malloc(), and must
+ * free() it.
+ *
+ *     typedef void  (*PMPIO_SpliceImageCallBack)(
+ *         void *file,         pointer to the shared file object
+ *         const char *nsname, name of the namespace the image holds
+ *         void *image,        the image returned by the close image callback
+ *         size_t size,        size, in bytes, of the image
+ *         void *udata         optional user data passed by PMPIO
+ *     );
+ *-----------------------------------------------------------------------------
+ */
+typedef void  (*PMPIO_SpliceImageCallBack)(void *file, const char *nsname,
+                                           void *image, size_t size, void *udata);
+
 typedef struct _PMPIO_baton_t
 {
     PMPIO_iomode_t ioMode;
@@ -219,6 +293,12 @@ typedef struct _PMPIO_baton_t
     PMPIO_OpenFileCallBack openCb;
     PMPIO_CloseFileCallBack closeCb;
     void *userData;
+    int aggregate;
+    int groupCount;
+    PMPIO_CreateImageCallBack createImageCb;
+    PMPIO_CloseImageCallBack closeImageCb;
+    PMPIO_SpliceImageCallBack spliceImageCb;
+    char *nsName;
 
 } PMPIO_baton_t;
 
@@ -288,7 +368,7 @@ PMPIO_Init(
     int numGroups = numFiles;
     int commSize, rankInComm;
     int groupSize, numGroupsWithExtraProc, commSplit,
-        groupRank, rankInGroup, procBeforeMe, procAfterMe;
+        groupRank, rankInGroup, procBeforeMe, procAfterMe, groupCount;
     PMPIO_baton_t *ret = 0;
 
     procBeforeMe = -1;
@@ -305,6 +385,7 @@ PMPIO_Init(
     {
         groupRank = rankInComm / (groupSize + 1);
         rankInGroup = rankInComm % (groupSize + 1);
+        groupCount = groupSize + 1;
         if (rankInGroup < groupSize)
             procAfterMe = rankInComm + 1;
     }
@@ -312,6 +393,7 @@ PMPIO_Init(
     {
         groupRank = numGroupsWithExtraProc + (rankInComm - commSplit) / groupSize; 
         rankInGroup = (rankInComm - commSplit) % groupSize;
+        groupCount = groupSize;
         if (rankInGroup < groupSize - 1)
             procAfterMe = rankInComm + 1;
     }
@@ -340,6 +422,82 @@ PMPIO_Init(
     ret->openCb = openCb;
     ret->closeCb = closeCb;
     ret->userData = userData;
+    ret->aggregate = 0;
+    ret->groupCount = groupCount;
+    ret->createImageCb = 0;
+    ret->closeImageCb = 0;
+    ret->spliceImageCb = 0;
+    ret->nsName = 0;
+
+    return ret;
+}
+
+/* Aggregating batons never open the shared file on other than the first
+   processor of a group. This stands in for the unused open callback. */
+static void *
+PMPIO_AggregateOpen(const char *fname, const char *nsname,
+    PMPIO_iomode_t ioMode, void *userData)
+{
+    return 0;
+}
+
+/*-----------------------------------------------------------------------------
+ * Audience:    Public
+ * Chapter:     Initialization 
+ * Purpose:     Initialize an aggregating PMPIO baton
+ * Description:
+ * Like PMPIO_Init() for PMPIO_WRITE but returns a baton that runs each
+ * group in /aggregating/ mode. Instead of waiting its turn to open the
+ * shared file, each processor other than the first in its group writes its
+ * piece to an in-memory file obtained from the create image callback, as
+ * soon as it calls PMPIO_WaitForBaton(). In PMPIO_HandOffBaton(), it turns
+ * that file into an image with the close image callback and ships the image
+ * to the first processor of its group. The first processor creates the
+ * shared file and writes its own piece, as usual. In its PMPIO_HandOffBaton()
+ * it receives the images of all others in the group, in whatever order they
+ * arrive, and passes each to the splice image callback before closing the
+ * shared file with the close callback.
+ *
+ * This trades memory on the first processor of each group, which holds one
+ * image at a time, for the serialization of ordinary baton passing.
+ *
+ * All processors should call this function with identical arguments otherwise
+ * behavior is undefined. The call returns immediatly on all processors.
+ *-----------------------------------------------------------------------------
+ */
+static PMPIO_baton_t *
+PMPIO_InitAggregate(
+    int numFiles,                               /* The number of files to be created */
+    MPI_Comm mpiComm,                           /* The MPI communicator PMPIO should use */
+    int mpiTag,                                 /* The message tag PMPIO should use for its image messages. */
+    PMPIO_CreateFileCallBack createCb,          /* The create file callback, called on the first processor
+                                                   of each group only. */
+    PMPIO_CloseFileCallBack closeCb,            /* The close file callback, called on the first processor
+                                                   of each group after all images are spliced. */
+    PMPIO_CreateImageCallBack createImageCb,    /* The create image callback, called on all but the first
+                                                   processor of each group. */
+    PMPIO_CloseImageCallBack closeImageCb,      /* The close image callback, called on all but the first
+                                                   processor of each group. */
+    PMPIO_SpliceImageCallBack spliceImageCb,    /* The splice image callback, called on the first processor
+                                                   of each group once for each image it receives. */
+    void *userData                              /* Optional, user-specified data that PMPIO passes into the
+                                                   callbacks. Pass 0 if you have no need for this. */
+    )
+{
+    PMPIO_baton_t *ret = 0;
+
+    if (createImageCb == 0 || closeImageCb == 0 || spliceImageCb == 0)
+        return 0;
+
+    ret = PMPIO_Init(numFiles, PMPIO_WRITE, mpiComm, mpiTag, createCb,
+              PMPIO_AggregateOpen, closeCb, userData);
+    if (ret == 0)
+        return 0;
+
+    ret->aggregate = 1;
+    ret->createImageCb = createImageCb;
+    ret->closeImageCb = closeImageCb;
+    ret->spliceImageCb = spliceImageCb;
 
     return ret;
 }
@@ -357,6 +515,8 @@ PMPIO_Finish(
     PMPIO_baton_t *bat
 )
 {
+    if (bat)
+        free(bat->nsName);
     free(bat);
 }
 
@@ -370,6 +530,10 @@ PMPIO_Finish(
  * in each group. All other processors in a group will block, waiting to get
  * the baton from their predecessor. To give up the baton, a processor must
  * call PMPIO_HandOffBaton().
+ *
+ * For an aggregating baton, this call returns immediately on all processors.
+ * The first processor in each group gets the shared file from the create
+ * callback, all others get an in-memory file from the create image callback.
  *-----------------------------------------------------------------------------
  */
 static void *
@@ -379,7 +543,15 @@ PMPIO_WaitForBaton(
     const char *nsname          /* The name of the namespace in the file this processor will work on. */
 )
 {
-    if (Bat->procBeforeMe != -1)
+    if (Bat->aggregate)
+    {
+        if (Bat->rankInGroup == 0)
+            return Bat->createCb(fname, nsname, Bat->userData);
+        free(Bat->nsName);
+        Bat->nsName = strdup(nsname ? nsname : "");
+        return Bat->createImageCb(nsname, Bat->userData);
+    }
+    else if (Bat->procBeforeMe != -1)
     {
         MPI_Status mpi_stat;
         int baton;
@@ -412,6 +584,15 @@ PMPIO_WaitForBaton(
  * Description:
  * Causes the calling processor to hand off its baton to the next processor. 
  * This call returns immediately.
+ *
+ * For an aggregating baton, all but the first processor in each group close
+ * their in-memory file and send its image, preceded by the name of the
+ * namespace it holds, to the first processor. The first processor receives
+ * and splices all the images of its group before closing the shared file.
+ * An image is sent in pieces of PMPIO_IMAGE_PIECE bytes, ending with a
+ * shorter, possibly empty, piece. A processor whose image could not be
+ * obtained sends an empty one, which is not spliced, so that the first
+ * processor does not wait on it forever.
  *-----------------------------------------------------------------------------
  */
 static void
@@ -421,8 +602,66 @@ PMPIO_HandOffBaton(
                                    from a PMPIO_WaitForBaton() call. */
 )
 {
+    if (Bat->aggregate && Bat->rankInGroup > 0)
+    {
+        size_t size = 0, off = 0, n;
+        void *image = Bat->closeImageCb(file, &size, Bat->userData);
+        int leader = Bat->rankInComm - Bat->rankInGroup;
+        MPI_Send(Bat->nsName, (int) strlen(Bat->nsName) + 1, MPI_CHAR, leader,
+            Bat->mpiTag, Bat->mpiComm);
+        if (!image)
+            size = 0;
+        do
+        {
+            n = size - off < PMPIO_IMAGE_PIECE ? size - off : PMPIO_IMAGE_PIECE;
+            MPI_Send(n ? (char *) image + off : image, (int) n, MPI_BYTE, leader,
+                Bat->mpiTag, Bat->mpiComm);
+            off += n;
+        } while (n == PMPIO_IMAGE_PIECE);
+        free(image);
+        return;
+    }
+    else if (Bat->aggregate)
+    {
+        int i;
+
+        /* Each member sends two messages, its namespace name and then its
+           image. Since messages from one sender arrive in order, receiving
+           the image from the sender of the name just received pairs them. */
+        for (i = 1; i < Bat->groupCount; i++)
+        {
+            MPI_Status mpi_stat;
+            int src, count = 0;
+            char *nsname, *image = 0;
+            size_t size = 0;
+
+            MPI_Probe(MPI_ANY_SOURCE, Bat->mpiTag, Bat->mpiComm, &mpi_stat);
+            src = mpi_stat.MPI_SOURCE;
+            MPI_Get_count(&mpi_stat, MPI_CHAR, &count);
+            nsname = (char *) malloc(count + 1);
+            MPI_Recv(nsname, count, MPI_CHAR, src, Bat->mpiTag, Bat->mpiComm, &mpi_stat);
+            nsname[count] = '\0';
+
+            do
+            {
+                MPI_Probe(src, Bat->mpiTag, Bat->mpiComm, &mpi_stat);
+                MPI_Get_count(&mpi_stat, MPI_BYTE, &count);
+                image = (char *) realloc(image, size + count + 1);
+                MPI_Recv(image + size, count, MPI_BYTE, src, Bat->mpiTag,
+                    Bat->mpiComm, &mpi_stat);
+                size += count;
+            } while (count == PMPIO_IMAGE_PIECE);
+
+            if (size > 0)
+                Bat->spliceImageCb(file, nsname, image, size, Bat->userData);
+            else
+                free(image);
+            free(nsname);
+        }
+    }
+
     Bat->closeCb(file, Bat->userData);
-    if (Bat->procAfterMe != -1)
+    if (!Bat->aggregate && Bat->procAfterMe != -1)
     {
         int baton = Bat->mpiVal;
         MPI_Ssend(&baton, 1, MPI_INT, Bat->procAfterMe,
@@ -549,6 +788,99 @@ PMPIO_DefaultClose(void *file, void *userData)
     if (siloFile)
         DBClose(siloFile);
 }
+
+/*-----------------------------------------------------------------------------
+ * Audience:    Public
+ * Chapter:     Callbacks
+ * Purpose:     Impliment the create image callback
+ *
+ * Description: Creates an HDF5 file in memory with the core VFD and no
+ * backing store. Aggregating batons require the HDF5 driver.
+ *-----------------------------------------------------------------------------
+ */
+static void *
+PMPIO_DefaultCreateImage(const char *nsname, void *userData)
+{
+    int vfd = DB_H5VFD_CORE, on = 1, optset;
+    DBoptlist *opts = DBMakeOptlist(2);
+    DBfile *siloFile;
+
+    DBAddOption(opts, DBOPT_H5_VFD, &vfd);
+    DBAddOption(opts, DBOPT_H5_CORE_NO_BACK_STORE, &on);
+    optset = DBRegisterFileOptionsSet(opts);
+    siloFile = DBCreate(nsname, DB_CLOBBER, DB_LOCAL, "PMPIO_DefaultCreateImage",
+        DB_HDF5_OPTS(optset));
+    DBUnregisterFileOptionsSet(optset);
+    DBFreeOptlist(opts);
+    if (siloFile && nsname)
+    {
+        DBMkDir(siloFile, nsname);
+        DBSetDir(siloFile, nsname);
+    }
+    return (void *) siloFile;
+}
+
+/*-----------------------------------------------------------------------------
+ * Audience:    Public
+ * Chapter:     Callbacks
+ * Purpose:     Impliment the close image callback
+ *-----------------------------------------------------------------------------
+ */
+static void *
+PMPIO_DefaultCloseImage(void *file, size_t *size, void *userData)
+{
+    DBfile *siloFile = (DBfile *) file;
+    void *image = 0;
+    if (siloFile)
+    {
+        if (DBGetFileImage(siloFile, &image, size) < 0)
+            image = 0;
+        DBClose(siloFile);
+    }
+    return image;
+}
+
+/*-----------------------------------------------------------------------------
+ * Audience:    Public
+ * Chapter:     Callbacks
+ * Purpose:     Impliment the splice image callback
+ *
+ * Description: Opens the image with the FIC VFD, which takes ownership of
+ * it, and copies its namespace to the root of the shared file with DBCpDir.
+ * The FIC VFD takes an int size, so larger images are reported and dropped.
+ *-----------------------------------------------------------------------------
+ */
+static void
+PMPIO_DefaultSpliceImage(void *file, const char *nsname, void *image,
+    size_t size, void *userData)
+{
+    int vfd = DB_H5VFD_FIC, isize = (int) size, optset, dw;
+    DBoptlist *opts;
+    DBfile *imageFile;
+
+    if (size > INT_MAX)
+    {
+        fprintf(stderr, "PMPIO: image of \"%s\" is too large to splice\n", nsname);
+        free(image);
+        return;
+    }
+    opts = DBMakeOptlist(3);
+
+    DBAddOption(opts, DBOPT_H5_VFD, &vfd);
+    DBAddOption(opts, DBOPT_H5_FIC_SIZE, &isize);
+    DBAddOption(opts, DBOPT_H5_FIC_BUF, image);
+    optset = DBRegisterFileOptionsSet(opts);
+    imageFile = DBOpen(nsname, DB_HDF5_OPTS(optset), DB_READ);
+    if (imageFile)
+    {
+        dw = DBSetDeprecateWarnings(0);
+        DBCpDir(imageFile, nsname, (DBfile *) file, DBSPrintf("/%s", nsname));
+        DBSetDeprecateWarnings(dw);
+        DBClose(imageFile);
+    }
+    DBUnregisterFileOptionsSet(optset);
+    DBFreeOptlist(opts);
+}
 #endif
 
 #endif
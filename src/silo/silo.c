@@ -255,6 +255,7 @@ typedef struct db_silo_stat_t {
 
 /* Forward declarations */
 PRIVATE int db_isregistered_file(DBfile *dbfile, const db_silo_stat_t *filestate);
+PRIVATE void db_FreeTocCache(DBfile *dbfile);
 
 /* Global structures for option lists.  */
 struct _ma     _ma;
@@ -311,9 +312,55 @@ SILO_Globals_t SILO_Globals = {
     0,     /* _db_err_func */
     DB_NONE,/* _db_err_level_drvr */
     0,     /* Jstk */
-    DEFAULT_DRIVER_PRIORITIES
+    DEFAULT_DRIVER_PRIORITIES,
+    1,     /* facelistThreads */
+    FALSE, /* tocNamesOnly */
+    8,     /* maxCachedFiles */
+    16,    /* pdbObjectCacheSize */
+    0,     /* pdbObjectCacheHits */
+    0,     /* pdbObjectCacheMisses */
+    0,     /* fileCacheHits */
+    0,     /* fileCacheMisses */
+    1      /* materialCalcThreads */
 };
 
+#ifdef SILO_THREADSAFE
+SILO_TLS SILO_Thread_t SILO_Thread;
+static pthread_mutex_t db_api_mutex;
+static pthread_once_t db_api_once = PTHREAD_ONCE_INIT;
+
+static void
+db_api_mutex_init(void)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&db_api_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    db_api_lock
+ *
+ * Purpose:     Take the library-wide lock held for the duration of an
+ *              outermost API call in a thread-safe build.
+ *
+ * Return:      void
+ *-------------------------------------------------------------------------*/
+INTERNAL void
+db_api_lock(void)
+{
+    pthread_once(&db_api_once, db_api_mutex_init);
+    pthread_mutex_lock(&db_api_mutex);
+}
+
+INTERNAL void
+db_api_unlock(void)
+{
+    pthread_mutex_unlock(&db_api_mutex);
+}
+#endif
+
 INTERNAL int
 db_FullyDeprecatedConvention(const char *name)
 {
@@ -356,14 +403,14 @@ INTERNAL int
 db_perror(char const *s, int errorno, char const *fname)
 {
     int            call_abort = 0;
-    static char    old_s[256] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                                 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                                 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                                 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                                 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                                 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                                 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                                 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+    static SILO_TLS char old_s[256] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+                                       0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+                                       0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+                                       0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+                                       0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+                                       0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+                                       0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+                                       0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
 
     /*
      * Save error number and function name so application
@@ -373,6 +420,12 @@ db_perror(char const *s, int errorno, char const *fname)
     if (fname)
         strncpy(db_errfunc, fname, sizeof(db_errfunc) - 1);
     db_errfunc[sizeof(db_errfunc) - 1] = '\0';
+#ifdef SILO_THREADSAFE
+    SILO_Errno = errorno;
+    if (fname)
+        strncpy(SILO_Errfunc, fname, sizeof(SILO_Errfunc) - 1);
+    SILO_Errfunc[sizeof(SILO_Errfunc) - 1] = '\0';
+#endif
 
     /*
      * If `s' is an empty string, then use the same string
@@ -391,12 +444,12 @@ db_perror(char const *s, int errorno, char const *fname)
 
     switch (SILO_Globals._db_err_level) {
         case DB_NONE:
-            if (SILO_Globals.Jstk)
-                longjmp(SILO_Globals.Jstk->jbuf, -1);
+            if (SILO_Jstk)
+                longjmp(SILO_Jstk->jbuf, -1);
             return -1;
         case DB_TOP:
-            if (SILO_Globals.Jstk)
-                longjmp(SILO_Globals.Jstk->jbuf, -1);
+            if (SILO_Jstk)
+                longjmp(SILO_Jstk->jbuf, -1);
             break;
         case DB_ALL:
             break;
@@ -472,7 +525,7 @@ db_perror(char const *s, int errorno, char const *fname)
 INTERNAL char *
 db_strerror(int errorno)
 {
-    static char    s[32];
+    static SILO_TLS char s[32];
 
     if (errorno < 0 || errorno >= NELMTS(_db_err_list)) {
         sprintf(s, "Error %d", errorno);
@@ -764,6 +817,8 @@ silo_db_close(DBfile *dbfile)
 {
     if (dbfile) {
         db_FreeToc(dbfile);
+        db_FreeTocCache(dbfile);
+        FREE(dbfile->pub.toc_cache);
         FREE(dbfile->pub.GrabId);
         dbfile->pub.GrabId = 0;
         dbfile->pub.Grab = FALSE;
@@ -908,19 +963,10 @@ db_AllocToc(void)
  *    Jeremy Meredith, Sept 18 1998
  *    Added multi-block species.
  *-------------------------------------------------------------------------*/
-INTERNAL int
-db_FreeToc(DBfile *dbfile)
+PRIVATE void
+db_FreeTocData(DBtoc *toc)
 {
     int            i;
-    DBtoc         *toc = NULL;
-    char          *me = "db_FreeToc";
-
-    if (!dbfile)
-        return db_perror(NULL, E_NOFILE, me);
-    if (!dbfile->pub.toc)
-        return 0;
-
-    toc = dbfile->pub.toc;
 
     if (toc->ncurve > 0) {
         if (toc->curve_names) {
@@ -1139,13 +1185,169 @@ db_FreeToc(DBfile *dbfile)
 #warning WE SHOULD PROBABLY JUST EITHER MAKE THIS CONSISTENT OR PERHAPS COPY ALL CHARS INTO LINK@TARGET format
 #endif
         /* toc->symlink_names is just copy of other members here.
-           So, we don't free it here. */
+           So, we don't free its entries here. */
+        FREE(toc->symlink_names);
     }
 
-    FREE(dbfile->pub.toc);
+    FREE(toc);
+}
+
+INTERNAL int
+db_FreeToc(DBfile *dbfile)
+{
+    char          *me = "db_FreeToc";
+
+    if (!dbfile)
+        return db_perror(NULL, E_NOFILE, me);
+    if (!dbfile->pub.toc)
+        return 0;
+
+    db_FreeTocData(dbfile->pub.toc);
+    dbfile->pub.toc = NULL;
     return 0;
 }
 
+/*-------------------------------------------------------------------------
+ * Tables of contents of directories other than the current one, most
+ * recently used first. DBSetDir stashes the table of contents of the
+ * directory it leaves here and takes back the one of the directory it
+ * enters, so tools moving between directories build each table once.
+ *-------------------------------------------------------------------------*/
+#define DB_TOC_CACHE_SIZE 32
+
+typedef struct db_TocCache_t {
+    int         namesOnly;              /* mode pub.toc was built in */
+    int         n;                      /* number of cached tables */
+    char       *dirs[DB_TOC_CACHE_SIZE];
+    DBtoc      *tocs[DB_TOC_CACHE_SIZE];
+    int         modes[DB_TOC_CACHE_SIZE];
+} db_TocCache_t;
+
+PRIVATE void
+db_FreeTocCache(DBfile *dbfile)
+{
+    db_TocCache_t *cache = dbfile->pub.toc_cache;
+    int            i;
+
+    if (!cache)
+        return;
+    for (i = 0; i < cache->n; i++)
+    {
+        FREE(cache->dirs[i]);
+        db_FreeTocData(cache->tocs[i]);
+    }
+    cache->n = 0;
+}
+
+/* Drop the cached table of contents for dir, if any */
+PRIVATE void
+db_DropCachedToc(DBfile *dbfile, char const *dir)
+{
+    db_TocCache_t *cache = dbfile->pub.toc_cache;
+    int            i, n;
+
+    if (!cache)
+        return;
+    for (i = 0; i < cache->n; i++)
+        if (!strcmp(cache->dirs[i], dir))
+            break;
+    if (i == cache->n)
+        return;
+
+    FREE(cache->dirs[i]);
+    db_FreeTocData(cache->tocs[i]);
+    n = --cache->n - i;
+    memmove(cache->dirs+i, cache->dirs+i+1, n*sizeof(cache->dirs[0]));
+    memmove(cache->tocs+i, cache->tocs+i+1, n*sizeof(cache->tocs[0]));
+    memmove(cache->modes+i, cache->modes+i+1, n*sizeof(cache->modes[0]));
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    db_InvalidateToc
+ *
+ * Purpose:     Called after name is created or changed in a file. That
+ *              always invalidates the table of contents of the current
+ *              directory, whether it is the current one or still sits
+ *              in the cache. If name is NULL or a path, it may have been
+ *              anywhere so all cached tables are dropped too.
+ *-------------------------------------------------------------------------*/
+INTERNAL void
+db_InvalidateToc(DBfile *dbfile, char const *name)
+{
+    char           cwd[256];
+
+    if (!dbfile)
+        return;
+    db_FreeToc(dbfile);
+    if (!dbfile->pub.toc_cache || !dbfile->pub.toc_cache->n)
+        return;
+    if (!name || strchr(name, '/') || !dbfile->pub.g_dir ||
+        (dbfile->pub.g_dir)(dbfile, cwd) < 0)
+        db_FreeTocCache(dbfile);
+    else
+        db_DropCachedToc(dbfile, cwd);
+}
+
+/* Whether the table of contents DBNewToc is building is names-only */
+INTERNAL int
+db_TocNamesOnly(DBfile *dbfile)
+{
+    db_TocCache_t *cache = dbfile->pub.toc_cache;
+    return cache ? cache->namesOnly : FALSE;
+}
+
+/* Move the current table of contents into the cache under dir */
+PRIVATE void
+db_StashToc(DBfile *dbfile, char const *dir)
+{
+    db_TocCache_t *cache = dbfile->pub.toc_cache;
+    int            n;
+
+    if (!dbfile->pub.toc || !cache)
+        return;
+
+    /* Make room at the front, evicting the least recently used */
+    n = cache->n;
+    if (n == DB_TOC_CACHE_SIZE)
+    {
+        n--;
+        FREE(cache->dirs[n]);
+        db_FreeTocData(cache->tocs[n]);
+    }
+    memmove(cache->dirs+1, cache->dirs, n*sizeof(cache->dirs[0]));
+    memmove(cache->tocs+1, cache->tocs, n*sizeof(cache->tocs[0]));
+    memmove(cache->modes+1, cache->modes, n*sizeof(cache->modes[0]));
+    cache->dirs[0] = STRDUP(dir);
+    cache->tocs[0] = dbfile->pub.toc;
+    cache->modes[0] = cache->namesOnly;
+    cache->n = n + 1;
+    dbfile->pub.toc = NULL;
+}
+
+/* Make the cached table of contents for dir, if any, the current one */
+PRIVATE void
+db_UnstashToc(DBfile *dbfile, char const *dir)
+{
+    db_TocCache_t *cache = dbfile->pub.toc_cache;
+    int            i, n;
+
+    if (dbfile->pub.toc || !cache)
+        return;
+    for (i = 0; i < cache->n; i++)
+        if (!strcmp(cache->dirs[i], dir))
+            break;
+    if (i == cache->n)
+        return;
+
+    dbfile->pub.toc = cache->tocs[i];
+    cache->namesOnly = cache->modes[i];
+    FREE(cache->dirs[i]);
+    n = --cache->n - i;
+    memmove(cache->dirs+i, cache->dirs+i+1, n*sizeof(cache->dirs[0]));
+    memmove(cache->tocs+i, cache->tocs+i+1, n*sizeof(cache->tocs[0]));
+    memmove(cache->modes+i, cache->modes+i+1, n*sizeof(cache->modes[0]));
+}
+
 /*----------------------------------------------------------------------
  *  Routine                                          silo_GetMachDataSize
  *
@@ -1754,6 +1956,24 @@ if (LS_VAR && toc->n##CAT > 0) { \
     return 0;
 }
 
+/*-------------------------------------------------------------------------
+ * Function:    db_IsFilePrefixedName
+ *
+ * Purpose:     Decide whether an object name names an object in another
+ *              file, "file:/path". Only a non-empty file name followed by
+ *              a colon and an absolute path counts; a colon anywhere else
+ *              is just part of a directory or object name.
+ *
+ * Return:      1 if the name has a file prefix, 0 otherwise
+ *-------------------------------------------------------------------------*/
+PRIVATE int
+db_IsFilePrefixedName(char const *name)
+{
+    char const *colon = strchr(name, ':');
+
+    return colon && colon != name && colon[1] == '/';
+}
+
 /*-------------------------------------------------------------------------
  * Function:    context_switch
  *
@@ -1793,10 +2013,11 @@ context_switch(DBfile *dbfile, char const *name, char const **base)
     /*
      * Save the old information.  If the name doesn't contain a `/' then
      * we don't have to do anything.  We will mark this case by storing
-     * NULL as the context name.
+     * NULL as the context name.  Names of objects in other files
+     * ("file:/path") are resolved by the driver, so leave them alone.
      */
     *base = name;
-    if (!strchr(name, '/')) {
+    if (!strchr(name, '/') || db_IsFilePrefixedName(name)) {
         old->dirid = 0;
         old->name = NULL;
         return old;
@@ -2546,6 +2767,250 @@ DB_SETGET(int, DeprecateWarnings, maxDeprecateWarnings, DB_INTBOOL_NOT_SET)
 DB_SETGET(int, AllowLongStrComponents, allowLongStrComponents, DB_INTBOOL_NOT_SET) 
 DB_SETGET(unsigned long long, DataReadMask2, dataReadMask, DB_MASK_NOT_SET) 
 DB_SETGET(int, CompatibilityMode, compatibilityMode, DB_INTBOOL_NOT_SET)
+DB_SETGET(int, TocNamesOnly, tocNamesOnly, DB_INTBOOL_NOT_SET)
+
+/*-------------------------------------------------------------------------
+ * Handles on files reached through "file:path" object names, most
+ * recently used first. The driver member says whose handle it is; the
+ * library itself caches DBfile handles under DB_UNKNOWN. A handle is
+ * taken out while it is read through and returned when done, so a handle
+ * in use is never closed under its user. Handles are closed when they
+ * fall off the end of the list, when any file is opened for writing and
+ * when the last Silo file the application opened is closed.
+ *-------------------------------------------------------------------------*/
+#define DB_FILE_CACHE_MAX 64
+
+typedef struct db_FileCacheEntry_t {
+    char       *name;
+    int         driver;
+    void       *handle;
+    void      (*close)(void *);
+} db_FileCacheEntry_t;
+
+static int db_nCachedFiles = 0;
+static db_FileCacheEntry_t db_CachedFiles[DB_FILE_CACHE_MAX];
+
+/* Entries are removed before their handle is closed because closing a
+   cached DBfile comes back here through DBClose */
+PRIVATE void
+db_TrimFileCache(int n)
+{
+    while (db_nCachedFiles > n)
+    {
+        db_FileCacheEntry_t e = db_CachedFiles[--db_nCachedFiles];
+        (e.close)(e.handle);
+        FREE(e.name);
+    }
+}
+
+PRIVATE int
+db_NumCachedDBfiles(void)
+{
+    int i, n = 0;
+    for (i = 0; i < db_nCachedFiles; i++)
+        n += db_CachedFiles[i].driver == DB_UNKNOWN;
+    return n;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    db_TakeCachedFile
+ *
+ * Purpose:     Take the cached handle a driver opened on the named file
+ *              out of the cache.
+ *
+ * Return:      Success:        the handle
+ *
+ *              Failure:        NULL if no handle on the file is cached
+ *-------------------------------------------------------------------------*/
+INTERNAL void *
+db_TakeCachedFile(char const *name, int driver)
+{
+    void *handle = 0;
+    int   i;
+
+#ifdef SILO_THREADSAFE
+    db_api_lock();
+#endif
+    for (i = 0; i < db_nCachedFiles; i++)
+    {
+        if (db_CachedFiles[i].driver == driver &&
+            !strcmp(db_CachedFiles[i].name, name))
+            break;
+    }
+    if (i < db_nCachedFiles)
+    {
+        SILO_Globals.fileCacheHits++;
+        handle = db_CachedFiles[i].handle;
+        FREE(db_CachedFiles[i].name);
+        memmove(&db_CachedFiles[i], &db_CachedFiles[i+1],
+            (db_nCachedFiles-i-1) * sizeof(db_FileCacheEntry_t));
+        db_nCachedFiles--;
+    }
+    else
+    {
+        SILO_Globals.fileCacheMisses++;
+    }
+#ifdef SILO_THREADSAFE
+    db_api_unlock();
+#endif
+    return handle;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    db_ReturnCachedFile
+ *
+ * Purpose:     Put a driver handle on the named file at the front of the
+ *              cache, closing the least recently used handle if the cache
+ *              is full. With caching off, the handle is closed at once.
+ *-------------------------------------------------------------------------*/
+INTERNAL void
+db_ReturnCachedFile(char const *name, int driver, void *handle,
+    void (*closefn)(void *))
+{
+    int   n = MIN(SILO_Globals.maxCachedFiles, DB_FILE_CACHE_MAX);
+    char *s = 0;
+
+#ifdef SILO_THREADSAFE
+    db_api_lock();
+#endif
+    if (n <= 0 || (s = STRDUP(name)) == 0)
+    {
+        closefn(handle);
+    }
+    else
+    {
+        db_TrimFileCache(n-1);
+        memmove(&db_CachedFiles[1], &db_CachedFiles[0],
+            db_nCachedFiles * sizeof(db_FileCacheEntry_t));
+        db_CachedFiles[0].name = s;
+        db_CachedFiles[0].driver = driver;
+        db_CachedFiles[0].handle = handle;
+        db_CachedFiles[0].close = closefn;
+        db_nCachedFiles++;
+    }
+#ifdef SILO_THREADSAFE
+    db_api_unlock();
+#endif
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    db_FlushFileCache
+ *
+ * Purpose:     Close cached handles. With lastonly set, do so only if the
+ *              cached DBfile handles are the only Silo files left open.
+ *-------------------------------------------------------------------------*/
+INTERNAL void
+db_FlushFileCache(int lastonly)
+{
+    if (!lastonly || db_num_registered_files() == db_NumCachedDBfiles())
+        db_TrimFileCache(0);
+}
+
+PRIVATE void
+db_CloseCachedDBfile(void *dbfile)
+{
+    DBClose((DBfile *) dbfile);
+}
+
+PUBLIC int
+DBSetMaxCachedFiles(int nfiles)
+{
+    int oldval;
+
+    API_BEGIN("DBSetMaxCachedFiles", int, -1) {
+        oldval = SILO_Globals.maxCachedFiles;
+        SILO_Globals.maxCachedFiles = nfiles;
+        db_TrimFileCache(MAX(MIN(nfiles, DB_FILE_CACHE_MAX), 0));
+        API_RETURN(oldval);
+    }
+    API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
+}
+
+PUBLIC int
+DBGetMaxCachedFiles(void)
+{
+    return SILO_Globals.maxCachedFiles;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    DBGetFileCacheStats
+ *
+ * Purpose:     Return the number of times a file reached through a
+ *              "file:/path" name was found open in the cache (hits) and
+ *              had to be opened (misses), optionally zeroing both counts.
+ *-------------------------------------------------------------------------*/
+PUBLIC void
+DBGetFileCacheStats(long long *hits, long long *misses, int reset)
+{
+#ifdef SILO_THREADSAFE
+    db_api_lock();
+#endif
+    if (hits) *hits = SILO_Globals.fileCacheHits;
+    if (misses) *misses = SILO_Globals.fileCacheMisses;
+    if (reset)
+    {
+        SILO_Globals.fileCacheHits = 0;
+        SILO_Globals.fileCacheMisses = 0;
+    }
+#ifdef SILO_THREADSAFE
+    db_api_unlock();
+#endif
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    DBSetPDBObjectCacheSize
+ *
+ * Purpose:     Set how many object descriptions the PDB driver keeps in
+ *              memory between reads. Zero turns the cache off. A smaller
+ *              size takes effect the next time an object is read.
+ *
+ * Return:      The previous size.
+ *-------------------------------------------------------------------------*/
+PUBLIC int
+DBSetPDBObjectCacheSize(int n)
+{
+    int volatile oldval;
+
+    API_BEGIN("DBSetPDBObjectCacheSize", int, -1) {
+        if (n < 0)
+            API_ERROR("n", E_BADARGS);
+        oldval = SILO_Globals.pdbObjectCacheSize;
+        SILO_Globals.pdbObjectCacheSize = n;
+        API_RETURN(oldval);
+    }
+    API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
+}
+
+PUBLIC int
+DBGetPDBObjectCacheSize(void)
+{
+    return SILO_Globals.pdbObjectCacheSize;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    DBGetPDBObjectCacheStats
+ *
+ * Purpose:     Return the number of PDB object reads satisfied from the
+ *              object cache (hits) and from the file (misses), optionally
+ *              zeroing both counts.
+ *-------------------------------------------------------------------------*/
+PUBLIC void
+DBGetPDBObjectCacheStats(long long *hits, long long *misses, int reset)
+{
+#ifdef SILO_THREADSAFE
+    db_api_lock();
+#endif
+    if (hits) *hits = SILO_Globals.pdbObjectCacheHits;
+    if (misses) *misses = SILO_Globals.pdbObjectCacheMisses;
+    if (reset)
+    {
+        SILO_Globals.pdbObjectCacheHits = 0;
+        SILO_Globals.pdbObjectCacheMisses = 0;
+    }
+#ifdef SILO_THREADSAFE
+    db_api_unlock();
+#endif
+}
 #ifndef _WIN32
 #warning WHAT ABOUT FORCESINGLE SHOWERRORS
 #endif
@@ -2553,6 +3018,9 @@ DB_SETGET(int, CompatibilityMode, compatibilityMode, DB_INTBOOL_NOT_SET)
 /* The compression stuff has some custom initialization */
 static void _db_set_compression_params(char **dst, char const *s)
 {
+    /* a file's setting starts out as the not set marker, not a string */
+    if (*dst == DB_CHAR_PTR_NOT_SET)
+        *dst = 0;
     if (s && *s == '\0') {
         if (*dst)
             FREE(*dst);
@@ -2967,6 +3435,7 @@ DBUngrabDriver(DBfile *file, const void *driver_handle)
 {
     if (file) {
        SILO_Globals.enableGrabDriver = FALSE;
+       db_InvalidateToc(file, NULL);
        return file->pub.type;
     }
     return DB_UNKNOWN;
@@ -3661,26 +4130,26 @@ DBShowErrors(int level, void(*func)(char*))
 PUBLIC char const *
 DBErrString(void)
 {
-    static char    s[128];
+    static SILO_TLS char s[128];
 
-    if (db_errno < 0 || db_errno >= NELMTS(_db_err_list)) {
-        sprintf(s, "Error %d", db_errno);
+    if (SILO_Errno < 0 || SILO_Errno >= NELMTS(_db_err_list)) {
+        sprintf(s, "Error %d", SILO_Errno);
         return s;
     }
 
-    return _db_err_list[db_errno];
+    return _db_err_list[SILO_Errno];
 }
 
 PUBLIC int
 DBErrno(void)
 {
-    return db_errno;
+    return SILO_Errno;
 }
 
 PUBLIC char const *
 DBErrFuncname(void)
 {
-    return db_errfunc;
+    return SILO_Errfunc;
 }
 
 PUBLIC DBErrFunc_t
@@ -3960,7 +4429,7 @@ DBFileVersionGE(const DBfile *dbfile, int Maj, int Min, int Pat)
 PUBLIC char const *
 DBFileName(const DBfile *dbfile)
 {
-    static char name[256];
+    static SILO_TLS char name[256];
     if (dbfile->pub.name)
         strcpy(name, dbfile->pub.name);
     else
@@ -4005,6 +4474,7 @@ db_InitFileGlobals(DBfile *dbfile, int mode)
 #endif
     dbfile->pub.file_scope_globals->compressionErrmode      = DB_INTBOOL_NOT_SET;
     dbfile->pub.file_scope_globals->compatibilityMode       = DB_INTBOOL_NOT_SET;
+    dbfile->pub.file_scope_globals->tocNamesOnly            = DB_INTBOOL_NOT_SET;
     dbfile->pub.file_scope_globals->compressionParams       = (char*) DB_CHAR_PTR_NOT_SET;
     dbfile->pub.file_scope_globals->_db_err_level           = DB_INTBOOL_NOT_SET;
     dbfile->pub.file_scope_globals->_db_err_func            = DB_VOID_PTR_NOT_SET;
@@ -4129,6 +4599,10 @@ DBOpenReal(const char *name, int type, int mode)
             API_ERROR(ascii, E_NOTIMP);
         }
 
+        /* Handles cached for reading may go stale once a file is written */
+        if ((mode & 0x0000000F) == DB_APPEND)
+            db_FlushFileCache(0);
+
         /****************************************************/
         /* Check to make sure the file exists and has the   */
         /* correct permissions.                             */
@@ -4314,6 +4788,9 @@ DBCreateReal(const char *name, int mode, int target, const char *info, int type)
         if (!name)
             API_ERROR(NULL, E_NOFILE);
 
+        /* Handles cached for reading may go stale once a file is written */
+        db_FlushFileCache(0);
+
         /* deal with extended driver type specifications */
         db_DriverTypeAndFileOptionsSetId(origtype, &type, &opts_set_id);
 
@@ -4461,6 +4938,7 @@ DBClose(DBfile *dbfile)
 	tmp_file_scope_globals = dbfile->pub.file_scope_globals; 
         retval = (dbfile->pub.close) (dbfile);
         free(tmp_file_scope_globals);
+        db_FlushFileCache(1);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -4497,6 +4975,40 @@ DBFlush(DBfile *dbfile)
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
 }
 
+/*-------------------------------------------------------------------------
+ * Function:    DBGetFileImage
+ *
+ * Purpose:     Flush the specified file and return a copy of its entire
+ *              contents in a buffer the caller must free. Together with the
+ *              HDF5 core and FIC VFDs, this permits a file built in memory
+ *              to be shipped to another process and reopened there.
+ *
+ * Return:      Success:        0
+ *
+ *              Failure:        -1
+ *-------------------------------------------------------------------------*/
+PUBLIC int
+DBGetFileImage(DBfile *dbfile, void **buf, size_t *size)
+{
+    int            retval;
+
+    API_BEGIN2("DBGetFileImage", int, -1, api_dummy) {
+        if (!dbfile)
+            API_ERROR(NULL, E_NOFILE);
+        if (SILO_Globals.enableGrabDriver == TRUE)
+            API_ERROR("DBGetFileImage", E_GRABBED);
+        if (!buf)
+            API_ERROR("buf", E_BADARGS);
+        if (!size)
+            API_ERROR("size", E_BADARGS);
+        if (NULL == dbfile->pub.g_image)
+            API_ERROR(dbfile->pub.name, E_NOTIMP);
+        retval = (dbfile->pub.g_image) (dbfile, buf, size);
+        API_RETURN(retval);
+    }
+    API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
+}
+
 /*----------------------------------------------------------------------
  * Routine:  db_inq_file_has_silo_objects_r
  *
@@ -5121,12 +5633,15 @@ DBInqVarType(DBfile *dbfile, char const *varname)
  *              If nothing has changed then this function just returns
  *              success, leaving the original table of contents in place.
  *              Any function that potentially changes the table of
- *              contents should call db_FreeToc() on the file handle.
+ *              contents should call db_InvalidateToc() on the file handle.
+ *
+ *              Also rebuilds the table if it was built in the other
+ *              DBSetTocNamesOnly mode.
  *-------------------------------------------------------------------------*/
 PUBLIC int
 DBNewToc(DBfile *dbfile)
 {
-    int retval;
+    int retval, namesOnly;
 
     API_BEGIN("DBNewToc", int, -1) {
         if (!dbfile)
@@ -5135,8 +5650,15 @@ DBNewToc(DBfile *dbfile)
             API_ERROR("", E_GRABBED) ; 
         if (!dbfile->pub.newtoc)
             API_ERROR(dbfile->pub.name, E_NOTIMP);
-        if (dbfile->pub.toc)
+        if (!dbfile->pub.toc_cache &&
+            !(dbfile->pub.toc_cache = ALLOC(db_TocCache_t)))
+            API_ERROR(NULL, E_NOMEM);
+        namesOnly = (dbfile->pub.file_scope_globals ?
+            DBGetTocNamesOnlyFile(dbfile) : DBGetTocNamesOnly()) == TRUE;
+        if (dbfile->pub.toc && dbfile->pub.toc_cache->namesOnly == namesOnly)
             API_RETURN(0);
+        db_FreeToc(dbfile);
+        dbfile->pub.toc_cache->namesOnly = namesOnly;
         retval = (dbfile->pub.newtoc) (dbfile);
         API_RETURN(retval);
     }
@@ -5454,8 +5976,17 @@ DBSetDir(DBfile *dbfile, const char *path)
         if (!dbfile->pub.cd)
             API_ERROR(dbfile->pub.name, E_NOTIMP);
 
+        db_StashToc(dbfile, tmp);
         retval = (dbfile->pub.cd) (dbfile, path);
+        if (retval < 0)
+        {
+            /* still in the old directory, so take its table back */
+            db_UnstashToc(dbfile, tmp);
+            API_RETURN(retval);
+        }
         db_FreeToc(dbfile);
+        if (DBGetDir(dbfile, tmp) >= 0)
+            db_UnstashToc(dbfile, tmp);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -5549,7 +6080,7 @@ DBMkDir(DBfile *dbfile, const char *name)
             API_ERROR(dbfile->pub.name, E_NOTIMP);
 
         retval = (dbfile->pub.mkdir) (dbfile, name);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -5646,7 +6177,8 @@ DBCpDir(DBfile *dbfile, char const *srcDir,
             API_ERROR(dbfile->pub.name, E_NOTIMP);
 
         retval = (dbfile->pub.cpdir) (dbfile, srcDir, dstFile, dstDir);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, NULL);
+        db_InvalidateToc(dstFile, NULL);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -5692,7 +6224,7 @@ DBMkSymlink(DBfile *dbfile, char const *target, char const *link)
             API_ERROR(dbfile->pub.name, E_NOTIMP);
 
         retval = (dbfile->pub.mksymlink) (dbfile, target, link);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, link);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -6574,7 +7106,8 @@ DBCpListedObjects(int nobjs,
         if (!dbfile->pub.cpnobjs)
             API_ERROR(dbfile->pub.name, E_NOTIMP);
         retval = (dbfile->pub.cpnobjs) (nobjs, dbfile, srcObjs, dstFile, dstObjs);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, NULL);
+        db_InvalidateToc(dstFile, NULL);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -6687,6 +7220,7 @@ DBWriteObject(DBfile *dbfile, DBobject const *obj, int freemem)
             API_ERROR(dbfile->pub.name, E_NOTIMP);
 
         retval = (dbfile->pub.w_obj) (dbfile, obj, freemem?FREE_MEM:0);
+        db_InvalidateToc(dbfile, obj->name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -6868,7 +7402,7 @@ DBWriteComponent(DBfile *dbfile, DBobject *obj, char const *comp_name,
 
         retval = (dbfile->pub.w_comp) (dbfile, obj, comp_name, prefix,
                                        datatype, var, nd, count);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, obj->name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -6945,7 +7479,7 @@ DBWrite(DBfile *dbfile, char const *vname, void const *var, int const *dims,
         /* diddle with retval if its an empty case */
         if ((ndims == 0 || nvals == 0) && retval == 1) retval = 0;
 
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, vname);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -7020,7 +7554,7 @@ DBWriteSlice (DBfile *dbfile, const char *vname, void const *values, int dtype,
         retval = (dbfile->pub.writeslice) (dbfile, vname, values,
                                            dtype, offset, length, stride,
                                            dims, ndims);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, vname);
         API_RETURN(retval);
     }
     API_END_NOPOP;     /* BEWARE: If API_RETURN above is removed use API_END */
@@ -7624,6 +8158,76 @@ DBGetQuadmesh(DBfile *dbfile, const char *name)
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
 }
 
+/*
+ * The buffer function of a DBGet*Into call. The call keeps it on its stack
+ * and hangs it on the file while the driver reads, so drivers can ask it for
+ * memory through db_GetReadBuffer as they read data arrays.
+ */
+struct db_ReadBuf_t {
+    DBReadBufferFunc_t func;
+    void *udata;
+    char const *objname;
+    int ncalls;
+};
+
+/*-------------------------------------------------------------------------
+ * Function:    db_GetReadBuffer
+ *
+ * Purpose:     Ask the buffer function of the DBGet*Into call in
+ *              progress for memory to read a data array into.
+ *
+ * Return:      Success:        Pointer to caller owned memory for at
+ *                              least nvals values of datatype.
+ *
+ *              Failure:        NULL if there is no DBGet*Into call in
+ *                              progress or its function declined.
+ *-------------------------------------------------------------------------*/
+INTERNAL void *
+db_GetReadBuffer(DBfile *dbfile, char const *member, int idx, int datatype,
+    long long nvals)
+{
+    struct db_ReadBuf_t *rb = dbfile ? dbfile->pub.readbuf : NULL;
+    void *buf;
+
+    if (!rb || !rb->func)
+        return NULL;
+    rb->ncalls++;
+
+    /* Reads the buffer function itself makes from this file are its own */
+    dbfile->pub.readbuf = NULL;
+    buf = rb->func(rb->objname, member, idx, datatype, nvals, rb->udata);
+    dbfile->pub.readbuf = rb;
+    return buf;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    db_MoveToReadBuffers
+ *
+ * Purpose:     For drivers that don't read into the buffers of a
+ *              DBGet*Into call themselves, copy the arrays they read
+ *              into those buffers and free them.
+ *-------------------------------------------------------------------------*/
+PRIVATE void
+db_MoveToReadBuffers(DBfile *dbfile, void **arrs, int narrs,
+    char const *member, int datatype, long long nvals)
+{
+    int i;
+    void *buf;
+
+    if (!arrs)
+        return;
+    for (i = 0; i < narrs; i++)
+    {
+        if (!arrs[i])
+            continue;
+        buf = db_GetReadBuffer(dbfile, member, i, datatype, nvals);
+        if (!buf)
+            continue;
+        memcpy(buf, arrs[i], (size_t) nvals * db_GetMachDataSize(datatype));
+        FREE(arrs[i]);
+    }
+}
+
 /*-------------------------------------------------------------------------
  * Function:    DBGetQuadvar
  *
@@ -7644,25 +8248,83 @@ DBGetQuadmesh(DBfile *dbfile, const char *name)
  *    Sean Ahern, Tue Sep 28 10:48:06 PDT 1999
  *    Added a check for variable name validity.
  *
- *    Sean Ahern, Tue Sep 28 11:00:13 PDT 1999
- *    Made the error messages a little better.
+ *    Sean Ahern, Tue Sep 28 11:00:13 PDT 1999
+ *    Made the error messages a little better.
+ *-------------------------------------------------------------------------*/
+PUBLIC DBquadvar *
+DBGetQuadvar(DBfile *dbfile, const char *name)
+{
+    DBquadvar * retval = NULL;
+
+    API_BEGIN2("DBGetQuadvar", DBquadvar *, NULL, name) {
+        if (!dbfile)
+            API_ERROR(NULL, E_NOFILE);
+        if (SILO_Globals.enableGrabDriver == TRUE)
+            API_ERROR("DBGetQuadvar", E_GRABBED) ; 
+        if (!name || !*name)
+            API_ERROR("quadvar name", E_BADARGS);
+        if (!dbfile->pub.g_qv)
+            API_ERROR(dbfile->pub.name, E_NOTIMP);
+
+        retval = (dbfile->pub.g_qv) (dbfile, name);
+        API_RETURN(retval);
+    }
+    API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    DBGetQuadvarInto
+ *
+ * Purpose:     Like DBGetQuadvar but reads the variable's data arrays
+ *              into memory supplied by the caller's buffer function.
+ *
+ * Return:      Success:        Pointer to the new DBquadvar struct. The
+ *                              vals and mixvals entries read into caller
+ *                              memory are NULL.
+ *
+ *              Failure:        NULL
  *-------------------------------------------------------------------------*/
 PUBLIC DBquadvar *
-DBGetQuadvar(DBfile *dbfile, const char *name)
+DBGetQuadvarInto(DBfile *dbfile, const char *name, DBReadBufferFunc_t func,
+    void *udata)
 {
     DBquadvar * retval = NULL;
+    struct db_ReadBuf_t rb;
+    struct db_ReadBuf_t *prevrb;
 
-    API_BEGIN2("DBGetQuadvar", DBquadvar *, NULL, name) {
+    API_BEGIN2("DBGetQuadvarInto", DBquadvar *, NULL, name) {
         if (!dbfile)
             API_ERROR(NULL, E_NOFILE);
         if (SILO_Globals.enableGrabDriver == TRUE)
-            API_ERROR("DBGetQuadvar", E_GRABBED) ; 
+            API_ERROR("DBGetQuadvarInto", E_GRABBED) ; 
         if (!name || !*name)
             API_ERROR("quadvar name", E_BADARGS);
+        if (!func)
+            API_ERROR("buffer function", E_BADARGS);
         if (!dbfile->pub.g_qv)
             API_ERROR(dbfile->pub.name, E_NOTIMP);
 
-        retval = (dbfile->pub.g_qv) (dbfile, name);
+        rb.func = func;
+        rb.udata = udata;
+        rb.objname = name;
+        rb.ncalls = 0;
+        prevrb = dbfile->pub.readbuf;
+        dbfile->pub.readbuf = &rb;
+
+        PROTECT {
+            retval = (dbfile->pub.g_qv) (dbfile, name);
+            if (retval && rb.ncalls == 0)
+            {
+                db_MoveToReadBuffers(dbfile, retval->vals, retval->nvals, "vals",
+                    retval->datatype, retval->nels);
+                db_MoveToReadBuffers(dbfile, retval->mixvals, retval->nvals, "mixvals",
+                    retval->datatype, retval->mixlen);
+            }
+            dbfile->pub.readbuf = prevrb;
+        } CLEANUP {
+            dbfile->pub.readbuf = prevrb;
+        } END_PROTECT;
+
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -7883,6 +8545,64 @@ DBGetUcdvar(DBfile *dbfile, const char *name)
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
 }
 
+/*-------------------------------------------------------------------------
+ * Function:    DBGetUcdvarInto
+ *
+ * Purpose:     Like DBGetUcdvar but reads the variable's data arrays
+ *              into memory supplied by the caller's buffer function.
+ *
+ * Return:      Success:        Pointer to the new DBucdvar struct. The
+ *                              vals and mixvals entries read into caller
+ *                              memory are NULL.
+ *
+ *              Failure:        NULL
+ *-------------------------------------------------------------------------*/
+PUBLIC DBucdvar *
+DBGetUcdvarInto(DBfile *dbfile, const char *name, DBReadBufferFunc_t func,
+    void *udata)
+{
+    DBucdvar * retval = NULL;
+    struct db_ReadBuf_t rb;
+    struct db_ReadBuf_t *prevrb;
+
+    API_BEGIN2("DBGetUcdvarInto", DBucdvar *, NULL, name) {
+        if (!dbfile)
+            API_ERROR(NULL, E_NOFILE);
+        if (SILO_Globals.enableGrabDriver == TRUE)
+            API_ERROR("DBGetUcdvarInto", E_GRABBED) ; 
+        if (!name || !*name)
+            API_ERROR("UCDvar name", E_BADARGS);
+        if (!func)
+            API_ERROR("buffer function", E_BADARGS);
+        if (!dbfile->pub.g_uv)
+            API_ERROR(dbfile->pub.name, E_NOTIMP);
+
+        rb.func = func;
+        rb.udata = udata;
+        rb.objname = name;
+        rb.ncalls = 0;
+        prevrb = dbfile->pub.readbuf;
+        dbfile->pub.readbuf = &rb;
+
+        PROTECT {
+            retval = (dbfile->pub.g_uv) (dbfile, name);
+            if (retval && rb.ncalls == 0)
+            {
+                db_MoveToReadBuffers(dbfile, retval->vals, retval->nvals, "vals",
+                    retval->datatype, retval->nels);
+                db_MoveToReadBuffers(dbfile, retval->mixvals, retval->nvals, "mixvals",
+                    retval->datatype, retval->mixlen);
+            }
+            dbfile->pub.readbuf = prevrb;
+        } CLEANUP {
+            dbfile->pub.readbuf = prevrb;
+        } END_PROTECT;
+
+        API_RETURN(retval);
+    }
+    API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
+}
+
 /*-------------------------------------------------------------------------
  * Function:    DBGetFacelist
  *
@@ -8619,7 +9339,7 @@ DBPutCompoundarray(
         retval = (dbfile->pub.p_ca) (dbfile, name, elemnames,
                                      elemlengths, nelems, values, nvalues,
                                      datatype, opts);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -8717,7 +9437,7 @@ DBPutCurve(
         retval = (dbfile->pub.p_cu) (dbfile, name, (void*)xvals, (void*)yvals,
                                      datatype, npts, opts);
 
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /* BEWARE: If API_RETURN above is removed use API_END */
@@ -8783,7 +9503,7 @@ DBPutDefvars(
 
         retval = (dbfile->pub.p_defv) (dbfile, name, ndefs, names,
                                        types, defns, opts);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /* BEWARE: If API_RETURN above is removed use API_END */
@@ -8880,7 +9600,7 @@ DBPutFacelist(DBfile *dbfile, const char *name, int nfaces, int ndims,
                                      nodelist, lnodelist, origin, zoneno,
                                      shapesize, shapecnt, nshapes, types,
                                      typelist, ntypes);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -9005,7 +9725,7 @@ DBPutMaterial(
         _ma._matnames = NULL;
         _ma._matcolors = NULL;
 
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -9118,7 +9838,7 @@ DBPutMatspecies(DBfile *dbfile, const char *name, const char *matname,
         _ms._specnames = NULL;
         _ms._speccolors = NULL;
 
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -9195,7 +9915,7 @@ DBPutMultimesh(DBfile *dbfile, char const *name, int nmesh,
 
         retval = (dbfile->pub.p_mm) (dbfile, name, nmesh, meshnames,
                                      meshtypes, optlist);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -9256,7 +9976,7 @@ DBPutMultimeshadj(DBfile *dbfile, char const *name, int nmesh,
                                         nneighbors, neighbors, back,
                                         lnodelists, nodelists, lzonelists, zonelists,
                                         optlist);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -9330,7 +10050,7 @@ DBPutMultivar(DBfile *dbfile, const char *name, int nvar,
 
         retval = (dbfile->pub.p_mv) (dbfile, name, nvar, varnames,
                                      vartypes, optlist);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -9406,7 +10126,7 @@ DBPutMultimat(DBfile *dbfile, const char *name, int nmats,
         _mm._matnames = NULL;
         _mm._matcolors = NULL;
 
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -9479,7 +10199,7 @@ DBPutMultimatspecies(DBfile *dbfile, const char *name, int nspec,
         _mm._specnames = NULL;
         _mm._speccolors = NULL;
 
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -9551,7 +10271,7 @@ DBPutPointmesh(DBfile *dbfile, const char *name, int ndims, DBVCP2_t coords,
 
         retval = (dbfile->pub.p_pm) (dbfile, name, ndims, coords, nels,
                                      datatype, optlist);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -9626,7 +10346,7 @@ DBPutPointvar(DBfile *dbfile, const char *vname, const char *mname, int nvars,
 
         retval = (dbfile->pub.p_pv) (dbfile, vname, mname,
                                      nvars, vars, nels, datatype, optlist);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, vname);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -9662,7 +10382,7 @@ DBPutPointvar1(DBfile *dbfile, const char *vname, const char *mname,
     {
         retval = DBPutPointvar(dbfile, vname, mname, 1, vars,
                                nels, datatype, optlist);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, vname);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -9752,7 +10472,7 @@ DBPutQuadmesh(DBfile *dbfile, const char *name, char const * const *coordnames,
         retval = (dbfile->pub.p_qm) (dbfile, name, coordnames, coords,
                                      dims, ndims, datatype, coordtype,
                                      optlist);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -9869,7 +10589,7 @@ DBPutQuadvar(DBfile *dbfile, const char *vname, const char *mname, int nvars,
                                      nvars, varnames, vars, dims, ndims,
                                      mixvars, mixlen, datatype, centering,
                                      optlist);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, vname);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -9911,7 +10631,7 @@ DBPutQuadvar1(DBfile *dbfile, const char *vname, const char *mname, void const *
                               mixvars, mixlen,
                               datatype, centering, optlist);
 
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, vname);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -10023,7 +10743,7 @@ DBPutUcdmesh(DBfile *dbfile, const char *name, int ndims,
                                      coords, nnodes, nzones,
                                      zonel_name, facel_name,
                                      datatype, optlist);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -10080,7 +10800,7 @@ DBPutUcdsubmesh(DBfile *dbfile, const char *name, const char *parentmesh,
         retval = (dbfile->pub.p_sm) (dbfile, name, parentmesh,
                                      nzones, zonel_name,
                                      facel_name, optlist);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -10188,7 +10908,7 @@ DBPutUcdvar(DBfile *dbfile, const char *vname, const char *mname, int nvars,
         retval = (dbfile->pub.p_uv) (dbfile, vname, mname,
                                      nvars, varnames, vars, nels, mixvars,
                                      mixlen, datatype, centering, optlist);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, vname);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -10229,7 +10949,7 @@ DBPutUcdvar1(DBfile *dbfile, const char *vname, const char *mname, void const *v
         retval = DBPutUcdvar(dbfile, vname, mname, 1, varnames, vars,
                      nels, mixvars, mixlen, datatype, centering, optlist);
 
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, vname);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -10315,7 +11035,7 @@ DBPutZonelist(DBfile *dbfile, const char *name, int nzones, int ndims,
         retval = (dbfile->pub.p_zl) (dbfile, name, nzones, ndims,
                                      nodelist, lnodelist, origin, shapesize,
                                      shapecnt, nshapes);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -10411,7 +11131,7 @@ DBPutZonelist2(DBfile *dbfile, const char *name, int nzones, int ndims,
                                       nodelist, lnodelist, origin, lo_offset,
                                       hi_offset, shapetype, shapesize,
                                       shapecnt, nshapes, optlist);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -10498,7 +11218,7 @@ DBPutPHZonelist(DBfile *dbfile, const char *name,
                                        origin, lo_offset, hi_offset,
                                        optlist);
 
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -10566,7 +11286,7 @@ DBPutCsgmesh(DBfile *dbfile, const char *name, int ndims,
                                      lcoeffs, datatype, extents, zonel_name,
                                      optlist);
 
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -10675,7 +11395,7 @@ DBPutCSGZonelist(DBfile *dbfile, const char *name, int nregs,
                                         typeflags, leftids, rightids,
                                         xforms, lxforms, datatype, 
                                         nzones, zonelist, optlist);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -10781,7 +11501,7 @@ DBPutCsgvar(DBfile *dbfile, const char *vname, const char *meshname,
         retval = (dbfile->pub.p_csgv) (dbfile, vname, meshname,
                                      nvars, varnames, vars, nvals,
                                      datatype, centering, optlist);
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, vname);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -13646,6 +14366,512 @@ DBSortObjectsByOffset(DBfile *dbfile, int nobjs,
     API_END_NOPOP;  /* If API_RETURN above is removed, use API_END instead */
 }
 
+/*-------------------------------------------------------------------------
+ * Loading the blocks of a multi-block object. Blocks are grouped by the
+ * file they live in and each group is read in on-disk order through a
+ * single handle on its file. Groups are read one after another; even a
+ * thread-safe build serializes calls into the drivers.
+ *-------------------------------------------------------------------------*/
+
+typedef struct db_mbo_group_t {
+    char const *filename;       /* NULL for blocks in the caller's file */
+    int         n;              /* number of blocks in the group */
+    int        *idx;            /* positions in the caller's block list */
+} db_mbo_group_t;
+
+/* Support type and function for sorting blocks by file; NULL sorts first */
+typedef struct db_mbo_key_t {
+    char const *filename;
+    int         pos;
+} db_mbo_key_t;
+
+static int db_mbo_compare_key(void const *a1, void const *a2)
+{
+    db_mbo_key_t const *k1 = (db_mbo_key_t const *) a1;
+    db_mbo_key_t const *k2 = (db_mbo_key_t const *) a2;
+    int c;
+    if (!k1->filename || !k2->filename)
+        c = (k1->filename != 0) - (k2->filename != 0);
+    else
+        c = strcmp(k1->filename, k2->filename);
+    return c ? c : k1->pos - k2->pos;
+}
+
+typedef struct db_mbo_plan_t {
+    DBfile     *dbfile;
+    int         nblocks;
+    char      **filenames;      /* [nblocks] file of each block or NULL */
+    char      **objnames;       /* [nblocks] name of each block in its file */
+    int        *objtypes;       /* [nblocks] the caller's type array */
+    void      **objs;           /* [nblocks] loaded objects */
+    int        *failed;         /* [nblocks] non-zero if load failed */
+    int        *order;          /* [nblocks] block positions sorted by file */
+    db_mbo_key_t *keys;         /* [nblocks] sort keys for order */
+    int         ngroups;
+    db_mbo_group_t *groups;
+} db_mbo_plan_t;
+
+PRIVATE void
+db_mbo_FreePlan(db_mbo_plan_t *plan)
+{
+    int i;
+
+    if (!plan)
+        return;
+    for (i = 0; i < plan->nblocks; i++)
+    {
+        if (plan->filenames) FREE(plan->filenames[i]);
+        if (plan->objnames) FREE(plan->objnames[i]);
+    }
+    FREE(plan->filenames);
+    FREE(plan->objnames);
+    FREE(plan->objs);
+    FREE(plan->failed);
+    FREE(plan->order);
+    FREE(plan->keys);
+    FREE(plan->groups);
+    free(plan);
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    db_mbo_GetObject
+ *
+ * Purpose:     Read one block of the given type from a file.
+ *
+ * Return:      Success:        pointer to the block object
+ *
+ *              Failure:        NULL
+ *-------------------------------------------------------------------------*/
+PRIVATE void *
+db_mbo_GetObject(DBfile *dbfile, char const *name, int type)
+{
+    switch (type)
+    {
+        case DB_QUADMESH:
+        case DB_QUAD_RECT:
+        case DB_QUAD_CURV:  return DBGetQuadmesh(dbfile, name);
+        case DB_UCDMESH:    return DBGetUcdmesh(dbfile, name);
+        case DB_POINTMESH:  return DBGetPointmesh(dbfile, name);
+        case DB_CSGMESH:    return DBGetCsgmesh(dbfile, name);
+        case DB_QUADVAR:    return DBGetQuadvar(dbfile, name);
+        case DB_UCDVAR:     return DBGetUcdvar(dbfile, name);
+        case DB_POINTVAR:   return DBGetPointvar(dbfile, name);
+        case DB_CSGVAR:     return DBGetCsgvar(dbfile, name);
+        case DB_MATERIAL:   return DBGetMaterial(dbfile, name);
+        case DB_MATSPECIES: return DBGetMatspecies(dbfile, name);
+    }
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    db_mbo_LoadGroup
+ *
+ * Purpose:     Read all the blocks of one group. The group's file is
+ *              opened once and its blocks are read in the order of their
+ *              offsets within it.
+ *-------------------------------------------------------------------------*/
+PRIVATE void
+db_mbo_LoadGroup(db_mbo_plan_t *plan, db_mbo_group_t const *g)
+{
+    DBfile      *dbfile = plan->dbfile;
+    char const **names = 0;
+    int         *ordering = 0;
+    int          i;
+
+    if (g->filename &&
+        (dbfile = (DBfile *) db_TakeCachedFile(g->filename, DB_UNKNOWN)) == 0 &&
+        (dbfile = DBOpen(g->filename, DB_UNKNOWN, DB_READ)) == 0)
+    {
+        for (i = 0; i < g->n; i++)
+            plan->failed[g->idx[i]] = 1;
+        return;
+    }
+
+    names = (char const **) malloc(g->n * sizeof(char const *));
+    ordering = (int *) malloc(g->n * sizeof(int));
+    if (!names || !ordering)
+    {
+        for (i = 0; i < g->n; i++)
+            plan->failed[g->idx[i]] = 1;
+    }
+    else
+    {
+        for (i = 0; i < g->n; i++)
+        {
+            names[i] = plan->objnames[g->idx[i]];
+            ordering[i] = i;
+        }
+        if (g->n > 1 && dbfile->pub.sort_obo &&
+            DBSortObjectsByOffset(dbfile, g->n, names, ordering) < 0)
+        {
+            for (i = 0; i < g->n; i++)
+                ordering[i] = i;
+        }
+        for (i = 0; i < g->n; i++)
+        {
+            int k = g->idx[ordering[i]];
+            plan->objs[k] = db_mbo_GetObject(dbfile, names[ordering[i]],
+                                plan->objtypes[k]);
+            if (!plan->objs[k])
+                plan->failed[k] = 1;
+        }
+    }
+
+    FREE(names);
+    FREE(ordering);
+    if (g->filename)
+        db_ReturnCachedFile(g->filename, DB_UNKNOWN, dbfile, db_CloseCachedDBfile);
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    db_mbo_MakePlan
+ *
+ * Purpose:     Resolve the file and object names of the requested blocks
+ *              of a multi-block object and group the blocks by file.
+ *
+ * Return:      Success:        pointer to the new plan
+ *
+ *              Failure:        NULL
+ *-------------------------------------------------------------------------*/
+PRIVATE db_mbo_plan_t *
+db_mbo_MakePlan(DBfile *dbfile, void const *mobj, int mobjtype, int nreq,
+    int const *blocks, int *objtypes)
+{
+    db_mbo_plan_t *plan = 0;
+    DBnamescheme  *volatile fns = 0, *volatile bns = 0;
+    char          *empty = 0;
+    char          *volatile dir = 0;
+    char         **names = 0;
+    int           *volatile types = 0;
+    int volatile   nblocks = nreq;
+    int            block_type = DB_INVALID_OBJECT;
+    char const    *file_ns = 0, *block_ns = 0;
+    int const     *empty_list = 0;
+    int            empty_cnt = 0, nmblocks = 0;
+    int            i, j;
+    char const    *p;
+
+    API_BEGIN2("DBGetMultiblockObjects", db_mbo_plan_t *, NULL, api_dummy) {
+        if (!dbfile)
+            API_ERROR(NULL, E_NOFILE);
+        if (!mobj)
+            API_ERROR("mobj", E_BADARGS);
+        if (nblocks < 0)
+            API_ERROR("nblocks", E_BADARGS);
+        if (!objtypes)
+            API_ERROR("objtypes", E_BADARGS);
+
+        switch (mobjtype)
+        {
+            case DB_MULTIMESH:
+            {
+                DBmultimesh const *mm = (DBmultimesh const *) mobj;
+                nmblocks = mm->nblocks;
+                names = mm->meshnames;
+                types = mm->meshtypes;
+                block_type = mm->block_type;
+                file_ns = mm->file_ns;
+                block_ns = mm->block_ns;
+                empty_list = mm->empty_list;
+                empty_cnt = mm->empty_cnt;
+                break;
+            }
+            case DB_MULTIVAR:
+            {
+                DBmultivar const *mv = (DBmultivar const *) mobj;
+                nmblocks = mv->nvars;
+                names = mv->varnames;
+                types = mv->vartypes;
+                block_type = mv->block_type;
+                file_ns = mv->file_ns;
+                block_ns = mv->block_ns;
+                empty_list = mv->empty_list;
+                empty_cnt = mv->empty_cnt;
+                break;
+            }
+            case DB_MULTIMAT:
+            {
+                DBmultimat const *mt = (DBmultimat const *) mobj;
+                nmblocks = mt->nmats;
+                names = mt->matnames;
+                block_type = DB_MATERIAL;
+                file_ns = mt->file_ns;
+                block_ns = mt->block_ns;
+                empty_list = mt->empty_list;
+                empty_cnt = mt->empty_cnt;
+                break;
+            }
+            case DB_MULTIMATSPECIES:
+            {
+                DBmultimatspecies const *ms = (DBmultimatspecies const *) mobj;
+                nmblocks = ms->nspec;
+                names = ms->specnames;
+                block_type = DB_MATSPECIES;
+                file_ns = ms->file_ns;
+                block_ns = ms->block_ns;
+                empty_list = ms->empty_list;
+                empty_cnt = ms->empty_cnt;
+                break;
+            }
+            default:
+                API_ERROR("mobjtype", E_BADARGS);
+        }
+        if (!blocks)
+            nblocks = nmblocks;
+        for (i = 0; blocks && i < nblocks; i++)
+        {
+            if (blocks[i] < 0 || blocks[i] >= nmblocks)
+                API_ERROR("blocks", E_BADARGS);
+        }
+        if (!names && !block_ns)
+            API_ERROR("multi-block object has no block names", E_BADARGS);
+        if (!types && block_type == DB_INVALID_OBJECT)
+            API_ERROR("multi-block object has no block types", E_BADARGS);
+
+        /* Nameschemes may refer to arrays in the caller's file */
+        if (!names)
+        {
+            if (file_ns && (fns = DBMakeNamescheme(file_ns, 0, dbfile, 0)) == 0)
+                API_ERROR(file_ns, E_INVALIDNAME);
+            if ((bns = DBMakeNamescheme(block_ns, 0, dbfile, 0)) == 0)
+            {
+                if (fns) DBFreeNamescheme(fns);
+                API_ERROR(block_ns, E_INVALIDNAME);
+            }
+        }
+
+        /* Other files are named relative to the caller's file */
+        if ((p = strrchr(dbfile->pub.name, '/')) != 0)
+            dir = STRNDUP(dbfile->pub.name, (int) (p - dbfile->pub.name) + 1);
+
+        plan = ALLOC(db_mbo_plan_t);
+        empty = ALLOC_N(char, nmblocks);
+        if (plan)
+        {
+            plan->dbfile = dbfile;
+            plan->nblocks = nblocks;
+            plan->objtypes = objtypes;
+            plan->filenames = ALLOC_N(char *, nblocks);
+            plan->objnames = ALLOC_N(char *, nblocks);
+            plan->objs = ALLOC_N(void *, nblocks);
+            plan->failed = ALLOC_N(int, nblocks);
+            plan->order = ALLOC_N(int, nblocks);
+            plan->keys = ALLOC_N(db_mbo_key_t, nblocks);
+            plan->groups = ALLOC_N(db_mbo_group_t, nblocks);
+        }
+        if (!plan || (nmblocks && !empty) || (nblocks &&
+            (!plan->filenames || !plan->objnames || !plan->objs ||
+             !plan->failed || !plan->order || !plan->keys || !plan->groups)))
+        {
+            db_mbo_FreePlan(plan);
+            if (fns) DBFreeNamescheme(fns);
+            if (bns) DBFreeNamescheme(bns);
+            FREE(empty);
+            FREE(dir);
+            API_ERROR(NULL, E_NOMEM);
+        }
+
+        for (i = 0; empty_list && i < empty_cnt; i++)
+        {
+            if (empty_list[i] >= 0 && empty_list[i] < nmblocks)
+                empty[empty_list[i]] = 1;
+        }
+
+        /* Resolve the file and object name of each block */
+        for (i = 0; i < nblocks; i++)
+        {
+            int b = blocks ? blocks[i] : i;
+            char const *fname = 0, *oname;
+            char const *colon = 0;
+
+            if (names)
+            {
+                oname = names[b];
+                if (!oname || !strcmp(oname, "EMPTY"))
+                    empty[b] = 1;
+                else if ((colon = strchr(oname, ':')) != 0)
+                {
+                    plan->filenames[i] = STRNDUP(oname, (int) (colon - oname));
+                    oname = colon + 1;
+                }
+                if (!empty[b])
+                    plan->objnames[i] = STRDUP(oname);
+            }
+            else if (!empty[b])
+            {
+                if (fns && (fname = DBGetName(fns, b)) && *fname)
+                    plan->filenames[i] = STRDUP(fname);
+                plan->objnames[i] = STRDUP(DBGetName(bns, b));
+            }
+
+            if (empty[b])
+            {
+                objtypes[i] = DB_INVALID_OBJECT;
+                continue;
+            }
+            objtypes[i] = types ? types[b] : block_type;
+
+            if (dir && plan->filenames[i] && plan->filenames[i][0] != '/')
+            {
+                char *full = ALLOC_N(char, strlen(dir) + strlen(plan->filenames[i]) + 1);
+                if (full)
+                {
+                    strcpy(full, dir);
+                    strcat(full, plan->filenames[i]);
+                }
+                FREE(plan->filenames[i]);
+                plan->filenames[i] = full;
+            }
+        }
+        if (fns) DBFreeNamescheme(fns);
+        if (bns) DBFreeNamescheme(bns);
+        FREE(empty);
+        FREE(dir);
+
+        /* Group the non-empty blocks by file */
+        for (i = j = 0; i < nblocks; i++)
+        {
+            if (objtypes[i] == DB_INVALID_OBJECT)
+                continue;
+            plan->keys[j].filename = plan->filenames[i];
+            plan->keys[j++].pos = i;
+        }
+        qsort(plan->keys, j, sizeof(db_mbo_key_t), db_mbo_compare_key);
+        for (i = 0; i < j; i++)
+        {
+            char const *f = plan->keys[i].filename;
+            db_mbo_group_t *g = plan->ngroups ? &plan->groups[plan->ngroups-1] : 0;
+
+            plan->order[i] = plan->keys[i].pos;
+            if (!g || (g->filename != f &&
+                       (!g->filename || !f || strcmp(g->filename, f))))
+            {
+                g = &plan->groups[plan->ngroups++];
+                g->filename = f;
+                g->idx = &plan->order[i];
+            }
+            g->n++;
+        }
+        FREE(plan->keys);
+
+        API_RETURN(plan);
+    }
+    API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    db_mbo_FinishPlan
+ *
+ * Purpose:     Hand the loaded blocks of a plan to the caller and free
+ *              the plan. If any block failed to load, all loaded blocks
+ *              are freed.
+ *
+ * Return:      Success:        array of block objects
+ *
+ *              Failure:        NULL
+ *-------------------------------------------------------------------------*/
+PRIVATE void **
+db_mbo_FinishPlan(db_mbo_plan_t *plan)
+{
+    DBfile *dbfile = plan->dbfile;
+    void  **retval = 0;
+    char    name[256];
+    int     i;
+
+    API_BEGIN2("DBGetMultiblockObjects", void **, NULL, api_dummy) {
+        for (i = 0; i < plan->nblocks; i++)
+        {
+            if (plan->failed[i])
+                break;
+        }
+        if (i < plan->nblocks)
+        {
+            snprintf(name, sizeof(name), "%s%s%s",
+                plan->filenames[i] ? plan->filenames[i] : "",
+                plan->filenames[i] ? ":" : "",
+                plan->objnames[i] ? plan->objnames[i] : "");
+            DBFreeMultiblockObjects(plan->objs, plan->nblocks, plan->objtypes);
+            plan->objs = 0;
+            db_mbo_FreePlan(plan);
+            API_ERROR(name, E_CALLFAIL);
+        }
+
+        retval = plan->objs;
+        plan->objs = 0;
+        db_mbo_FreePlan(plan);
+        API_RETURN(retval);
+    }
+    API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    DBGetMultiblockObjects
+ *
+ * Purpose:     Read a subset of the blocks of a multi-block mesh,
+ *              variable, material or species object. Block names are
+ *              resolved from the object's name list or nameschemes and
+ *              the blocks are read file by file, in on-disk order within
+ *              each file.
+ *
+ * Return:      Success:        array of nblocks block objects. Entries
+ *                              for empty blocks are NULL and their type
+ *                              is DB_INVALID_OBJECT.
+ *
+ *              Failure:        NULL
+ *-------------------------------------------------------------------------*/
+PUBLIC void **
+DBGetMultiblockObjects(DBfile *dbfile, void const *mobj, int mobjtype,
+    int nblocks, int const *blocks, int *objtypes)
+{
+    db_mbo_plan_t *plan;
+    int            g;
+
+    if ((plan = db_mbo_MakePlan(dbfile, mobj, mobjtype, nblocks, blocks,
+                                objtypes)) == 0)
+        return 0;
+
+    for (g = 0; g < plan->ngroups; g++)
+        db_mbo_LoadGroup(plan, &plan->groups[g]);
+
+    return db_mbo_FinishPlan(plan);
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    DBFreeMultiblockObjects
+ *
+ * Purpose:     Free an array of block objects returned by
+ *              DBGetMultiblockObjects.
+ *-------------------------------------------------------------------------*/
+PUBLIC void
+DBFreeMultiblockObjects(void **objs, int nblocks, int const *objtypes)
+{
+    int i;
+
+    if (!objs)
+        return;
+    for (i = 0; i < nblocks; i++)
+    {
+        if (!objs[i])
+            continue;
+        switch (objtypes[i])
+        {
+            case DB_QUADMESH:
+            case DB_QUAD_RECT:
+            case DB_QUAD_CURV:  DBFreeQuadmesh((DBquadmesh *) objs[i]); break;
+            case DB_UCDMESH:    DBFreeUcdmesh((DBucdmesh *) objs[i]); break;
+            case DB_POINTMESH:  DBFreePointmesh((DBpointmesh *) objs[i]); break;
+            case DB_CSGMESH:    DBFreeCsgmesh((DBcsgmesh *) objs[i]); break;
+            case DB_QUADVAR:    DBFreeQuadvar((DBquadvar *) objs[i]); break;
+            case DB_UCDVAR:     DBFreeUcdvar((DBucdvar *) objs[i]); break;
+            case DB_POINTVAR:   DBFreeMeshvar((DBmeshvar *) objs[i]); break;
+            case DB_CSGVAR:     DBFreeCsgvar((DBcsgvar *) objs[i]); break;
+            case DB_MATERIAL:   DBFreeMaterial((DBmaterial *) objs[i]); break;
+            case DB_MATSPECIES: DBFreeMatspecies((DBmatspecies *) objs[i]); break;
+        }
+    }
+    free(objs);
+}
+
 /*----------------------------------------------------------------------
  * Purpose
  *
@@ -14891,7 +16117,7 @@ DBPutMrgtree(DBfile *dbfile, char const *name, char const *mesh_name,
         retval = (dbfile->pub.p_mrgt) (dbfile, name, mesh_name,
                                        tree, opts); 
 
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /* BEWARE: If API_RETURN above is removed use API_END */
@@ -14952,7 +16178,7 @@ DBPutGroupelmap(DBfile *dbfile, const char *name,
             num_segments, groupel_types, segment_lengths, segment_ids,
             segment_data, (void const * const *) segment_fracs, fracs_data_type, opts);
 
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -15015,7 +16241,7 @@ DBPutMrgvar(DBfile *dbfile, const char *name, const char *mrgt_name,
         retval = (dbfile->pub.p_mrgv) (dbfile, name, mrgt_name, ncomps,
             compnames, nregns, reg_pnames, datatype, (void const * const *) data, opts);
 
-        db_FreeToc(dbfile);
+        db_InvalidateToc(dbfile, name);
         API_RETURN(retval);
     }
     API_END_NOPOP; /*BEWARE: If API_RETURN above is removed use API_END */
@@ -15215,6 +16441,8 @@ int DBIsDifferentDouble(double a, double b, double abstol, double reltol, double
  *
  *   Mark C. Miller, Mon Jan 11 16:20:16 PST 2010
  *   Made it compiled UNconditionally.
+ *
+ *   Don't divide by a zero denominator; integer division traps there.
  *-------------------------------------------------------------------------
  */
 #define FABS(A) ((A)<0?-(A):(A))
@@ -15237,7 +16465,7 @@ int DBIsDifferentLongLong(long long a, long long b, double abstol, double reltol
          num = FABS (a - b);
          den = FABS (a) + FABS(b) + reltol_eps;
       }
-      if (0.0==den && num) return 1;
+      if (0==den) return num!=0;
       if (num/den > reltol) return 1;
       return 0;
    }
@@ -15267,8 +16495,8 @@ int DBIsDifferentLongLong(long long a, long long b, double abstol, double reltol
             num = FABS (a - b);
             den = FABS (a/2 + b/2);
          }
-         if (0.0==den && num) return 1;
-         if (num/den > reltol) return 1;
+         if (0==den && num) return 1;
+         if (den && num/den > reltol) return 1;
 
          if (abstol>0 || reltol>0) return 0;
       }
@@ -62,10 +62,21 @@ typedef struct _DBexprnode {
     char type;
     long long val;
     char sval[128];
+    DBnamescheme *embedns; /* compiled form of sval when it has conv. specs. */
     struct _DBexprnode *left;
     struct _DBexprnode *right;
 } DBexprnode;
 
+/* Result of evaluating a string valued (sub)expression. The string is
+   either used as is or, when it has conv. specs. of its own, formatted
+   through ns. If ns was made just for this evaluation, it is also held
+   in owned and must be freed by the caller. */
+typedef struct _DBexprstr {
+    char const *name;
+    DBnamescheme const *ns;
+    DBnamescheme *owned;
+} DBexprstr;
+
 static void
 FreeTree(DBexprnode *tree)
 {
@@ -73,6 +84,8 @@ FreeTree(DBexprnode *tree)
         return;
     FreeTree(tree->left);
     FreeTree(tree->right);
+    if (tree->embedns)
+        DBFreeNamescheme(tree->embedns);
     free(tree);
 }
 
@@ -249,57 +262,107 @@ BuildExprTree(const char **porig)
     return tree;
 }
 
-/* very simple circular cache for a handful of embedded strings */
-static int SaveInternalString(DBnamescheme const *ns, const char *sval)
+static void
+CompileStrings(DBexprnode *tree)
 {
-    /* The modn/embedns portion of a namescheme is 'internal' state
-       allowed to disobey const rules */
-    DBnamescheme *non_const_ns = (DBnamescheme*) ns;
-    int modn = non_const_ns->nembed++ % DB_MAX_EXPNS;
-    if (non_const_ns->embedns[modn])
-        DBFreeNamescheme(non_const_ns->embedns[modn]);
-    non_const_ns->embedns[modn] = DBMakeNamescheme(sval);
-    return modn;
+    if (!tree)
+        return;
+    if (tree->type == 's' && strchr(tree->sval, '%'))
+        tree->embedns = DBMakeNamescheme(tree->sval);
+    CompileStrings(tree->left);
+    CompileStrings(tree->right);
+}
+
+/* Build an expression tree and compile any literal strings in it that
+   are themselves nameschemes so that evaluation need not parse them again */
+static DBexprnode *
+CompileExpr(char const *exprstr)
+{
+    DBexprnode *tree = BuildExprTree(&exprstr);
+    CompileStrings(tree);
+    return tree;
 }
 
-/* very simple circular cache for strings returned from DBGetName */
+INTERNAL void
+db_FreeNameschemeExprs(DBnamescheme *ns)
+{
+    int i;
+
+    if (!ns || !ns->exprtrees)
+        return;
+    for (i = 0; i < ns->ncspecs; i++)
+        FreeTree((DBexprnode *) ns->exprtrees[i]);
+    FREE(ns->exprtrees);
+}
+
+/* very simple circular cache for strings returned from DBGetName. It is
+   per-thread in a thread-safe build. */
 #define DB_MAX_RETSTRS 32
-static char * retstrbuf[DB_MAX_RETSTRS];
+static SILO_TLS char * retstrbuf[DB_MAX_RETSTRS];
+static SILO_TLS size_t retstrsiz[DB_MAX_RETSTRS];
 static char * SaveReturnedString(char const * retstr)
 {
-    static size_t n = 0;
-    size_t modn;
+    static SILO_TLS size_t n = 0;
+    size_t modn, len;
 
     /* Hack to cleanup when really needed */
     if (retstr == 0)
     {
         for (n = 0; n < DB_MAX_RETSTRS; n++)
+        {
             FREE(retstrbuf[n]);
+            retstrsiz[n] = 0;
+        }
         n = 0;
         return 0;
     }
 
+    /* re-use a slot's buffer when it is already big enough */
     modn = n % DB_MAX_RETSTRS;
     n++;
-    FREE(retstrbuf[modn]);
-    retstrbuf[modn] = STRDUP(retstr);
+    len = strlen(retstr) + 1;
+    if (retstrsiz[modn] < len)
+    {
+        FREE(retstrbuf[modn]);
+        retstrbuf[modn] = (char *) malloc(len);
+        retstrsiz[modn] = retstrbuf[modn] ? len : 0;
+        if (!retstrbuf[modn])
+            return "";
+    }
+    memcpy(retstrbuf[modn], retstr, len);
     return retstrbuf[modn];
 }
 
+/* Set the string result of a string literal or string array reference */
+static long long
+SetExprStr(DBexprstr *str, char const *sval, DBnamescheme *embedns)
+{
+    if (!str)
+        return 0;
+    if (str->owned)
+        DBFreeNamescheme(str->owned);
+    str->name = sval;
+    str->ns = embedns;
+    str->owned = 0;
+    if (!embedns && sval && strchr(sval, '%'))
+        str->ns = str->owned = DBMakeNamescheme(sval);
+    return 0;
+}
+
 static long long
-EvalExprTree(DBnamescheme const *ns, DBexprnode *tree, long long n)
+EvalExprTree(DBnamescheme const *ns, DBexprnode *tree, long long n, DBexprstr *str)
 {
     if (tree == 0)
         return 0;
     else if ((tree->type == '$' || tree->type == '#') && tree->left != 0)
     {
-        long long i, q = EvalExprTree(ns, tree->left, n);
+        long long i, q = EvalExprTree(ns, tree->left, n, 0);
         for (i = 0; i < ns->narrefs; i++)
         {
             if (strcmp(tree->sval, ns->arrnames[i]) == 0)
             {
                 if (tree->type == '$')
-                    return SaveInternalString(ns,  ((char**)ns->arrvals[i])[q]);
+                    return SetExprStr(str, ((char**)ns->arrvals[i])[q], 0);
                 else
                     return ((int*)ns->arrvals[i])[q];
             }
@@ -312,24 +375,24 @@ EvalExprTree(DBnamescheme const *ns, DBexprnode *tree, long long n)
         else if (tree->type == 'n')
             return n;
         else if (tree->type == 's')
-            return SaveInternalString(ns, tree->sval);
+            return SetExprStr(str, tree->sval, tree->embedns);
     }
     else if (tree->left != 0 && tree->right != 0)
     {
         long long vc = 0, vl = 0, vr = 0;
         if (tree->type == '?')
         {
-            vc = EvalExprTree(ns, tree->left, n);
+            vc = EvalExprTree(ns, tree->left, n, 0);
             tree = tree->right;
             if (vc) 
-                vl = EvalExprTree(ns, tree->left, n);
+                vl = EvalExprTree(ns, tree->left, n, str);
             else
-                vr = EvalExprTree(ns, tree->right, n);
+                vr = EvalExprTree(ns, tree->right, n, str);
         }
         else
         {
-            vl = EvalExprTree(ns, tree->left, n);
-            vr = EvalExprTree(ns, tree->right, n);
+            vl = EvalExprTree(ns, tree->left, n, str);
+            vr = EvalExprTree(ns, tree->right, n, str);
         }
         switch (tree->type)
         {
@@ -360,8 +423,12 @@ DBMakeNamescheme(char const *fmt, ...)
     if (fmt == 0 || *fmt == '\0')
         return 0;
 
-    /* Start by allocating an empty name scheme */
-    rv = DBAllocNamescheme();
+    /* Start by allocating an empty name scheme. This avoids the API
+       machinery of DBAllocNamescheme because DBGetNames may get here from
+       several threads for string array entries that are nameschemes. */
+    rv = (DBnamescheme *) calloc(1, sizeof(DBnamescheme));
+    if (!rv)
+        return 0;
 
     // set the delimeter character
     n = 0;
@@ -410,7 +477,7 @@ DBMakeNamescheme(char const *fmt, ...)
             }
         }
     }
-    rv->fmtptrs[rv->ncspecs] = &(rv->fmt[n+1]);
+    rv->fmtptrs[rv->ncspecs] = &(rv->fmt[rv->fmtlen]);
 
     /* If there are no conversion specs., we have nothing to do */
     /* However, in this case, assume the first char is a real char. */
@@ -419,6 +486,7 @@ DBMakeNamescheme(char const *fmt, ...)
         free(rv->fmt);
         rv->fmt = STRNDUP(&fmt[0],n);
         rv->fmtlen = n;
+        rv->fmtptrs[0] = &(rv->fmt[n]);
         return rv;
     }
 
@@ -561,54 +629,111 @@ DBMakeNamescheme(char const *fmt, ...)
         }
     }
 
+    /* Compile each expression once here rather than on every DBGetName */
+    if (rv)
+    {
+        rv->exprtrees = (void **) calloc(rv->ncspecs, sizeof(void*));
+        for (i = 0; rv->exprtrees && i < rv->ncspecs; i++)
+            rv->exprtrees[i] = CompileExpr(rv->exprstrs[i]);
+    }
+
     return rv;
 }
 
-PUBLIC const char *
-DBGetName(DBnamescheme const *ns, long long natnum)
+/* Format the name for natnum into buf, truncating at size-1 chars. This
+   touches only the namescheme's compiled expressions and the caller's
+   storage so many threads may format names from one namescheme at once. */
+static void
+FormatName(DBnamescheme const *ns, long long natnum, char *buf, size_t size)
 {
-    char *currentExpr, *tmpExpr;
-    char retval[1024];
+    size_t len, n;
     int i;
 
-    /* a hackish way to cleanup the saved returned string buffer */
-    if (ns == 0 && natnum == -1) return SaveReturnedString(0);
-    if (ns == 0) return SaveReturnedString("");
+    buf[0] = '\0';
+    if (!ns || !ns->fmt || size < 2)
+        return;
 
-    if (!ns->fmt) return "";
+    len = ns->fmtptrs[0] - ns->fmt;
+    if (len > size-1) len = size-1;
+    memcpy(buf, ns->fmt, len);
+    buf[len] = '\0';
 
-    retval[0] = '\0';
-    strncat(retval, ns->fmt, ns->fmtptrs[0] - ns->fmt);
-    for (i = 0; i < ns->ncspecs; i++)
+    for (i = 0; i < ns->ncspecs && len < size-1; i++)
     {
-        char tmp[256];
-        char tmpfmt[256] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                            0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                            0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                            0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                            0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                            0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                            0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
-                            0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
+        char tmp[1024];
+        char tmpfmt[256];
+        DBexprstr str = {0, 0, 0};
         DBexprnode *exprtree;
         long long theVal;
 
-        currentExpr = STRDUP(ns->exprstrs[i]);
-        tmpExpr = currentExpr;
-        exprtree = BuildExprTree((const char **)&currentExpr);
-        theVal = EvalExprTree(ns, exprtree, natnum);
-        FreeTree(exprtree);
-        strncpy(tmpfmt, ns->fmtptrs[i], ns->fmtptrs[i+1] - ns->fmtptrs[i]);
-        if (strncmp(tmpfmt, "%s", 2) == 0 && 0 <= theVal && theVal < DB_MAX_EXPNS)
-            sprintf(tmp, tmpfmt, DBGetName(ns->embedns[theVal],natnum));
+        /* Nameschemes from DBMakeNamescheme are always compiled but fall
+           back to parsing the expression for any that were built by hand */
+        if (ns->exprtrees)
+            exprtree = (DBexprnode *) ns->exprtrees[i];
         else
-            sprintf(tmp, tmpfmt, theVal);
-        strcat(retval, tmp);
-        FREE(tmpExpr);
+            exprtree = CompileExpr(ns->exprstrs[i]);
+        theVal = EvalExprTree(ns, exprtree, natnum, &str);
+        if (!ns->exprtrees)
+            FreeTree(exprtree);
+
+        n = ns->fmtptrs[i+1] - ns->fmtptrs[i];
+        if (n > sizeof(tmpfmt)-1) n = sizeof(tmpfmt)-1;
+        memcpy(tmpfmt, ns->fmtptrs[i], n);
+        tmpfmt[n] = '\0';
+
+        if (strncmp(tmpfmt, "%s", 2) == 0)
+        {
+            char embed[1024];
+            if (str.ns)
+                FormatName(str.ns, natnum, embed, sizeof(embed));
+            else
+                snprintf(embed, sizeof(embed), "%s", str.name ? str.name : "");
+            snprintf(tmp, sizeof(tmp), tmpfmt, embed);
+        }
+        else
+            snprintf(tmp, sizeof(tmp), tmpfmt, theVal);
+        SetExprStr(&str, 0, 0);
+
+        n = strlen(tmp);
+        if (n > size-1-len) n = size-1-len;
+        memcpy(&buf[len], tmp, n);
+        len += n;
+        buf[len] = '\0';
     }
+}
+
+PUBLIC const char *
+DBGetName(DBnamescheme const *ns, long long natnum)
+{
+    char retval[1024];
+
+    /* a hackish way to cleanup the saved returned string buffer */
+    if (ns == 0 && natnum == -1) return SaveReturnedString(0);
+    if (ns == 0) return SaveReturnedString("");
+
+    if (!ns->fmt) return "";
+
+    FormatName(ns, natnum, retval, sizeof(retval));
     return SaveReturnedString(retval);
 }
 
+PUBLIC int
+DBGetNames(DBnamescheme const *ns, long long first, int count,
+    char *names, int namelen)
+{
+    int i;
+
+    if (ns == 0 || first < 0 || count < 0)
+        return -1;
+    if (count > 0 && (names == 0 || namelen <= 0))
+        return -1;
+
+    for (i = 0; i < count; i++)
+        FormatName(ns, first + i, &names[(size_t) i * namelen], (size_t) namelen);
+
+    return 0;
+}
+
 PUBLIC long long
 DBGetIndex(char const *dbns_name_str, int fieldSelector, int base)
 {
@@ -650,7 +775,7 @@ DBGetIndex(char const *dbns_name_str, int fieldSelector, int base)
 PUBLIC char const *
 DBSPrintf(char const *fmt, ...)
 {
-    static char strbuf[2048];
+    static SILO_TLS char strbuf[2048];
     static size_t const nmax = sizeof(strbuf);
     va_list ap;
     int n, en;
@@ -77,6 +77,25 @@ be used for advertising or product endorsement purposes.
 #endif
 #endif
 #include "silo.h"
+#ifdef SILO_THREADSAFE
+#include <pthread.h>
+#endif
+
+/*
+ * In a thread-safe build, SILO_TLS makes a variable per-thread. Otherwise
+ * it is empty.
+ */
+#ifdef SILO_THREADSAFE
+#if defined(_MSC_VER)
+#define SILO_TLS __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define SILO_TLS _Thread_local
+#else
+#define SILO_TLS __thread
+#endif
+#else
+#define SILO_TLS
+#endif
 
 /*
  * The error mechanism....
@@ -91,9 +110,8 @@ be used for advertising or product endorsement purposes.
  * a `return' statement inside the API_BEGIN/API_END construct should be
  * coded as an `API_RETURN(x)' macro call.  As a convenience, returning
  * the failure value as registered with API_BEGIN may be done by calling
- * API_ERROR().  API_BEGIN and API_BEGIN2 cannot be used in routines that
- * are recursive.  This is because there are two local variables that are
- * declared static so that setjmp and longjmp work properly.
+ * API_ERROR().  The two local variables that are read after a longjmp
+ * are declared volatile so that setjmp and longjmp work properly.
  *
  * Synopsis:
  *
@@ -190,7 +208,7 @@ be used for advertising or product endorsement purposes.
  * device driver developers to constantly worry about the error handling
  * mechanism.
  *
- * Each time an API function is called and the global jump stack, Jstk, is
+ * Each time an API function is called and the jump stack, Jstk, is
  * empty (as it should be at the application level) the API function will
  * call setjmp() and add the resulting jump buffer to the jump stack.  The
  * API_END macro conditionally removes this item from the jump stack.  When
@@ -223,6 +241,16 @@ be used for advertising or product endorsement purposes.
  *    CANCEL_UNWIND;
  * } END_PROTECT;
  *      -- we continue here regardless of status --
+ *
+ * In a thread-safe build (SILO_THREADSAFE), the jump stack and the last
+ * error number and function name are per-thread, so each thread sees
+ * only its own errors. Because the device drivers and the libraries
+ * under them are not reentrant, the API function that finds its thread's
+ * jump stack empty also takes a library-wide lock, db_api_lock(), and
+ * releases it wherever it pops that jump stack entry. Nested API calls
+ * on the same thread find the stack non-empty and so do not lock again.
+ * The lock is recursive so that an error handling function called by
+ * db_perror() may itself call the API.
  */
 typedef struct jstk_t {
     struct jstk_t *prev;
@@ -234,8 +262,22 @@ typedef struct context_t {
     char          *name;
 } context_t;
 
-#define jstk_push()     {jstk_t*jt=ALLOC(jstk_t);jt->prev=SILO_Globals.Jstk;SILO_Globals.Jstk=jt;}
-#define jstk_pop()      if(SILO_Globals.Jstk){jstk_t*jt=SILO_Globals.Jstk;SILO_Globals.Jstk=SILO_Globals.Jstk->prev;FREE(jt);}
+#ifdef SILO_THREADSAFE
+#define SILO_Jstk       SILO_Thread.Jstk
+#define SILO_Errno      SILO_Thread.db_errno
+#define SILO_Errfunc    SILO_Thread.db_errfunc
+#define API_LOCK        int jlock = !SILO_Jstk; if (jlock) db_api_lock();
+#define API_UNLOCK      if (jlock) db_api_unlock();
+#else
+#define SILO_Jstk       SILO_Globals.Jstk
+#define SILO_Errno      db_errno
+#define SILO_Errfunc    db_errfunc
+#define API_LOCK
+#define API_UNLOCK
+#endif
+
+#define jstk_push()     {jstk_t*jt=ALLOC(jstk_t);jt->prev=SILO_Jstk;SILO_Jstk=jt;}
+#define jstk_pop()      if(SILO_Jstk){jstk_t*jt=SILO_Jstk;SILO_Jstk=SILO_Jstk->prev;FREE(jt);}
 
 #define DEPRECATE_MSG(M,Maj,Min,Alt)                                          \
 {                                                                             \
@@ -257,21 +299,23 @@ typedef struct context_t {
 
 #define API_BEGIN(M,T,R) {                                                    \
                         char    *me = M ;                                     \
-                        static int     jstat ;                                \
-                        static context_t *jold ;                              \
+                        volatile int jstat ;                                  \
+                        context_t *volatile jold ;                            \
                         DBfile  *jdbfile = NULL ;                             \
                         T jrv = R ;                                           \
+                        API_LOCK                                              \
                         jstat = 0 ;                                           \
                         jold = NULL ;                                         \
                         if (DBDebugAPI>0) {                                   \
                            write (DBDebugAPI, M, strlen(M));                  \
                            write (DBDebugAPI, "\n", 1);                       \
                         }                                                     \
-                        if (!SILO_Globals.Jstk){                              \
+                        if (!SILO_Jstk){                                      \
                            jstk_push() ;                                      \
-                           if (setjmp(SILO_Globals.Jstk->jbuf)) {             \
-                              while (SILO_Globals.Jstk) jstk_pop () ;         \
-                              db_perror ("", db_errno, me) ;                  \
+                           if (setjmp(SILO_Jstk->jbuf)) {                     \
+                              while (SILO_Jstk) jstk_pop () ;                 \
+                              db_perror ("", SILO_Errno, me) ;                \
+                              API_UNLOCK                                      \
                               return R ;                                      \
                            }                                                  \
                            jstat = 1 ;                                        \
@@ -283,42 +327,46 @@ typedef struct context_t {
 
 #define API_BEGIN2(M,T,R,NM) {                                                \
                         char    *me = M ;                                     \
-                        static int     jstat ;                                \
-                        static context_t *jold ;                              \
+                        volatile int jstat ;                                  \
+                        context_t *volatile jold ;                            \
                         DBfile  *jdbfile = dbfile ;                           \
                         T jrv = R ;                                           \
+                        API_LOCK                                              \
                         jstat = 0 ;                                           \
                         jold = NULL ;                                         \
                         if (db_isregistered_file(dbfile,0) == -1)             \
                         {                                                     \
                             db_perror("", E_NOTREG, me);                      \
+                            API_UNLOCK                                        \
                             return R;                                         \
                         }                                                     \
                         if (DBDebugAPI>0) {                                   \
                            write (DBDebugAPI, M, strlen(M));                  \
                            write (DBDebugAPI, "\n", 1);                       \
                         }                                                     \
-                        if (!SILO_Globals.Jstk){                              \
+                        if (!SILO_Jstk){                                      \
                            jstk_push() ;                                      \
-                           if (setjmp(SILO_Globals.Jstk->jbuf)) {             \
+                           if (setjmp(SILO_Jstk->jbuf)) {                     \
                               if (jold) {                                     \
                                  context_restore (jdbfile, jold) ;            \
                               }                                               \
-                              while (SILO_Globals.Jstk) jstk_pop () ;         \
-                              db_perror ("", db_errno, me) ;                  \
+                              while (SILO_Jstk) jstk_pop () ;                 \
+                              db_perror ("", SILO_Errno, me) ;                \
+                              API_UNLOCK                                      \
                               return R ;                                      \
                            }                                                  \
                            jstat = 1 ;                                        \
                            if (NM && jdbfile && !jdbfile->pub.pathok) {       \
                               char const *jr ;                                \
                               jold = context_switch (jdbfile,NM,&jr) ;        \
-                              if (!jold) longjmp (SILO_Globals.Jstk->jbuf, -1) ;\
+                              if (!jold) longjmp (SILO_Jstk->jbuf, -1) ;      \
                               NM = jr ;                                       \
                            }                                                  \
                         }
 
 #define API_END         if (jold) context_restore (jdbfile, jold) ;     \
                         if (jstat) jstk_pop() ;                         \
+                        API_UNLOCK                                      \
                      }                        /*API_BEGIN or API_BEGIN2 */
 
 #define API_END_NOPOP   }         /*API_BEGIN or API_BEGIN2 */
@@ -327,6 +375,7 @@ typedef struct context_t {
                            db_perror (S,N,me) ; /*might never return*/  \
                            if (jold) context_restore (jdbfile, jold) ;  \
                            if (jstat) jstk_pop() ;                      \
+                           API_UNLOCK                                   \
                            return jrv ;                                 \
                         }
 
@@ -334,13 +383,14 @@ typedef struct context_t {
                            jrv = R ; /*might be a calculation*/         \
                            if (jold) context_restore (jdbfile, jold) ;  \
                            if (jstat) jstk_pop() ;                      \
+                           API_UNLOCK                                   \
                            return jrv ;                                 \
                         }
 
-#define PROTECT         {jstk_push();if(!setjmp(SILO_Globals.Jstk->jbuf)){
-#define UNWIND()        longjmp(SILO_Globals.Jstk->jbuf,-1)
+#define PROTECT         {jstk_push();if(!setjmp(SILO_Jstk->jbuf)){
+#define UNWIND()        longjmp(SILO_Jstk->jbuf,-1)
 #define CLEANUP         jstk_pop();}else{int jcan=0;
-#define END_PROTECT     jstk_pop();if(!jcan&&SILO_Globals.Jstk)longjmp(SILO_Globals.Jstk->jbuf,-1);}}
+#define END_PROTECT     jstk_pop();if(!jcan&&SILO_Jstk)longjmp(SILO_Jstk->jbuf,-1);}}
 #define CANCEL_UNWIND   jcan=1
 
 /*
@@ -853,9 +903,28 @@ typedef struct SILO_Globals_t {
     int _db_err_level_drvr;
     jstk_t *Jstk;   /*error jump stack  */
     int unknownDriverPriorities[MAX_FILE_OPTIONS_SETS+10+1];
+    int facelistThreads;
+    int tocNamesOnly;
+    int maxCachedFiles;
+    int pdbObjectCacheSize;
+    long long pdbObjectCacheHits;
+    long long pdbObjectCacheMisses;
+    long long fileCacheHits;
+    long long fileCacheMisses;
+    int materialCalcThreads;
 } SILO_Globals_t;
 extern SILO_Globals_t SILO_Globals;
 
+#ifdef SILO_THREADSAFE
+/* Error state kept per-thread in a thread-safe build */
+typedef struct SILO_Thread_t {
+    jstk_t *Jstk;           /*error jump stack                */
+    int db_errno;           /*last error number               */
+    char db_errfunc[64];    /*name of erring function         */
+} SILO_Thread_t;
+extern SILO_TLS SILO_Thread_t SILO_Thread;
+#endif
+
 struct db_PathnameComponentTag
 {  char                            *name;
    struct db_PathnameComponentTag *prevComponent;
@@ -880,12 +949,23 @@ INTERNAL DBfile *silo_db_close (DBfile *);
 INTERNAL int db_num_registered_files();
 INTERNAL DBtoc *db_AllocToc (void);
 INTERNAL int db_FreeToc (DBfile *);
+INTERNAL void db_InvalidateToc (DBfile *, char const *);
+INTERNAL int db_TocNamesOnly (DBfile *);
+INTERNAL void *db_TakeCachedFile (char const *, int);
+INTERNAL void db_ReturnCachedFile (char const *, int, void *, void (*)(void *));
+INTERNAL void db_FlushFileCache (int);
 INTERNAL int db_GetMachDataSize (int);
 INTERNAL char *DBGetObjtypeName (int);
 INTERNAL char *db_strndup (const char *, int);
+INTERNAL void db_FreeNameschemeExprs (DBnamescheme *);
+INTERNAL void *db_GetReadBuffer (DBfile *, char const *, int, int, long long);
 INTERNAL char *db_GetDatatypeString (int);
 INTERNAL int db_GetDatatypeID (char const * const);
 INTERNAL int db_perror (char const *, int, char const *);
+#ifdef SILO_THREADSAFE
+INTERNAL void db_api_lock (void);
+INTERNAL void db_api_unlock (void);
+#endif
 INTERNAL void _DBQQCalcStride (int *, int *, int, int);
 INTERNAL void _DBQMSetStride (DBquadmesh *);
 INTERNAL int _DBstrprint (FILE *, char **, int, int, int, int, int);
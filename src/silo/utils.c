@@ -57,152 +57,307 @@ be used for advertising or product endorsement purposes.
 
 #include "silo_private.h"
 
-static double get_frac(int m, int i, int dtype, DBVCP2_t const vfracs)
+#if defined(HAVE_PTHREAD_H) && !defined(_WIN32)
+#define DB_MATCALC_THREADS
+#include <pthread.h>
+#endif
+
+/* Zones are converted in blocks small enough that the volume fractions of
+   every material for a block stay in cache between the passes made over
+   it.  Threads are handed contiguous runs of blocks. */
+#define MATCALC_BLOCK       128
+#define MATCALC_THREADS_MAX 64
+
+/***********************************************************************
+ *
+ * Purpose:  Set the number of threads DBCalcMaterialFromDenseArrays and
+ *           DBCalcDenseArraysFromMaterial use to convert zones.
+ *
+ * Input arguments:
+ *    nthreads : The number of threads.  Values less than 2 convert
+ *               serially, which is the default.
+ *
+ * Output arguments:
+ *    oldval   : The previous number of threads.
+ *
+ * Notes
+ *    Each thread converts a contiguous range of zones, so the results
+ *    do not depend on the number of threads.
+ *
+ **********************************************************************/
+
+PUBLIC int
+DBSetMaterialCalcThreads(int nthreads)
 {
-    assert(dtype==DB_FLOAT || dtype==DB_DOUBLE);
-    if (dtype == DB_FLOAT)
-    {
-        float const **ffracs = (float const **) vfracs;
-        if (!ffracs[m]) return 0;
-        return ffracs[m][i];
-    }
-    else if (dtype == DB_DOUBLE)
+    int oldval = SILO_Globals.materialCalcThreads;
+    SILO_Globals.materialCalcThreads = nthreads;
+    return oldval;
+}
+
+PUBLIC int
+DBGetMaterialCalcThreads(void)
+{
+    return SILO_Globals.materialCalcThreads;
+}
+
+/* Run JOB on each of NPARTS structs of PARTSIZE bytes starting at PARTS,
+   one per thread.  The calling thread takes the first part and any part
+   whose thread could not be started. */
+typedef void *(*db_matcalc_job_t)(void *part);
+
+PRIVATE void
+db_matcalc_run(db_matcalc_job_t job, void *parts, size_t partsize, int nparts)
+{
+    int i;
+#ifdef DB_MATCALC_THREADS
+    pthread_t threads[MATCALC_THREADS_MAX];
+    int started[MATCALC_THREADS_MAX];
+
+    for (i = 1; i < nparts; i++)
+        started[i] = pthread_create(&threads[i], NULL, job,
+                                    (char *) parts + i * partsize) == 0;
+    job(parts);
+    for (i = 1; i < nparts; i++)
     {
-        double const **dfracs = (double const **) vfracs;
-        if (!dfracs[m]) return 0;
-        return dfracs[m][i];
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else
+            job((char *) parts + i * partsize);
     }
+#else
+    for (i = 0; i < nparts; i++)
+        job((char *) parts + i * partsize);
+#endif
+}
+
+/* Number of parts to split NZONES zones into. */
+PRIVATE int
+db_matcalc_nparts(int nzones)
+{
+    int nblocks = (nzones + MATCALC_BLOCK - 1) / MATCALC_BLOCK;
+    int nparts = 1;
+#ifdef DB_MATCALC_THREADS
+    nparts = MIN(DBGetMaterialCalcThreads(), MATCALC_THREADS_MAX);
+    nparts = MIN(nparts, nblocks);
+#endif
+    return MAX(nparts, 1);
+}
+
+/* Zones [z0,z1) of the dense arrays and the mix entries made from them.
+   Each part builds its own mix arrays, numbered from zero.  Once every
+   part is done they are shifted by OFFSET and copied into place. */
+typedef struct db_dense2mat_part_t {
+    int             narrs;
+    int             dtype;
+    int const      *matnos;
+    DBVCP2_t        vfracs;
+    int            *matlist;
+    int             z0, z1;
+    int             len, cap;
+    int            *mix_mat, *mix_zone, *mix_next;
+    void           *mix_vf;
+    int             failed;
+    int             offset;
+    DBmaterial     *mat;
+} db_dense2mat_part_t;
+
+PRIVATE int
+db_dense2mat_grow(db_dense2mat_part_t *p, int need)
+{
+    size_t vfsize = p->dtype == DB_FLOAT ? sizeof(float) : sizeof(double);
+    int cap = MAX(p->cap, 1024);
+    void *tmp;
+
+    while (cap < need)
+        cap *= 2;
+    if (cap == p->cap)
+        return 0;
+
+    if (!(tmp = realloc(p->mix_mat, cap * sizeof(int)))) return -1;
+    p->mix_mat = (int *) tmp;
+    if (!(tmp = realloc(p->mix_zone, cap * sizeof(int)))) return -1;
+    p->mix_zone = (int *) tmp;
+    if (!(tmp = realloc(p->mix_next, cap * sizeof(int)))) return -1;
+    p->mix_next = (int *) tmp;
+    if (!(tmp = realloc(p->mix_vf, cap * vfsize))) return -1;
+    p->mix_vf = tmp;
+    p->cap = cap;
     return 0;
 }
 
-static void put_frac(void *mix_vf, int mixlen, int dtype, double vf)
+/* For each block of zones, first count the mixing entries of every zone,
+   which tells each zone where its entries go, then fill them in.  Both
+   passes go material by material so the inner loops run down contiguous
+   fractions, and the second pass finds the block's fractions in cache.
+   A zone's entries are consecutive and in material order, so each links
+   to the next without walking its list.  A zone with a fraction >= 1 is
+   clean.  Mixing fractions that come after it are kept as unlinked
+   placeholder entries.  This is the layout the zone-by-zone loop this
+   replaced produced. */
+#define DB_DENSE2MAT_KERNEL(NAME, T)                                        \
+PRIVATE void *                                                              \
+NAME(void *arg)                                                             \
+{                                                                           \
+    db_dense2mat_part_t *p = (db_dense2mat_part_t *) arg;                   \
+    T const * const *fracs = (T const * const *) p->vfracs;                 \
+    const int notSet = -INT_MAX;                                            \
+    int next[MATCALC_BLOCK], last[MATCALC_BLOCK];                           \
+    int z0, z1, z, m, n;                                                    \
+                                                                            \
+    for (z0 = p->z0; z0 < p->z1; z0 = z1)                                   \
+    {                                                                       \
+        z1 = MIN(z0 + MATCALC_BLOCK, p->z1);                                \
+                                                                            \
+        for (z = 0; z < z1 - z0; z++)                                       \
+            next[z] = 0;                                                    \
+        for (m = 0; m < p->narrs; m++)                                      \
+        {                                                                   \
+            T const *f = fracs[m];                                          \
+            if (!f) continue;                                               \
+            for (z = z0; z < z1; z++)                                       \
+                next[z-z0] += (0 < f[z]) & (f[z] < 1);                      \
+        }                                                                   \
+                                                                            \
+        /* turn the counts into the index of each zone's first entry */     \
+        for (z = 0, n = p->len; z < z1 - z0; z++)                           \
+        {                                                                   \
+            int cnt = next[z];                                              \
+            next[z] = n;                                                    \
+            n += cnt;                                                       \
+        }                                                                   \
+        if (db_dense2mat_grow(p, n) != 0)                                   \
+        {                                                                   \
+            p->failed = 1;                                                  \
+            return 0;                                                       \
+        }                                                                   \
+        p->len = n;                                                         \
+                                                                            \
+        for (z = z0; z < z1; z++)                                           \
+            p->matlist[z] = notSet;                                         \
+        for (m = 0; m < p->narrs; m++)                                      \
+        {                                                                   \
+            T const *f = fracs[m];                                          \
+            int matno = p->matnos[m];                                       \
+            if (!f) continue;                                               \
+            for (z = z0; z < z1; z++)                                       \
+            {                                                               \
+                T vf = f[z];                                                \
+                if (vf >= 1)                                                \
+                {                                                           \
+                    assert(p->matlist[z] == notSet);                        \
+                    p->matlist[z] = matno;                                  \
+                }                                                           \
+                else if (vf > 0)                                            \
+                {                                                           \
+                    int j = next[z-z0]++;                                   \
+                    p->mix_mat[j] = matno;                                  \
+                    ((T *) p->mix_vf)[j] = vf;                              \
+                    p->mix_zone[j] = z+1; /* one origin */                  \
+                    p->mix_next[j] = 0;                                     \
+                    if (p->matlist[z] == notSet)                            \
+                        p->matlist[z] = -(j+1);                             \
+                    else if (p->matlist[z] < 0)                             \
+                        p->mix_next[last[z-z0]] = j+1;                      \
+                    last[z-z0] = j;                                         \
+                }                                                           \
+            }                                                               \
+        }                                                                   \
+    }                                                                       \
+    return 0;                                                               \
+}
+
+DB_DENSE2MAT_KERNEL(db_dense2mat_float, float)
+DB_DENSE2MAT_KERNEL(db_dense2mat_double, double)
+
+/* Copy a part's mix entries to their place in the material object. */
+PRIVATE void *
+db_dense2mat_place(void *arg)
 {
-    assert(mix_vf);
-    assert(dtype==DB_FLOAT || dtype==DB_DOUBLE);
-    assert(0 <= vf && vf <= 1);
-    if (dtype == DB_FLOAT)
+    db_dense2mat_part_t *p = (db_dense2mat_part_t *) arg;
+    DBmaterial *mat = p->mat;
+    size_t vfsize = p->dtype == DB_FLOAT ? sizeof(float) : sizeof(double);
+    int i, z;
+
+    for (z = p->z0; z < p->z1; z++)
+        if (p->matlist[z] < 0 && p->matlist[z] != -INT_MAX)
+            p->matlist[z] -= p->offset;
+    for (i = 0; i < p->len; i++)
     {
-        float *fmix_vf = (float *) mix_vf;
-        fmix_vf[mixlen] = (float) vf;
-    }
-    else if (dtype == DB_DOUBLE)
-    {
-        double *dmix_vf = (double *) mix_vf;
-        dmix_vf[mixlen] = vf;
+        mat->mix_mat[p->offset + i] = p->mix_mat[i];
+        mat->mix_zone[p->offset + i] = p->mix_zone[i];
+        mat->mix_next[p->offset + i] = p->mix_next[i] ? p->mix_next[i] + p->offset : 0;
     }
+    if (p->len)
+        memcpy((char *) mat->mix_vf + p->offset * vfsize, p->mix_vf, p->len * vfsize);
+    return 0;
+}
+
+PRIVATE void
+db_dense2mat_free_part(db_dense2mat_part_t *p)
+{
+    FREE(p->mix_mat);
+    FREE(p->mix_zone);
+    FREE(p->mix_next);
+    FREE(p->mix_vf);
 }
 
 static
 DBmaterial *db_CalcMaterialFromDenseArrays(int narrs, int ndims, int const *dims,
     int const *matnos, int dtype, DBVCP2_t const vfracs)
 {
+    static char const *me = "db_CalcMaterialFromDenseArrays";
     const int notSet = -INT_MAX;
-    int i,m,z,nzones = 1;
-    int *matlist = 0, mixlen = 0, *mix_mat = 0;
-    int *mix_zone = 0, *mix_next = 0;
-    int *matnos_copy = 0;
-    void *mix_vf = 0;
+    size_t vfsize = dtype == DB_FLOAT ? sizeof(float) : sizeof(double);
+    int i, nzones = 1, nparts, mixlen = 0;
+    int *matlist = 0, *matnos_copy = 0;
+    db_dense2mat_part_t parts[MATCALC_THREADS_MAX];
     DBmaterial *mat = 0;
 
+    /* compute number of zones (and array length) */
+    for (i = 0; i < ndims; i++)
+        nzones *= dims[i];
+
+    nparts = db_matcalc_nparts(nzones);
+    memset(parts, 0, sizeof(parts));
+
     /* copy matnos (we'll need it for returned material object anyways) */
     matnos_copy = (int *) malloc(narrs * sizeof(int));
     if (!matnos_copy) goto cleanup;
     memcpy(matnos_copy, matnos, narrs * sizeof(int));
 
-    /* compute number of zones (and array length) */
-    for (i = 0; i < ndims; i++)
-        nzones *= dims[i];
-
-    /* allocate and fill matlist array with the 'notSet' value */
-    matlist = (int *) malloc(nzones * sizeof(int)); 
+    matlist = (int *) malloc(nzones * sizeof(int));
     if (!matlist) goto cleanup;
 
-    for (i = 0; i < nzones; i++)
-        matlist[i] = notSet;
-
-    /* pre-compute size of mix arrays */
-    for (m = 0; m < narrs; m++)
+    /* Build the mix entries of each range of zones. Only float and double
+       fractions are meaningful; any other type leaves every zone unset. */
+    for (i = 0; i < nparts; i++)
     {
-        for (z = 0; z < nzones; z++)
-        {
-            double vf = get_frac(m, z, dtype, vfracs);
-            if (0 < vf && vf < 1)
-                mixlen++;
-        }
+        parts[i].narrs = narrs;
+        parts[i].dtype = dtype;
+        parts[i].matnos = matnos;
+        parts[i].vfracs = vfracs;
+        parts[i].matlist = matlist;
+        parts[i].z0 = (int) ((long long) nzones * i / nparts);
+        parts[i].z1 = (int) ((long long) nzones * (i+1) / nparts);
     }
+    if (dtype == DB_FLOAT)
+        db_matcalc_run(db_dense2mat_float, parts, sizeof(parts[0]), nparts);
+    else if (dtype == DB_DOUBLE)
+        db_matcalc_run(db_dense2mat_double, parts, sizeof(parts[0]), nparts);
+    else
+        for (i = 0; i < nzones; i++)
+            matlist[i] = notSet;
 
-    /* allocate mix arrays */
-    mix_vf   = malloc(mixlen * (dtype==DB_FLOAT?sizeof(float):sizeof(double))); 
-    if (!mix_vf) goto cleanup;
-    mix_mat  = (int *) malloc(mixlen * sizeof(int));
-    if (!mix_mat) goto cleanup;
-    mix_zone = (int *) malloc(mixlen * sizeof(int));
-    if (!mix_zone) goto cleanup;
-    mix_next = (int *) malloc(mixlen * sizeof(int));
-    if (!mix_next) goto cleanup;
-
-    /* Loop over zones, then materials to ensure this operation
-       will faithfully invert the companion operation. */
-    mixlen = 0;
-    for (z = 0; z < nzones; z++)
+    for (i = 0; i < nparts; i++)
     {
-        int nmixing = 0;
-        for (m = 0; m < narrs; m++)
-        {
-            double vf = get_frac(m, z, dtype, vfracs);
-
-            if (vf >= 1.0)
-            {
-                assert(matlist[z] == notSet);
-                matlist[z] = matnos[m];
-            }
-            else if (vf > 0.0)
-            {
-                nmixing++;
-                if (matlist[z] == notSet)
-                {
-                    /* put the first entry in the list for this zone */
-                    matlist[z] = -(mixlen+1); 
-                    mix_mat [mixlen] = matnos[m];
-                    put_frac(mix_vf, mixlen, dtype, vf);
-                    mix_zone[mixlen] = z+1; /* one origin */
-                    mix_next[mixlen] = 0;
-                }
-                else if (matlist[z] < 0)
-                {
-                    /* walk forward through the list for this zone */
-                    int j = -(matlist[z]+1);
-                    while (mix_next[j]!=0)
-                        j = mix_next[j]-1;
-
-                    /* link up last entry in list with the new entry */
-                    mix_next[j] = mixlen+1;
-
-                    /* put in the new entry */
-                    mix_mat [mixlen] = matnos[m];
-                    put_frac(mix_vf, mixlen, dtype, vf);
-                    mix_zone[mixlen] = z+1; /* one origin */
-                    mix_next[mixlen] = 0;
-                }
-                else
-                {
-                    /* We've encountered a zone with a frac>=1 *AND* another
-                       frac > 0. We ignore the frac>0 since we already have
-                       marked the zone clean for the frac>=1. We effectively
-                       put a placeholder entry into the mix arrays here. */
-                    mix_mat [mixlen] = matnos[m];
-                    put_frac(mix_vf, mixlen, dtype, vf);
-                    mix_zone[mixlen] = z+1; /* one origin */
-                    mix_next[mixlen] = 0;
-                }
-                mixlen++;
-            }
-        }
-        assert(nmixing==0 || nmixing>=2);
+        if (parts[i].failed) goto cleanup;
+        parts[i].offset = mixlen;
+        mixlen += parts[i].len;
     }
 
     /* create material object to return */
     mat = DBAllocMaterial();
+    if (!mat) goto cleanup;
     mat->origin = 0;
     mat->ndims = ndims;
     for (i = 0; i < ndims; i++)
@@ -211,22 +366,50 @@ DBmaterial *db_CalcMaterialFromDenseArrays(int narrs, int ndims, int const *dims
     mat->matnos = matnos_copy;
     mat->matlist = matlist;
     mat->datatype = dtype;
-    mat->mix_vf = mix_vf;
-    mat->mix_next = mix_next;
-    mat->mix_mat = mix_mat;
-    mat->mix_zone = mix_zone;
     mat->mixlen = mixlen;
 
+    /* A single part's arrays are already in place. Otherwise, renumber
+       each part's entries and copy them after those of the parts before
+       it. */
+    if (nparts == 1 && parts[0].cap)
+    {
+        mat->mix_mat = parts[0].mix_mat;
+        mat->mix_zone = parts[0].mix_zone;
+        mat->mix_next = parts[0].mix_next;
+        mat->mix_vf = parts[0].mix_vf;
+        memset(&parts[0], 0, sizeof(parts[0]));
+    }
+    else
+    {
+        mat->mix_mat = (int *) malloc(MAX(mixlen,1) * sizeof(int));
+        mat->mix_zone = (int *) malloc(MAX(mixlen,1) * sizeof(int));
+        mat->mix_next = (int *) malloc(MAX(mixlen,1) * sizeof(int));
+        mat->mix_vf = malloc(MAX(mixlen,1) * vfsize);
+        if (!mat->mix_mat || !mat->mix_zone || !mat->mix_next || !mat->mix_vf)
+        {
+            mat->matnos = 0;
+            mat->matlist = 0;
+            DBFreeMaterial(mat);
+            mat = 0;
+            goto cleanup;
+        }
+        for (i = 0; i < nparts; i++)
+            parts[i].mat = mat;
+        db_matcalc_run(db_dense2mat_place, parts, sizeof(parts[0]), nparts);
+    }
+
+    for (i = 0; i < nparts; i++)
+        db_dense2mat_free_part(&parts[i]);
+
     return(mat);
 
 cleanup:
 
+    for (i = 0; i < nparts; i++)
+        db_dense2mat_free_part(&parts[i]);
     FREE(matnos_copy);
-    FREE(matlist); 
-    FREE(mix_vf);
-    FREE(mix_mat);
-    FREE(mix_zone);
-    FREE(mix_next);
+    FREE(matlist);
+    db_perror(NULL, E_NOMEM, me);
 
     return 0;
 }
@@ -254,6 +437,17 @@ DBmaterial *DBCalcMaterialFromDenseArrays(int narrs, int ndims, int const *dims,
     API_END_NOPOP;
 }
 
+/* Maps material numbers to their index in matnos. Material numbers
+   are usually small and dense enough to index a table directly.
+   Otherwise, a sorted copy of (matno, index) pairs is searched. */
+typedef struct db_matmap_t {
+    int         nmat;
+    int         minmat;
+    int         range;          /* table covers minmat...minmat+range-1 */
+    int        *table;          /* index of each matno, or -1 */
+    int        *pairs;          /* sorted matno, index pairs */
+} db_matmap_t;
+
 PRIVATE
 int compar_ints(void const *ia, void const *ib)
 {
@@ -262,73 +456,164 @@ int compar_ints(void const *ia, void const *ib)
     return 0;
 }
 
-/* Binary search for a given material number in the sorted
-   list of material numbers. */
-PRIVATE
-int mat_index(int nmat_nums, int const *mat_nums, int mat_num)
+PRIVATE int
+db_matmap_init(db_matmap_t *map, int nmat, int const *matnos)
 {
-    int bot = 0;
-    int top = nmat_nums - 1;
-    int mid;
-    static int last_mat_num = -1;
-    static int last_mat_idx = 0;
+    int i, minmat, maxmat;
+
+    /* an empty map finds nothing */
+    memset(map, 0, sizeof(*map));
+    if (nmat <= 0)
+        return 0;
 
-    /* quick acclerator (see below for reset logic) */
-    if (mat_num == last_mat_num)
-        return last_mat_idx;
+    map->nmat = nmat;
+    minmat = maxmat = matnos[0];
+    for (i = 1; i < nmat; i++)
+    {
+        minmat = MIN(minmat, matnos[i]);
+        maxmat = MAX(maxmat, matnos[i]);
+    }
+
+    if ((long long) maxmat - minmat < 4LL * nmat + 4096)
+    {
+        map->minmat = minmat;
+        map->range = maxmat - minmat + 1;
+        map->table = (int *) malloc(map->range * sizeof(int));
+        if (!map->table) return -1;
+        for (i = 0; i < map->range; i++)
+            map->table[i] = -1;
+        /* the first of any repeated material numbers wins */
+        for (i = nmat - 1; i >= 0; i--)
+            map->table[matnos[i] - minmat] = i;
+    }
+    else
+    {
+        map->pairs = (int *) malloc(2 * nmat * sizeof(int));
+        if (!map->pairs) return -1;
+        for (i = 0; i < nmat; i++)
+        {
+            map->pairs[2*i] = matnos[i];
+            map->pairs[2*i+1] = i;
+        }
+        qsort(map->pairs, nmat, 2 * sizeof(int), compar_ints);
+    }
+    return 0;
+}
+
+/* Index of MATNO in matnos, or -1 if it isn't there. */
+PRIVATE int
+db_matmap_index(db_matmap_t const *map, int matno)
+{
+    int bot = 0, top = map->nmat - 1;
+
+    if (map->table)
+    {
+        unsigned int i = (unsigned int) matno - (unsigned int) map->minmat;
+        return i < (unsigned int) map->range ? map->table[i] : -1;
+    }
 
     while (bot <= top)
     {
-        mid = (bot + top) >> 1;
+        int mid = (bot + top) >> 1;
 
-        if (mat_num > mat_nums[mid])
+        if (matno > map->pairs[2*mid])
             bot = mid + 1;
-        else if (mat_num < mat_nums[mid])
+        else if (matno < map->pairs[2*mid])
             top = mid - 1;
         else
-        {
-            last_mat_num = mat_num;
-            last_mat_idx = mid;
-            return mid;
-        }
+            return map->pairs[2*mid+1];
     }
-
-    /* Any real inputs should never get here. But,
-       an input to force reset of last num/idx will.
-       We want this logic here instead of at top to
-       avoid having to test whether to execut it *every*
-       lookup. A call of mat_index(0,0,-1) is sufficient
-       to cause this reset code to execute. */
-    assert(nmat_nums==0 && mat_nums==0 && mat_num==-1);
-    last_mat_num = -1;
-    last_mat_idx = 0;
     return -1;
 }
 
+/* Sanity check that the fractions found for each zone add up to one. */
+#define MATCALC_SUM_DECL         float check_frac = 0
+#ifndef NDEBUG
+#define MATCALC_SUM_INIT         (check_frac = 0)
+#define MATCALC_SUM_ADD(VF)      (check_frac += (float) (VF))
+#define MATCALC_SUM_CHECK        assert(0.999 <= check_frac && check_frac < 1.001)
+#else
+#define MATCALC_SUM_INIT         ((void) 0)
+#define MATCALC_SUM_ADD(VF)      ((void) 0)
+#define MATCALC_SUM_CHECK        ((void) check_frac)
+#endif
+
+/* Zones [z0,z1) of the material object and the dense arrays they fill. */
+typedef struct db_mat2dense_part_t {
+    DBmaterial const   *mat;
+    db_matmap_t const  *map;
+    void              **vfracs;
+    int                 z0, z1;
+} db_mat2dense_part_t;
+
+/* Fill in the fractions of each zone in the part. Each zone writes only
+   its own element of the arrays, so parts never touch the same memory.
+   OT is the type of the arrays being filled, MT that of mix_vf. */
+#define DB_MAT2DENSE_KERNEL(NAME, OT, MT)                                   \
+PRIVATE void *                                                              \
+NAME(void *arg)                                                             \
+{                                                                           \
+    db_mat2dense_part_t *p = (db_mat2dense_part_t *) arg;                   \
+    DBmaterial const *mat = p->mat;                                         \
+    OT **arrs = (OT **) p->vfracs;                                          \
+    MT const *mix_vf = (MT const *) mat->mix_vf;                            \
+    int z;                                                                  \
+    MATCALC_SUM_DECL;                                                       \
+                                                                            \
+    for (z = p->z0; z < p->z1; z++)                                         \
+    {                                                                       \
+        int ml = mat->matlist[z];                                           \
+        MATCALC_SUM_INIT;                                                   \
+        if (ml >= 0) /* clean case */                                       \
+        {                                                                   \
+            int idx = db_matmap_index(p->map, ml);                          \
+            if (idx >= 0)                                                   \
+                arrs[idx][z] = 1;                                           \
+            MATCALC_SUM_ADD(1);                                             \
+        }                                                                   \
+        else /* mixing case */                                              \
+        {                                                                   \
+            int mix_idx = -ml - 1;                                          \
+            while (0 <= mix_idx && mix_idx < mat->mixlen)                   \
+            {                                                               \
+                int idx = db_matmap_index(p->map, mat->mix_mat[mix_idx]);   \
+                if (idx >= 0)                                               \
+                    arrs[idx][z] = (OT) mix_vf[mix_idx];                    \
+                MATCALC_SUM_ADD(mix_vf[mix_idx]);                           \
+                mix_idx = mat->mix_next[mix_idx] - 1;                       \
+            }                                                               \
+        }                                                                   \
+        MATCALC_SUM_CHECK;                                                  \
+    }                                                                       \
+    return 0;                                                               \
+}
+
+DB_MAT2DENSE_KERNEL(db_mat2dense_ff, float, float)
+DB_MAT2DENSE_KERNEL(db_mat2dense_fd, float, double)
+DB_MAT2DENSE_KERNEL(db_mat2dense_df, double, float)
+DB_MAT2DENSE_KERNEL(db_mat2dense_dd, double, double)
 
 PRIVATE
 int db_CalcDenseArraysFromMaterial(DBmaterial const *mat, int datatype, int *narrs, void ***vfracs)
 {
     static char const *me = "db_CalcDenseArraysFromMaterial";
-    int i;
+    int i, nparts;
     int nzones = 1;
     int etag = E_NOMEM;
     int typesz = (int) sizeof(float);
-    int *matnos_sorted=0;
-    void **matarrs=0, **matarrs_fixed=0;
-    float *pflt;
-    double *pdbl;
-#ifndef NDEBUG
-    float *check_fracs;
-#endif
+    int mixdbl = mat->mixlen > 0 && mat->datatype == DB_DOUBLE;
+    void **matarrs=0;
+    db_matmap_t map;
+    db_mat2dense_part_t parts[MATCALC_THREADS_MAX];
+    db_matcalc_job_t job;
+
+    memset(&map, 0, sizeof(map));
 
     if (datatype == DB_DOUBLE)
         typesz = (int) sizeof(double);
 
     matarrs = (void **) calloc(mat->nmat,sizeof(void *));
     if (!matarrs) goto cleanup;
-    matarrs_fixed = (void **) calloc(mat->nmat,sizeof(void *));
-    if (!matarrs_fixed) goto cleanup;
 
     for (i = 0; i < mat->ndims; i++)
         nzones *= mat->dims[i];
@@ -339,77 +624,31 @@ int db_CalcDenseArraysFromMaterial(DBmaterial const *mat, int datatype, int *nar
         matarrs[i] = (void *) calloc(nzones, typesz);
         if (!matarrs[i]) goto cleanup;
     }
-#ifndef NDEBUG
-    check_fracs = (float *) calloc(nzones, sizeof(float));
-#endif
 
-    /* make a copy of matnos and sort it for binary search */
-    matnos_sorted = (int *) malloc(mat->nmat * sizeof(int));
-    memcpy(matnos_sorted, mat->matnos, mat->nmat * sizeof(int));
-    qsort(matnos_sorted, mat->nmat, sizeof(int), compar_ints);
+    if (db_matmap_init(&map, mat->nmat, mat->matnos) != 0) goto cleanup;
 
-    /* reset binary searcher last num/idx state */
-    mat_index(0,0,-1);
+    /* mix_vf is read in its own type, which may differ from datatype */
+    if (datatype == DB_DOUBLE)
+        job = mixdbl ? db_mat2dense_dd : db_mat2dense_df;
+    else
+        job = mixdbl ? db_mat2dense_fd : db_mat2dense_ff;
 
-    for (i = 0; i < nzones; i++)
+    nparts = db_matcalc_nparts(nzones);
+    for (i = 0; i < nparts; i++)
     {
-        if (mat->matlist[i] >= 0) /* clean case */
-        {
-            int idx = mat_index(mat->nmat, matnos_sorted, mat->matlist[i]);
-            switch (datatype)
-            {
-                case DB_FLOAT: ((float*)(matarrs[idx]))[i] = 1.0; break;
-                case DB_DOUBLE: ((double*)(matarrs[idx]))[i] = 1.0; break;
-            }
-#ifndef NDEBUG
-            check_fracs[i] += 1.0;
-#endif
-        }
-        else /* mixing case */
-        {
-            int mix_idx = -mat->matlist[i] - 1;
-            while(mix_idx >= 0)
-            {
-                int matno = mat->mix_mat[mix_idx];
-                int idx = mat_index(mat->nmat, matnos_sorted, matno);
-                switch (datatype)
-                {
-                    case DB_FLOAT:
-                        ((float*)matarrs[idx])[i] = ((float*)mat->mix_vf)[mix_idx];
-#ifndef NDEBUG
-                        check_fracs[i] += ((float*)matarrs[idx])[i];
-#endif
-                        break;
-                    case DB_DOUBLE:
-                        ((double*)matarrs[idx])[i] = ((double*)mat->mix_vf)[mix_idx];
-#ifndef NDEBUG
-                        check_fracs[i] += ((double*)matarrs[idx])[i];
-#endif
-                        break;
-                }
-                mix_idx = mat->mix_next[mix_idx] - 1;
-            }
-        }
+        parts[i].mat = mat;
+        parts[i].map = &map;
+        parts[i].vfracs = matarrs;
+        parts[i].z0 = (int) ((long long) nzones * i / nparts);
+        parts[i].z1 = (int) ((long long) nzones * (i+1) / nparts);
     }
+    db_matcalc_run(job, parts, sizeof(parts[0]), nparts);
 
-#ifndef NDEBUG
-    /* sanity check */
-    for (i = 0; i < nzones; i++)
-        assert(0.999 <= check_fracs[i] && check_fracs[i] < 1.001);
-    free(check_fracs);
-#endif
-
-    /* The matarr arrays are in the wrong order because
-       we pre-sorted matnos. We need to undue that now. */
-    mat_index(0,0,-1);
-    for (i = 0; i < mat->nmat; i++)
-        matarrs_fixed[i] = matarrs[mat_index(mat->nmat, matnos_sorted, mat->matnos[i])];
-
-    free(matarrs);
-    free(matnos_sorted);
+    FREE(map.table);
+    FREE(map.pairs);
 
     *narrs = mat->nmat;
-    *vfracs = matarrs_fixed; 
+    *vfracs = matarrs;
 
     return 0;
 
@@ -421,8 +660,8 @@ cleanup:
             FREE(matarrs[i]);
         FREE(matarrs);
     }
-    FREE(matarrs_fixed);
-    FREE(matnos_sorted);
+    FREE(map.table);
+    FREE(map.pairs);
     db_perror(NULL, etag, me);
 
     return -1;
@@ -76,6 +76,10 @@ be used for advertising or product endorsement purposes.
 #include <sys/stat.h>           /*stat */
 #endif
 #include <ctype.h>		/*isspace */
+#if HAVE_SYS_MMAN_H && !defined(_WIN32)
+#include <sys/mman.h>           /*mmap */
+#define TAURUS_MMAP
+#endif
 
 #define MAXBUF 100000
 
@@ -423,6 +427,57 @@ init_file_info (TAURUSfile *taurus)
         stat(taurus->filename, &statbuf);
         taurus->filesize[i] = statbuf.st_size;
     }
+
+#ifdef TAURUS_MMAP
+    /*
+     * The files are mapped on first use by taurus_map.
+     */
+    taurus->filemap = ALLOC_N(char *, nfiles);
+#endif
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    taurus_map
+ *
+ * Purpose:     Return a read-only mapping of a file in the family,
+ *              mapping the file the first time it is needed.  The
+ *              mappings stay in place until the family is closed so
+ *              that moving between states never reopens a file.
+ *
+ * Return:      Success:        pointer to the start of the file
+ *
+ *              Failure:        NULL, the file must be read with read()
+ *
+ *-------------------------------------------------------------------------
+ */
+static char *
+taurus_map (TAURUSfile *taurus, int ifile)
+{
+#ifdef TAURUS_MMAP
+    int            fd;
+    void          *map;
+
+    if (taurus->filemap == NULL || ifile < 0 || ifile >= taurus->nfiles)
+        return (NULL);
+
+    if (taurus->filemap[ifile] == NULL) {
+        map = MAP_FAILED;
+        fam_name(taurus->basename, ifile, taurus->filename);
+        if (taurus->filesize[ifile] > 0 &&
+            (fd = open(taurus->filename, O_RDONLY)) >= 0) {
+            map = mmap(NULL, (size_t) taurus->filesize[ifile], PROT_READ,
+                       MAP_PRIVATE, fd, 0);
+            close(fd);
+        }
+        taurus->filemap[ifile] = (char *) map;
+    }
+
+    if (taurus->filemap[ifile] == (char *) MAP_FAILED)
+        return (NULL);
+    return (taurus->filemap[ifile]);
+#else
+    return (NULL);
+#endif
 }
 
 /*-------------------------------------------------------------------------
@@ -453,12 +508,13 @@ taurus_read (TAURUSfile *taurus, int ifile, int iadd, int length, char *buffer)
     int            n;
     int            ibuf;
     int            idisk;
+    char          *map;
 
     /*
      * Skip to the correct file if the address is not in the
      * specified file.
      */
-    while (iadd > taurus->filesize[ifile]) {
+    while (ifile < taurus->nfiles && iadd > taurus->filesize[ifile]) {
         iadd -= taurus->filesize[ifile];
         ifile++;
     }
@@ -469,6 +525,22 @@ taurus_read (TAURUSfile *taurus, int ifile, int iadd, int length, char *buffer)
     ibuf = 0;
     idisk = iadd;
     while (length > 0) {
+        if (ifile >= taurus->nfiles)
+            return (-1);
+
+        /*
+         * Copy out of the mapping if the file is mapped.
+         */
+        if ((map = taurus_map(taurus, ifile)) != NULL) {
+            n = MIN(taurus->filesize[ifile] - idisk, length);
+            memcpy(&buffer[ibuf], map + idisk, n);
+            ibuf += n;
+            length -= n;
+            ifile++;
+            idisk = 0;
+            continue;
+        }
+
         /*
          * If the desired file is not open, close the current file
          * and open the desired file.
@@ -478,6 +550,7 @@ taurus_read (TAURUSfile *taurus, int ifile, int iadd, int length, char *buffer)
                 close(taurus->fd);
             fam_name(taurus->basename, ifile, taurus->filename);
             if ((taurus->fd = open(taurus->filename, O_RDONLY)) < 0) {
+                taurus->ifile = -1;
                 return (-1);
             }
             taurus->ifile = ifile;
@@ -1531,6 +1604,30 @@ taurus_readblockvar (TAURUSfile *taurus, int var_id, int val_id, float *var)
     offset = taurus->var_offset[val_id];
     ncomps = taurus->var_ncomps[val_id];
 
+    /*
+     * A plain component of a block that lies within one mapped file
+     * is gathered straight from the mapping, touching only the words
+     * of that component.
+     */
+    if (var_id >= VAR_NORMAL && var_id <= VAR_EPS) {
+        int            jfile = ifile, jadd = iadd;
+        char          *map;
+        float const   *src;
+
+        while (jfile < taurus->nfiles && jadd > taurus->filesize[jfile]) {
+            jadd -= taurus->filesize[jfile];
+            jfile++;
+        }
+        if (jfile < taurus->nfiles && jadd % sizeof(float) == 0 &&
+            jadd + nel * ncomps * (int) sizeof(float) <= taurus->filesize[jfile] &&
+            (map = taurus_map(taurus, jfile)) != NULL) {
+            src = (float const *) (map + jadd) + offset;
+            for (ivar = 0; ivar < nel; ivar++)
+                var[ivar] = src[ivar * ncomps];
+            return (0);
+        }
+    }
+
     /*
      * Allocate space for the buffer.
      */
@@ -1744,8 +1841,21 @@ db_taur_open (char const *basename)
 int
 db_taur_close (TAURUSfile *taurus)
 {
+    int            i;
 
     close(taurus->fd);
+#ifdef TAURUS_MMAP
+    if (taurus->filemap != NULL) {
+        for (i = 0; i < taurus->nfiles; i++) {
+            if (taurus->filemap[i] != NULL &&
+                taurus->filemap[i] != (char *) MAP_FAILED)
+                munmap(taurus->filemap[i], (size_t) taurus->filesize[i]);
+        }
+        FREE(taurus->filemap);
+    }
+#endif
+    for (i = 0; i < MAX_VARCACHE; i++)
+        FREE(taurus->varcache[i].vals);
     FREE(taurus->basename);
     FREE(taurus->filename);
     FREE(taurus->filesize);
@@ -2296,6 +2406,7 @@ taurus_readvar (TAURUSfile *taurus, char const *varname, float **var, int *lengt
     int            idir;
     int            ivar;
     int            var_id, val_id;
+    varcache_s    *vc;
 
     if (taurus->icode == 1)
         idir = 8;
@@ -2344,6 +2455,19 @@ taurus_readvar (TAURUSfile *taurus, char const *varname, float **var, int *lengt
      */
     *var = ALLOC_N(float, *length);
 
+    /*
+     * Return a copy of the values if this variable was read recently
+     * for this state.
+     */
+    for (i = 0; i < MAX_VARCACHE; i++) {
+        vc = &taurus->varcache[i];
+        if (vc->vals != NULL && vc->state == taurus->state &&
+            vc->ivar == ivar && vc->length == *length) {
+            memcpy(*var, vc->vals, *length * sizeof(float));
+            return (0);
+        }
+    }
+
     /*
      * Read the variable.
      */
@@ -2354,5 +2478,19 @@ taurus_readvar (TAURUSfile *taurus, char const *varname, float **var, int *lengt
                             &(var[0][taurus->nel8]));
     }
 
+    /*
+     * Remember the values, replacing the oldest cache entry.
+     */
+    if (*length > 0) {
+        vc = &taurus->varcache[taurus->varcache_next];
+        taurus->varcache_next = (taurus->varcache_next + 1) % MAX_VARCACHE;
+        FREE(vc->vals);
+        vc->vals = ALLOC_N(float, *length);
+        memcpy(vc->vals, *var, *length * sizeof(float));
+        vc->state = taurus->state;
+        vc->ivar = ivar;
+        vc->length = *length;
+    }
+
     return (0);
 }
@@ -59,6 +59,7 @@ be used for advertising or product endorsement purposes.
 
 #define MAX_MESH  5
 #define MAX_VAL  69
+#define MAX_VARCACHE 8
 
 #define VAR_NORMAL          0
 #define VAR_SIGX            1
@@ -181,6 +182,13 @@ be used for advertising or product endorsement purposes.
 #define VAL_VORTZ            2
 #define VAL_PRESSURE         3
 
+typedef struct {
+    int            state;       /* The state the values belong to */
+    int            ivar;        /* The index in taur_var_list */
+    int            length;      /* The number of values */
+    float         *vals;        /* The values, NULL if the entry is empty */
+} varcache_s;
+
 typedef struct {
 /*
  * File information.
@@ -192,6 +200,7 @@ typedef struct {
     char          *filename;    /* The name of the currently open file */
     int            nfiles;      /* The number of files in the family */
     int           *filesize;    /* The size of each file in the family */
+    char         **filemap;     /* Read-only mapping of each file, if any */
 /*
  * State information.
  */
@@ -209,6 +218,8 @@ typedef struct {
     int            var_len[MAX_VAL];  /* The length of the variable */
     int            var_offset[MAX_VAL];  /* The offset in the vector */
     int            var_ncomps[MAX_VAL];  /* The number of components to a vector */
+    varcache_s     varcache[MAX_VARCACHE];  /* Recently read variables */
+    int            varcache_next;  /* The next cache entry to replace */
 /*
  * Mesh information.
  */
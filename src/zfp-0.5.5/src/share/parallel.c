@@ -18,7 +18,7 @@ compress_init_par(zfp_stream* stream, const zfp_field* field, uint chunks, uint
 
   /* determine maximum size buffer needed per thread */
   zfp_field f = *field;
-  switch (zfp_field_dimensionality(field)) {
+  switch (zfpns.zfp_field_dimensionality(field)) {
     case 1:
       f.nx = 4 * (blocks + chunks - 1) / chunks;
       break;
@@ -40,12 +40,12 @@ compress_init_par(zfp_stream* stream, const zfp_field* field, uint chunks, uint
     default:
       return NULL;
   }
-  size = zfp_stream_maximum_size(stream, &f);
+  size = zfpns.zfp_stream_maximum_size(stream, &f);
 
   /* avoid copies in fixed-rate mode when each bitstream is word aligned */
   copy |= stream->minbits != stream->maxbits;
-  copy |= (stream->maxbits % stream_word_bits) != 0;
-  copy |= (stream_wtell(stream->stream) % stream_word_bits) != 0;
+  copy |= (stream->maxbits % bsns.stream_word_bits) != 0;
+  copy |= (bsns.stream_wtell(stream->stream) % bsns.stream_word_bits) != 0;
 
   /* set up buffer for each thread to compress to */
   bs = (bitstream**)malloc(chunks * sizeof(bitstream*));
@@ -53,17 +53,17 @@ compress_init_par(zfp_stream* stream, const zfp_field* field, uint chunks, uint
     return NULL;
   for (i = 0; i < chunks; i++) {
     uint block = chunk_offset(blocks, chunks, i);
-    void* buffer = copy ? malloc(size) : (uchar*)stream_data(stream->stream) + stream_size(stream->stream) + block * stream->maxbits / CHAR_BIT;
+    void* buffer = copy ? malloc(size) : (uchar*)bsns.stream_data(stream->stream) + bsns.stream_size(stream->stream) + block * stream->maxbits / CHAR_BIT;
     if (!buffer)
       break;
-    bs[i] = stream_open(buffer, size);
+    bs[i] = bsns.stream_open(buffer, size);
   }
 
   /* handle memory allocation failure */
   if (copy && i < chunks) {
     while (i--) {
-      free(stream_data(bs[i]));
-      stream_close(bs[i]);
+      free(bsns.stream_data(bs[i]));
+      bsns.stream_close(bs[i]);
     }
     free(bs);
     bs = NULL;
@@ -76,25 +76,25 @@ compress_init_par(zfp_stream* stream, const zfp_field* field, uint chunks, uint
 static void
 compress_finish_par(zfp_stream* stream, bitstream** src, uint chunks)
 {
-  bitstream* dst = zfp_stream_bit_stream(stream);
-  int copy = (stream_data(dst) != stream_data(*src));
-  size_t offset = stream_wtell(dst);
+  bitstream* dst = zfpns.zfp_stream_bit_stream(stream);
+  int copy = (bsns.stream_data(dst) != bsns.stream_data(*src));
+  size_t offset = bsns.stream_wtell(dst);
   uint i;
   for (i = 0; i < chunks; i++) {
-    size_t bits = stream_wtell(src[i]);
+    size_t bits = bsns.stream_wtell(src[i]);
     offset += bits;
-    stream_flush(src[i]);
+    bsns.stream_flush(src[i]);
     /* concatenate streams if they are not already contiguous */
     if (copy) {
-      stream_rewind(src[i]);
-      stream_copy(dst, src[i], bits);
-      free(stream_data(src[i]));
+      bsns.stream_rewind(src[i]);
+      bsns.stream_copy(dst, src[i], bits);
+      free(bsns.stream_data(src[i]));
     }
-    stream_close(src[i]);
+    bsns.stream_close(src[i]);
   }
   free(src);
   if (!copy)
-    stream_wseek(dst, offset);
+    bsns.stream_wseek(dst, offset);
 }
 
 #endif
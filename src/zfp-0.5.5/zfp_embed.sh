@@ -125,3 +125,19 @@ echo "    .stream_word_bits = wsize" >> src/inline/bitstream.c
 echo "@};@@#endif@" | tr '@' '\n' >> src/inline/bitstream.c
 # Fix src/bitstream.c
 sed -i .orig '/export_ const size_t stream_word_bits/d' src/bitstream.c
+
+#
+# Adjust src/share/parallel.c and src/template/ompcompress.c, which are
+# compiled only with OpenMP, to call through the zfpns and bsns structs
+#
+sed -e 's/\([^.a-z_]\)\(zfp_field_dimensionality(\)/\1zfpns.\2/g' \
+    -e 's/\([^.a-z_]\)\(zfp_stream_maximum_size(\)/\1zfpns.\2/g' \
+    -e 's/\([^.a-z_]\)\(zfp_stream_bit_stream(\)/\1zfpns.\2/g' \
+    -e 's/\([^.a-z_]\)\(stream_word_bits\)/\1bsns.\2/g' \
+    -e 's/\([^.a-z_]\)\(stream_[a-z]*(\)/\1bsns.\2/g' \
+    src/share/parallel.c > src/share/parallel.c.tmp
+mv src/share/parallel.c src/share/parallel.c.orig
+mv src/share/parallel.c.tmp src/share/parallel.c
+sed -e 's/\([^.a-z_]\)\(zfp_stream_set_bit_stream(\)/\1zfpns.\2/g' \
+    src/template/ompcompress.c > src/template/ompcompress.c.tmp
+mv src/template/ompcompress.c.tmp src/template/ompcompress.c
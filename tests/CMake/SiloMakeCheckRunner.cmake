@@ -121,6 +121,7 @@ foreach(driver ${drivers})
     silo_add_make_check_runner(NAME testall ARGS -small -fortran ${driver})
     silo_add_make_check_runner(NAME obj ARGS ${driver})
     silo_add_make_check_runner(NAME onehex ARGS ${driver})
+    silo_add_make_check_runner(NAME nanedges ARGS ${driver})
     silo_add_make_check_runner(NAME oneprism ARGS ${driver})
     silo_add_make_check_runner(NAME onepyramid ARGS ${driver})
     silo_add_make_check_runner(NAME onetet ARGS ${driver})
@@ -160,15 +161,27 @@ foreach(driver ${drivers})
     silo_add_make_check_runner(NAME empty ARGS ${driver})
     silo_add_make_check_runner(NAME efcentering ARGS ${driver})
     silo_add_make_check_runner(NAME misc ARGS ${driver})
+    silo_add_make_check_runner(NAME filecache ARGS ${driver})
+    silo_add_make_check_runner(NAME pdbcache ARGS ${driver})
+    silo_add_make_check_runner(NAME taurus_family ARGS ${driver})
 if(${HDF5})
     # multi_file test doesn't compile without hdf5
     silo_add_make_check_runner(NAME multi_file ARGS ${driver})
     silo_add_make_check_runner(NAME multi_file ARGS use-ns ${driver})
+    if(NOT WIN32)
+        silo_add_make_check_runner(NAME silovfd ARGS ${driver})
+    endif()
+    silo_add_make_check_runner(NAME linknames ARGS ${driver})
+    silo_add_make_check_runner(NAME fileimage ARGS ${driver})
 endif()
 
     silo_add_make_check_runner(NAME testall ARGS -small -fortran ${driver})
     silo_add_make_check_runner(NAME testall ARGS -medium ${driver})
     silo_add_make_check_runner(NAME testall ARGS -large ${driver})
+
+if(${THREADSAFE})
+    silo_add_make_check_runner(NAME threadsafe ARGS ${driver})
+endif()
 endforeach()
 
 if(${ADD_FORT})
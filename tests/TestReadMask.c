@@ -91,6 +91,9 @@ struct timeval start_time;
 struct timeval end_time;
 #endif
 
+/* Number of DBGet*Into reads that differed from the usual reads */
+int     intoErrors = 0;
+
 /*
  * 
  * Mark C. Miller, Mon Jan 11 16:24:33 PST 2010
@@ -353,7 +356,7 @@ main(int argc, char *argv[])
     printTimes(ms);
 
     CleanupDriverStuff();
-    return 0;
+    return intoErrors ? 1 : 0;
 }
 
 int
@@ -526,6 +529,68 @@ test_readquadmesh(DBfile * dbfile, unsigned long long mask)
     return ms;
 }
 
+static size_t
+TypeSize(int datatype)
+{
+    switch (datatype)
+    {
+        case DB_CHAR: return sizeof(char);
+        case DB_SHORT: return sizeof(short);
+        case DB_INT: return sizeof(int);
+        case DB_LONG: return sizeof(long);
+        case DB_LONG_LONG: return sizeof(long long);
+        case DB_FLOAT: return sizeof(float);
+    }
+    return sizeof(double);
+}
+
+/* Buffer function for DBGet*Into; hands out one reused buffer per array */
+static void *
+ReadBuffer(char const *objname, char const *member, int idx, int datatype,
+    long long nvals, void *udata)
+{
+    void **bufs = (void **) udata;
+    int k = (strcmp(member, "mixvals") ? 0 : 2) + idx;
+
+    if (k >= 4) return NULL;
+    bufs[k] = realloc(bufs[k], nvals * TypeSize(datatype));
+    return bufs[k];
+}
+
+/*
+ * Check arrays read by DBGet*Into match those read the usual way. Arrays
+ * ReadBuffer gave a buffer for must be in that buffer and NULL in the
+ * returned object; the rest must be in the returned object as usual.
+ */
+static int
+CompareIntoVals(char const *testName, void **vals, void **intovals,
+    void **bufs, int nvals, long long nels, int datatype, int off)
+{
+    int i, err = 0;
+    size_t n = nels * TypeSize(datatype);
+
+    for (i = 0; vals && i < nvals; i++)
+    {
+        void *got = intovals ? intovals[i] : NULL;
+        if (!vals[i])
+            continue;
+        if (off+i < 4)
+        {
+            if (got)
+                err = 1;
+            got = bufs[off+i];
+        }
+        if (!got || memcmp(vals[i], got, n))
+            err = 1;
+    }
+    if (err)
+    {
+        fprintf(stderr, "%s: vals read into caller buffers differ!\n", testName);
+        intoErrors++;
+    }
+    return err;
+}
+
 /*
  * Mark C. Miller, Mon Jan 11 16:26:26 PST 2010
  * Removed condition on DBFreeQuadvar call.
@@ -533,7 +598,7 @@ test_readquadmesh(DBfile * dbfile, unsigned long long mask)
 int
 test_readquadvar(DBfile * dbfile, unsigned long long mask)
 {
-    int     ms;
+    int     i, ms;
     DBquadvar *qvar = NULL;
 
     /* Reset the timer. */
@@ -558,6 +623,28 @@ test_readquadvar(DBfile * dbfile, unsigned long long mask)
         fprintf(stderr, "test_readquadvar: qvar = NULL!\n");
     }
 
+    /* Read it again into our own buffers and compare */
+    if (qvar != NULL)
+    {
+        void *bufs[4] = {0, 0, 0, 0};
+        DBquadvar *qvar2 = DBGetQuadvarInto(dbfile, "d", ReadBuffer, bufs);
+        if (qvar2 != NULL)
+        {
+            CompareIntoVals("test_readquadvar", qvar->vals, qvar2->vals, bufs,
+                qvar->nvals, qvar->nels, qvar->datatype, 0);
+            CompareIntoVals("test_readquadvar", qvar->mixvals, qvar2->mixvals, bufs,
+                qvar->nvals, qvar->mixlen, qvar->datatype, 2);
+        }
+        else
+        {
+            fprintf(stderr, "test_readquadvar: qvar2 = NULL!\n");
+            intoErrors++;
+        }
+        DBFreeQuadvar(qvar2);
+        for (i = 0; i < 4; i++)
+            free(bufs[i]);
+    }
+
     /* This check gets us around a crash! */
     DBFreeQuadvar(qvar);
 
@@ -615,7 +702,7 @@ test_readucdmesh(DBfile * dbfile, const char *testName, unsigned long long mask)
 int
 test_readucdvar(DBfile * dbfile, unsigned long long mask)
 {
-    int     ms;
+    int     i, ms;
     DBucdvar *uvar = NULL;
 
     /* Reset the timer. */
@@ -640,6 +727,28 @@ test_readucdvar(DBfile * dbfile, unsigned long long mask)
         fprintf(stderr, "test_readucdvar: uvar = NULL!\n");
     }
 
+    /* Read it again into our own buffers and compare */
+    if (uvar != NULL)
+    {
+        void *bufs[4] = {0, 0, 0, 0};
+        DBucdvar *uvar2 = DBGetUcdvarInto(dbfile, "u", ReadBuffer, bufs);
+        if (uvar2 != NULL)
+        {
+            CompareIntoVals("test_readucdvar", uvar->vals, uvar2->vals, bufs,
+                uvar->nvals, uvar->nels, uvar->datatype, 0);
+            CompareIntoVals("test_readucdvar", uvar->mixvals, uvar2->mixvals, bufs,
+                uvar->nvals, uvar->mixlen, uvar->datatype, 2);
+        }
+        else
+        {
+            fprintf(stderr, "test_readucdvar: uvar2 = NULL!\n");
+            intoErrors++;
+        }
+        DBFreeUcdvar(uvar2);
+        for (i = 0; i < 4; i++)
+            free(bufs[i]);
+    }
+
     /* This check gets us around a crash! */
     DBFreeUcdvar(uvar);
 
@@ -68,12 +68,441 @@ be used for advertising or product endorsement purposes.
 #endif
 #include <stdlib.h>
 
+#include <config.h>
+#ifdef HAVE_HDF5_H
+#include <hdf5.h>
+#endif
+
 #define GNU_AUTOTEST_SKIP_CODE 77
 #define ONE_MEG 1048576
 #define ITERATE 50
 
 #include <std.c>
 
+/*-------------------------------------------------------------------------
+ * Function:        is_slab_stream
+ *
+ * Purpose:         Look at the raw first chunk of a dataset to see whether
+ *                  FPZIP wrote it as a slab stream ("fpzs" magic).
+ *
+ * Return:          1 if it is a slab stream, 0 if it is not and -1 if
+ *                  that can't be told in this build.
+ *-------------------------------------------------------------------------
+ */
+static int
+is_slab_stream(char const *filename, char const *name)
+{
+    int retval = -1;
+#if defined(HAVE_HDF5_H) && H5_VERSION_GE(1,10,2)
+    hid_t fid, did, sid;
+    hsize_t offset[3] = {0, 0, 0};
+    hsize_t nbytes = 0;
+    uint32_t filters = 0;
+    unsigned char *buf;
+
+    if ((fid = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT)) < 0)
+        return -1;
+    if ((did = H5Dopen(fid, name, H5P_DEFAULT)) >= 0)
+    {
+        sid = H5Dget_space(did);
+        if (H5Sget_simple_extent_ndims(sid) <= 3 &&
+            H5Dget_chunk_storage_size(did, offset, &nbytes) >= 0 && nbytes >= 4 &&
+            (buf = (unsigned char *) malloc(nbytes)) != NULL)
+        {
+            if (H5Dread_chunk(did, H5P_DEFAULT, offset, &filters, buf) >= 0)
+                retval = !memcmp(buf, "fpzs", 4);
+            free(buf);
+        }
+        H5Sclose(sid);
+        H5Dclose(did);
+    }
+    H5Fclose(fid);
+#endif
+    return retval;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:        get_chunk_dims
+ *
+ * Purpose:         Read the chunk dimensions of a dataset back from the
+ *                  file with H5Pget_chunk.
+ *
+ * Return:          Rank of the chunks, or -1 if they can't be read in
+ *                  this build.
+ *-------------------------------------------------------------------------
+ */
+static int
+get_chunk_dims(char const *filename, char const *name, int chunk[3])
+{
+    int rank = -1;
+#ifdef HAVE_HDF5_H
+    hid_t fid, did, pid;
+    hsize_t dims[3];
+    int i;
+
+    if ((fid = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT)) < 0)
+        return -1;
+    if ((did = H5Dopen(fid, name, H5P_DEFAULT)) >= 0)
+    {
+        pid = H5Dget_create_plist(did);
+        if (H5Pget_layout(pid) == H5D_CHUNKED &&
+            (rank = H5Pget_chunk(pid, 3, dims)) > 0)
+        {
+            for (i = 0; i < rank; i++)
+                chunk[i] = (int) dims[i];
+        }
+        H5Pclose(pid);
+        H5Dclose(did);
+    }
+    H5Fclose(fid);
+#endif
+    return rank;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:        test_chunking
+ *
+ * Purpose:         Write datasets under each form of the "CHUNK=" keyword
+ *                  and check the chunk dimensions HDF5 stored for them.
+ *
+ * Return:          Number of errors.
+ *-------------------------------------------------------------------------
+ */
+static int
+test_chunking(int driver, int verbose)
+{
+    /* 40x30x20 doubles are 4800 bytes per plane and 160 bytes per row.
+       200x30x40 doubles are 1.9 megabytes, so the 1 megabyte target of
+       a mismatched shape splits them in two. */
+    static struct {
+        char const *name;
+        char const *compression;
+        int checksums;
+        int ndims;
+        int dims[3];
+        int chunk[3];
+    } cases[] = {
+        {"bytes", "METHOD=GZIP CHUNK=4096", 0, 3, {40, 30, 20}, {1, 15, 20}},
+        {"minimum", "METHOD=GZIP CHUNK=16", 0, 3, {40, 30, 20}, {1, 15, 20}},
+        {"shape", "METHOD=GZIP CHUNK=10x7x5", 0, 3, {40, 30, 20}, {10, 7, 5}},
+        {"shape2d", "METHOD=GZIP CHUNK=10x7", 0, 2, {40, 30, 1}, {10, 7, 0}},
+        {"rankmismatch", "METHOD=GZIP CHUNK=10x7", 0, 3, {200, 30, 40}, {100, 30, 40}},
+        {"clamped", "METHOD=GZIP CHUNK=100x100x100", 0, 3, {40, 30, 20}, {40, 30, 20}},
+        {"whole", "METHOD=GZIP CHUNK=0", 0, 3, {200, 30, 40}, {200, 30, 40}},
+        {"default", "METHOD=GZIP", 0, 3, {200, 30, 40}, {200, 30, 40}},
+        {"checksums", "CHUNK=4096", 1, 3, {40, 30, 20}, {1, 15, 20}}
+    };
+    int ncases = (int) (sizeof(cases) / sizeof(cases[0]));
+    int nerrors = 0;
+    int c, i, rank;
+    int chunk[3];
+    double *val = (double *) calloc(200*30*40, sizeof(double));
+    char filename[64];
+    DBfile *dbfile;
+
+    for (c = 0; c < ncases; c++)
+    {
+        sprintf(filename, "compression_chunk_%s.h5", cases[c].name);
+        DBSetCompression(cases[c].compression);
+        DBSetEnableChecksums(cases[c].checksums);
+        dbfile = DBCreate(filename, DB_CLOBBER, DB_LOCAL, "Chunking test", driver);
+        if (!dbfile || DBWrite(dbfile, "val", val, cases[c].dims,
+                cases[c].ndims, DB_DOUBLE) < 0)
+        {
+            printf("Writing \"%s\" with \"%s\" failed\n", filename,
+                cases[c].compression);
+            nerrors++;
+        }
+        if (dbfile)
+            DBClose(dbfile);
+        DBSetCompression(0);
+        DBSetEnableChecksums(0);
+
+        if ((rank = get_chunk_dims(filename, "val", chunk)) < 0)
+            continue;
+        for (i = 0; i < cases[c].ndims; i++)
+            if (rank != cases[c].ndims || chunk[i] != cases[c].chunk[i])
+                break;
+        if (i < cases[c].ndims)
+        {
+            printf("\"%s\": chunk dims are", cases[c].compression);
+            for (i = 0; i < rank; i++)
+                printf(" %d", chunk[i]);
+            printf(", expected");
+            for (i = 0; i < cases[c].ndims; i++)
+                printf(" %d", cases[c].chunk[i]);
+            printf("\n");
+            nerrors++;
+        }
+        else if (verbose)
+            printf("\"%s\" chunked as expected\n", cases[c].compression);
+    }
+
+    free(val);
+    return nerrors;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:        test_fpzip_slabs
+ *
+ * Purpose:         Round trip float and double arrays through FPZIP slab
+ *                  streams whose last slab is thinner than the others, and
+ *                  through the older single stream format, which must
+ *                  still read back as written.
+ *
+ * Return:          Number of errors, or GNU_AUTOTEST_SKIP_CODE if this
+ *                  build has no FPZIP.
+ *-------------------------------------------------------------------------
+ */
+static int
+test_fpzip_slabs(int driver, int verbose)
+{
+    /* 23 planes in 4 slabs are 3 slabs of 6 and a last one of 5; 1000
+       values in 3 slabs are 2 slabs of 334 and a last one of 332. The
+       driver takes a file's FPZIP settings from its first compressed
+       write, so each case gets its own file. */
+    static struct {
+        char const *name;
+        char const *compression;
+        int ndims;
+        int dims[3];
+        int slabs;
+    } cases[] = {
+        {"slabs3d", "METHOD=FPZIP SLABS=4 THREADS=2", 3, {23, 9, 17}, 1},
+        {"slabs1d", "METHOD=FPZIP SLABS=3", 1, {1000, 1, 1}, 1},
+        {"stream3d", "METHOD=FPZIP", 3, {23, 9, 17}, 0}
+    };
+    int ncases = (int) (sizeof(cases) / sizeof(cases[0]));
+    int nerrors = 0;
+    int c, i, n, dp, slabs;
+    float *fval, *frval;
+    double *dval, *drval;
+    char filename[64];
+    char name[64];
+    DBfile *dbfile;
+
+    fval = (float *) malloc(23*9*17 * sizeof(float));
+    frval = (float *) malloc(23*9*17 * sizeof(float));
+    dval = (double *) malloc(23*9*17 * sizeof(double));
+    drval = (double *) malloc(23*9*17 * sizeof(double));
+
+    /* A staircase fpzip predicts well in 1D and 3D, so even doubles
+       compress past the default minimum ratio instead of being stored raw */
+    for (i = 0; i < 23*9*17; i++)
+    {
+        dval[i] = 1024 + 0.5 * (i / 8);
+        fval[i] = (float) dval[i];
+    }
+
+    for (c = 0; c < ncases && nerrors < 10; c++)
+    {
+        sprintf(filename, "compression_%s.h5", cases[c].name);
+        n = cases[c].dims[0] * cases[c].dims[1] * cases[c].dims[2];
+
+        DBSetCompression(cases[c].compression);
+        dbfile = DBCreate(filename, DB_CLOBBER, DB_LOCAL, "FPZIP slab test", driver);
+        for (dp = 0; dbfile && dp < 2; dp++)
+        {
+            sprintf(name, "%s_%s", cases[c].name, dp ? "double" : "float");
+            if (DBWrite(dbfile, name, dp ? (void *) dval : (void *) fval,
+                    cases[c].dims, cases[c].ndims, dp ? DB_DOUBLE : DB_FLOAT) < 0)
+            {
+                int err = DBErrno();
+                DBClose(dbfile);
+                DBSetCompression(0);
+                free(fval);
+                free(frval);
+                free(dval);
+                free(drval);
+                return err == E_COMPRESSION ? GNU_AUTOTEST_SKIP_CODE : 1;
+            }
+        }
+        if (dbfile)
+            DBClose(dbfile);
+
+        /* Slab streams are decoded on as many threads as "THREADS=" asks */
+        DBSetCompression("METHOD=FPZIP THREADS=2");
+        if ((dbfile = DBOpen(filename, driver, DB_READ)) == NULL)
+        {
+            printf("Unable to open `%s'\n", filename);
+            nerrors++;
+            continue;
+        }
+        for (dp = 0; dp < 2; dp++)
+        {
+            sprintf(name, "%s_%s", cases[c].name, dp ? "double" : "float");
+            memset(dp ? (void *) drval : (void *) frval, 0,
+                n * (dp ? sizeof(double) : sizeof(float)));
+            if (DBReadVar(dbfile, name, dp ? (void *) drval : (void *) frval) < 0)
+            {
+                printf("DBReadVar for \"%s\" failed\n", name);
+                nerrors++;
+                continue;
+            }
+            for (i = 0; i < n; i++)
+            {
+                if (dp ? drval[i] != dval[i] : frval[i] != fval[i])
+                {
+                    printf("Read error in \"%s\" at position %d. Expected %g, got %g\n",
+                        name, i, dp ? dval[i] : fval[i], dp ? drval[i] : frval[i]);
+                    nerrors++;
+                    break;
+                }
+            }
+            if (verbose && i == n)
+                printf("\"%s\" round tripped\n", name);
+        }
+        DBClose(dbfile);
+
+        /* Make sure each case really was written in the format it tests */
+        for (dp = 0; dp < 2; dp++)
+        {
+            sprintf(name, "%s_%s", cases[c].name, dp ? "double" : "float");
+            slabs = is_slab_stream(filename, name);
+            if (slabs >= 0 && slabs != cases[c].slabs)
+            {
+                printf("\"%s\" was %swritten as a slab stream\n", name,
+                    slabs ? "" : "not ");
+                nerrors++;
+            }
+        }
+    }
+    DBSetCompression(0);
+
+    free(fval);
+    free(frval);
+    free(dval);
+    free(drval);
+    return nerrors;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:        test_threads
+ *
+ * Purpose:         Write the same chunked float and double arrays with
+ *                  FPZIP and ZFP using "THREADS=1" and "THREADS=4", so
+ *                  the second file's chunks are compressed on the thread
+ *                  pool. Both must read back identical values, and the
+ *                  lossless ones must read back as written.
+ *
+ * Return:          Number of errors, or GNU_AUTOTEST_SKIP_CODE if this
+ *                  build has neither FPZIP nor ZFP.
+ *-------------------------------------------------------------------------
+ */
+static int
+test_threads(int driver, int verbose)
+{
+    /* 40x32x48 doubles are 8 chunks of 64K, the floats 4 */
+    static struct {
+        char const *name;
+        char const *compression;
+        int lossless;
+    } cases[] = {
+        {"fpzip", "METHOD=FPZIP CHUNK=65536", 1},
+        {"fpziplossy", "METHOD=FPZIP LOSS=2 CHUNK=65536", 0},
+        {"fpzipslabs", "METHOD=FPZIP SLABS=3 CHUNK=65536", 1},
+        {"zfp", "METHOD=ZFP RATE=8 CHUNK=65536", 0}
+    };
+    static int const nthreads[2] = {1, 4};
+    int ncases = (int) (sizeof(cases) / sizeof(cases[0]));
+    int dims[3] = {40, 32, 48}, n = 40*32*48;
+    int nerrors = 0, nskipped = 0;
+    int c, i, t, dp, err = 0;
+    double *val, *rval[2];
+    char compression[128];
+    char filename[64];
+    char name[64];
+    DBfile *dbfile;
+
+    val = (double *) malloc(n * sizeof(double));
+    rval[0] = (double *) malloc(n * sizeof(double));
+    rval[1] = (double *) malloc(n * sizeof(double));
+
+    /* Smooth enough that every chunk compresses past the minimum ratio */
+    for (i = 0; i < n; i++)
+        val[i] = 100 + sin(i * 0.001) + 0.25 * (i / 1000);
+
+    for (c = 0; c < ncases && nerrors < 10; c++)
+    {
+        for (t = 0; t < 2; t++)
+        {
+            sprintf(compression, "%s THREADS=%d", cases[c].compression, nthreads[t]);
+            sprintf(filename, "compression_threads_%s_%d.h5", cases[c].name, nthreads[t]);
+            DBSetCompression(compression);
+            dbfile = DBCreate(filename, DB_CLOBBER, DB_LOCAL, "compression thread test", driver);
+            for (dp = 0; dbfile && dp < 2; dp++)
+            {
+                float *fval = (float *) rval[0];
+                sprintf(name, "%s_%s", cases[c].name, dp ? "double" : "float");
+                for (i = 0; !dp && i < n; i++)
+                    fval[i] = (float) val[i];
+                if (DBWrite(dbfile, name, dp ? (void *) val : (void *) fval,
+                        dims, 3, dp ? DB_DOUBLE : DB_FLOAT) < 0)
+                    break;
+            }
+            err = DBErrno();
+            if (dbfile)
+                DBClose(dbfile);
+            if (dp < 2)
+                break;
+        }
+        DBSetCompression(0);
+        if (t < 2)
+        {
+            /* compression requested not supported in this build */
+            if (err != E_COMPRESSION)
+                nerrors++;
+            nskipped++;
+            continue;
+        }
+
+        for (dp = 0; dp < 2; dp++)
+        {
+            size_t size = dp ? sizeof(double) : sizeof(float);
+
+            sprintf(name, "%s_%s", cases[c].name, dp ? "double" : "float");
+            for (t = 0; t < 2; t++)
+            {
+                sprintf(filename, "compression_threads_%s_%d.h5", cases[c].name, nthreads[t]);
+                memset(rval[t], 0, n * size);
+                if ((dbfile = DBOpen(filename, driver, DB_READ)) == NULL ||
+                    DBReadVar(dbfile, name, rval[t]) < 0)
+                {
+                    printf("Unable to read \"%s\" from `%s'\n", name, filename);
+                    nerrors++;
+                }
+                if (dbfile)
+                    DBClose(dbfile);
+            }
+            if (memcmp(rval[0], rval[1], n * size))
+            {
+                printf("\"%s\" differs between 1 and %d threads\n", name, nthreads[1]);
+                nerrors++;
+            }
+            else if (cases[c].lossless)
+            {
+                for (i = 0; i < n; i++)
+                {
+                    if (dp ? rval[1][i] != val[i] :
+                             ((float *) rval[1])[i] != (float) val[i])
+                    {
+                        printf("Read error in \"%s\" at position %d\n", name, i);
+                        nerrors++;
+                        break;
+                    }
+                }
+            }
+            if (verbose)
+                printf("\"%s\" checked\n", name);
+        }
+    }
+
+    free(val);
+    free(rval[0]);
+    free(rval[1]);
+    return nskipped == ncases ? GNU_AUTOTEST_SKIP_CODE : nerrors;
+}
+
 /*-------------------------------------------------------------------------
  * Function:        main
  *
@@ -97,6 +526,9 @@ main(int argc, char *argv[])
     int            verbose = 0;
     int            usefloat = 0;
     int            readonly = 0;
+    int            slabs = 0;
+    int            chunking = 0;
+    int            threads = 0;
     int            i, j, ndims=1;
     int            fdims[]={ONE_MEG/sizeof(float)};
     int            ddims[]={ONE_MEG/sizeof(double)};
@@ -143,6 +575,12 @@ main(int argc, char *argv[])
           DBSetCompression("METHOD=GZIP LEVEL=9");
        } else if (!strcmp(argv[i], "fpzip")) {
           DBSetCompression("METHOD=FPZIP");
+       } else if (!strcmp(argv[i], "fpzipslabs")) {
+          slabs = 1;
+       } else if (!strcmp(argv[i], "chunking")) {
+          chunking = 1;
+       } else if (!strcmp(argv[i], "threads")) {
+          threads = 1;
        } else if (!strcmp(argv[i], "zfp")) {
           DBSetCompression("METHOD=ZFP RATE=8.5");
           has_loss = 1;
@@ -172,6 +610,9 @@ main(int argc, char *argv[])
           printf("       single   - writes data as floats not doubles\n");
           printf("       verbose  - displays more feedback\n");
           printf("       readonly - checks an existing file (used for cross platform test)\n");
+          printf("       fpzipslabs - round trips FPZIP slab and single streams instead\n");
+          printf("       chunking - checks the chunks each form of \"CHUNK=\" gives instead\n");
+          printf("       threads  - compares chunks compressed on 1 and 4 threads instead\n");
           printf("       DB_HDF5  - enable HDF5 driver, the default\n");
           return (0);
        } else if (!strcmp(argv[i], "show-all-errors")) {
@@ -189,6 +630,19 @@ main(int argc, char *argv[])
 
     DBShowErrors(show_errors, 0);
 
+    if (slabs || chunking || threads)
+    {
+        nerrors = slabs ? test_fpzip_slabs(driver, verbose) :
+                  threads ? test_threads(driver, verbose) :
+                          test_chunking(driver, verbose);
+        free(fval);
+        free(frval);
+        free(dval);
+        free(drval);
+        CleanupDriverStuff();
+        return nerrors;
+    }
+
     if (!readonly)
     {
       /*
@@ -63,6 +63,10 @@ be used for advertising or product endorsement purposes.
 
 #include "silo.h"
 #include <std.c>
+#include <config.h>
+#ifdef HAVE_HDF5_H
+#include <hdf5.h>
+#endif
 extern int build_quad(DBfile *dbfile, char *name);
 extern int build_ucd(DBfile *dbfile, char *name);
 extern int build_ucd_tri(DBfile *dbfile, char *name, int flags);
@@ -266,6 +270,62 @@ int main(int argc, char *argv[])
             DBSetDir(dbfile, "/testtoc");
             dbtoc = DBGetToc(dbfile);
         }
+
+        /* a write through a path must not leave a stale cached toc */
+        {
+            DBtoc *dbtoc;
+            int one = 1;
+
+            DBSetDir(dbfile, "/");
+            DBWrite(dbfile, "/testtoc/tocvar", &one, &one, 1, DB_INT);
+            DBSetDir(dbfile, "/testtoc");
+            dbtoc = DBGetToc(dbfile);
+            if (dbtoc->nvar != 1 || dbtoc->ndir != ndirs)
+                exit(EXIT_FAILURE);
+
+            /* names-only tocs still list every entry */
+            DBSetTocNamesOnly(1);
+            dbtoc = DBGetToc(dbfile);
+            if (dbtoc->nobj + dbtoc->ndir + dbtoc->nvar != ndirs + 1)
+                exit(EXIT_FAILURE);
+            DBSetTocNamesOnly(0);
+        }
+    }
+
+    /* writes must not leave a stale table in the per-directory cache,
+       including after a DBSetDir that failed */
+    {
+        DBtoc *dbtoc;
+        int one = 1;
+
+        DBClose(dbfile);
+        dbfile = DBOpen(filename, driver, DB_APPEND);
+        DBMkDir(dbfile, "tocstale");
+        DBSetDir(dbfile, "/tocstale");
+        DBWrite(dbfile, "a", &one, &one, 1, DB_INT);
+        dbtoc = DBGetToc(dbfile);
+        DBSetDir(dbfile, "/");
+        DBGetToc(dbfile);
+        DBSetDir(dbfile, "/tocstale");
+        DBWrite(dbfile, "b", &one, &one, 1, DB_INT);
+        DBSetDir(dbfile, "/");
+        DBSetDir(dbfile, "/tocstale");
+        dbtoc = DBGetToc(dbfile);
+        if (dbtoc->nvar != 2)
+            exit(EXIT_FAILURE);
+
+        DBShowErrors(DB_NONE, NULL);
+        if (DBSetDir(dbfile, "/no_such_dir") == 0)
+            exit(EXIT_FAILURE);
+        DBShowErrors(show_all_errors?DB_ALL_AND_DRVR:DB_ALL, NULL);
+        DBWrite(dbfile, "c", &one, &one, 1, DB_INT);
+        DBSetDir(dbfile, "/");
+        DBGetToc(dbfile);
+        DBSetDir(dbfile, "/tocstale");
+        dbtoc = DBGetToc(dbfile);
+        if (dbtoc->nvar != 3)
+            exit(EXIT_FAILURE);
+        DBSetDir(dbfile, "/");
     }
 
     DBClose(dbfile);
@@ -274,6 +334,20 @@ int main(int argc, char *argv[])
     dbfile = DBOpen(filename, driver, DB_READ);
     dbfile2 = DBOpen(filename2, driver2, DB_APPEND);
 
+    /* the reopened file (read from the object index on hdf5) must agree */
+    if (ntocs)
+    {
+        DBtoc *dbtoc;
+
+        DBSetDir(dbfile, "/testtoc");
+        dbtoc = DBGetToc(dbfile);
+        if (dbtoc->nvar != 1 || dbtoc->ndir != ndirs ||
+            DBInqVarType(dbfile, "tocvar") != DB_VARIABLE ||
+            !DBInqVarExists(dbfile, "tocvar"))
+            exit(EXIT_FAILURE);
+        DBSetDir(dbfile, "/");
+    }
+
     if ((driver&0xF) == DB_HDF5)
         DBCpDir(dbfile, "ucd_dir", dbfile2, "gorfo/foobar");
 
@@ -317,6 +391,38 @@ int main(int argc, char *argv[])
     if (dbfile2 != 0)
         exit(1);
 
+#ifdef HAVE_HDF5_H
+    /* a rename by plain HDF5 keeps the link count of the directory but
+       must not leave the object index in use */
+    if ((driver&0xF) == DB_HDF5)
+    {
+        float x[2] = {0, 1};
+        DBtoc *dbtoc;
+        hid_t h5f;
+
+        dbfile = DBCreate("dirindex.h5", DB_CLOBBER, DB_LOCAL, "dir test file", driver);
+        DBMkDir(dbfile, "d");
+        DBSetDir(dbfile, "/d");
+        DBPutCurve(dbfile, "a", x, x, DB_FLOAT, 2, 0);
+        DBPutCurve(dbfile, "b", x, x, DB_FLOAT, 2, 0);
+        DBClose(dbfile);
+
+        h5f = H5Fopen("dirindex.h5", H5F_ACC_RDWR, H5P_DEFAULT);
+        if (h5f < 0 || H5Lmove(h5f, "/d/a", h5f, "/d/z", H5P_DEFAULT, H5P_DEFAULT) < 0)
+            exit(EXIT_FAILURE);
+        H5Fclose(h5f);
+
+        dbfile = DBOpen("dirindex.h5", driver, DB_READ);
+        DBSetDir(dbfile, "/d");
+        dbtoc = DBGetToc(dbfile);
+        if (dbtoc->ncurve != 2 || strcmp(dbtoc->curve_names[0], "b") ||
+            strcmp(dbtoc->curve_names[1], "z") ||
+            DBInqVarType(dbfile, "z") != DB_CURVE || DBInqVarExists(dbfile, "a"))
+            exit(EXIT_FAILURE);
+        DBClose(dbfile);
+    }
+#endif
+
     CleanupDriverStuff();
     return 0;
 }
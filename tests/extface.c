@@ -57,6 +57,7 @@ be used for advertising or product endorsement purposes.
 #include <stdio.h>
 #include <silo.h>
 #include <stdlib.h>     /* For exit() */
+#include <sys/time.h>
 #include <std.c>
 
 /*
@@ -1766,6 +1767,105 @@ double    v[1093];
 double    w[1093];
 double    t[1200];      /* Zone-centered */
 
+/* Wall clock time in seconds */
+static double
+BenchTime(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return (double) tv.tv_sec + (double) tv.tv_usec * 1e-6;
+}
+
+/***********************************************************************
+ *
+ * Purpose:  Time DBCalcExternalFacelist2 on an n x n x n block of hexes
+ *           whose zones are shuffled, serially and with threads, and
+ *           check both facelists have the right faces and match.
+ *
+ * Input arguments:
+ *    n        : The number of zones in each direction.
+ *    nthreads : The number of threads for the threaded run.
+ *
+ * Output arguments:
+ *
+ * Input/Output arguments:
+ *
+ * Notes:
+ *    Returns 0 on success and 1 on failure.
+ *
+ **********************************************************************/
+static int
+BenchExternalFacelist(int n, int nthreads)
+{
+    int             i, j, k, m, z;
+    int             nn = n + 1;
+    int             nzones = n * n * n;
+    int             nnodes = nn * nn * nn;
+    int             shapetype = DB_ZONETYPE_HEX;
+    int             shapesize = 8;
+    int            *znodes = (int *) malloc(8 * nzones * sizeof(int));
+    int            *order = (int *) malloc(nzones * sizeof(int));
+    DBfacelist     *fl[2];
+    double          t0, t1;
+    int             err = 0;
+
+    /* Shuffle the zone order so faces don't arrive in spatial order */
+    for (z = 0; z < nzones; z++)
+        order[z] = z;
+    srand(0xBADF00D);
+    for (z = nzones - 1; z > 0; z--)
+    {
+        int r = rand() % (z + 1);
+        int tmp = order[z]; order[z] = order[r]; order[r] = tmp;
+    }
+    for (m = 0; m < nzones; m++)
+    {
+        int *zn = &znodes[8*m];
+        z = order[m];
+        i = z % n; j = (z / n) % n; k = z / (n * n);
+        zn[0] = (k*nn + j)*nn + i;
+        zn[1] = zn[0] + 1;
+        zn[2] = zn[0] + nn + 1;
+        zn[3] = zn[0] + nn;
+        zn[4] = zn[0] + nn*nn;
+        zn[5] = zn[1] + nn*nn;
+        zn[6] = zn[2] + nn*nn;
+        zn[7] = zn[3] + nn*nn;
+    }
+
+    for (m = 0; m < 2; m++)
+    {
+        DBSetFacelistThreads(m == 0 ? 1 : nthreads);
+        t0 = BenchTime();
+        fl[m] = DBCalcExternalFacelist2(znodes, nnodes, 0, 0, 0, &shapetype,
+                    &shapesize, &nzones, 1, NULL, 0);
+        t1 = BenchTime();
+        printf("DBCalcExternalFacelist2: %d zones, %d thread(s), %g seconds\n",
+            nzones, m == 0 ? 1 : nthreads, t1 - t0);
+        if (!fl[m] || fl[m]->nfaces != 6 * n * n)
+        {
+            fprintf(stderr, "Expected %d external faces, got %d\n",
+                6 * n * n, fl[m] ? fl[m]->nfaces : -1);
+            err = 1;
+        }
+    }
+    DBSetFacelistThreads(1);
+
+    if (!err && (fl[0]->lnodelist != fl[1]->lnodelist ||
+        memcmp(fl[0]->nodelist, fl[1]->nodelist, fl[0]->lnodelist * sizeof(int)) ||
+        memcmp(fl[0]->zoneno, fl[1]->zoneno, fl[0]->nfaces * sizeof(int))))
+    {
+        fprintf(stderr, "Serial and threaded facelists differ\n");
+        err = 1;
+    }
+
+    DBFreeFacelist(fl[0]);
+    DBFreeFacelist(fl[1]);
+    free(znodes);
+    free(order);
+    return err;
+}
+
 /***********************************************************************
  *
  * Purpose:  Test the DBCalcExternalFacelist routine with all the
@@ -1826,6 +1926,8 @@ main(int argc, char *argv[])
     int		    driver = DB_PDB;
     int             show_all_errors = FALSE;
     char **matnames;
+    int             bench = 0;
+    int             nthreads = 4;
 
     /* Parse command-line */
     for (i=1; i<argc; i++) {
@@ -1837,6 +1939,10 @@ main(int argc, char *argv[])
 	    filename = "globe.h5";
         } else if (!strcmp(argv[i], "show-all-errors")) {
             show_all_errors = 1;
+        } else if (!strncmp(argv[i], "bench=", 6)) {
+            bench = (int) strtol(argv[i]+6, 0, 10);
+        } else if (!strncmp(argv[i], "threads=", 8)) {
+            nthreads = (int) strtol(argv[i]+8, 0, 10);
 	} else if (argv[i][0] != '\0') {
 	    fprintf(stderr, "%s: ignored argument `%s'\n", argv[0], argv[i]);
 	}
@@ -1844,6 +1950,9 @@ main(int argc, char *argv[])
     
     if (show_all_errors) DBShowErrors(DB_ALL_AND_DRVR, 0);
 
+    if (bench > 0)
+        return BenchExternalFacelist(bench, nthreads);
+
     DBSetDeprecateWarnings(0);
     printf("Creating test file \"%s\".\n", filename);
     dbfile = DBCreate(filename, DB_CLOBBER, DB_LOCAL,
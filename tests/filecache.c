@@ -0,0 +1,246 @@
+/*
+Copyright (C) 1994-2016 Lawrence Livermore National Security, LLC.
+LLNL-CODE-425250.
+All rights reserved.
+
+This file is part of Silo. For details, see silo.llnl.gov.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+   * Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the disclaimer below.
+   * Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the disclaimer (as noted
+     below) in the documentation and/or other materials provided with
+     the distribution.
+   * Neither the name of the LLNS/LLNL nor the names of its
+     contributors may be used to endorse or promote products derived
+     from this software without specific prior written permission.
+
+THIS SOFTWARE  IS PROVIDED BY  THE COPYRIGHT HOLDERS  AND CONTRIBUTORS
+"AS  IS" AND  ANY EXPRESS  OR IMPLIED  WARRANTIES, INCLUDING,  BUT NOT
+LIMITED TO, THE IMPLIED  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A  PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN  NO  EVENT SHALL  LAWRENCE
+LIVERMORE  NATIONAL SECURITY, LLC,  THE U.S.  DEPARTMENT OF  ENERGY OR
+CONTRIBUTORS BE LIABLE FOR  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR  CONSEQUENTIAL DAMAGES  (INCLUDING, BUT NOT  LIMITED TO,
+PROCUREMENT OF  SUBSTITUTE GOODS  OR SERVICES; LOSS  OF USE,  DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER  IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING
+NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT  OF THE USE  OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This work was produced at Lawrence Livermore National Laboratory under
+Contract No.  DE-AC52-07NA27344 with the DOE.
+
+Neither the  United States Government nor  Lawrence Livermore National
+Security, LLC nor any of  their employees, makes any warranty, express
+or  implied,  or  assumes  any  liability or  responsibility  for  the
+accuracy, completeness,  or usefulness of  any information, apparatus,
+product, or  process disclosed, or  represents that its use  would not
+infringe privately-owned rights.
+
+Any reference herein to  any specific commercial products, process, or
+services by trade name,  trademark, manufacturer or otherwise does not
+necessarily  constitute or imply  its endorsement,  recommendation, or
+favoring  by  the  United  States  Government  or  Lawrence  Livermore
+National Security,  LLC. The views  and opinions of  authors expressed
+herein do not necessarily state  or reflect those of the United States
+Government or Lawrence Livermore National Security, LLC, and shall not
+be used for advertising or product endorsement purposes.
+*/
+
+#include <silo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <std.c>
+
+#define NFILES 4
+#define NPTS   10
+
+/* Write a curve, /dom/c, whose y values all equal val into a new file */
+static int
+write_block(char const *filename, int driver, float val)
+{
+    float          x[NPTS], y[NPTS];
+    DBfile        *dbfile;
+    int            i;
+
+    for (i = 0; i < NPTS; i++)
+    {
+        x[i] = i;
+        y[i] = val;
+    }
+    dbfile = DBCreate(filename, DB_CLOBBER, DB_LOCAL, "file cache test", driver);
+    if (dbfile == NULL)
+    {
+        fprintf(stderr, "unable to create \"%s\"\n", filename);
+        return 1;
+    }
+    DBMkDir(dbfile, "dom");
+    DBSetDir(dbfile, "dom");
+    DBPutCurve(dbfile, "c", x, y, DB_FLOAT, NPTS, 0);
+    DBClose(dbfile);
+    return 0;
+}
+
+/* Read a curve and check its last y value */
+static int
+check_curve(DBfile *dbfile, char const *objname, float val)
+{
+    DBcurve       *c;
+    int            err = 0;
+
+    if ((c = DBGetCurve(dbfile, objname)) == NULL)
+    {
+        fprintf(stderr, "unable to read \"%s\"\n", objname);
+        return 1;
+    }
+    if (c->npts != NPTS || ((float *) c->y)[NPTS-1] != val)
+    {
+        fprintf(stderr, "\"%s\" has wrong values\n", objname);
+        err = 1;
+    }
+    DBFreeCurve(c);
+    return err;
+}
+
+/* Read the curve of block file i through the root file and check whether
+   the block file had to be opened for it. One object read may take the
+   file from the cache more than once, so only misses, which are opens,
+   are counted. */
+static int
+read_block(DBfile *root, int i, float val, int opened, char const *what)
+{
+    char           objname[64];
+    long long      misses;
+    int            err;
+
+    sprintf(objname, "filecache_%d.pdb:/dom/c", i);
+    DBGetFileCacheStats(0, 0, 1);
+    err = check_curve(root, objname, val);
+    DBGetFileCacheStats(0, &misses, 1);
+    if ((misses > 0) != opened)
+    {
+        fprintf(stderr, "%s: block %d was %sopened\n", what, i,
+            opened ? "not " : "");
+        err = 1;
+    }
+    return err;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    main
+ *
+ * Purpose:     Test the cache of open files reached through "file:/path"
+ *              object names (see DBSetMaxCachedFiles). The second read
+ *              from a block file must find it open, the least recently
+ *              used file must be closed when the cache is full and closing
+ *              the root file or rewriting a block file must drop the
+ *              cached handles. Only the PDB driver resolves such names
+ *              itself, so the cache is tested with PDB only. With either
+ *              driver, a directory named "t:1" must not be taken for a
+ *              file prefix.
+ *
+ * Return:      0 on success, 1 if any check fails
+ *-------------------------------------------------------------------------
+ */
+int
+main(int argc, char *argv[])
+{
+    int            nerrors = 0;
+    int            i, driver = DB_PDB;
+    char          *filename = "filecache_colon.pdb";
+    int            show_all_errors = FALSE;
+    float          x[NPTS], y[NPTS];
+    DBfile        *dbfile;
+
+    /* Parse command-line */
+    for (i=1; i<argc; i++) {
+        if (!strncmp(argv[i], "DB_PDB", 6)) {
+            driver = StringToDriver(argv[i]);
+            filename = "filecache_colon.pdb";
+        } else if (!strncmp(argv[i], "DB_HDF5", 7)) {
+            driver = StringToDriver(argv[i]);
+            filename = "filecache_colon.h5";
+        } else if (!strcmp(argv[i], "show-all-errors")) {
+            show_all_errors = 1;
+        } else if (argv[i][0] != '\0') {
+            fprintf(stderr, "%s: ignored argument `%s'\n", argv[0], argv[i]);
+        }
+    }
+
+    DBShowErrors(show_all_errors?DB_ALL_AND_DRVR:DB_TOP, NULL);
+
+    if (driver == DB_PDB)
+    {
+        char blockname[64];
+
+        for (i = 0; i < NFILES; i++)
+        {
+            sprintf(blockname, "filecache_%d.pdb", i);
+            if (write_block(blockname, driver, (float) i))
+                exit(1);
+        }
+        dbfile = DBCreate("filecache_root.pdb", DB_CLOBBER, DB_LOCAL,
+            "file cache test", driver);
+        DBClose(dbfile);
+        dbfile = DBOpen("filecache_root.pdb", driver, DB_READ);
+
+        /* The second read from a file finds it open */
+        DBSetMaxCachedFiles(NFILES);
+        nerrors += read_block(dbfile, 0, 0, 1, "cache hit");
+        nerrors += read_block(dbfile, 0, 0, 0, "cache hit");
+
+        /* With room for 2 files, reading a third closes the oldest */
+        DBSetMaxCachedFiles(2);
+        nerrors += read_block(dbfile, 1, 1, 1, "eviction");
+        nerrors += read_block(dbfile, 2, 2, 1, "eviction");
+        nerrors += read_block(dbfile, 0, 0, 1, "eviction");
+        nerrors += read_block(dbfile, 2, 2, 0, "eviction");
+
+        /* Turned off, nothing is kept */
+        DBSetMaxCachedFiles(0);
+        nerrors += read_block(dbfile, 3, 3, 1, "no cache");
+        nerrors += read_block(dbfile, 3, 3, 1, "no cache");
+
+        /* Closing the root file closes the cached ones */
+        DBSetMaxCachedFiles(NFILES);
+        nerrors += read_block(dbfile, 1, 1, 1, "DBClose");
+        nerrors += read_block(dbfile, 1, 1, 0, "DBClose");
+        DBClose(dbfile);
+        dbfile = DBOpen("filecache_root.pdb", driver, DB_READ);
+        nerrors += read_block(dbfile, 1, 1, 1, "DBClose");
+
+        /* Rewriting a file drops it and the new contents are read */
+        nerrors += read_block(dbfile, 2, 2, 1, "rewrite");
+        write_block("filecache_2.pdb", driver, 20);
+        nerrors += read_block(dbfile, 2, 20, 1, "rewrite");
+
+        DBClose(dbfile);
+    }
+
+    /* A colon in a directory name is not a file prefix */
+    for (i = 0; i < NPTS; i++)
+    {
+        x[i] = i;
+        y[i] = 5;
+    }
+    dbfile = DBCreate(filename, DB_CLOBBER, DB_LOCAL, "file cache test", driver);
+    if (dbfile == NULL)
+        exit(1);
+    DBMkDir(dbfile, "t:1");
+    DBSetDir(dbfile, "t:1");
+    DBPutCurve(dbfile, "c", x, y, DB_FLOAT, NPTS, 0);
+    DBSetDir(dbfile, "/");
+    nerrors += check_curve(dbfile, "/t:1/c", 5);
+    nerrors += check_curve(dbfile, "t:1/c", 5);
+    DBClose(dbfile);
+
+    CleanupDriverStuff();
+    return nerrors > 0;
+}
@@ -0,0 +1,233 @@
+/*
+Copyright (C) 1994-2016 Lawrence Livermore National Security, LLC.
+LLNL-CODE-425250.
+All rights reserved.
+
+This file is part of Silo. For details, see silo.llnl.gov.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+   * Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the disclaimer below.
+   * Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the disclaimer (as noted
+     below) in the documentation and/or other materials provided with
+     the distribution.
+   * Neither the name of the LLNS/LLNL nor the names of its
+     contributors may be used to endorse or promote products derived
+     from this software without specific prior written permission.
+
+THIS SOFTWARE  IS PROVIDED BY  THE COPYRIGHT HOLDERS  AND CONTRIBUTORS
+"AS  IS" AND  ANY EXPRESS  OR IMPLIED  WARRANTIES, INCLUDING,  BUT NOT
+LIMITED TO, THE IMPLIED  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A  PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN  NO  EVENT SHALL  LAWRENCE
+LIVERMORE  NATIONAL SECURITY, LLC,  THE U.S.  DEPARTMENT OF  ENERGY OR
+CONTRIBUTORS BE LIABLE FOR  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR  CONSEQUENTIAL DAMAGES  (INCLUDING, BUT NOT  LIMITED TO,
+PROCUREMENT OF  SUBSTITUTE GOODS  OR SERVICES; LOSS  OF USE,  DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER  IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING
+NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT  OF THE USE  OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This work was produced at Lawrence Livermore National Laboratory under
+Contract No.  DE-AC52-07NA27344 with the DOE.
+
+Neither the  United States Government nor  Lawrence Livermore National
+Security, LLC nor any of  their employees, makes any warranty, express
+or  implied,  or  assumes  any  liability or  responsibility  for  the
+accuracy, completeness,  or usefulness of  any information, apparatus,
+product, or  process disclosed, or  represents that its use  would not
+infringe privately-owned rights.
+
+Any reference herein to  any specific commercial products, process, or
+services by trade name,  trademark, manufacturer or otherwise does not
+necessarily  constitute or imply  its endorsement,  recommendation, or
+favoring  by  the  United  States  Government  or  Lawrence  Livermore
+National Security,  LLC. The views  and opinions of  authors expressed
+herein do not necessarily state  or reflect those of the United States
+Government or Lawrence Livermore National Security, LLC, and shall not
+be used for advertising or product endorsement purposes.
+*/
+
+#include <silo.h>
+#include <hdf5.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NVALS 1000
+
+/* Create a Silo file that exists only in memory */
+static DBfile *
+create_in_memory(char const *name)
+{
+    int            vfd = DB_H5VFD_CORE, on = 1, optset;
+    DBoptlist     *opts = DBMakeOptlist(2);
+    DBfile        *dbfile;
+
+    DBAddOption(opts, DBOPT_H5_VFD, &vfd);
+    DBAddOption(opts, DBOPT_H5_CORE_NO_BACK_STORE, &on);
+    optset = DBRegisterFileOptionsSet(opts);
+    dbfile = DBCreate(name, DB_CLOBBER, DB_LOCAL, "file image test",
+        DB_HDF5_OPTS(optset));
+    DBUnregisterFileOptionsSet(optset);
+    DBFreeOptlist(opts);
+    return dbfile;
+}
+
+/* Open an image with HDF5 alone, as H5LTopen_file_image does, and read
+   the values back */
+static int
+check_with_hdf5(void *image, size_t size, double const *vals)
+{
+    hid_t          fapl, fid, dset;
+    double         rvals[NVALS];
+    int            i, nerrors = 0;
+
+    fapl = H5Pcreate(H5P_FILE_ACCESS);
+    H5Pset_fapl_core(fapl, 65536, 0);
+    H5Pset_file_image(fapl, image, size);
+    if ((fid = H5Fopen("fileimage", H5F_ACC_RDONLY, fapl)) < 0)
+    {
+        fprintf(stderr, "HDF5 cannot open the image\n");
+        H5Pclose(fapl);
+        return 1;
+    }
+    H5Pclose(fapl);
+
+    if ((dset = H5Dopen(fid, "/dom/vals", H5P_DEFAULT)) < 0 ||
+        H5Dread(dset, H5T_NATIVE_DOUBLE, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+            rvals) < 0)
+    {
+        fprintf(stderr, "HDF5 cannot read \"/dom/vals\" from the image\n");
+        nerrors++;
+    }
+    else
+    {
+        for (i = 0; i < NVALS; i++)
+            if (rvals[i] != vals[i]) break;
+        if (i < NVALS)
+        {
+            fprintf(stderr, "HDF5 read wrong values from the image\n");
+            nerrors++;
+        }
+    }
+    if (dset >= 0)
+        H5Dclose(dset);
+    H5Fclose(fid);
+    return nerrors;
+}
+
+/* Open an image with the FIC VFD, which takes ownership of it even if
+   the open fails, and read the values back */
+static int
+check_with_fic(void *image, size_t size, double const *vals)
+{
+    int            vfd = DB_H5VFD_FIC, isize = (int) size, optset;
+    DBoptlist     *opts = DBMakeOptlist(3);
+    DBfile        *dbfile;
+    double        *rvals;
+    int            i, nerrors = 0;
+
+    DBAddOption(opts, DBOPT_H5_VFD, &vfd);
+    DBAddOption(opts, DBOPT_H5_FIC_SIZE, &isize);
+    DBAddOption(opts, DBOPT_H5_FIC_BUF, image);
+    optset = DBRegisterFileOptionsSet(opts);
+    dbfile = DBOpen("fileimage", DB_HDF5_OPTS(optset), DB_READ);
+    DBUnregisterFileOptionsSet(optset);
+    DBFreeOptlist(opts);
+    if (dbfile == NULL)
+    {
+        fprintf(stderr, "DBOpen cannot open the image\n");
+        return 1;
+    }
+
+    if ((rvals = (double *) DBGetVar(dbfile, "/dom/vals")) == NULL)
+    {
+        fprintf(stderr, "DBGetVar cannot read \"/dom/vals\" from the image\n");
+        nerrors++;
+    }
+    else
+    {
+        for (i = 0; i < NVALS; i++)
+            if (rvals[i] != vals[i]) break;
+        if (i < NVALS)
+        {
+            fprintf(stderr, "DBGetVar read wrong values from the image\n");
+            nerrors++;
+        }
+        free(rvals);
+    }
+    DBClose(dbfile);
+    return nerrors;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    main
+ *
+ * Purpose:     Test DBGetFileImage. A file is built in memory with the
+ *              core VFD and its image is reopened, first with HDF5 alone
+ *              the way H5LTopen_file_image does and then with the FIC VFD.
+ *              Images of version 2 and 3 superblocks open only if their
+ *              checksum matches the status flags HDF5 clears in them.
+ *
+ * Return:      0 on success, 1 if any check fails
+ *-------------------------------------------------------------------------
+ */
+int
+main(int argc, char *argv[])
+{
+    int            nerrors = 0;
+    int            i, dims[1] = {NVALS};
+    int            show_all_errors = FALSE;
+    double         vals[NVALS];
+    DBfile        *dbfile;
+    void          *image = NULL;
+    size_t         size = 0;
+
+    /* Parse command-line */
+    for (i=1; i<argc; i++) {
+        if (!strncmp(argv[i], "DB_HDF5", 7)) {
+            /* in-memory files are always HDF5 */
+        } else if (!strncmp(argv[i], "DB_", 3)) {
+            fprintf(stderr, "%s: file images are HDF5 only\n", argv[0]);
+            exit(0);
+        } else if (!strcmp(argv[i], "show-all-errors")) {
+            show_all_errors = 1;
+        } else if (argv[i][0] != '\0') {
+            fprintf(stderr, "%s: ignored argument `%s'\n", argv[0], argv[i]);
+        }
+    }
+
+    DBShowErrors(show_all_errors?DB_ALL_AND_DRVR:DB_TOP, NULL);
+
+    for (i = 0; i < NVALS; i++)
+        vals[i] = i * 0.5 - 100.0;
+
+    if ((dbfile = create_in_memory("fileimage")) == NULL)
+    {
+        fprintf(stderr, "unable to create in-memory file\n");
+        exit(1);
+    }
+    DBMkDir(dbfile, "dom");
+    DBSetDir(dbfile, "dom");
+    if (DBWrite(dbfile, "vals", vals, dims, 1, DB_DOUBLE) < 0)
+    {
+        fprintf(stderr, "unable to write \"vals\"\n");
+        nerrors++;
+    }
+    if (DBGetFileImage(dbfile, &image, &size) < 0 || image == NULL)
+    {
+        fprintf(stderr, "unable to get the file image\n");
+        exit(1);
+    }
+    DBClose(dbfile);
+
+    nerrors += check_with_hdf5(image, size, vals);
+    nerrors += check_with_fic(image, size, vals);
+
+    return nerrors > 0;
+}
@@ -51,10 +51,13 @@ product endorsement purposes.
 */
 #include <dlfcn.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <unistd.h>
 
@@ -279,6 +282,10 @@ static int ProcessCommandLine(int argc, char *argv[], options_t *opts)
         {
             opts->print_details = 1;
         }
+        else if (!strcmp(argv[i], "--direct"))
+        {
+            opts->direct = 1;
+        }
         else if (!strcmp(argv[i], plugin_opts_delim))
         {
             break;
@@ -314,9 +321,10 @@ extern iointerface_t* CreateInterface_pdb(int argi, int argc, char *argv[],
     const char *filename, const options_t *opts);
 #endif
 
+static char testfilename[256];
+
 static iointerface_t* GetIOInterface(int argi, int argc, char *argv[], const options_t *opts)
 {
-    char testfilename[256];
     char ifacename[256];
     void *dlhandle=0;
     iointerface_t *retval=0;
@@ -503,6 +511,41 @@ static void AddTimingInfo(ioop_t op, size_t size, double t0, double t1)
     i++;
 }
 
+/* Report how much of the test file the OS holds in its page cache.
+   Writes with --direct should leave little or none of it there. */
+static void OutputPageCacheResidency(const char *filename)
+{
+    struct stat sb;
+    size_t pgsz = (size_t) sysconf(_SC_PAGESIZE);
+    size_t j, npages, nres = 0;
+    unsigned char *vec;
+    void *addr;
+    int fd;
+
+    if ((fd = open(filename, O_RDONLY)) < 0)
+        return;
+    if (fstat(fd, &sb) < 0 || sb.st_size == 0)
+    {
+        close(fd);
+        return;
+    }
+    addr = mmap(0, (size_t) sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return;
+
+    npages = ((size_t) sb.st_size + pgsz - 1) / pgsz;
+    vec = (unsigned char *) malloc(npages);
+    if (vec && mincore(addr, (size_t) sb.st_size, (void *) vec) == 0)
+    {
+        for (j = 0; j < npages; j++)
+            nres += vec[j] & 1;
+        fprintf(stdout, "Page cache: %zd of %zd pages of \"%s\" resident\n", nres, npages, filename);
+    }
+    free(vec);
+    munmap(addr, (size_t) sb.st_size);
+}
+
 static void TestWrites(iointerface_t *ioiface, const options_t *opts)
 {
     int i,n;
@@ -510,9 +553,18 @@ static void TestWrites(iointerface_t *ioiface, const options_t *opts)
     double *buf;
     int num_doubles;
 
-    /* allocate and initialize a buffer of data to write */
+    /* allocate and initialize a buffer of data to write, page aligned
+       for direct I/O */
     num_doubles = opts->request_size_in_bytes / sizeof(double);
-    buf = (double*) calloc(opts->request_size_in_bytes,1);
+    if (opts->direct)
+    {
+        if (posix_memalign((void**) &buf, (size_t) sysconf(_SC_PAGESIZE), opts->request_size_in_bytes) != 0)
+            buf = 0;
+        else
+            memset(buf, 0, opts->request_size_in_bytes);
+    }
+    else
+        buf = (double*) calloc(opts->request_size_in_bytes,1);
     for (i=0; i<num_doubles;i++)
         buf[i] = i;
 
@@ -605,6 +657,9 @@ main(int argc, char *argv[])
     else
         AddTimingInfo(OP_OUTPUT_SUMMARY, 0, 0, 0);
 
+    if (options.flags&IO_WRITE)
+        OutputPageCacheResidency(testfilename);
+
 #ifdef PARALLEL
     if (!options.no_mpi)
         MPI_Finalize();
@@ -73,6 +73,7 @@ typedef struct _options_t
     int print_details;
     int alignment;
     int rand_file_name;
+    int direct;
     int no_mpi;
     int mpi_rank;
     int mpi_size;
@@ -77,6 +77,7 @@ static hid_t dspc = -1;
 
 extern herr_t H5Pset_fapl_silo(hid_t);
 extern herr_t H5Pset_silo_block_size_and_count(hid_t, hsize_t, int);
+extern herr_t H5Pset_silo_use_direct(hid_t, int);
 
 static int Open_hdf5(ioflags_t iopflags)
 {
@@ -97,6 +98,8 @@ static int Open_hdf5(ioflags_t iopflags)
         h5status |= H5Pset_fapl_silo(fapl_id);
         h5status |= H5Pset_silo_block_size_and_count(fapl_id, (hsize_t) silo_block_size,
             silo_block_count);
+        if (options.direct)
+            h5status |= H5Pset_silo_use_direct(fapl_id, 1);
     }
     else if (use_log)
     {
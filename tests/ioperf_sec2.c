@@ -49,6 +49,11 @@ reflect those  of the United  States Government or  Lawrence Livermore
 National  Security, LLC,  and shall  not  be used  for advertising  or
 product endorsement purposes.
 */
+/* for O_DIRECT */
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
@@ -75,6 +80,9 @@ static int Open_sec2(ioflags_t iopflags)
     if (!(iopflags&IO_WRITE) && (iopflags&IO_READ)) flags=O_RDONLY;
     if (iopflags&IO_TRUNCATE) flags|=O_TRUNC;
     if (iopflags&IO_APPEND) flags|=O_APPEND;
+#ifdef O_DIRECT
+    if (options.direct) flags|=O_DIRECT;
+#endif
 
     fd = open(filename, flags, S_IRUSR|S_IWUSR); 
 
@@ -172,6 +172,11 @@ static iointerface_t *CreateInterfaceReal(int argi, int argc, char *argv[], cons
     if (ProcessArgs_silo(argi, argc, argv) != 0)
         return 0;
 
+    /* Direct I/O for Silo means HDF5 through the Silo VFD. Other drivers
+       given with --driver are left alone. */
+    if (options.direct && driver == DB_HDF5)
+        driver = StringToDriver("DB_HDF5_OPTS(DBOPT_H5_VFD=DB_H5VFD_SILO,DBOPT_H5_SILO_USE_DIRECT=1)");
+
     filename = strdup(_filename);
 
     retval = (iointerface_t*) calloc(sizeof(iointerface_t),1);
@@ -0,0 +1,295 @@
+/*
+Copyright (C) 1994-2016 Lawrence Livermore National Security, LLC.
+LLNL-CODE-425250.
+All rights reserved.
+
+This file is part of Silo. For details, see silo.llnl.gov.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+   * Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the disclaimer below.
+   * Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the disclaimer (as noted
+     below) in the documentation and/or other materials provided with
+     the distribution.
+   * Neither the name of the LLNS/LLNL nor the names of its
+     contributors may be used to endorse or promote products derived
+     from this software without specific prior written permission.
+
+THIS SOFTWARE  IS PROVIDED BY  THE COPYRIGHT HOLDERS  AND CONTRIBUTORS
+"AS  IS" AND  ANY EXPRESS  OR IMPLIED  WARRANTIES, INCLUDING,  BUT NOT
+LIMITED TO, THE IMPLIED  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A  PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN  NO  EVENT SHALL  LAWRENCE
+LIVERMORE  NATIONAL SECURITY, LLC,  THE U.S.  DEPARTMENT OF  ENERGY OR
+CONTRIBUTORS BE LIABLE FOR  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR  CONSEQUENTIAL DAMAGES  (INCLUDING, BUT NOT  LIMITED TO,
+PROCUREMENT OF  SUBSTITUTE GOODS  OR SERVICES; LOSS  OF USE,  DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER  IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING
+NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT  OF THE USE  OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This work was produced at Lawrence Livermore National Laboratory under
+Contract No.  DE-AC52-07NA27344 with the DOE.
+
+Neither the  United States Government nor  Lawrence Livermore National
+Security, LLC nor any of  their employees, makes any warranty, express
+or  implied,  or  assumes  any  liability or  responsibility  for  the
+accuracy, completeness,  or usefulness of  any information, apparatus,
+product, or  process disclosed, or  represents that its use  would not
+infringe privately-owned rights.
+
+Any reference herein to  any specific commercial products, process, or
+services by trade name,  trademark, manufacturer or otherwise does not
+necessarily  constitute or imply  its endorsement,  recommendation, or
+favoring  by  the  United  States  Government  or  Lawrence  Livermore
+National Security,  LLC. The views  and opinions of  authors expressed
+herein do not necessarily state  or reflect those of the United States
+Government or Lawrence Livermore National Security, LLC, and shall not
+be used for advertising or product endorsement purposes.
+*/
+
+#include <silo.h>
+#include <hdf5.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <std.c>
+
+#define NX 12
+#define NY 10
+
+#define VALUE(V,I) ((V) * 1000.0 + (I))
+
+/* Write a quad mesh and a node variable on it, each with its own data */
+static int
+put_mesh_and_var(DBfile *dbfile, char const *mname, char const *vname, int v)
+{
+    float          x[NX], y[NY];
+    float         *coords[2];
+    double         vals[NX*NY];
+    int            dims[2] = {NX, NY};
+    int            i, nerrors = 0;
+
+    coords[0] = x;
+    coords[1] = y;
+    for (i = 0; i < NX; i++) x[i] = v + i;
+    for (i = 0; i < NY; i++) y[i] = v - i;
+    for (i = 0; i < NX*NY; i++) vals[i] = VALUE(v, i);
+
+    if (DBPutQuadmesh(dbfile, mname, 0, coords, dims, 2, DB_FLOAT,
+            DB_COLLINEAR, 0) < 0)
+    {
+        fprintf(stderr, "unable to write \"%s\"\n", mname);
+        nerrors++;
+    }
+    if (DBPutQuadvar1(dbfile, vname, mname, vals, dims, 2, 0, 0, DB_DOUBLE,
+            DB_NODECENT, 0) < 0)
+    {
+        fprintf(stderr, "unable to write \"%s\"\n", vname);
+        nerrors++;
+    }
+    return nerrors;
+}
+
+/* Read back what put_mesh_and_var wrote and count the differences */
+static int
+check_mesh_and_var(DBfile *dbfile, char const *mname, char const *vname, int v)
+{
+    DBquadmesh    *qm;
+    DBquadvar     *qv;
+    int            i, nerrors = 0;
+
+    if ((qm = DBGetQuadmesh(dbfile, mname)) == NULL)
+    {
+        fprintf(stderr, "unable to read \"%s\"\n", mname);
+        nerrors++;
+    }
+    else if (qm->ndims != 2 || qm->dims[0] != NX || qm->dims[1] != NY ||
+             !qm->coords[0] || !qm->coords[1])
+    {
+        fprintf(stderr, "\"%s\" is incomplete\n", mname);
+        nerrors++;
+        DBFreeQuadmesh(qm);
+    }
+    else
+    {
+        for (i = 0; i < NX; i++)
+            if (((float *) qm->coords[0])[i] != v + i) break;
+        if (i < NX) nerrors++;
+        for (i = 0; i < NY; i++)
+            if (((float *) qm->coords[1])[i] != v - i) break;
+        if (i < NY) nerrors++;
+        if (nerrors)
+            fprintf(stderr, "\"%s\" has wrong coordinates\n", mname);
+        DBFreeQuadmesh(qm);
+    }
+
+    if ((qv = DBGetQuadvar(dbfile, vname)) == NULL)
+    {
+        fprintf(stderr, "unable to read \"%s\"\n", vname);
+        nerrors++;
+    }
+    else if (qv->ndims != 2 || qv->nels != NX*NY || qv->dims[0] != NX ||
+             qv->dims[1] != NY || !qv->vals || !qv->vals[0])
+    {
+        fprintf(stderr, "\"%s\" is incomplete\n", vname);
+        nerrors++;
+        DBFreeQuadvar(qv);
+    }
+    else
+    {
+        for (i = 0; i < NX*NY; i++)
+            if (((double *) qv->vals[0])[i] != VALUE(v, i)) break;
+        if (i < NX*NY)
+        {
+            fprintf(stderr, "\"%s\" has wrong values\n", vname);
+            nerrors++;
+        }
+        DBFreeQuadvar(qv);
+    }
+    return nerrors;
+}
+
+/* Overwrite the count of link names a file has handed out, as a handle
+   with a different count would when it is flushed */
+static int
+set_nlinks(char const *filename, int nlinks)
+{
+    hid_t          fid, grp, attr;
+    int            nerrors = 0;
+
+    if ((fid = H5Fopen(filename, H5F_ACC_RDWR, H5P_DEFAULT)) < 0)
+        return 1;
+    if ((grp = H5Gopen(fid, "/.silo", H5P_DEFAULT)) < 0 ||
+        (attr = H5Aopen_name(grp, "nlinks")) < 0 ||
+        H5Awrite(attr, H5T_NATIVE_INT, &nlinks) < 0 ||
+        H5Aclose(attr) < 0 || H5Gclose(grp) < 0)
+    {
+        fprintf(stderr, "unable to set nlinks of \"%s\"\n", filename);
+        nerrors++;
+    }
+    H5Fclose(fid);
+    return nerrors;
+}
+
+/* Return non-zero if the link group of the file has a dataset NAME */
+static int
+has_link(char const *filename, char const *name)
+{
+    hid_t          fid;
+    int            found = 0;
+
+    if ((fid = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT)) < 0)
+        return 0;
+    found = H5Lexists(fid, name, H5P_DEFAULT) > 0;
+    H5Fclose(fid);
+    return found;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    main
+ *
+ * Purpose:     Test the names the HDF5 driver gives datasets in its link
+ *              group, /.silo. A directory is copied with DBCpDir into a
+ *              file whose count of names is at 999999, so the copies get
+ *              the longer name #1000000 and up in place of #000001. Then the
+ *              count is set back to 0, as a stale count flushed by another
+ *              handle on the file would, and more objects are written,
+ *              which must not reuse names already there. Everything must
+ *              read back unchanged.
+ *
+ * Return:      0 on success, 1 if any check fails
+ *-------------------------------------------------------------------------
+ */
+int
+main(int argc, char *argv[])
+{
+    int            nerrors = 0;
+    int            i, driver = DB_HDF5;
+    char          *srcname = "linknames_src.h5";
+    char          *dstname = "linknames_dst.h5";
+    int            show_all_errors = FALSE;
+    DBfile        *src, *dst;
+
+    /* Parse command-line */
+    for (i=1; i<argc; i++) {
+        if (!strncmp(argv[i], "DB_HDF5", 7)) {
+            driver = StringToDriver(argv[i]);
+        } else if (!strncmp(argv[i], "DB_", 3)) {
+            fprintf(stderr, "%s: link names are HDF5 only\n", argv[0]);
+            exit(0);
+        } else if (!strcmp(argv[i], "show-all-errors")) {
+            show_all_errors = 1;
+        } else if (argv[i][0] != '\0') {
+            fprintf(stderr, "%s: ignored argument `%s'\n", argv[0], argv[i]);
+        }
+    }
+
+    DBShowErrors(show_all_errors?DB_ALL_AND_DRVR:DB_TOP, NULL);
+    DBSetDeprecateWarnings(0);
+
+    if ((src = DBCreate(srcname, DB_CLOBBER, DB_LOCAL, "link names source",
+            driver)) == NULL ||
+        (dst = DBCreate(dstname, DB_CLOBBER, DB_LOCAL, "link names target",
+            driver)) == NULL)
+    {
+        fprintf(stderr, "unable to create test files\n");
+        exit(1);
+    }
+    DBMkDir(src, "dir");
+    DBSetDir(src, "dir");
+    nerrors += put_mesh_and_var(src, "mesh", "var", 1);
+    nerrors += put_mesh_and_var(dst, "mesh", "var", 2);
+    DBClose(src);
+    DBClose(dst);
+
+    /* Copy into a file whose names have reached 7 digits */
+    nerrors += set_nlinks(dstname, 999999);
+    src = DBOpen(srcname, driver, DB_READ);
+    dst = DBOpen(dstname, driver, DB_APPEND);
+    if (src == NULL || dst == NULL)
+    {
+        fprintf(stderr, "unable to open test files\n");
+        exit(1);
+    }
+    if (DBCpDir(src, "dir", dst, "dir_copy") < 0)
+    {
+        fprintf(stderr, "unable to copy \"dir\"\n");
+        nerrors++;
+    }
+    DBClose(src);
+    DBClose(dst);
+    if (!has_link(dstname, "/.silo/#1000000"))
+    {
+        fprintf(stderr, "copies were not named past #999999\n");
+        nerrors++;
+    }
+
+    /* Write more with a count that is behind the names in the file */
+    nerrors += set_nlinks(dstname, 0);
+    if ((dst = DBOpen(dstname, driver, DB_APPEND)) == NULL)
+    {
+        fprintf(stderr, "unable to open \"%s\"\n", dstname);
+        exit(1);
+    }
+    nerrors += put_mesh_and_var(dst, "mesh2", "var2", 3);
+    DBClose(dst);
+
+    if ((dst = DBOpen(dstname, driver, DB_READ)) == NULL)
+    {
+        fprintf(stderr, "unable to open \"%s\"\n", dstname);
+        exit(1);
+    }
+    nerrors += check_mesh_and_var(dst, "mesh", "var", 2);
+    nerrors += check_mesh_and_var(dst, "dir_copy/mesh", "dir_copy/var", 1);
+    nerrors += check_mesh_and_var(dst, "mesh2", "var2", 3);
+    DBClose(dst);
+
+    CleanupDriverStuff();
+    return nerrors > 0;
+}
@@ -122,6 +122,7 @@ void fill_mat(float *, float *, float *, int *, int, int, int,
     int *, int *, int *, float *, int *, int, double, double, double, double);
 
 int  build_multi(char *, int, char *, int, int, int, int);
+int  read_multi(char *, char *);
 
 void build_block_ucd3d(char *, int, char *, int, int, int);
 
@@ -219,6 +220,15 @@ main(int argc, char *argv[])
      */
     build_multi(basename, driver, file_ext, 6, 8, 6, windows_style_slash);
 
+    /*
+     * Read the blocks back through the multi-block objects.
+     */
+#if !defined(_WIN32)
+    if (!comm_rank && !windows_style_slash && !empties &&
+        read_multi(basename, file_ext) != 0)
+        return 1;
+#endif
+
     CleanupDriverStuff();
 
 #ifdef HAVE_MPI
@@ -228,6 +238,73 @@ main(int argc, char *argv[])
     return 0;
 }
 
+/***********************************************************************
+ *
+ * Purpose:
+ *    Read all blocks of the multi-block mesh and every other block of
+ *    the multi-block material back with DBGetMultiblockObjects.
+ *
+ ***********************************************************************/
+int
+read_multi(char *basename, char *file_ext)
+{
+    char            filename[256];
+    DBfile         *dbfile;
+    DBmultimesh    *mm;
+    DBmultimat     *mt;
+    void          **objs;
+    int            *types, *blocks;
+    int             i, n, nerrors = 0;
+
+    sprintf(filename, "%s_root.%s", basename, file_ext);
+    if ((dbfile = DBOpen(filename, DB_UNKNOWN, DB_READ)) == NULL)
+    {
+        fprintf(stderr, "Error opening %s\n", filename);
+        return 1;
+    }
+
+    mm = DBGetMultimesh(dbfile, "mesh1");
+    types = ALLOC_N(int, mm->nblocks);
+    objs = DBGetMultiblockObjects(dbfile, mm, DB_MULTIMESH, mm->nblocks, 0, types);
+    if (objs == NULL)
+        nerrors++;
+    for (i = 0; objs && i < mm->nblocks; i++)
+    {
+        DBucdmesh *um = (DBucdmesh *) objs[i];
+        if (types[i] != DB_UCDMESH || um == NULL || um->ndims != 3)
+            nerrors++;
+    }
+    DBFreeMultiblockObjects(objs, mm->nblocks, types);
+    FREE(types);
+
+    mt = DBGetMultimat(dbfile, "mat1");
+    n = mt->nmats / 2;
+    blocks = ALLOC_N(int, n);
+    types = ALLOC_N(int, n);
+    for (i = 0; i < n; i++)
+        blocks[i] = 2 * i + 1;
+    objs = DBGetMultiblockObjects(dbfile, mt, DB_MULTIMAT, n, blocks, types);
+    if (objs == NULL)
+        nerrors++;
+    for (i = 0; objs && i < n; i++)
+    {
+        DBmaterial *mat = (DBmaterial *) objs[i];
+        if (types[i] != DB_MATERIAL || mat == NULL || mat->nmat != 3)
+            nerrors++;
+    }
+    DBFreeMultiblockObjects(objs, n, types);
+    FREE(blocks);
+    FREE(types);
+
+    DBFreeMultimesh(mm);
+    DBFreeMultimat(mt);
+    DBClose(dbfile);
+
+    if (nerrors)
+        fprintf(stderr, "%d errors reading blocks of %s\n", nerrors, filename);
+    return nerrors != 0;
+}
+
 /***********************************************************************      
  *
  * Purpose:
@@ -73,12 +73,19 @@ if (!NS)
 }                                                                                                          \
 else                                                                                                       \
 {                                                                                                          \
+    char batchName[1024];                                                                                  \
     if (strcmp(DBGetName(NS, I), EXP) != 0)                                                                \
     {                                                                                                      \
         fprintf(stderr, "Namescheme at line %d failed for index %d. Expected \"%s\", got \"%s\"\n", \
             __LINE__, I, EXP, DBGetName(NS, I));                                                           \
         return 1;                                                                                          \
     }                                                                                                      \
+    if (DBGetNames(NS, I, 1, batchName, sizeof(batchName)) != 0 || strcmp(batchName, EXP) != 0)            \
+    {                                                                                                      \
+        fprintf(stderr, "DBGetNames at line %d failed for index %d. Expected \"%s\", got \"%s\"\n",   \
+            __LINE__, I, EXP, batchName);                                                                  \
+        return 1;                                                                                          \
+    }                                                                                                      \
 }
 
 #define TEST_GET_INDEX(STR,FLD,BASE,IND)                                                                   \
@@ -177,6 +184,33 @@ int main(int argc, char **argv)
     TEST_GET_NAME(ns, 19, "foo_095x009");
     TEST_GET_NAME(ns, 20, "foo_100x000");
     TEST_GET_NAME(ns, 21, "foo_105x001");
+
+    /* Test getting a batch of names into caller storage, including
+       truncation to the caller's name length */
+    {
+        char names[5*12];
+        char const *exp[5] = {"foo_085x001", "foo_090x004", "foo_095x009",
+                              "foo_100x000", "foo_105x001"};
+        if (DBGetNames(ns, 17, 5, names, 12) != 0)
+        {
+            fprintf(stderr, "DBGetNames failed at line %d\n", __LINE__);
+            return 1;
+        }
+        for (i = 0; i < 5; i++)
+            TEST_STR(exp[i], &names[i*12]);
+        if (DBGetNames(ns, 17, 5, names, 6) != 0)
+        {
+            fprintf(stderr, "DBGetNames failed at line %d\n", __LINE__);
+            return 1;
+        }
+        TEST_STR("foo_0", &names[0*6]);
+        TEST_STR("foo_1", &names[4*6]);
+        if (DBGetNames(0, 0, 1, names, 12) != -1)
+        {
+            fprintf(stderr, "DBGetNames did not fail for NULL namescheme at line %d\n", __LINE__);
+            return 1;
+        }
+    }
     DBFreeNamescheme(ns);
 
     /* Test array-based references to char* valued array */
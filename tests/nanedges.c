@@ -0,0 +1,161 @@
+/*
+Copyright (C) 1994-2016 Lawrence Livermore National Security, LLC.
+LLNL-CODE-425250.
+All rights reserved.
+
+This file is part of Silo. For details, see silo.llnl.gov.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+   * Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the disclaimer below.
+   * Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the disclaimer (as noted
+     below) in the documentation and/or other materials provided with
+     the distribution.
+   * Neither the name of the LLNS/LLNL nor the names of its
+     contributors may be used to endorse or promote products derived
+     from this software without specific prior written permission.
+
+THIS SOFTWARE  IS PROVIDED BY  THE COPYRIGHT HOLDERS  AND CONTRIBUTORS
+"AS  IS" AND  ANY EXPRESS  OR IMPLIED  WARRANTIES, INCLUDING,  BUT NOT
+LIMITED TO, THE IMPLIED  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A  PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN  NO  EVENT SHALL  LAWRENCE
+LIVERMORE  NATIONAL SECURITY, LLC,  THE U.S.  DEPARTMENT OF  ENERGY OR
+CONTRIBUTORS BE LIABLE FOR  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR  CONSEQUENTIAL DAMAGES  (INCLUDING, BUT NOT  LIMITED TO,
+PROCUREMENT OF  SUBSTITUTE GOODS  OR SERVICES; LOSS  OF USE,  DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER  IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING
+NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT  OF THE USE  OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This work was produced at Lawrence Livermore National Laboratory under
+Contract No.  DE-AC52-07NA27344 with the DOE.
+
+Neither the  United States Government nor  Lawrence Livermore National
+Security, LLC nor any of  their employees, makes any warranty, express
+or  implied,  or  assumes  any  liability or  responsibility  for  the
+accuracy, completeness,  or usefulness of  any information, apparatus,
+product, or  process disclosed, or  represents that its use  would not
+infringe privately-owned rights.
+
+Any reference herein to  any specific commercial products, process, or
+services by trade name,  trademark, manufacturer or otherwise does not
+necessarily  constitute or imply  its endorsement,  recommendation, or
+favoring  by  the  United  States  Government  or  Lawrence  Livermore
+National Security,  LLC. The views  and opinions of  authors expressed
+herein do not necessarily state  or reflect those of the United States
+Government or Lawrence Livermore National Security, LLC, and shall not
+be used for advertising or product endorsement purposes.
+*/
+
+#include <silo.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <std.c>
+
+#define BLOCK 4096              /* SCAN_BLOCK in silock */
+
+/* Write the clean and double arrays and, if asked, the float array */
+static int
+write_file(char const *filename, int driver, int with_floats)
+{
+    double         one = 1.0, inf, nanval;
+    double         d[2*BLOCK+1];
+    float          f[2*BLOCK];
+    int            i, dims[1];
+    DBfile        *dbfile;
+
+    inf = one/(one-1.0);
+#ifndef _WIN32
+    nanval = nan("");
+    if (nanval == 0.0)
+#endif
+        nanval = sqrt((double)-1.0);
+
+    for (i = 0; i < 2*BLOCK+1; i++)
+        d[i] = i * 0.5;
+    for (i = 0; i < 2*BLOCK; i++)
+        f[i] = (float) (i * 0.25);
+
+    dbfile = DBCreate(filename, DB_CLOBBER, DB_LOCAL,
+        "NaN/Inf at silock block edges", driver);
+    if (dbfile == NULL)
+    {
+        fprintf(stderr, "unable to create %s\n", filename);
+        return 1;
+    }
+
+    dims[0] = 2*BLOCK;
+    DBWrite(dbfile, "clean", d, dims, 1, DB_DOUBLE);
+
+    /* two whole blocks and one value */
+    d[0]         = nanval;
+    d[BLOCK-1]   = inf;
+    d[BLOCK]     = -inf;
+    d[2*BLOCK-1] = nanval;
+    d[2*BLOCK]   = inf;
+    dims[0] = 2*BLOCK+1;
+    DBWrite(dbfile, "d", d, dims, 1, DB_DOUBLE);
+
+    /* exactly two blocks */
+    if (with_floats)
+    {
+        f[BLOCK-1]   = (float) nanval;
+        f[BLOCK]     = (float) inf;
+        f[2*BLOCK-1] = (float) -inf;
+        dims[0] = 2*BLOCK;
+        DBWrite(dbfile, "f", f, dims, 1, DB_FLOAT);
+    }
+
+    DBClose(dbfile);
+    return 0;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    main
+ *
+ * Purpose:     Write nanedges.silo and nanedges2.silo for testsilock. The
+ *              first holds a double and a float array with NaNs and
+ *              infinities on both sides of the boundaries between the
+ *              blocks silock checks at a time, at the first and last
+ *              values and in a partial last block, plus a clean array. The
+ *              second holds only the clean and double arrays, so scanning
+ *              the two files finds different things. testsilock knows
+ *              where each bad value is.
+ *
+ * Return:      0 on success, 1 if a file could not be written
+ *-------------------------------------------------------------------------
+ */
+int
+main(int argc, char *argv[])
+{
+    int            nerrors = 0;
+    int            i, driver = DB_PDB;
+    int            show_all_errors = FALSE;
+
+    /* Parse command-line */
+    for (i=1; i<argc; i++) {
+        if (!strncmp(argv[i], "DB_", 3)) {
+            driver = StringToDriver(argv[i]);
+        } else if (!strcmp(argv[i], "show-all-errors")) {
+            show_all_errors = 1;
+        } else if (argv[i][0] != '\0') {
+            fprintf(stderr, "%s: ignored argument `%s'\n", argv[0], argv[i]);
+        }
+    }
+
+    DBShowErrors(show_all_errors?DB_ALL_AND_DRVR:DB_TOP, NULL);
+
+    nerrors += write_file("nanedges.silo", driver, TRUE);
+    nerrors += write_file("nanedges2.silo", driver, FALSE);
+
+    CleanupDriverStuff();
+    return nerrors > 0;
+}
@@ -0,0 +1,217 @@
+/*
+Copyright (C) 1994-2016 Lawrence Livermore National Security, LLC.
+LLNL-CODE-425250.
+All rights reserved.
+
+This file is part of Silo. For details, see silo.llnl.gov.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+   * Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the disclaimer below.
+   * Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the disclaimer (as noted
+     below) in the documentation and/or other materials provided with
+     the distribution.
+   * Neither the name of the LLNS/LLNL nor the names of its
+     contributors may be used to endorse or promote products derived
+     from this software without specific prior written permission.
+
+THIS SOFTWARE  IS PROVIDED BY  THE COPYRIGHT HOLDERS  AND CONTRIBUTORS
+"AS  IS" AND  ANY EXPRESS  OR IMPLIED  WARRANTIES, INCLUDING,  BUT NOT
+LIMITED TO, THE IMPLIED  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A  PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN  NO  EVENT SHALL  LAWRENCE
+LIVERMORE  NATIONAL SECURITY, LLC,  THE U.S.  DEPARTMENT OF  ENERGY OR
+CONTRIBUTORS BE LIABLE FOR  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR  CONSEQUENTIAL DAMAGES  (INCLUDING, BUT NOT  LIMITED TO,
+PROCUREMENT OF  SUBSTITUTE GOODS  OR SERVICES; LOSS  OF USE,  DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER  IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING
+NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT  OF THE USE  OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This work was produced at Lawrence Livermore National Laboratory under
+Contract No.  DE-AC52-07NA27344 with the DOE.
+
+Neither the  United States Government nor  Lawrence Livermore National
+Security, LLC nor any of  their employees, makes any warranty, express
+or  implied,  or  assumes  any  liability or  responsibility  for  the
+accuracy, completeness,  or usefulness of  any information, apparatus,
+product, or  process disclosed, or  represents that its use  would not
+infringe privately-owned rights.
+
+Any reference herein to  any specific commercial products, process, or
+services by trade name,  trademark, manufacturer or otherwise does not
+necessarily  constitute or imply  its endorsement,  recommendation, or
+favoring  by  the  United  States  Government  or  Lawrence  Livermore
+National Security,  LLC. The views  and opinions of  authors expressed
+herein do not necessarily state  or reflect those of the United States
+Government or Lawrence Livermore National Security, LLC, and shall not
+be used for advertising or product endorsement purposes.
+*/
+
+#include <silo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <std.c>
+
+#define NOBJS 6
+#define NPTS  10
+
+/* Write curve ci, whose y values all equal val, in the current dir */
+static void
+write_curve(DBfile *dbfile, int i, float val)
+{
+    float          x[NPTS], y[NPTS];
+    char           name[16];
+    int            j;
+
+    for (j = 0; j < NPTS; j++)
+    {
+        x[j] = j;
+        y[j] = val;
+    }
+    sprintf(name, "c%d", i);
+    DBPutCurve(dbfile, name, x, y, DB_FLOAT, NPTS, 0);
+}
+
+/* Read a curve, check its last y value and check whether its description
+   had to be read from the file */
+static int
+read_curve(DBfile *dbfile, char const *objname, float val, int fromfile,
+    char const *what)
+{
+    DBcurve       *c;
+    long long      misses;
+    int            err = 0;
+
+    DBGetPDBObjectCacheStats(0, 0, 1);
+    if ((c = DBGetCurve(dbfile, objname)) == NULL)
+    {
+        fprintf(stderr, "%s: unable to read \"%s\"\n", what, objname);
+        return 1;
+    }
+    if (c->npts != NPTS || ((float *) c->y)[NPTS-1] != val)
+    {
+        fprintf(stderr, "%s: \"%s\" has wrong values\n", what, objname);
+        err = 1;
+    }
+    DBFreeCurve(c);
+    DBGetPDBObjectCacheStats(0, &misses, 1);
+    if ((misses > 0) != fromfile)
+    {
+        fprintf(stderr, "%s: \"%s\" was %sread from the file\n", what,
+            objname, fromfile ? "not " : "");
+        err = 1;
+    }
+    return err;
+}
+
+static int
+read_dom_curve(DBfile *dbfile, int i, float val, int fromfile,
+    char const *what)
+{
+    char           name[16];
+
+    sprintf(name, "/dom/c%d", i);
+    return read_curve(dbfile, name, val, fromfile, what);
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    main
+ *
+ * Purpose:     Test the PDB driver's cache of object descriptions (see
+ *              DBSetPDBObjectCacheSize). A second read of an object, also
+ *              through a relative name from another directory, must find
+ *              its description in the cache, the least recently used
+ *              description must be dropped when the cache is full, a size
+ *              of zero must turn the cache off and rewriting an object or
+ *              closing the file must drop the descriptions it invalidates.
+ *              Only the PDB driver has this cache.
+ *
+ * Return:      0 on success, 1 if any check fails
+ *-------------------------------------------------------------------------
+ */
+int
+main(int argc, char *argv[])
+{
+    int            nerrors = 0;
+    int            i, driver = DB_PDB;
+    char          *filename = "pdbcache.pdb";
+    int            show_all_errors = FALSE;
+    DBfile        *dbfile;
+
+    /* Parse command-line */
+    for (i=1; i<argc; i++) {
+        if (!strncmp(argv[i], "DB_PDB", 6)) {
+            driver = StringToDriver(argv[i]);
+        } else if (!strncmp(argv[i], "DB_", 3)) {
+            fprintf(stderr, "%s: the object cache is PDB only\n", argv[0]);
+            exit(0);
+        } else if (!strcmp(argv[i], "show-all-errors")) {
+            show_all_errors = 1;
+        } else if (argv[i][0] != '\0') {
+            fprintf(stderr, "%s: ignored argument `%s'\n", argv[0], argv[i]);
+        }
+    }
+
+    DBShowErrors(show_all_errors?DB_ALL_AND_DRVR:DB_TOP, NULL);
+
+    dbfile = DBCreate(filename, DB_CLOBBER, DB_LOCAL, "PDB object cache test",
+        driver);
+    if (dbfile == NULL)
+        exit(1);
+    DBMkDir(dbfile, "dom");
+    DBSetDir(dbfile, "dom");
+    for (i = 0; i < NOBJS; i++)
+        write_curve(dbfile, i, (float) i);
+    DBSetDir(dbfile, "/");
+
+    /* A second read, by absolute or relative name, is a hit */
+    DBSetPDBObjectCacheSize(4);
+    nerrors += read_dom_curve(dbfile, 0, 0, 1, "cache hit");
+    nerrors += read_dom_curve(dbfile, 0, 0, 0, "cache hit");
+    DBSetDir(dbfile, "dom");
+    nerrors += read_curve(dbfile, "c0", 0, 0, "cache hit");
+    DBSetDir(dbfile, "/");
+
+    /* With room for 4, the least recently used description goes */
+    for (i = 1; i < 4; i++)
+        nerrors += read_dom_curve(dbfile, i, (float) i, 1, "eviction");
+    nerrors += read_dom_curve(dbfile, 0, 0, 0, "eviction");
+    nerrors += read_dom_curve(dbfile, 4, 4, 1, "eviction"); /* drops c1 */
+    nerrors += read_dom_curve(dbfile, 1, 1, 1, "eviction"); /* drops c2 */
+    nerrors += read_dom_curve(dbfile, 3, 3, 0, "eviction");
+    nerrors += read_dom_curve(dbfile, 2, 2, 1, "eviction");
+
+    /* Size zero turns the cache off */
+    DBSetPDBObjectCacheSize(0);
+    nerrors += read_dom_curve(dbfile, 5, 5, 1, "no cache");
+    nerrors += read_dom_curve(dbfile, 5, 5, 1, "no cache");
+
+    /* Rewriting an object drops its description */
+    DBSetPDBObjectCacheSize(4);
+    nerrors += read_dom_curve(dbfile, 5, 5, 1, "rewrite");
+    nerrors += read_dom_curve(dbfile, 5, 5, 0, "rewrite");
+    DBSetAllowOverwrites(1);
+    DBSetDir(dbfile, "dom");
+    write_curve(dbfile, 5, 50);
+    DBSetDir(dbfile, "/");
+    DBSetAllowOverwrites(0);
+    nerrors += read_dom_curve(dbfile, 5, 50, 1, "rewrite");
+
+    /* Closing the file drops all of its descriptions */
+    DBClose(dbfile);
+    if ((dbfile = DBOpen(filename, driver, DB_READ)) == NULL)
+        exit(1);
+    nerrors += read_dom_curve(dbfile, 5, 50, 1, "DBClose");
+    nerrors += read_dom_curve(dbfile, 5, 50, 0, "DBClose");
+    DBClose(dbfile);
+
+    CleanupDriverStuff();
+    return nerrors > 0;
+}
@@ -0,0 +1,307 @@
+/*
+Copyright (C) 1994-2016 Lawrence Livermore National Security, LLC.
+LLNL-CODE-425250.
+All rights reserved.
+
+This file is part of Silo. For details, see silo.llnl.gov.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+   * Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the disclaimer below.
+   * Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the disclaimer (as noted
+     below) in the documentation and/or other materials provided with
+     the distribution.
+   * Neither the name of the LLNS/LLNL nor the names of its
+     contributors may be used to endorse or promote products derived
+     from this software without specific prior written permission.
+
+THIS SOFTWARE  IS PROVIDED BY  THE COPYRIGHT HOLDERS  AND CONTRIBUTORS
+"AS  IS" AND  ANY EXPRESS  OR IMPLIED  WARRANTIES, INCLUDING,  BUT NOT
+LIMITED TO, THE IMPLIED  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A  PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN  NO  EVENT SHALL  LAWRENCE
+LIVERMORE  NATIONAL SECURITY, LLC,  THE U.S.  DEPARTMENT OF  ENERGY OR
+CONTRIBUTORS BE LIABLE FOR  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR  CONSEQUENTIAL DAMAGES  (INCLUDING, BUT NOT  LIMITED TO,
+PROCUREMENT OF  SUBSTITUTE GOODS  OR SERVICES; LOSS  OF USE,  DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER  IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING
+NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT  OF THE USE  OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This work was produced at Lawrence Livermore National Laboratory under
+Contract No.  DE-AC52-07NA27344 with the DOE.
+
+Neither the  United States Government nor  Lawrence Livermore National
+Security, LLC nor any of  their employees, makes any warranty, express
+or  implied,  or  assumes  any  liability or  responsibility  for  the
+accuracy, completeness,  or usefulness of  any information, apparatus,
+product, or  process disclosed, or  represents that its use  would not
+infringe privately-owned rights.
+
+Any reference herein to  any specific commercial products, process, or
+services by trade name,  trademark, manufacturer or otherwise does not
+necessarily  constitute or imply  its endorsement,  recommendation, or
+favoring  by  the  United  States  Government  or  Lawrence  Livermore
+National Security,  LLC. The views  and opinions of  authors expressed
+herein do not necessarily state  or reflect those of the United States
+Government or Lawrence Livermore National Security, LLC, and shall not
+be used for advertising or product endorsement purposes.
+*/
+
+/*
+ * Time reading numeric arrays from PDB files written in big endian and
+ * little endian IEEE formats, as doubles, floats and ints, with and without
+ * narrowing or widening to the other floating point type. The arrays read
+ * are checked against what was written. Narrowing of doubles too small for
+ * a float is checked against the generic conversion.
+ *
+ *     pdbconvperf [nvals] [nreps]
+ */
+
+#include <lite_pdb.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static double
+seconds(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec * 1.0e-6;
+}
+
+static int
+write_file(char const *name, data_standard *std, data_alignment *align,
+    long n)
+{
+    PDBfile *pdb;
+    double *d = (double *) malloc(n * sizeof(double));
+    float *f = (float *) malloc(n * sizeof(float));
+    int *ival = (int *) malloc(n * sizeof(int));
+    char dims[64];
+    long i;
+
+    /* values exact as floats and small enough for 2 byte ints, which
+       some of the formats have */
+    for (i = 0; i < n; i++)
+    {
+        d[i] = (i % 4096 - 2048) * 0.125;
+        f[i] = (float) d[i];
+        ival[i] = (int) (i % 30000 - 15000);
+    }
+
+    PD_target(std, align);
+    if ((pdb = PD_create((char *) name)) == 0)
+    {
+        fprintf(stderr, "cannot create \"%s\"\n", name);
+        return 1;
+    }
+    sprintf(dims, "[%ld]", n);
+    {
+        char dname[80], fname[80], iname[80];
+        sprintf(dname, "d%s", dims);
+        sprintf(fname, "f%s", dims);
+        sprintf(iname, "i%s", dims);
+        PD_write(pdb, dname, "double", d);
+        PD_write(pdb, fname, "float", f);
+        PD_write(pdb, iname, "integer", ival);
+    }
+    PD_close(pdb);
+
+    free(d);
+    free(f);
+    free(ival);
+    return 0;
+}
+
+static double
+value_at(char const *memtype, char const *buf, long i)
+{
+    if (!strcmp(memtype, "double")) return ((double const *) buf)[i];
+    if (!strcmp(memtype, "float")) return ((float const *) buf)[i];
+    if (!strcmp(memtype, "long")) return (double) ((long const *) buf)[i];
+    return ((int const *) buf)[i];
+}
+
+static int
+time_read(PDBfile *pdb, char const *label, char *var, char *memtype,
+    int convert, long n, int nreps)
+{
+    size_t size = !strcmp(memtype, "double") ? sizeof(double) :
+                  !strcmp(memtype, "float") ? sizeof(float) :
+                  !strcmp(memtype, "long") ? sizeof(long) : sizeof(int);
+    char *buf = (char *) malloc(n * size);
+    double t0, t = 0;
+    long i;
+    int rep, nerrs = 0;
+
+    for (rep = 0; rep < nreps; rep++)
+    {
+        memset(buf, 0, n * size);
+        t0 = seconds();
+        if (convert ? !PD_read_as(pdb, var, memtype, buf) : !PD_read(pdb, var, buf))
+        {
+            fprintf(stderr, "%s: read failed\n", label);
+            free(buf);
+            return 1;
+        }
+        t += seconds() - t0;
+    }
+
+    for (i = 0; i < n && nerrs == 0; i++)
+    {
+        double expected = var[0] == 'i' ? (double) (i % 30000 - 15000) :
+                          (i % 4096 - 2048) * 0.125;
+        if (value_at(memtype, buf, i) != expected)
+        {
+            fprintf(stderr, "%s: value %ld is %g, expected %g\n", label, i,
+                value_at(memtype, buf, i), expected);
+            nerrs++;
+        }
+    }
+
+    printf("    %-18s %8.1f MB/s\n", label,
+        (double) n * size * nreps / (1 << 20) / (t > 0 ? t : 1.0e-9));
+    free(buf);
+    return nerrs;
+}
+
+/* Store the IEEE bit pattern BITS, NB bytes long, in the byte order ORD */
+static void
+put_bits(unsigned char *buf, unsigned long long bits, int nb, int const *ord)
+{
+    int j;
+    for (j = 0; j < nb; j++)
+        buf[j] = (unsigned char) (bits >> 8 * (nb - ord[j]));
+}
+
+/* Inverse of put_bits */
+static unsigned long long
+get_bits(unsigned char const *buf, int nb, int const *ord)
+{
+    unsigned long long bits = 0;
+    int j;
+    for (j = 0; j < nb; j++)
+        bits |= (unsigned long long) buf[j] << 8 * (nb - ord[j]);
+    return bits;
+}
+
+/*
+ * Narrow doubles near and below the bottom of the float range, including
+ * double denormals, with the IEEE fast path and with the generic
+ * conversion, which is forced by asking for the float bytes in an order
+ * the fast path does not handle. Both must agree and anything smaller than
+ * FLT_MIN must become a 0 of the same sign.
+ */
+static int
+check_denormals(char const *label, data_standard *std)
+{
+    static unsigned long long const vals[] = {
+        0x0000000000000000ULL,  /* 0 */
+        0x8000000000000000ULL,  /* -0 */
+        0x0000000000000001ULL,  /* smallest double denormal */
+        0x800FFFFFFFFFFFFFULL,  /* largest negative double denormal */
+        0x0010000000000000ULL,  /* DBL_MIN */
+        0x36A0000000000000ULL,  /* 2^-149, smallest float denormal */
+        0xB7D0000000000000ULL,  /* -2^-130 */
+        0x3808000000000000ULL,  /* 1.5 * 2^-127, float exponent 0 */
+        0xB80FFFFFFFFFFFFFULL,  /* just above -2^-126 */
+        0x3810000000000000ULL,  /* FLT_MIN */
+        0x3810000020000000ULL,  /* FLT_MIN plus one float ulp */
+        0x3FF0000000000000ULL,  /* 1 */
+        0xC004000000000000ULL,  /* -2.5 */
+        0x47EFFFFFE0000000ULL,  /* FLT_MAX */
+        0xC7F0000000000000ULL   /* -2^128, too large for a float */
+    };
+    enum { NV = sizeof(vals) / sizeof(vals[0]) };
+    static int const swapped[] = {2, 1, 4, 3};
+    static int const one = 1;
+    unsigned char in[8 * NV], fast[4 * NV], slow[4 * NV];
+    char *pin, *pout;
+    int l_order = *(char const *) &one ? REVERSE_ORDER : NORMAL_ORDER;
+    int i, nerrs = 0;
+
+    for (i = 0; i < NV; i++)
+        put_bits(in + 8 * i, vals[i], 8, std->double_order);
+
+    pin = (char *) in;
+    pout = (char *) fast;
+    _lite_PD_fconvert(&pout, &pin, NV, 0, std->double_format,
+        std->double_order, std->float_format, std->float_order,
+        l_order, (int) sizeof(long), 0);
+
+    pin = (char *) in;
+    pout = (char *) slow;
+    _lite_PD_fconvert(&pout, &pin, NV, 0, std->double_format,
+        std->double_order, std->float_format, (int *) swapped,
+        l_order, (int) sizeof(long), 0);
+
+    for (i = 0; i < NV; i++)
+    {
+        unsigned long long f = get_bits(fast + 4 * i, 4, std->float_order);
+        unsigned long long g = get_bits(slow + 4 * i, 4, swapped);
+        unsigned long long sign = (vals[i] >> 32) & 0x80000000ULL;
+        int tiny = (vals[i] & 0x7FFFFFFFFFFFFFFFULL) < 0x3810000000000000ULL;
+
+        if (f != g || (tiny && f != sign))
+        {
+            fprintf(stderr, "%s: 0x%016llx became 0x%08llx, generic "
+                "0x%08llx\n", label, vals[i], f, g);
+            nerrs++;
+        }
+    }
+
+    return nerrs;
+}
+
+int
+main(int argc, char *argv[])
+{
+    static struct {
+        char const *name;
+        data_standard *std;
+        data_alignment *align;
+    } fmts[] = {
+        {"big endian",    &lite_IEEEA_STD,  &lite_M68000_ALIGNMENT},
+        {"little endian", &lite_INTELA_STD, &lite_INTELA_ALIGNMENT}
+    };
+    long n = argc > 1 ? atol(argv[1]) : 1 << 22;
+    int nreps = argc > 2 ? atoi(argv[2]) : 5;
+    int k, nerrs = 0;
+
+    for (k = 0; k < (int) (sizeof(fmts) / sizeof(fmts[0])); k++)
+    {
+        char const *filename = "pdbconvperf.pdb";
+        PDBfile *pdb;
+
+        if (write_file(filename, fmts[k].std, fmts[k].align, n))
+            return 1;
+        if ((pdb = PD_open((char *) filename, "r")) == 0)
+        {
+            fprintf(stderr, "cannot open \"%s\"\n", filename);
+            return 1;
+        }
+
+        printf("%s, %ld values\n", fmts[k].name, n);
+        nerrs += time_read(pdb, "double", "d", "double", 0, n, nreps);
+        nerrs += time_read(pdb, "double as float", "d", "float", 1, n, nreps);
+        nerrs += time_read(pdb, "float", "f", "float", 0, n, nreps);
+        nerrs += time_read(pdb, "float as double", "f", "double", 1, n, nreps);
+        nerrs += time_read(pdb, "int", "i", "integer", 0, n, nreps);
+        nerrs += time_read(pdb, "int as long", "i", "long", 1, n, nreps);
+        nerrs += check_denormals(fmts[k].name, fmts[k].std);
+
+        PD_close(pdb);
+        unlink(filename);
+    }
+
+    return nerrs != 0;
+}
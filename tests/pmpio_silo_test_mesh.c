@@ -117,6 +117,80 @@ static void CloseSiloFile(void *file, void *userData)
         DBClose(siloFile);
 }
 
+/*-----------------------------------------------------------------------------
+ * Purpose:     Impliment the create image callback for aggregating pmpio
+ *              Will create an in-memory HDF5 file using the core VFD with no
+ *              backing store and the directory (namespace) in it.
+ *-----------------------------------------------------------------------------
+ */
+static void *CreateSiloImage(const char *nsname, void *userData)
+{
+    int vfd = DB_H5VFD_CORE, on = 1, optset;
+    DBoptlist *opts = DBMakeOptlist(2);
+    DBfile *siloFile;
+
+    DBAddOption(opts, DBOPT_H5_VFD, &vfd);
+    DBAddOption(opts, DBOPT_H5_CORE_NO_BACK_STORE, &on);
+    optset = DBRegisterFileOptionsSet(opts);
+    siloFile = DBCreate(nsname, DB_CLOBBER, DB_LOCAL, "pmpio testing", DB_HDF5_OPTS(optset));
+    DBUnregisterFileOptionsSet(optset);
+    DBFreeOptlist(opts);
+    if (siloFile && nsname)
+    {
+        DBMkDir(siloFile, nsname);
+        DBSetDir(siloFile, nsname);
+    }
+    return (void *) siloFile;
+}
+
+/*-----------------------------------------------------------------------------
+ * Purpose:     Impliment the close image callback for aggregating pmpio
+ *-----------------------------------------------------------------------------
+ */
+static void *CloseSiloImage(void *file, size_t *size, void *userData)
+{
+    DBfile *siloFile = (DBfile *) file;
+    void *image = 0;
+    if (siloFile)
+    {
+        if (DBGetFileImage(siloFile, &image, size) < 0)
+            image = 0;
+        DBClose(siloFile);
+    }
+    return image;
+}
+
+/*-----------------------------------------------------------------------------
+ * Purpose:     Impliment the splice image callback for aggregating pmpio
+ *              Opens the image with the FIC VFD and copies its directory
+ *              (namespace) into the root of the shared file. The FIC VFD
+ *              takes ownership of the image and frees it. DBCpDir, though
+ *              deprecated, copies with HDF5 itself and so misses nothing.
+ *-----------------------------------------------------------------------------
+ */
+static void SpliceSiloImage(void *file, const char *nsname, void *image,
+    size_t size, void *userData)
+{
+    int vfd = DB_H5VFD_FIC, isize = (int) size, optset, dw;
+    DBoptlist *opts = DBMakeOptlist(3);
+    DBfile *imageFile;
+
+    DBAddOption(opts, DBOPT_H5_VFD, &vfd);
+    DBAddOption(opts, DBOPT_H5_FIC_SIZE, &isize);
+    DBAddOption(opts, DBOPT_H5_FIC_BUF, image);
+    optset = DBRegisterFileOptionsSet(opts);
+    imageFile = DBOpen(nsname, DB_HDF5_OPTS(optset), DB_READ);
+    if (imageFile)
+    {
+        dw = DBSetDeprecateWarnings(0);
+        DBCpDir(imageFile, nsname, (DBfile *) file, DBSPrintf("/%s", nsname));
+        DBSetDeprecateWarnings(dw);
+        DBClose(imageFile);
+    }
+    DBUnregisterFileOptionsSet(optset);
+    DBFreeOptlist(opts);
+}
+
 /*-----------------------------------------------------------------------------
  * Purpose:     Broadcast relevant bits of multi-block object (for read)
  *-----------------------------------------------------------------------------
@@ -397,6 +471,7 @@ static int ReadSiloWithoutPMPIO(char const *fname, int driver)
  *     use-ns means to use nameschemes instead of explicitly listed names.
  *     separate-root means to create multi-block objects in sep. file
  *     separate-block-dir means to put block-level files in sep. directory.
+ *     aggregate means to use PMPIO_InitAggregate (DB_HDF5 only).
  *     <root-filename> means to exercise a read scenario.
  *     <driver-spec> means to use the specified Silo driver.
  *
@@ -417,6 +492,7 @@ int main(int argc, char **argv)
     int separate_root = 0;
     int separate_block_dir = 0;
     int do_read = 0;
+    int aggregate = 0;
     DBfile *siloFile;
     char *file_ext = "pdb";
     char fileName[256], nsName[256];
@@ -443,6 +519,10 @@ int main(int argc, char **argv)
             separate_block_dir = 1;
             separate_root = 1;
         }
+        else if (!strcmp(argv[i], "aggregate"))
+        {
+            aggregate = 1;
+        }
         else if (!strcmp(argv[i], "DB_HDF5"))
         {
             driver = DB_HDF5;
@@ -506,9 +586,14 @@ int main(int argc, char **argv)
         assert(!chdir("silo_block_dir"));
 
     /* Initialize PMPIO, pass a pointer to the driver type as the
-       user data. */
-    bat = PMPIO_Init(numGroups, PMPIO_WRITE, MPI_COMM_WORLD, 1,
-        CreateSiloFile, OpenSiloFile, CloseSiloFile, &driver);
+       user data. In-memory images are supported only by the HDF5 driver. */
+    if (aggregate && driver == DB_HDF5)
+        bat = PMPIO_InitAggregate(numGroups, MPI_COMM_WORLD, 1,
+            CreateSiloFile, CloseSiloFile,
+            CreateSiloImage, CloseSiloImage, SpliceSiloImage, &driver);
+    else
+        bat = PMPIO_Init(numGroups, PMPIO_WRITE, MPI_COMM_WORLD, 1,
+            CreateSiloFile, OpenSiloFile, CloseSiloFile, &driver);
 
     /* Construct names for the silo files and the directories in them */
     sprintf(fileName, "silo_%03d.%s", PMPIO_GroupRank(bat, rank), file_ext);
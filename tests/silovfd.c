@@ -0,0 +1,243 @@
+/*
+Copyright (C) 1994-2016 Lawrence Livermore National Security, LLC.
+LLNL-CODE-425250.
+All rights reserved.
+
+This file is part of Silo. For details, see silo.llnl.gov.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+   * Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the disclaimer below.
+   * Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the disclaimer (as noted
+     below) in the documentation and/or other materials provided with
+     the distribution.
+   * Neither the name of the LLNS/LLNL nor the names of its
+     contributors may be used to endorse or promote products derived
+     from this software without specific prior written permission.
+
+THIS SOFTWARE  IS PROVIDED BY  THE COPYRIGHT HOLDERS  AND CONTRIBUTORS
+"AS  IS" AND  ANY EXPRESS  OR IMPLIED  WARRANTIES, INCLUDING,  BUT NOT
+LIMITED TO, THE IMPLIED  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A  PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN  NO  EVENT SHALL  LAWRENCE
+LIVERMORE  NATIONAL SECURITY, LLC,  THE U.S.  DEPARTMENT OF  ENERGY OR
+CONTRIBUTORS BE LIABLE FOR  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR  CONSEQUENTIAL DAMAGES  (INCLUDING, BUT NOT  LIMITED TO,
+PROCUREMENT OF  SUBSTITUTE GOODS  OR SERVICES; LOSS  OF USE,  DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER  IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING
+NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT  OF THE USE  OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This work was produced at Lawrence Livermore National Laboratory under
+Contract No.  DE-AC52-07NA27344 with the DOE.
+
+Neither the  United States Government nor  Lawrence Livermore National
+Security, LLC nor any of  their employees, makes any warranty, express
+or  implied,  or  assumes  any  liability or  responsibility  for  the
+accuracy, completeness,  or usefulness of  any information, apparatus,
+product, or  process disclosed, or  represents that its use  would not
+infringe privately-owned rights.
+
+Any reference herein to  any specific commercial products, process, or
+services by trade name,  trademark, manufacturer or otherwise does not
+necessarily  constitute or imply  its endorsement,  recommendation, or
+favoring  by  the  United  States  Government  or  Lawrence  Livermore
+National Security,  LLC. The views  and opinions of  authors expressed
+herein do not necessarily state  or reflect those of the United States
+Government or Lawrence Livermore National Security, LLC, and shall not
+be used for advertising or product endorsement purposes.
+*/
+
+#include <silo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <config.h>
+
+#include <std.c>
+
+#define NVARS 8
+#define NX    64
+#define NY    48
+
+#define VALUE(V,I) ((V) * 100000.0 + (I))
+
+/* Write a quad mesh and NVARS double node variables on it */
+static int
+write_file(char const *filename, int driver)
+{
+    float          x[NX], y[NY];
+    float         *coords[2];
+    double        *vals;
+    int            dims[2] = {NX, NY};
+    int            i, v;
+    DBfile        *dbfile;
+
+    dbfile = DBCreate(filename, DB_CLOBBER, DB_LOCAL, "silo VFD test", driver);
+    if (dbfile == NULL)
+    {
+        fprintf(stderr, "unable to create \"%s\"\n", filename);
+        return 1;
+    }
+
+    coords[0] = x;
+    coords[1] = y;
+    for (i = 0; i < NX; i++) x[i] = i;
+    for (i = 0; i < NY; i++) y[i] = i;
+    DBPutQuadmesh(dbfile, "mesh", 0, coords, dims, 2, DB_FLOAT, DB_COLLINEAR, 0);
+
+    vals = (double *) malloc(NX*NY*sizeof(double));
+    for (v = 0; v < NVARS; v++)
+    {
+        char vname[16];
+
+        sprintf(vname, "v%d", v);
+        for (i = 0; i < NX*NY; i++)
+            vals[i] = VALUE(v, i);
+        DBPutQuadvar1(dbfile, vname, "mesh", vals, dims, 2, 0, 0, DB_DOUBLE,
+            DB_NODECENT, 0);
+    }
+    free(vals);
+
+    DBClose(dbfile);
+    return 0;
+}
+
+/* Read the variables back and count those with wrong values */
+static int
+read_file(char const *filename, int driver, char const *how)
+{
+    DBfile        *dbfile;
+    int            i, v, nerrors = 0;
+
+    if ((dbfile = DBOpen(filename, driver, DB_READ)) == NULL)
+    {
+        fprintf(stderr, "%s: unable to open \"%s\"\n", how, filename);
+        return 1;
+    }
+    for (v = 0; v < NVARS; v++)
+    {
+        char vname[16];
+        DBquadvar *qv;
+
+        sprintf(vname, "v%d", v);
+        if ((qv = DBGetQuadvar(dbfile, vname)) == NULL)
+        {
+            fprintf(stderr, "%s: unable to read \"%s\"\n", how, vname);
+            nerrors++;
+            continue;
+        }
+        for (i = 0; i < NX*NY; i++)
+        {
+            if (((double *) qv->vals[0])[i] != VALUE(v, i))
+            {
+                fprintf(stderr, "%s: \"%s\" has wrong values\n", how, vname);
+                nerrors++;
+                break;
+            }
+        }
+        DBFreeQuadvar(qv);
+    }
+    DBClose(dbfile);
+    return nerrors;
+}
+
+/* Return the count on the line of the VFD stats log that starts with what */
+static long long
+log_count(char const *logname, char const *what)
+{
+    char           line[256];
+    long long      n = -1;
+    FILE          *logf;
+
+    if ((logf = fopen(logname, "r")) == NULL)
+        return -1;
+    while (fgets(line, sizeof(line), logf))
+    {
+        if (!strncmp(line, what, strlen(what)) && line[strlen(what)] == ' ')
+        {
+            sscanf(line + strlen(what), " = %lld", &n);
+            break;
+        }
+    }
+    fclose(logf);
+    return n;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    main
+ *
+ * Purpose:     Test the block cache of the silo VFD. A file is written
+ *              through a cache of 4 blocks of 4K, far less than one of
+ *              its variables, so dirty blocks are evicted as the writes
+ *              go and runs of contiguous dirty blocks are written
+ *              together. The stats log written on close must show
+ *              evictions and, where pwritev is available, multi-block
+ *              writes. Every value must read back unchanged through the
+ *              silo VFD and through HDF5's default driver.
+ *
+ * Return:      0 on success, 1 if any check fails
+ *-------------------------------------------------------------------------
+ */
+int
+main(int argc, char *argv[])
+{
+    int            nerrors = 0;
+    int            i, driver;
+    char          *filename = "silovfd.h5";
+    char          *logname = "silovfd.h5-h5-vfd-log";
+    int            show_all_errors = FALSE;
+
+    /* Parse command-line */
+    for (i=1; i<argc; i++) {
+        if (!strncmp(argv[i], "DB_HDF5", 7)) {
+            /* the VFD is chosen below */
+        } else if (!strncmp(argv[i], "DB_", 3)) {
+            fprintf(stderr, "%s: the silo VFD is HDF5 only\n", argv[0]);
+            exit(0);
+        } else if (!strcmp(argv[i], "show-all-errors")) {
+            show_all_errors = 1;
+        } else if (argv[i][0] != '\0') {
+            fprintf(stderr, "%s: ignored argument `%s'\n", argv[0], argv[i]);
+        }
+    }
+
+    DBShowErrors(show_all_errors?DB_ALL_AND_DRVR:DB_TOP, NULL);
+
+    driver = StringToDriver("DB_HDF5_OPTS(DBOPT_H5_VFD=DB_H5VFD_SILO,"
+        "DBOPT_H5_SILO_BLOCK_SIZE=4096,DBOPT_H5_SILO_BLOCK_COUNT=4,"
+        "DBOPT_H5_SILO_LOG_STATS=1)");
+    remove(logname);
+    if (write_file(filename, driver))
+        exit(1);
+
+    if (log_count(logname, "number of block cache evictions") <= 0)
+    {
+        fprintf(stderr, "no dirty blocks were evicted\n");
+        nerrors++;
+    }
+#ifdef HAVE_PWRITEV
+    if (log_count(logname, "number of multi-block writes") <= 0)
+    {
+        fprintf(stderr, "no contiguous dirty blocks were written together\n");
+        nerrors++;
+    }
+    else if (log_count(logname, "number of blocks in multi-block writes") <=
+             log_count(logname, "number of multi-block writes"))
+    {
+        fprintf(stderr, "multi-block writes hold less than 2 blocks each\n");
+        nerrors++;
+    }
+#endif
+
+    nerrors += read_file(filename, driver, "silo VFD");
+    nerrors += read_file(filename, DB_HDF5, "default VFD");
+
+    CleanupDriverStuff();
+    return nerrors > 0;
+}
@@ -217,6 +217,9 @@ static int StringToDriver(const char *str)
             CHECK_SYMBOLN_INT(DBOPT_H5_SILO_BLOCK_COUNT)
             CHECK_SYMBOLN_INT(DBOPT_H5_SILO_LOG_STATS)
             CHECK_SYMBOLN_INT(DBOPT_H5_SILO_USE_DIRECT)
+            CHECK_SYMBOLN_INT(DBOPT_H5_SILO_WRITE_BEHIND)
+            CHECK_SYMBOLN_INT(DBOPT_H5_SILO_READ_AHEAD)
+            CHECK_SYMBOLN_INT(DBOPT_H5_SILO_META_AT_END)
             CHECK_SYMBOLN_STR(DB_FILE_OPTS_H5_DEFAULT_DEFAULT)
             CHECK_SYMBOLN_STR(DB_FILE_OPTS_H5_DEFAULT_SEC2)
             CHECK_SYMBOLN_STR(DB_FILE_OPTS_H5_DEFAULT_STDIO)
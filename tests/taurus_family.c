@@ -0,0 +1,292 @@
+/*
+Copyright (C) 1994-2016 Lawrence Livermore National Security, LLC.
+LLNL-CODE-425250.
+All rights reserved.
+
+This file is part of Silo. For details, see silo.llnl.gov.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+   * Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the disclaimer below.
+   * Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the disclaimer (as noted
+     below) in the documentation and/or other materials provided with
+     the distribution.
+   * Neither the name of the LLNS/LLNL nor the names of its
+     contributors may be used to endorse or promote products derived
+     from this software without specific prior written permission.
+
+THIS SOFTWARE  IS PROVIDED BY  THE COPYRIGHT HOLDERS  AND CONTRIBUTORS
+"AS  IS" AND  ANY EXPRESS  OR IMPLIED  WARRANTIES, INCLUDING,  BUT NOT
+LIMITED TO, THE IMPLIED  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A  PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN  NO  EVENT SHALL  LAWRENCE
+LIVERMORE  NATIONAL SECURITY, LLC,  THE U.S.  DEPARTMENT OF  ENERGY OR
+CONTRIBUTORS BE LIABLE FOR  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR  CONSEQUENTIAL DAMAGES  (INCLUDING, BUT NOT  LIMITED TO,
+PROCUREMENT OF  SUBSTITUTE GOODS  OR SERVICES; LOSS  OF USE,  DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER  IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING
+NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT  OF THE USE  OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This work was produced at Lawrence Livermore National Laboratory under
+Contract No.  DE-AC52-07NA27344 with the DOE.
+
+Neither the  United States Government nor  Lawrence Livermore National
+Security, LLC nor any of  their employees, makes any warranty, express
+or  implied,  or  assumes  any  liability or  responsibility  for  the
+accuracy, completeness,  or usefulness of  any information, apparatus,
+product, or  process disclosed, or  represents that its use  would not
+infringe privately-owned rights.
+
+Any reference herein to  any specific commercial products, process, or
+services by trade name,  trademark, manufacturer or otherwise does not
+necessarily  constitute or imply  its endorsement,  recommendation, or
+favoring  by  the  United  States  Government  or  Lawrence  Livermore
+National Security,  LLC. The views  and opinions of  authors expressed
+herein do not necessarily state  or reflect those of the United States
+Government or Lawrence Livermore National Security, LLC, and shall not
+be used for advertising or product endorsement purposes.
+*/
+
+#include <silo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* One hex of a dyna3d plot with coordinates and velocities in each state */
+#define NUMNP     8
+#define NDIM      3
+#define NV3D      7
+#define HDRSIZE   (64 * 4)
+#define GEOMSIZE  ((NDIM * NUMNP + 9) * 4)
+#define STATESIZE ((1 + 2 * NDIM * NUMNP + NV3D) * 4)
+
+#define VEL(S,N,C) (1000.0f * (S) + 10.0f * (N) + (C))
+
+static void
+fam_name(char const *base, int i, char *name)
+{
+    if (i == 0)
+        strcpy(name, base);
+    else
+        sprintf(name, "%s%02d", base, i);
+}
+
+/* Header and geometry of a family: one hex on the unit cube */
+static void
+make_header(char *buf)
+{
+    int           *ibuf = (int *) buf;
+    float         *coords = (float *) (buf + HDRSIZE);
+    int           *hex = (int *) (buf + HDRSIZE + NDIM * NUMNP * 4);
+    int            i;
+
+    memset(buf, 0, HDRSIZE + GEOMSIZE);
+    memcpy(buf, "taurus family test", 18);
+    ibuf[15 + 0] = 4;           /* 3d, unpacked node list */
+    ibuf[15 + 1] = NUMNP;
+    ibuf[15 + 2] = 2;           /* dyna3d */
+    ibuf[15 + 5] = 1;           /* current geometry */
+    ibuf[15 + 6] = 1;           /* velocities */
+    ibuf[15 + 8] = 1;           /* one hex */
+    ibuf[15 + 9] = 1;
+    ibuf[15 + 12] = NV3D;
+    for (i = 0; i < NUMNP; i++)
+    {
+        coords[i*NDIM+0] = (float) (i & 1);
+        coords[i*NDIM+1] = (float) ((i >> 1) & 1);
+        coords[i*NDIM+2] = (float) ((i >> 2) & 1);
+        hex[i] = i + 1;
+    }
+    hex[8] = 1;                 /* material */
+}
+
+/* One state: time, coordinates, velocities and the hex values */
+static void
+make_state(char *buf, int state)
+{
+    float         *fbuf = (float *) buf;
+    int            i, j;
+
+    memset(buf, 0, STATESIZE);
+    fbuf[0] = 0.5f * state;
+    for (i = 0; i < NUMNP; i++)
+    {
+        for (j = 0; j < NDIM; j++)
+        {
+            fbuf[1 + i*NDIM + j] = (float) ((i >> j) & 1);
+            fbuf[1 + NDIM*NUMNP + i*NDIM + j] = VEL(state, i, j);
+        }
+    }
+}
+
+static int
+write_member(char const *base, int i, char const *buf, int len)
+{
+    char           name[64];
+    FILE          *f;
+    int            err;
+
+    fam_name(base, i, name);
+    if ((f = fopen(name, "wb")) == NULL)
+        return 1;
+    err = fwrite(buf, 1, len, f) != (size_t) len;
+    fclose(f);
+    return err;
+}
+
+/* Write a family and return how many states it has. The whole layout puts
+   the header, the geometry and states 0 and 1 in the first member and
+   states 2 and 3 in the second. The split layout puts the header and
+   geometry alone in the first member and each state in two halves in the
+   members after it; a state bigger than one member always starts at the
+   start of a member. */
+static int
+write_family(char const *base, int split)
+{
+    char           buf[HDRSIZE + GEOMSIZE + 2 * STATESIZE];
+    char           state[STATESIZE];
+    int            s, err = 0;
+
+    make_header(buf);
+    if (split)
+    {
+        err |= write_member(base, 0, buf, HDRSIZE + GEOMSIZE);
+        for (s = 0; s < 2; s++)
+        {
+            make_state(state, s);
+            err |= write_member(base, 1 + 2*s, state, STATESIZE / 2);
+            err |= write_member(base, 2 + 2*s, state + STATESIZE / 2,
+                STATESIZE - STATESIZE / 2);
+        }
+        return err ? -1 : 2;
+    }
+
+    make_state(buf + HDRSIZE + GEOMSIZE, 0);
+    make_state(buf + HDRSIZE + GEOMSIZE + STATESIZE, 1);
+    err |= write_member(base, 0, buf, sizeof(buf));
+    make_state(buf, 2);
+    make_state(buf + STATESIZE, 3);
+    err |= write_member(base, 1, buf, 2 * STATESIZE);
+    return err ? -1 : 4;
+}
+
+/* Read one velocity component of a state and check its values */
+static int
+check_vel(DBfile *dbfile, char const *base, int state, int comp)
+{
+    static char const *names[] = {"vel_x", "vel_y", "vel_z"};
+    char           dir[32];
+    DBucdvar      *uv;
+    int            i, err = 0;
+
+    sprintf(dir, "/state%02d/nodal", state);
+    if (DBSetDir(dbfile, dir) < 0 ||
+        (uv = DBGetUcdvar(dbfile, names[comp])) == NULL)
+    {
+        fprintf(stderr, "%s: unable to read %s in state %d\n", base,
+            names[comp], state);
+        return 1;
+    }
+    if (uv->nels != NUMNP)
+    {
+        fprintf(stderr, "%s: %s in state %d has %d values\n", base,
+            names[comp], state, uv->nels);
+        err = 1;
+    }
+    for (i = 0; !err && i < NUMNP; i++)
+    {
+        if (((float *) uv->vals[0])[i] != VEL(state, i, comp))
+        {
+            fprintf(stderr, "%s: %s in state %d has wrong values\n", base,
+                names[comp], state);
+            err = 1;
+        }
+    }
+    DBFreeUcdvar(uv);
+    return err;
+}
+
+/* Write a family and read every state forwards, backwards and enough
+   variables to overrun the reader's cache of recent ones */
+static int
+test_family(char const *base, int split)
+{
+    DBfile        *dbfile;
+    int            nstates, s, c, pass, nerrors = 0;
+
+    if ((nstates = write_family(base, split)) < 0)
+    {
+        fprintf(stderr, "%s: unable to write the family\n", base);
+        return 1;
+    }
+    if ((dbfile = DBOpen(base, DB_TAURUS, DB_READ)) == NULL)
+    {
+        fprintf(stderr, "%s: unable to open the family\n", base);
+        return 1;
+    }
+
+    /* Each state, read twice so the second read comes from the cache */
+    for (s = 0; s < nstates; s++)
+    {
+        nerrors += check_vel(dbfile, base, s, 0);
+        nerrors += check_vel(dbfile, base, s, 0);
+    }
+
+    /* Back across the member boundaries */
+    for (s = nstates - 1; s >= 0; s--)
+        nerrors += check_vel(dbfile, base, s, 0);
+
+    /* More variables than the cache holds, twice over */
+    for (pass = 0; pass < 2; pass++)
+        for (s = 0; s < nstates; s++)
+            for (c = 0; c < NDIM; c++)
+                nerrors += check_vel(dbfile, base, s, c);
+
+    DBClose(dbfile);
+    return nerrors;
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    main
+ *
+ * Purpose:     Test reading a Taurus plot family. Two families of one hex
+ *              are written by hand, one with two whole states in each
+ *              member and one with each state split across two members,
+ *              so that the velocities of every state straddle a member
+ *              boundary. Every read is checked against what was written.
+ *              The Taurus driver only reads, so the driver argument the
+ *              other tests take is ignored.
+ *
+ * Return:      0 on success, 1 if any check fails
+ *-------------------------------------------------------------------------
+ */
+int
+main(int argc, char *argv[])
+{
+    int            nerrors = 0;
+    int            i;
+    int            show_all_errors = FALSE;
+
+    /* Parse command-line */
+    for (i=1; i<argc; i++) {
+        if (!strncmp(argv[i], "DB_", 3)) {
+            /* ignored */
+        } else if (!strcmp(argv[i], "show-all-errors")) {
+            show_all_errors = 1;
+        } else if (argv[i][0] != '\0') {
+            fprintf(stderr, "%s: ignored argument `%s'\n", argv[0], argv[i]);
+        }
+    }
+
+    DBShowErrors(show_all_errors?DB_ALL_AND_DRVR:DB_TOP, NULL);
+
+    nerrors += test_family("taurus_whole", 0);
+    nerrors += test_family("taurus_split", 1);
+
+    return nerrors > 0;
+}
@@ -99,6 +99,142 @@ static int calc_material_object_size(DBmaterial const *mat)
     return retval;
 }
 
+/* Compare two material objects array by array */
+static int same_material(DBmaterial const *a, DBmaterial const *b)
+{
+    int i, nzones = 1;
+    int vfsize = a->datatype == DB_FLOAT ? sizeof(float) : sizeof(double);
+
+    if (a->nmat != b->nmat || a->ndims != b->ndims || a->mixlen != b->mixlen ||
+        a->datatype != b->datatype)
+        return 0;
+    for (i = 0; i < a->ndims; i++)
+    {
+        if (a->dims[i] != b->dims[i])
+            return 0;
+        nzones *= a->dims[i];
+    }
+    if (memcmp(a->matnos, b->matnos, a->nmat * sizeof(int)) ||
+        memcmp(a->matlist, b->matlist, nzones * sizeof(int)))
+        return 0;
+    if (a->mixlen > 0 &&
+        (memcmp(a->mix_mat, b->mix_mat, a->mixlen * sizeof(int)) ||
+         memcmp(a->mix_next, b->mix_next, a->mixlen * sizeof(int)) ||
+         memcmp(a->mix_zone, b->mix_zone, a->mixlen * sizeof(int)) ||
+         memcmp(a->mix_vf, b->mix_vf, a->mixlen * vfsize)))
+        return 0;
+    return 1;
+}
+
+/******************************************************************************
+ * Check DBSetMaterialCalcThreads does not change results. A material made
+ * on 1 thread from dense volume fractions over 37x27 zones (not a multiple
+ * of the 128 zone blocks) is turned back into dense arrays and then into a
+ * material again, on 1 thread and on nthreads threads. Both results must be
+ * identical, and the dense arrays must match the ones we started from.
+ *****************************************************************************/
+static int check_calc_threads(int nthreads)
+{
+    int const dims[2] = {37, 27};
+    int const nzones = 37*27;
+    int const matnos[3] = {1, 5, 7};
+    int nerrors = 0;
+    int dt, i, z;
+
+    for (dt = 0; dt < 2; dt++)
+    {
+        int datatype = dt ? DB_DOUBLE : DB_FLOAT;
+        int vfsize = dt ? sizeof(double) : sizeof(float);
+        void *vfracs[3];
+        int narrs1 = 0, narrsN = 0;
+        void **dense1 = 0, **denseN = 0;
+        DBmaterial *mat, *mat1, *matN;
+
+        /* Every 4th zone is clean; the rest mix 2 or 3 materials */
+        for (i = 0; i < 3; i++)
+            vfracs[i] = calloc(nzones, vfsize);
+        for (z = 0; z < nzones; z++)
+        {
+            double vf[3] = {0, 0, 0};
+            if (z % 4 == 0)
+                vf[z % 3] = 1;
+            else if (z % 4 == 1)
+            {
+                vf[z % 3] = 0.25;
+                vf[(z+1) % 3] = 0.75;
+            }
+            else
+            {
+                vf[0] = 0.125 * (z % 3 + 1);
+                vf[1] = 0.5;
+                vf[2] = 1 - vf[0] - vf[1];
+            }
+            for (i = 0; i < 3; i++)
+            {
+                if (dt)
+                    ((double *) vfracs[i])[z] = vf[i];
+                else
+                    ((float *) vfracs[i])[z] = (float) vf[i];
+            }
+        }
+
+        DBSetMaterialCalcThreads(1);
+        mat = DBCalcMaterialFromDenseArrays(3, 2, dims, matnos, datatype, vfracs);
+        ASSERT(mat);
+        DBCalcDenseArraysFromMaterial(mat, datatype, &narrs1, &dense1);
+        ASSERT(narrs1 == 3);
+        mat1 = DBCalcMaterialFromDenseArrays(narrs1, 2, dims, matnos, datatype, dense1);
+        ASSERT(mat1);
+
+        DBSetMaterialCalcThreads(nthreads);
+        DBCalcDenseArraysFromMaterial(mat, datatype, &narrsN, &denseN);
+        ASSERT(narrsN == 3);
+        matN = DBCalcMaterialFromDenseArrays(narrsN, 2, dims, matnos, datatype, denseN);
+        ASSERT(matN);
+        DBSetMaterialCalcThreads(1);
+
+        for (i = 0; i < 3; i++)
+        {
+            if (memcmp(dense1[i], vfracs[i], nzones * vfsize))
+            {
+                fprintf(stderr, "%s material %d: dense arrays do not round trip\n",
+                    dt ? "double" : "float", matnos[i]);
+                nerrors++;
+            }
+            if (memcmp(dense1[i], denseN[i], nzones * vfsize))
+            {
+                fprintf(stderr, "%s material %d: dense arrays differ on %d threads\n",
+                    dt ? "double" : "float", matnos[i], nthreads);
+                nerrors++;
+            }
+        }
+        if (!same_material(mat, mat1))
+        {
+            fprintf(stderr, "%s: material does not round trip\n", dt ? "double" : "float");
+            nerrors++;
+        }
+        if (!same_material(mat1, matN))
+        {
+            fprintf(stderr, "%s: material differs on %d threads\n",
+                dt ? "double" : "float", nthreads);
+            nerrors++;
+        }
+
+        for (i = 0; i < 3; i++)
+        {
+            FREE(vfracs[i]);
+            FREE(dense1[i]);
+            FREE(denseN[i]);
+        }
+        FREE(dense1);
+        FREE(denseN);
+        DBFreeMaterial(mat);
+        DBFreeMaterial(mat1);
+        DBFreeMaterial(matN);
+    }
+    return nerrors;
+}
+
 /******************************************************************************
  * Test various approaches to compressing material data.
  *
@@ -123,6 +259,10 @@ static int calc_material_object_size(DBmaterial const *mat)
  *     object represents what VisIt would 'see' after compression and
  *     decompression.
  * dense=<int> specifies whether to output dense material fractions (def=0)
+ * threads=<int> number of threads used to convert between the material
+ *     object and dense volume fractions (def=1)
+ * threadcheck=<int> instead of the above, check converting a synthetic
+ *     material on that many threads gives the same results as on 1 thread
  * driver a Silo file driver such as DB_HDF5 (default) or DB_PDB or other
  *     HDF5 variants. Note, compression works *only* with HDF5 variants.
  *
@@ -171,6 +311,7 @@ main(int argc, char *argv[])
     int             narrs = 0;
     void          **vfracs = 0;
     char          **vfrac_varnames = 0;
+    int             threadcheck = 0;
 
     /* Parse command-line */
     for (i=1; i<argc; i++) {
@@ -205,6 +346,10 @@ main(int argc, char *argv[])
             outputDense = 1;
         } else if (!strncmp(argv[i], "dense=", 6)) {
             outputDense = (int) strtol(argv[i]+6,0,10);
+        } else if (!strncmp(argv[i], "threads=", 8)) {
+            DBSetMaterialCalcThreads((int) strtol(argv[i]+8,0,10));
+        } else if (!strncmp(argv[i], "threadcheck=", 12)) {
+            threadcheck = (int) strtol(argv[i]+12,0,10);
         } else if (!strncmp(argv[i], "compress=", 9)) {
             DBSetCompression(argv[i]+9);
 	} else if (argv[i][0] != '\0') {
@@ -212,6 +357,14 @@ main(int argc, char *argv[])
 	}
     }
 
+    if (threadcheck > 0)
+    {
+        int nerrors = check_calc_threads(threadcheck);
+        DBFreeOptlist(mat_opts);
+        CleanupDriverStuff();
+        return nerrors ? 1 : 0;
+    }
+
     if (!ifileSet) tmcERROR(("input file and material object path not specified"));
     if (!ofileSet) tmcERROR(("output file and material object path not specified"));
 
@@ -0,0 +1,267 @@
+/*
+Copyright (C) 1994-2016 Lawrence Livermore National Security, LLC.
+LLNL-CODE-425250.
+All rights reserved.
+
+This file is part of Silo. For details, see silo.llnl.gov.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+   * Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the disclaimer below.
+   * Redistributions in binary form must reproduce the above copyright
+     notice, this list of conditions and the disclaimer (as noted
+     below) in the documentation and/or other materials provided with
+     the distribution.
+   * Neither the name of the LLNS/LLNL nor the names of its
+     contributors may be used to endorse or promote products derived
+     from this software without specific prior written permission.
+
+THIS SOFTWARE  IS PROVIDED BY  THE COPYRIGHT HOLDERS  AND CONTRIBUTORS
+"AS  IS" AND  ANY EXPRESS  OR IMPLIED  WARRANTIES, INCLUDING,  BUT NOT
+LIMITED TO, THE IMPLIED  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A  PARTICULAR  PURPOSE ARE  DISCLAIMED.  IN  NO  EVENT SHALL  LAWRENCE
+LIVERMORE  NATIONAL SECURITY, LLC,  THE U.S.  DEPARTMENT OF  ENERGY OR
+CONTRIBUTORS BE LIABLE FOR  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR  CONSEQUENTIAL DAMAGES  (INCLUDING, BUT NOT  LIMITED TO,
+PROCUREMENT OF  SUBSTITUTE GOODS  OR SERVICES; LOSS  OF USE,  DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+LIABILITY, WHETHER  IN CONTRACT, STRICT LIABILITY,  OR TORT (INCLUDING
+NEGLIGENCE OR  OTHERWISE) ARISING IN  ANY WAY OUT  OF THE USE  OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+This work was produced at Lawrence Livermore National Laboratory under
+Contract No.  DE-AC52-07NA27344 with the DOE.
+
+Neither the  United States Government nor  Lawrence Livermore National
+Security, LLC nor any of  their employees, makes any warranty, express
+or  implied,  or  assumes  any  liability or  responsibility  for  the
+accuracy, completeness,  or usefulness of  any information, apparatus,
+product, or  process disclosed, or  represents that its use  would not
+infringe privately-owned rights.
+
+Any reference herein to  any specific commercial products, process, or
+services by trade name,  trademark, manufacturer or otherwise does not
+necessarily  constitute or imply  its endorsement,  recommendation, or
+favoring  by  the  United  States  Government  or  Lawrence  Livermore
+National Security,  LLC. The views  and opinions of  authors expressed
+herein do not necessarily state  or reflect those of the United States
+Government or Lawrence Livermore National Security, LLC, and shall not
+be used for advertising or product endorsement purposes.
+*/
+/*
+ * Purpose:     Tests a thread-safe build of the library. Several threads
+ *              each open and read their own file. The library serializes
+ *              their calls, so only the work between calls overlaps. Some
+ *              threads also make calls that fail, each with its own error,
+ *              and every thread checks that DBErrno() reports only its own
+ *              errors. The error jump stack is per-thread too; if it were
+ *              shared, a thread inside the library would let others skip
+ *              the API lock and the values read would be garbled.
+ *
+ *              Built only when SILO_ENABLE_THREADSAFE is on.
+ */
+#include <silo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <std.c>
+
+#include <config.h>
+
+#ifdef SILO_THREADSAFE
+#include <pthread.h>
+#endif
+
+#define NTHREADS 8
+#define NITER    20
+#define NX       64
+#define NY       48
+
+static int driver = DB_PDB;
+static int nfailures = 0;
+
+#ifdef SILO_THREADSAFE
+static pthread_mutex_t fail_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void
+fail(int t, int it, char const *msg, int err)
+{
+    pthread_mutex_lock(&fail_lock);
+    fprintf(stderr, "thread %d, iteration %d: %s (DBErrno() = %d)\n",
+        t, it, msg, err);
+    nfailures++;
+    pthread_mutex_unlock(&fail_lock);
+}
+
+static void
+file_name(char *name, int t)
+{
+    sprintf(name, "threadsafe_%d.%s", t, driver == DB_PDB ? "pdb" : "h5");
+}
+
+static int
+write_file(int t)
+{
+    char name[64];
+    float x[NX], y[NY], *v = (float *) malloc(NX*NY*sizeof(float));
+    float *coords[2];
+    int dims[2] = {NX, NY}, i;
+    DBfile *dbfile;
+
+    coords[0] = x;
+    coords[1] = y;
+    for (i = 0; i < NX; i++) x[i] = i;
+    for (i = 0; i < NY; i++) y[i] = i;
+    for (i = 0; i < NX*NY; i++) v[i] = t*10000.0f + i;
+
+    file_name(name, t);
+    if ((dbfile = DBCreate(name, DB_CLOBBER, DB_LOCAL, "thread-safe test",
+             driver)) == NULL)
+    {
+        free(v);
+        return 1;
+    }
+    DBPutQuadmesh(dbfile, "mesh", 0, coords, dims, 2, DB_FLOAT, DB_COLLINEAR, 0);
+    DBPutQuadvar1(dbfile, "v", "mesh", v, dims, 2, 0, 0, DB_FLOAT, DB_NODECENT, 0);
+    DBClose(dbfile);
+    free(v);
+    return 0;
+}
+
+/*
+ * Threads t%4==1 ask for an object that does not exist, threads t%4==3
+ * pass no file and the rest make no failing calls at all. After its first
+ * failure a thread knows what DBErrno() should say after every call. Each
+ * thread's final error is kept so main can check the two kinds of failure
+ * really did report different errors.
+ */
+static int final_errno[NTHREADS];
+
+static void *
+reader(void *arg)
+{
+    int t = (int) (long) arg;
+    int expect = E_NOERROR;
+    int it, i, err;
+    char name[64];
+
+    file_name(name, t);
+    if ((err = DBErrno()) != E_NOERROR)
+        fail(t, -1, "new thread starts with an error", err);
+
+    for (it = 0; it < NITER; it++)
+    {
+        DBfile *dbfile = DBOpen(name, driver, DB_READ);
+        DBquadvar *qv;
+
+        if (!dbfile)
+        {
+            fail(t, it, "DBOpen failed", DBErrno());
+            continue;
+        }
+        if ((err = DBErrno()) != expect)
+            fail(t, it, "DBOpen changed the error", err);
+
+        if ((qv = DBGetQuadvar(dbfile, "v")) == NULL)
+            fail(t, it, "DBGetQuadvar failed", DBErrno());
+        else
+        {
+            float const *vals = (float const *) qv->vals[0];
+            for (i = 0; i < NX*NY; i++)
+            {
+                if (vals[i] != t*10000.0f + i)
+                {
+                    fail(t, it, "read wrong values", DBErrno());
+                    break;
+                }
+            }
+            DBFreeQuadvar(qv);
+        }
+
+        if (t % 4 == 1)
+        {
+            if (DBGetQuadvar(dbfile, "no_such_var") != NULL)
+                fail(t, it, "read a variable that does not exist", DBErrno());
+            if (it == 0)
+                expect = DBErrno();
+        }
+        else if (t % 4 == 3)
+        {
+            if (DBGetQuadvar(NULL, "v") != NULL)
+                fail(t, it, "read from no file", DBErrno());
+            if (it == 0)
+                expect = DBErrno();
+        }
+        if (t % 2 && expect == E_NOERROR)
+            fail(t, it, "failing call set no error", expect);
+        if ((err = DBErrno()) != expect)
+            fail(t, it, "error is not this thread's own", err);
+
+        DBClose(dbfile);
+        if ((err = DBErrno()) != expect)
+            fail(t, it, "DBClose changed the error", err);
+    }
+    final_errno[t] = DBErrno();
+    return NULL;
+}
+#endif
+
+int
+main(int argc, char *argv[])
+{
+    int i, show_all_errors = FALSE;
+#ifdef SILO_THREADSAFE
+    pthread_t threads[NTHREADS];
+#endif
+
+    for (i=1; i<argc; i++) {
+        if (!strncmp(argv[i], "DB_", 3)) {
+            driver = StringToDriver(argv[i]);
+        } else if (!strcmp(argv[i], "show-all-errors")) {
+            show_all_errors = 1;
+        } else if (argv[i][0] != '\0') {
+            fprintf(stderr, "%s: ignored argument `%s'\n", argv[0], argv[i]);
+        }
+    }
+
+#ifndef SILO_THREADSAFE
+    fprintf(stderr, "This test needs a thread-safe build of the library\n");
+    return 0;
+#else
+    /* Write the files first, one at a time. This test is about reading. */
+    DBShowErrors(show_all_errors ? DB_ALL_AND_DRVR : DB_TOP, NULL);
+    for (i = 0; i < NTHREADS; i++)
+    {
+        if (write_file(i))
+        {
+            fprintf(stderr, "unable to write file %d\n", i);
+            return 1;
+        }
+    }
+
+    /* The failures below are expected, so keep them quiet */
+    DBShowErrors(show_all_errors ? DB_ALL_AND_DRVR : DB_NONE, NULL);
+    for (i = 0; i < NTHREADS; i++)
+    {
+        if (pthread_create(&threads[i], NULL, reader, (void *) (long) i))
+        {
+            fprintf(stderr, "unable to start thread %d\n", i);
+            return 1;
+        }
+    }
+    for (i = 0; i < NTHREADS; i++)
+        pthread_join(threads[i], NULL);
+    if (final_errno[1] == final_errno[3])
+    {
+        fprintf(stderr, "both kinds of failure reported error %d\n",
+            final_errno[1]);
+        nfailures++;
+    }
+
+    CleanupDriverStuff();
+    return nfailures ? 1 : 0;
+#endif
+}
@@ -664,6 +664,9 @@ ary_walk1 (obj_t _self, void *mem, int operation, walk_t *wdata) {
  *
  *      Mark C. Miller, Mon Dec  7 07:29:42 PST 2009
  *      Made it descend into arrays of differing type.
+ *
+ *      Skip leading equal elements of numeric arrays with
+ *      prim_diff_first instead of walking them one at a time.
  *-------------------------------------------------------------------------
  */
 static int
@@ -677,6 +680,7 @@ ary_walk2 (obj_t _a, void *a_mem, obj_t _b, void *b_mem, walk_t *wdata) {
     int         *elmtno=NULL;           /*linear element number         */
     int         nleft, nright;          /*print limits                  */
     int         i, j, n, status, differ=0, oldlit;
+    int         start;                  /*first element to walk         */
     int         a_ndims=0, a_dim[NDIMS];
     int         b_ndims=0, b_dim[NDIMS];
     out_t       *f = wdata->f;
@@ -814,13 +818,23 @@ ary_walk2 (obj_t _a, void *a_mem, obj_t _b, void *b_mem, walk_t *wdata) {
         }
     }
 
+    /* Skip the leading run of equal elements with a typed scan when
+     * both arrays hold the same numeric type. */
+    start = -1;
+    if (a_nbytes==b_nbytes) {
+        n = MIN(a_total, b_total);
+        start = prim_diff_first(a->sub, a_mem, b->sub, b_mem, n);
+        if (start==n && a_total==b_total) return 0;
+    }
+    if (start<0) start = 0;
+
     /* Only print array indices if we're doing a full difference. */
     if (DIFF_REP_ALL==DiffOpt.report) {
         elmtno = out_push_array(f, NULL, a_ndims, a->offset, a_dim);
     }
    
     /* Compare and print partial differences. */
-    for (i=0; i<=MAX(a_total,b_total); i++) {
+    for (i=start; i<=MAX(a_total,b_total); i++) {
         if (out_brokenpipe(f)) {
             out_pop (f);
             return -1;
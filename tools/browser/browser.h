@@ -638,6 +638,7 @@ extern prim_assoc_t PA_ZONETYPE[];
 
 obj_t prim_set_io_assoc (obj_t, prim_assoc_t*);
 DBdatatype prim_silotype (obj_t);
+int prim_diff_first (obj_t, void*, obj_t, void*, int);
 void prim_octal(char *buf/*out*/, const void *_mem, size_t nbytes);
 
 /*** range.c ***/
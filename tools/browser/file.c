@@ -311,6 +311,9 @@ void file_reset_hdf5_vfd_options (void) {
             CHECK_SYMBOLN_SYM(DBOPT_H5_FAM_FILE_OPTS)
             CHECK_SYMBOLN_INT(DBOPT_H5_SILO_BLOCK_SIZE)
             CHECK_SYMBOLN_INT(DBOPT_H5_SILO_BLOCK_COUNT)
+            CHECK_SYMBOLN_INT(DBOPT_H5_SILO_WRITE_BEHIND)
+            CHECK_SYMBOLN_INT(DBOPT_H5_SILO_READ_AHEAD)
+            CHECK_SYMBOLN_INT(DBOPT_H5_SILO_META_AT_END)
             free(tmp);
             if (!got_it)
             {
@@ -1162,6 +1162,82 @@ prim_walk2 (obj_t _a, void *a_mem, obj_t _b, void *b_mem, walk_t *wdata)
     return status;
 }
 
+
+/*
+ * Scan two arrays of type T a block at a time.  The first pass over a
+ * block is a branch-free equality test the compiler can vectorize; only
+ * blocks holding an unequal pair are checked against the tolerances.
+ * Equal values are never different under any DiffOpt setting.
+ */
+#define PRIM_DIFF_BLOCK 256
+#define PRIM_DIFF_SCAN(T, DIFF, ABS, REL, EPS) {                        \
+    const T *a_t = (const T*)a_mem;                                     \
+    const T *b_t = (const T*)b_mem;                                     \
+    for (i=0; i<n; i+=PRIM_DIFF_BLOCK) {                                \
+        int m = MIN(PRIM_DIFF_BLOCK, n-i), ne = 0;                      \
+        for (j=0; j<m; j++) ne |= a_t[i+j]!=b_t[i+j];                   \
+        if (!ne) continue;                                              \
+        for (j=0; j<m; j++) {                                           \
+            if (a_t[i+j]!=b_t[i+j] &&                                   \
+                DIFF(a_t[i+j], b_t[i+j], ABS, REL, EPS)) return i+j;    \
+        }                                                               \
+    }                                                                   \
+    return n;                                                           \
+}
+
+/*-------------------------------------------------------------------------
+ * Function:    prim_diff_first
+ *
+ * Purpose:     Finds the first of N consecutive elements of A_MEM and
+ *              B_MEM that prim_walk2 would report as different, without
+ *              walking the elements one object at a time.
+ *
+ * Return:      Success:        Index of the first differing element,
+ *                              or N if all N elements are the same.
+ *
+ *              Failure:        -1 if A and B are not the same numeric
+ *                              primitive type.  The caller should walk
+ *                              the elements instead.
+ *
+ *-------------------------------------------------------------------------
+ */
+int
+prim_diff_first (obj_t _a, void *a_mem, obj_t _b, void *b_mem, int n)
+{
+    obj_prim_t  *a = MYCLASS(_a);
+    obj_prim_t  *b = MYCLASS(_b);
+    int          i, j;
+
+    if (!a || C_PRIM!=a->pub.cls || !b || C_PRIM!=b->pub.cls) return -1;
+    if (a->browser_type!=b->browser_type) return -1;
+
+    switch (a->browser_type) {
+    case BROWSER_INT8:
+        PRIM_DIFF_SCAN(signed char, different,
+                       DiffOpt.c_abs, DiffOpt.c_rel, DiffOpt.c_eps);
+    case BROWSER_SHORT:
+        PRIM_DIFF_SCAN(short, different,
+                       DiffOpt.s_abs, DiffOpt.s_rel, DiffOpt.s_eps);
+    case BROWSER_INT:
+        PRIM_DIFF_SCAN(int, different,
+                       DiffOpt.i_abs, DiffOpt.i_rel, DiffOpt.i_eps);
+    case BROWSER_LONG:
+        PRIM_DIFF_SCAN(long, different,
+                       DiffOpt.l_abs, DiffOpt.l_rel, DiffOpt.l_eps);
+    case BROWSER_LONG_LONG:
+        PRIM_DIFF_SCAN(long long, differentll,
+                       DiffOpt.ll_abs, DiffOpt.ll_rel, DiffOpt.ll_eps);
+    case BROWSER_FLOAT:
+        PRIM_DIFF_SCAN(float, different,
+                       DiffOpt.f_abs, DiffOpt.f_rel, DiffOpt.f_eps);
+    case BROWSER_DOUBLE:
+        PRIM_DIFF_SCAN(double, different,
+                       DiffOpt.d_abs, DiffOpt.d_rel, DiffOpt.d_eps);
+    }
+    return -1;
+}
+
+
 
 /*-------------------------------------------------------------------------
  * Function:    prim_walk3
@@ -61,6 +61,12 @@ be used for advertising or product endorsement purposes.
  *      Mark C. Miller, Thu Nov  5 10:49:43 PST 2009
  *      Added logic to handle an HDF5 file without friendly names.
  *      Added isinf to test for valid float/double.
+ *
+ *      Check values a block at a time with branch-free exponent tests,
+ *      scan each array on a second thread while the next one is read,
+ *      add -summary to stop reading an array at its first bad value and
+ *      accept several files, scanning them concurrently with -j when
+ *      the Silo library is thread-safe.
  *-------------------------------------------------------------------------
  */
 #include <config.h>
@@ -75,11 +81,18 @@ be used for advertising or product endorsement purposes.
 #ifdef HAVE_IEEEFP_H
 #include <ieeefp.h>
 #endif
+#if defined(HAVE_PTHREAD_H) && !defined(_WIN32)
+#define SILOCK_THREADS
+#include <pthread.h>
+#endif
 
 #define True                    1
 #define False                   0
 #define UPDATE_INTERVAL         5      /* seconds */
-#define INITIAL_CHECK_RATE      500000 /* tests per second */
+#define SCAN_BLOCK              4096   /* values per exponent test block */
+#define SLAB_VALUES             (1<<20)/* values per read with -summary */
+#define MAX_DIMS                32
+#define MAX_JOBS                64
 
 
 /* if isnan is not available, this tool cannot operate. So, we define
@@ -95,20 +108,53 @@ be used for advertising or product endorsement purposes.
 
 int disableProgress;
 int disableVerbose;
-int totalBytes;
-char fileName[1024];
-
-int fBufSize;
-int dBufSize;
-float  *fBuf;
-double *dBuf;
+int summaryOnly;
+
+/* A piece of an array on its way from the reader to the scanner. Without
+   -summary a piece is a whole array. With -summary it is a slab of rows
+   so reading can stop at the first bad value. Pieces of type DB_NOTYPE
+   carry only the name of an array that is skipped. */
+typedef struct scanPiece_t {
+   int     dbType;
+   int     varSeq;                      /* which array of the file */
+   int     first;                       /* first piece of its array? */
+   int     offset;                      /* index of the first value */
+   int     n;                           /* number of values */
+   int     full;                        /* waiting to be scanned? */
+   size_t  bufSize;
+   void   *buf;
+   char    theDir[1024];
+   char    varName[1024];
+} scanPiece_t;
+
+/* Everything needed to scan one file. The reader fills the two pieces
+   in turn while the scanner thread empties them, so reading one array
+   overlaps checking the one before it. All output for the file is
+   written by the scanner, in order, to OUT. */
+typedef struct scanState_t {
+   FILE        *out;
+   long long    totalBytes;
+   long long    processedBytes;
+   double       tLast;
+   char         lastDir[1024], lastVar[1024];
+   int          badVarSeq;              /* last array cut short */
+   int          fillNext, scanNext;
+   scanPiece_t  pieces[2];
+#ifdef SILOCK_THREADS
+   int          threaded;
+   int          done;
+   pthread_t    scanner;
+   pthread_mutex_t lock;
+   pthread_cond_t  cond;
+#endif
+} scanState_t;
 
 
 /* this function is only called if a NaN issue has been discovered */
 static void
-handleInvalidValue(char *theDir, char *varName, int index, double value)
+handleInvalidValue(scanState_t *st, char *theDir, char *varName, int index,
+   double value)
 {
-   static char lastDir[1024], lastVar[1024];
    char errMsg[128];
 
    /* try to produce a useful error message regarding the kind of NaN */
@@ -135,26 +181,27 @@ handleInvalidValue(char *theDir, char *varName, int index, double value)
    if (!disableVerbose)
    {
       /* strip off leading slash for root dir */
-      if (strcmp(lastDir, theDir) || strcmp(lastVar, varName))
+      if (strcmp(st->lastDir, theDir) || strcmp(st->lastVar, varName))
       {
          if (!strcmp(theDir,"/"))
-            printf("   simple array /%s...\n", varName);
+            fprintf(st->out, "   simple array /%s...\n", varName);
          else
-            printf("   simple array %s/%s...\n", theDir, varName);
+            fprintf(st->out, "   simple array %s/%s...\n", theDir, varName);
       }
-      printf("   ...has %s issue at index %d\n", errMsg, index);
+      fprintf(st->out, "   ...has %s issue at index %d\n", errMsg, index);
    }
    else
    {
       /* early termination of we not using verbose mode */
+      fflush(st->out);
       printf("   found %s issue\n", errMsg);
       exit(-1);
    }
 
    /* keep a record of last dir and varname we used so we don't keep
       issuing the `  simple array ... statement ' */
-   strcpy(lastDir, theDir);
-   strcpy(lastVar, varName);
+   strcpy(st->lastDir, theDir);
+   strcpy(st->lastVar, varName);
 }
 
 
@@ -163,53 +210,298 @@ handleInvalidValue(char *theDir, char *varName, int index, double value)
    of bytes in the file is primarily float and double data. Of course, there
    can be a lot of integer data too, but rarely is it more than 10-20% of
    the whole file. So, our % complete measure is a rough approximation that
-   is always an underestimate. Next, we would like to update the user about
-   progress on an elapsed time basis. So, we need to know how much time has
-   gone by. However, if we call gettimeofday after every NaN test, that would
-   kill us! So, we predict how long in the future, in terms of number of
-   NaN checks, we can go before we need to peek at the time. Then, we call
-   gettimeofday. At that point, we know how much time has passed since the
-   last call and we know how many checks we've done. We can compute the
-   current check rate and a new count of checks into the future before we
-   need to call gettimeofday again. */
+   is always an underestimate. Progress is reported on an elapsed time
+   basis. Values are checked a block at a time, so looking at the time once
+   per block is cheap enough that we need not predict when to do it. */
 static void
-updateProgress(int bytes)
+updateProgress(scanState_t *st, long long bytes)
 {
-   static int nextUpdate;
-   static int processedBytes;
-   static int checksPerformed;
-   static double tLast;
    struct timeval timeVal;
-   struct timezone timeZone;
+   double tNow;
+
+   gettimeofday(&timeVal, NULL);
+   tNow = (double) timeVal.tv_sec + (double) timeVal.tv_usec * 1.0E-6;
 
    /* bytes==0 ==> initialization */
    if (bytes == 0)
    {
-      nextUpdate = INITIAL_CHECK_RATE * UPDATE_INTERVAL;
-      processedBytes = 0;
-      checksPerformed = 0;
-      gettimeofday(&timeVal, &timeZone);
-      tLast = (double) timeVal.tv_sec + (double) timeVal.tv_usec * 1.0E-6;
+      st->processedBytes = 0;
+      st->tLast = tNow;
+      return;
    }
-   else
+
+   st->processedBytes += bytes;
+   if (tNow - st->tLast >= UPDATE_INTERVAL)
    {
+      fprintf(st->out, "\n*** %2d %% completed ***\n", st->totalBytes ?
+         (int) (st->processedBytes*100/st->totalBytes) : 0);
+      st->tLast = tNow;
+   }
+}
 
-      processedBytes += bytes;
-      checksPerformed++;
 
-      if (checksPerformed >= nextUpdate)
+/* A float or double is a NaN or an infinity exactly when all of its
+   exponent bits are set. These count such values in a block without a
+   branch per value so that the compiler can vectorize the loops. The
+   values are copied to integers with memcpy to avoid aliasing them. */
+static int
+countBadFloats(const float *vals, int n)
+{
+   int j, nbad = 0;
+
+   for (j = 0; j < n; j++)
+   {
+      unsigned int bits;
+      memcpy(&bits, &vals[j], sizeof(bits));
+      nbad += (bits & 0x7f800000U) == 0x7f800000U;
+   }
+   return nbad;
+}
+
+static int
+countBadDoubles(const double *vals, int n)
+{
+   int j, nbad = 0;
+
+   for (j = 0; j < n; j++)
+   {
+      unsigned long long bits;
+      memcpy(&bits, &vals[j], sizeof(bits));
+      nbad += (bits & 0x7ff0000000000000ULL) == 0x7ff0000000000000ULL;
+   }
+   return nbad;
+}
+
+
+/* Check one piece of an array. Blocks without a bad value cost one
+   exponent test per value. Only blocks that have one are walked value by
+   value to report each bad value. With -summary we stop at the first and
+   return 1 so the caller can tell the reader to skip the rest of it. */
+static int
+scanPiece(scanState_t *st, scanPiece_t *p)
+{
+   int size = p->dbType == DB_FLOAT ? sizeof(float) : sizeof(double);
+   int j0, j, m, nbad;
+
+   if (p->first && !disableVerbose)
+   {
+      if (p->dbType == DB_FLOAT || p->dbType == DB_DOUBLE)
+         fprintf(st->out, "CHECKING array %-56s\r", p->varName);
+      else
+         fprintf(st->out, "skipping array %-56s\r", p->varName);
+   }
+
+   if (p->dbType != DB_FLOAT && p->dbType != DB_DOUBLE)
+      return 0;
+
+   /* rest of an array already cut short */
+   if (p->varSeq == st->badVarSeq)
+      return 0;
+
+   for (j0 = 0; j0 < p->n; j0 += SCAN_BLOCK)
+   {
+      m = p->n - j0 < SCAN_BLOCK ? p->n - j0 : SCAN_BLOCK;
+
+      if (p->dbType == DB_FLOAT)
+         nbad = countBadFloats((float *) p->buf + j0, m);
+      else
+         nbad = countBadDoubles((double *) p->buf + j0, m);
+
+      for (j = j0; nbad && j < j0 + m; j++)
       {
-         double currentCheckRate;
-         double tNow;
+         double value;
+
+         if (p->dbType == DB_FLOAT)
+         {
+            if (IS_VALID_FLOAT(((float *) p->buf)[j]))
+               continue;
+            value = (double) ((float *) p->buf)[j];
+         }
+         else
+         {
+            if (IS_VALID_DOUBLE(((double *) p->buf)[j]))
+               continue;
+            value = ((double *) p->buf)[j];
+         }
+
+         handleInvalidValue(st, p->theDir, p->varName, p->offset + j, value);
+         nbad--;
+
+         if (summaryOnly)
+            return 1;
+      }
+
+      if (!disableProgress)
+         updateProgress(st, (long long) m * size);
+   }
+   return 0;
+}
+
+
+#ifdef SILOCK_THREADS
+static void *
+scanThread(void *arg)
+{
+   scanState_t *st = (scanState_t *) arg;
+   int isBad;
+
+   pthread_mutex_lock(&st->lock);
+   for (;;)
+   {
+      scanPiece_t *p = &st->pieces[st->scanNext];
+
+      while (!p->full && !st->done)
+         pthread_cond_wait(&st->cond, &st->lock);
+      if (!p->full)
+         break;
+
+      pthread_mutex_unlock(&st->lock);
+      isBad = scanPiece(st, p);
+      pthread_mutex_lock(&st->lock);
+
+      if (isBad)
+         st->badVarSeq = p->varSeq;
+      p->full = False;
+      st->scanNext ^= 1;
+      pthread_cond_broadcast(&st->cond);
+   }
+   pthread_mutex_unlock(&st->lock);
+   return NULL;
+}
+#endif
 
-         printf("\n*** %2d %% completed ***\n", processedBytes*100/totalBytes);
 
-         gettimeofday(&timeVal, &timeZone);
-         tNow = (double) timeVal.tv_sec + (double) timeVal.tv_usec * 1.0E-6;
-         currentCheckRate = checksPerformed / (tNow - tLast);
-         nextUpdate += (currentCheckRate * UPDATE_INTERVAL);
-         tLast = tNow;
+/* Wait for the next piece to be free and make sure its buffer holds
+   NBYTES. Also tells the caller whether array VARSEQ was cut short. */
+static scanPiece_t *
+getEmptyPiece(scanState_t *st, size_t nbytes, int varSeq, int *isBad)
+{
+   scanPiece_t *p = &st->pieces[st->fillNext];
+
+#ifdef SILOCK_THREADS
+   if (st->threaded)
+   {
+      pthread_mutex_lock(&st->lock);
+      while (p->full)
+         pthread_cond_wait(&st->cond, &st->lock);
+      *isBad = st->badVarSeq == varSeq;
+      pthread_mutex_unlock(&st->lock);
+   }
+   else
+#endif
+      *isBad = st->badVarSeq == varSeq;
+
+   /* increase allocated buffer if necessary */
+   if (nbytes > p->bufSize)
+   {
+      if (p->buf != NULL)
+         free(p->buf);
+      p->buf = malloc(nbytes);
+      p->bufSize = p->buf ? nbytes : 0;
+   }
+   return p;
+}
+
+static void
+putFullPiece(scanState_t *st, scanPiece_t *p)
+{
+   st->fillNext ^= 1;
+
+#ifdef SILOCK_THREADS
+   if (st->threaded)
+   {
+      pthread_mutex_lock(&st->lock);
+      p->full = True;
+      pthread_cond_broadcast(&st->cond);
+      pthread_mutex_unlock(&st->lock);
+      return;
+   }
+#endif
+
+   if (scanPiece(st, p))
+      st->badVarSeq = p->varSeq;
+   st->scanNext ^= 1;
+}
+
+
+/* Read one float or double array into pieces. Without -summary the whole
+   array is one piece. With -summary it is read in slabs of its slowest
+   varying dimension and reading stops once the scanner has found a bad
+   value in it. */
+static void
+readSiloArray(scanState_t *st, DBfile *siloFile, char *theDir, char *varName,
+   int varSeq, int n, int dbType)
+{
+   int size = dbType == DB_FLOAT ? sizeof(float) : sizeof(double);
+   int dims[MAX_DIMS], offset[MAX_DIMS], length[MAX_DIMS], stride[MAX_DIMS];
+   int ndims = 0, rowSize = 1, rowsPerSlab, row, i, isBad;
+   scanPiece_t *p;
+
+   /* nothing to read, but still say we checked it */
+   if (n <= 0)
+   {
+      p = getEmptyPiece(st, 0, varSeq, &isBad);
+      p->dbType = dbType;
+      p->varSeq = varSeq;
+      p->first = True;
+      p->offset = 0;
+      p->n = 0;
+      strncpy(p->theDir, theDir, sizeof(p->theDir)-1);
+      strncpy(p->varName, varName, sizeof(p->varName)-1);
+      putFullPiece(st, p);
+      return;
+   }
+
+   if (summaryOnly && n > SLAB_VALUES)
+      ndims = DBGetVarDims(siloFile, varName, MAX_DIMS, dims);
+   for (i = 1; i < ndims; i++)
+      rowSize *= dims[i];
+   if (ndims < 1 || dims[0] * rowSize != n)
+   {
+      ndims = 1;
+      dims[0] = n;
+      rowSize = 1;
+      rowsPerSlab = n;
+   }
+   else
+   {
+      rowsPerSlab = SLAB_VALUES / rowSize;
+      if (rowsPerSlab < 1)
+         rowsPerSlab = 1;
+   }
+
+   for (row = 0; row < dims[0]; row += rowsPerSlab)
+   {
+      int nrows = dims[0] - row < rowsPerSlab ? dims[0] - row : rowsPerSlab;
+
+      p = getEmptyPiece(st, (size_t) nrows * rowSize * size, varSeq, &isBad);
+      if (isBad || p->buf == NULL)
+         break;
+
+      if (nrows == dims[0])
+      {
+         DBReadVar(siloFile, varName, p->buf);
+      }
+      else
+      {
+         for (i = 0; i < ndims; i++)
+         {
+            offset[i] = i ? 0 : row;
+            length[i] = i ? dims[i] : nrows;
+            stride[i] = 1;
+         }
+         DBReadVarSlice(siloFile, varName, offset, length, stride, ndims,
+            p->buf);
       }
+
+      p->dbType = dbType;
+      p->varSeq = varSeq;
+      p->first = row == 0;
+      p->offset = row * rowSize;
+      p->n = nrows * rowSize;
+      strncpy(p->theDir, theDir, sizeof(p->theDir)-1);
+      strncpy(p->varName, varName, sizeof(p->varName)-1);
+      putFullPiece(st, p);
    }
 }
 
@@ -218,16 +510,13 @@ updateProgress(int bytes)
    in the file. Ultimately, the data associated with all of Silo's abstract
    objects, excpet for object headers, is implemented in terms of simple
    arrays. This function finds all the simple arrays in the current dir
-   and for each float or double array, reads it and examines it for NaNs.
-   To avoid constantly allocating and freeing the buffers for arrays, we
-   simply keep a growing buffer that grows to the largest array in the file
-   and is freed only upon exit. We use Silo's non-allocating simple array
-   read function. To make the loops for checking a NaN as fast as possible,
-   we have two versions of the loop, one where progress is checked and 
-   one where progress is not checked. We first examine all the simple
-   arrays in the current dir, then we loop over subdirs and recurse */
+   and hands each float or double array to the scanner to examine it for
+   NaNs. The array buffers grow to the largest array (or slab) in the file
+   and are freed only when the file is done. We use Silo's non-allocating
+   simple array read functions. We first examine all the simple arrays in
+   the current dir, then we loop over subdirs and recurse */
 static void
-scanSiloDir(DBfile *siloFile, char *theDir)
+scanSiloDir(scanState_t *st, DBfile *siloFile, char *theDir, int *varSeq)
 {
    char **dirNames;
    int i,nDirs,nObjects;
@@ -250,77 +539,23 @@ scanSiloDir(DBfile *siloFile, char *theDir)
       char *varName = toc->var_names[i];
       int n         = DBGetVarLength(siloFile, varName);
       int dbType    = DBGetVarType(siloFile, varName);
-      int j;
 
-      if (!disableVerbose)
-      {
-         if (dbType == DB_FLOAT || dbType == DB_DOUBLE)
-            printf("CHECKING array %-56s\r", varName);
-         else
-            printf("skipping array %-56s\r", varName);
-      }
+      (*varSeq)++;
 
-      /* for float arrays */
-      if (dbType == DB_FLOAT)
+      if (dbType == DB_FLOAT || dbType == DB_DOUBLE)
       {
-
-         /* increase allocated buffer if necessary */
-         if (n*sizeof(float) > fBufSize)
-         {
-            if (fBuf != NULL)
-               free(fBuf);
-            fBuf = (float *) malloc(n * sizeof(float));
-            fBufSize = n;
-         }
-
-         DBReadVar(siloFile, varName, fBuf);
-
-         if (disableProgress)
-         {
-            for (j = 0; j < n; j++)
-               if (!IS_VALID_FLOAT(fBuf[j]))
-                  handleInvalidValue(theDir, varName, j, (double) fBuf[j]);
-         }
-         else
-         {
-            for (j = 0; j < n; j++)
-            {
-               if (!IS_VALID_FLOAT(fBuf[j]))
-                  handleInvalidValue(theDir, varName, j, (double) fBuf[j]);
-               updateProgress(sizeof(float));
-            }
-         }
+         readSiloArray(st, siloFile, theDir, varName, *varSeq, n, dbType);
       }
-
-      /* for double arrays */
-      if (dbType == DB_DOUBLE)
+      else if (!disableVerbose)
       {
-         /* increase allocated buffer if necessary */
-         if (n*sizeof(double) > dBufSize)
-         {
-            if (dBuf != NULL)
-               free(dBuf);
-            dBuf = (double *) malloc(n * sizeof(double));
-            dBufSize = n;
-         }
-
-         DBReadVar(siloFile, varName, dBuf);
-
-         if (disableProgress)
-         {
-            for (j = 0; j < n; j++)
-               if (!IS_VALID_DOUBLE(dBuf[j]))
-                  handleInvalidValue(theDir, varName, j, dBuf[j]);
-         }
-         else
-         {
-            for (j = 0; j < n; j++)
-            {
-               if (!IS_VALID_DOUBLE(dBuf[j]))
-                  handleInvalidValue(theDir, varName, j, dBuf[j]);
-               updateProgress(sizeof(double));
-            }
-         }
+         int isBad;
+         scanPiece_t *p = getEmptyPiece(st, 0, *varSeq, &isBad);
+         p->dbType = DB_NOTYPE;
+         p->varSeq = *varSeq;
+         p->first = True;
+         p->n = 0;
+         strncpy(p->varName, varName, sizeof(p->varName)-1);
+         putFullPiece(st, p);
       }
    } /* for i */
 
@@ -338,7 +573,7 @@ scanSiloDir(DBfile *siloFile, char *theDir)
    for (i = 0; i < nDirs; i++)
    {
       DBSetDir(siloFile, dirNames[i]);
-      scanSiloDir(siloFile, dirNames[i]); 
+      scanSiloDir(st, siloFile, dirNames[i], varSeq);
       DBSetDir(siloFile, "..");
       free(dirNames[i]);
    }
@@ -349,21 +584,214 @@ scanSiloDir(DBfile *siloFile, char *theDir)
 }
 
 
+/* Scan one file, writing everything but errors to OUT. Returns -1 if the
+   file could not be opened. */
+static int
+scanSiloFile(char *fileName, char *progName, FILE *out, int toggleErrors)
+{
+   scanState_t st;
+   struct stat stat_buf;
+   DBfile *siloFile;
+   int varSeq = 0;
+
+   memset(&st, 0, sizeof(st));
+   st.out = out;
+   st.badVarSeq = -1;
+   if (stat(fileName, &stat_buf) == 0)
+      st.totalBytes = stat_buf.st_size;
+
+   /* initialize progress meter */
+   updateProgress(&st, 0);
+
+   if (toggleErrors)
+      DBShowErrors(DB_NONE, NULL);
+
+   siloFile = DBOpen(fileName, DB_UNKNOWN, DB_READ);
+
+   if (toggleErrors)
+      DBShowErrors(DB_TOP, NULL);
+
+   if (siloFile == NULL)
+   {
+      fprintf(stderr, "unable to open silo file \"%s\"\n", fileName);
+      return -1;
+   }
+
+#ifdef SILOCK_THREADS
+   pthread_mutex_init(&st.lock, NULL);
+   pthread_cond_init(&st.cond, NULL);
+   st.threaded = !pthread_create(&st.scanner, NULL, scanThread, &st);
+#endif
+
+   if (DBGetDriverType(siloFile) == DB_HDF5 && !DBGuessHasFriendlyHDF5Names(siloFile))
+   {
+       fprintf(stderr,"WARNING: This is an HDF5 file without \"Friendly\" HDF5 array names.\n");
+       fprintf(stderr,"WARNING: Consequently, while %s will be able to find/detect nans/infs,\n",
+           strrchr(progName,'/')?strrchr(progName,'/')+1:progName);
+       fprintf(stderr,"WARNING: the names of the arrays in which it finds them will be cryptic.\n");
+       fprintf(stderr,"WARNING: You will most likely have to use h5ls/h5dump to determine which\n");
+       fprintf(stderr,"WARNING: Silo objects are involved.\n");
+       DBSetDir(siloFile, "/.silo");
+       scanSiloDir(&st, siloFile, "/.silo", &varSeq);
+   }
+   else
+   {
+       scanSiloDir(&st, siloFile, "/", &varSeq);
+   }
+
+#ifdef SILOCK_THREADS
+   if (st.threaded)
+   {
+      pthread_mutex_lock(&st.lock);
+      st.done = True;
+      pthread_cond_broadcast(&st.cond);
+      pthread_mutex_unlock(&st.lock);
+      pthread_join(st.scanner, NULL);
+   }
+   pthread_cond_destroy(&st.cond);
+   pthread_mutex_destroy(&st.lock);
+#endif
+
+   DBClose(siloFile);
+
+   if (st.pieces[0].buf != NULL)
+      free(st.pieces[0].buf);
+   if (st.pieces[1].buf != NULL)
+      free(st.pieces[1].buf);
+
+   if (!disableProgress)
+      fprintf(out, "\n*** 100 %% completed ***\n");
+
+   if (!disableVerbose)
+      fprintf(out, "\n");
+
+   return 0;
+}
+
+
+#if defined(SILOCK_THREADS) && defined(SILO_THREADSAFE)
+/* With -j, several files are scanned at once. Each file's output goes to
+   a temporary file that main copies to stdout in command line order as
+   soon as the file is done. */
+typedef struct fileJobs_t {
+   char          **fileNames;
+   char           *progName;
+   int             nFiles;
+   int             next;
+   FILE          **outs;
+   int            *status;
+   int            *finished;
+   pthread_mutex_t lock;
+   pthread_cond_t  cond;
+} fileJobs_t;
+
+static void *
+fileThread(void *arg)
+{
+   fileJobs_t *jobs = (fileJobs_t *) arg;
+
+   for (;;)
+   {
+      int k, status;
+
+      pthread_mutex_lock(&jobs->lock);
+      k = jobs->next < jobs->nFiles ? jobs->next++ : -1;
+      pthread_mutex_unlock(&jobs->lock);
+      if (k < 0)
+         break;
+
+      status = jobs->outs[k] ? scanSiloFile(jobs->fileNames[k],
+         jobs->progName, jobs->outs[k], False) : -1;
+
+      pthread_mutex_lock(&jobs->lock);
+      jobs->status[k] = status;
+      jobs->finished[k] = True;
+      pthread_cond_broadcast(&jobs->cond);
+      pthread_mutex_unlock(&jobs->lock);
+   }
+   return NULL;
+}
+
+static int
+scanSiloFiles(char **fileNames, int nFiles, int nJobs, char *progName)
+{
+   pthread_t threads[MAX_JOBS];
+   int started[MAX_JOBS];
+   fileJobs_t jobs;
+   int i, k, c, result = 0;
+
+   jobs.fileNames = fileNames;
+   jobs.progName = progName;
+   jobs.nFiles = nFiles;
+   jobs.next = 0;
+   jobs.outs = (FILE **) calloc(nFiles, sizeof(FILE*));
+   jobs.status = (int *) calloc(nFiles, sizeof(int));
+   jobs.finished = (int *) calloc(nFiles, sizeof(int));
+   pthread_mutex_init(&jobs.lock, NULL);
+   pthread_cond_init(&jobs.cond, NULL);
+   for (k = 0; k < nFiles; k++)
+      jobs.outs[k] = tmpfile();
+
+   for (i = 0; i < nJobs; i++)
+      started[i] = !pthread_create(&threads[i], NULL, fileThread, &jobs);
+
+   /* if no thread could be started, do the work here */
+   for (i = 0; i < nJobs && !started[i]; i++)
+      ;
+   if (i == nJobs)
+      fileThread(&jobs);
+
+   for (k = 0; k < nFiles; k++)
+   {
+      pthread_mutex_lock(&jobs.lock);
+      while (!jobs.finished[k])
+         pthread_cond_wait(&jobs.cond, &jobs.lock);
+      pthread_mutex_unlock(&jobs.lock);
+
+      printf("%s:\n", fileNames[k]);
+      if (jobs.outs[k])
+      {
+         rewind(jobs.outs[k]);
+         while ((c = getc(jobs.outs[k])) != EOF)
+            putchar(c);
+         fclose(jobs.outs[k]);
+      }
+      else
+      {
+         fprintf(stderr, "unable to create temporary file for \"%s\"\n",
+            fileNames[k]);
+      }
+      fflush(stdout);
+      if (jobs.status[k] < 0)
+         result = -1;
+   }
+
+   for (i = 0; i < nJobs; i++)
+      if (started[i])
+         pthread_join(threads[i], NULL);
+
+   pthread_cond_destroy(&jobs.cond);
+   pthread_mutex_destroy(&jobs.lock);
+   free(jobs.outs);
+   free(jobs.status);
+   free(jobs.finished);
+   return result;
+}
+#endif
+
+
 int
 main(int argc, char *argv[])
 {
-   int i;
-   DBfile *siloFile;
+   int i, nFiles = 0, nJobs = 1, result = 0;
+   char **fileNames;
 
    /* set default values */
    disableProgress = False;
    disableVerbose  = False;
+   summaryOnly     = False;
 
-   /* initialization */
-   fBufSize = 0;
-   dBufSize = 0;
-   fBuf = NULL;
-   dBuf = NULL;
+   fileNames = (char **) malloc(argc * sizeof(char*));
 
    /* here's where we issue an error message if we have no isnan() test */
 #ifndef HAVE_ISNAN
@@ -379,78 +807,82 @@ main(int argc, char *argv[])
          disableProgress = True;
       else if (!strcmp(argv[i], "-q"))
          disableVerbose = True;
+      else if (!strcmp(argv[i], "-summary"))
+         summaryOnly = True;
+      else if (!strcmp(argv[i], "-j") && i+1 < argc)
+         nJobs = atoi(argv[++i]);
+      else if (!strncmp(argv[i], "-j", 2) && argv[i][2])
+         nJobs = atoi(argv[i]+2);
       else if (!strcmp(argv[i], "-help"))
       {
-         fprintf(stderr,"Scan a silo file for NaN/Inf floating point data\n"); 
+         fprintf(stderr,"Scan a silo file for NaN/Inf floating point data\n");
          fprintf(stderr,"Warning: As a precaution, you should use this tool\n");
          fprintf(stderr,"         only on the same class of platform the\n");
          fprintf(stderr,"         data was generated on.\n");
-         fprintf(stderr,"usage: silock [-q] [-progress]"
-            " silofile\n");
+         fprintf(stderr,"usage: silock [-q] [-progress] [-summary] [-j N]"
+            " silofile [silofile...]\n");
          fprintf(stderr,"available options...\n");
          fprintf(stderr,"   -progress: Disable progress display\n");
          fprintf(stderr,"   -q:        Quiet. Report only if bad values\n");
          fprintf(stderr,"              exist and exit on first occurence\n");
+         fprintf(stderr,"   -summary:  Report only the first bad value of\n");
+         fprintf(stderr,"              each array and stop reading it there\n");
+         fprintf(stderr,"   -j N:      Scan up to N files at once. Needs a\n");
+         fprintf(stderr,"              thread-safe Silo library. Disables\n");
+         fprintf(stderr,"              the progress display\n");
          exit(-1);
       }
       else /* assume its a file and try to open it */
       {
          struct stat stat_buf;
 
-         strncpy(fileName, argv[i], sizeof(fileName)-1);
-         if (stat(fileName, &stat_buf) != 0)
+         if (stat(argv[i], &stat_buf) != 0)
          {
             fprintf(stderr,"unrecognized option \"%s\". Use -help for usage\n",
-               fileName);
+               argv[i]);
             exit(-1);
          }
-         totalBytes = stat_buf.st_size;
+         fileNames[nFiles++] = argv[i];
       }
    }
 
-   /* initialize progress meter */
-   updateProgress(0);
-
-   DBShowErrors(DB_NONE, NULL);
-
-   siloFile = DBOpen(fileName, DB_UNKNOWN, DB_READ);
-
-   if (siloFile == NULL)
+   if (nFiles == 0)
    {
-      fprintf(stderr, "unable to open silo file \"%s\"\n", fileName);
+      fprintf(stderr,"no silo file given. Use -help for usage\n");
       exit(-1);
    }
 
-   DBShowErrors(DB_TOP, NULL);
+   if (nJobs < 1)
+      nJobs = 1;
+   if (nJobs > MAX_JOBS)
+      nJobs = MAX_JOBS;
+   if (nJobs > nFiles)
+      nJobs = nFiles;
 
-   if (DBGetDriverType(siloFile) == DB_HDF5 && !DBGuessHasFriendlyHDF5Names(siloFile))
+#if defined(SILOCK_THREADS) && defined(SILO_THREADSAFE)
+   if (nJobs > 1)
    {
-       fprintf(stderr,"WARNING: This is an HDF5 file without \"Friendly\" HDF5 array names.\n");
-       fprintf(stderr,"WARNING: Consequently, while %s will be able to find/detect nans/infs,\n",
-           strrchr(argv[0],'/')?strrchr(argv[0],'/')+1:argv[0]);
-       fprintf(stderr,"WARNING: the names of the arrays in which it finds them will be cryptic.\n");
-       fprintf(stderr,"WARNING: You will most likely have to use h5ls/h5dump to determine which\n");
-       fprintf(stderr,"WARNING: Silo objects are involved.\n");
-       DBSetDir(siloFile, "/.silo");
-       scanSiloDir(siloFile, "/.silo");
+      disableProgress = True;
+      DBShowErrors(DB_TOP, NULL);
+      result = scanSiloFiles(fileNames, nFiles, nJobs, argv[0]);
+      free(fileNames);
+      return result;
    }
-   else
+#endif
+
+   for (i = 0; i < nFiles; i++)
    {
-       scanSiloDir(siloFile, "/");
+      if (nFiles > 1)
+         printf("%s:\n", fileNames[i]);
+      if (scanSiloFile(fileNames[i], argv[0], stdout, True) < 0)
+      {
+         if (nFiles == 1)
+            exit(-1);
+         result = -1;
+      }
+      fflush(stdout);
    }
 
-   DBClose(siloFile);
-
-   if (fBuf != NULL)
-      free(fBuf);
-   if (dBuf != NULL)
-      free(dBuf);
-
-   if (!disableProgress)
-      printf("\n*** 100 %% completed ***\n");
-
-   if (!disableVerbose)
-      printf("\n");
-
-   return 0;
+   free(fileNames);
+   return result;
 }